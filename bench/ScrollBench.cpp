@@ -0,0 +1,202 @@
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QGuiApplication>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QQmlComponent>
+#include <QQmlContext>
+#include <QQmlEngine>
+#include <QQuickItem>
+#include <QQuickWindow>
+#include <QSGRendererInterface>
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "PlaylistModel.h"
+
+// Scripted fast scroll through a large queue, rendered with the same delegate as the app.
+// The bench pins the software renderer so numbers are repeatable across machines. Reports
+// per-frame times rather than a single average, since what is noticed is the slow frames.
+//
+//   musicplayer_scrollbench [--rows 50000] [--frames 600] [--step 240] [--json out.json]
+//
+// Frame time runs from the start of a frame (animations advanced) to the swap, so it covers
+// delegate creation, bindings, polish and rendering; the interval is swap to swap.
+
+namespace {
+
+constexpr int WarmupFrames = 30;
+constexpr double FrameBudgetMs = 1000.0 / 60;
+
+const char ViewSource[] = R"(
+import QtQuick
+
+Window {
+    width: 480
+    height: 800
+    visible: true
+
+    ListView {
+        objectName: "view"
+        anchors.fill: parent
+        clip: true
+        reuseItems: true
+        model: tracks
+        delegate: TrackDelegate {
+            width: ListView.view.width
+            current: ListView.isCurrentItem
+        }
+    }
+}
+)";
+
+QVector<PlaylistModel::Item> syntheticItems(int rows)
+{
+    static const char* const Genres[] = {"Rock", "Jazz", "Electronic", "Classical", "Folk"};
+    QVector<PlaylistModel::Item> items;
+    items.reserve(rows);
+    for (int i = 0; i < rows; ++i) {
+        PlaylistModel::Item item;
+        item.artist = QStringLiteral("Artist %1").arg(i / 120);
+        item.album = QStringLiteral("Album %1").arg(i / 12);
+        item.title = QStringLiteral("Track %1 with a title long enough to be elided").arg(i);
+        item.location = QStringLiteral("/music/%1/%2/%3.flac").arg(item.artist, item.album).arg(i % 12 + 1);
+        item.display = item.artist + QStringLiteral(" - ") + item.title;
+        item.genre = QLatin1String(Genres[i % 5]);
+        item.year = QString::number(1970 + i % 50);
+        item.trackNumber = i % 12 + 1;
+        item.duration = 120'000 + (i * 7919) % 300'000;
+        items.append(item);
+    }
+    return items;
+}
+
+double percentile(std::vector<double> sorted, double p)
+{
+    if (sorted.empty()) return 0;
+    const size_t i = std::min(sorted.size() - 1, size_t(p * (sorted.size() - 1) + 0.5));
+    return sorted[i];
+}
+
+QJsonObject summarize(const char* label, std::vector<double> samples)
+{
+    std::sort(samples.begin(), samples.end());
+    const long overBudget = std::count_if(samples.begin(), samples.end(), [](double ms) { return ms > FrameBudgetMs; });
+    QJsonObject stats {
+        {"p50", percentile(samples, 0.50)},
+        {"p95", percentile(samples, 0.95)},
+        {"p99", percentile(samples, 0.99)},
+        {"max", samples.empty() ? 0.0 : samples.back()},
+        {"overBudget", int(overBudget)},
+    };
+    std::printf("%-16s p50 %6.2f  p95 %6.2f  p99 %6.2f  max %6.2f ms  over %.1f ms: %ld\n", label,
+                stats["p50"].toDouble(), stats["p95"].toDouble(), stats["p99"].toDouble(), stats["max"].toDouble(),
+                FrameBudgetMs, overBudget);
+    return stats;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QGuiApplication app(argc, argv);
+    // Pinned to the software renderer, the worst case: the app falls back to it when no
+    // hardware API comes up, and it has to keep up there too
+    QQuickWindow::setGraphicsApi(QSGRendererInterface::Software);
+    qputenv("QSG_RHI_BACKEND", QByteArray("software"));
+    qputenv("QT_QUICK_BACKEND", QByteArray("software"));
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    const QCommandLineOption rowsOption(QStringLiteral("rows"), QStringLiteral("Rows in the queue."),
+                                        QStringLiteral("count"), QStringLiteral("50000"));
+    const QCommandLineOption framesOption(QStringLiteral("frames"), QStringLiteral("Frames to measure."),
+                                          QStringLiteral("count"), QStringLiteral("600"));
+    const QCommandLineOption stepOption(QStringLiteral("step"), QStringLiteral("Pixels scrolled per frame."),
+                                        QStringLiteral("pixels"), QStringLiteral("240"));
+    const QCommandLineOption jsonOption(QStringLiteral("json"), QStringLiteral("Also write the results as JSON."),
+                                        QStringLiteral("file"));
+    parser.addOptions({rowsOption, framesOption, stepOption, jsonOption});
+    parser.process(app);
+    const int rows = qMax(1, parser.value(rowsOption).toInt());
+    const int frames = qMax(1, parser.value(framesOption).toInt());
+    const double step = parser.value(stepOption).toDouble();
+
+    PlaylistModel model;
+    model.resetItems(syntheticItems(rows));
+
+    QQmlEngine engine;
+    engine.rootContext()->setContextProperty("tracks", &model);
+    QQmlComponent component(&engine);
+    // Resolves TrackDelegate from the app's QML directory
+    component.setData(ViewSource, QUrl::fromLocalFile(QStringLiteral(MUSICPLAYER_QML_DIR "/ScrollBench.qml")));
+    std::unique_ptr<QObject> root(component.create());
+    auto* window = qobject_cast<QQuickWindow*>(root.get());
+    if (!window) {
+        std::fprintf(stderr, "%s\n", qPrintable(component.errorString()));
+        return 1;
+    }
+    auto* view = window->findChild<QQuickItem*>(QStringLiteral("view"));
+
+    std::vector<double> work;
+    std::vector<double> intervals;
+    work.reserve(frames);
+    intervals.reserve(frames);
+    QElapsedTimer clock;
+    clock.start();
+    qint64 frameStartNs = -1;
+    qint64 lastSwapNs = -1;
+    int frame = 0;
+    double direction = 1;
+
+    QObject::connect(window, &QQuickWindow::afterAnimating, window, [&] { frameStartNs = clock.nsecsElapsed(); });
+    QObject::connect(window, &QQuickWindow::frameSwapped, window, [&] {
+        const qint64 now = clock.nsecsElapsed();
+        if (frame >= WarmupFrames && frameStartNs >= 0) {
+            work.push_back((now - frameStartNs) / 1e6);
+            if (lastSwapNs >= 0)
+                intervals.push_back((now - lastSwapNs) / 1e6);
+        }
+        lastSwapNs = now;
+        if (++frame == WarmupFrames + frames) {
+            QMetaObject::invokeMethod(&app, &QCoreApplication::quit, Qt::QueuedConnection);
+            return;
+        }
+
+        // Bounce between the ends, like a user flinging back and forth
+        const double contentHeight = view->property("contentHeight").toDouble() - view->height();
+        double y = view->property("contentY").toDouble() + direction * step;
+        if (y >= contentHeight || y <= 0) {
+            direction = -direction;
+            y = qMax(0.0, qMin(y, contentHeight));
+        }
+        view->setProperty("contentY", y);
+        window->update();
+    });
+
+    app.exec();
+
+    std::printf("%d rows, %d frames, %.0f px per frame, %s renderer\n", rows, int(work.size()), step,
+                qPrintable(window->rendererInterface()->graphicsApi() == QSGRendererInterface::Software
+                               ? QStringLiteral("software") : QStringLiteral("hardware")));
+    QJsonObject results {
+        {"rows", rows},
+        {"step", step},
+        {"frameTime", summarize("frame time", work)},
+        {"frameInterval", summarize("frame interval", intervals)},
+    };
+
+    if (parser.isSet(jsonOption)) {
+        QFile out(parser.value(jsonOption));
+        if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            std::fprintf(stderr, "%s: %s\n", qPrintable(out.fileName()), qPrintable(out.errorString()));
+            return 1;
+        }
+        out.write(QJsonDocument(results).toJson());
+    }
+    return 0;
+}
@@ -0,0 +1,459 @@
+#include "SyntheticCorpus.h"
+
+#include <QBuffer>
+#include <QColor>
+#include <QFile>
+#include <QImage>
+#include <QPainter>
+#include <QTextStream>
+#include <QDebug>
+
+#include <taglib/tpropertymap.h>
+#include <taglib/flacfile.h>
+#include <taglib/flacpicture.h>
+#include <taglib/mpegfile.h>
+#include <taglib/id3v2tag.h>
+#include <taglib/attachedpictureframe.h>
+#include <taglib/opusfile.h>
+#include <taglib/xiphcomment.h>
+#include <taglib/mp4file.h>
+#include <taglib/mp4coverart.h>
+
+namespace {
+
+constexpr int FilesPerBucket = 8;
+constexpr quint32 SampleRate = 44100;
+constexpr quint32 LengthSeconds = 215;
+
+void appendBE(QByteArray& out, quint64 value, int bytes)
+{
+    for (int i = bytes - 1; i >= 0; --i)
+        out.append(char((value >> (8 * i)) & 0xFF));
+}
+
+void appendLE(QByteArray& out, quint64 value, int bytes)
+{
+    for (int i = 0; i < bytes; ++i)
+        out.append(char((value >> (8 * i)) & 0xFF));
+}
+
+QByteArray mp4Atom(const char* type, const QByteArray& payload)
+{
+    QByteArray atom;
+    appendBE(atom, quint64(payload.size() + 8), 4);
+    atom.append(type, 4);
+    atom.append(payload);
+    return atom;
+}
+
+QByteArray mp4FullAtom(const char* type, const QByteArray& payload)
+{
+    return mp4Atom(type, QByteArray(4, '\0') + payload);
+}
+
+QByteArray identityMatrix()
+{
+    QByteArray m;
+    const quint32 values[9] = {0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000};
+    for (quint32 v : values)
+        appendBE(m, v, 4);
+    return m;
+}
+
+quint32 oggCrc(const QByteArray& page)
+{
+    static quint32 table[256];
+    static bool init = false;
+    if (!init) {
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 r = i << 24;
+            for (int j = 0; j < 8; ++j)
+                r = (r & 0x80000000u) ? (r << 1) ^ 0x04C11DB7u : (r << 1);
+            table[i] = r;
+        }
+        init = true;
+    }
+    quint32 crc = 0;
+    for (char c : page)
+        crc = (crc << 8) ^ table[((crc >> 24) & 0xFF) ^ quint8(c)];
+    return crc;
+}
+
+QByteArray oggPage(const QByteArray& packet, quint8 headerType, quint64 granule, quint32 sequence)
+{
+    QByteArray page("OggS");
+    page.append('\0');
+    page.append(char(headerType));
+    appendLE(page, granule, 8);
+    appendLE(page, 0x4D504C59, 4); // stream serial
+    appendLE(page, sequence, 4);
+    appendLE(page, 0, 4);          // CRC placeholder
+
+    // Lacing values for a single packet
+    QByteArray lacing;
+    int remaining = packet.size();
+    while (remaining >= 255) {
+        lacing.append(char(255));
+        remaining -= 255;
+    }
+    lacing.append(char(remaining));
+    page.append(char(lacing.size()));
+    page.append(lacing);
+    page.append(packet);
+
+    const quint32 crc = oggCrc(page);
+    for (int i = 0; i < 4; ++i)
+        page[22 + i] = char((crc >> (8 * i)) & 0xFF);
+    return page;
+}
+
+TagLib::String toTagLib(const QString& s)
+{
+    return TagLib::String(s.toUtf8().constData(), TagLib::String::UTF8);
+}
+
+TagLib::FLAC::Picture* makeFlacPicture(const QByteArray& jpeg)
+{
+    auto* picture = new TagLib::FLAC::Picture;
+    picture->setType(TagLib::FLAC::Picture::FrontCover);
+    picture->setMimeType("image/jpeg");
+    picture->setWidth(500);
+    picture->setHeight(500);
+    picture->setColorDepth(24);
+    picture->setData(TagLib::ByteVector(jpeg.constData(), static_cast<unsigned int>(jpeg.size())));
+    return picture;
+}
+
+} // namespace
+
+SyntheticCorpus& SyntheticCorpus::instance()
+{
+    static SyntheticCorpus corpus;
+    return corpus;
+}
+
+SyntheticCorpus::SyntheticCorpus()
+    : m_files(FormatCount * 2)
+{
+    if (!m_dir.isValid()) {
+        qWarning() << "SyntheticCorpus: cannot create temporary directory";
+        return;
+    }
+
+    int serial = 0;
+    for (int f = 0; f < FormatCount; ++f) {
+        for (int art = 0; art < 2; ++art) {
+            for (int i = 0; i < FilesPerBucket; ++i) {
+                const QString path = writeFile(Format(f), art != 0, serial++);
+                if (!path.isEmpty())
+                    m_files[f * 2 + art] << path;
+            }
+        }
+    }
+}
+
+const QStringList& SyntheticCorpus::files(Format format, bool withArt) const
+{
+    return m_files.at(format * 2 + (withArt ? 1 : 0));
+}
+
+QStringList SyntheticCorpus::allFiles() const
+{
+    QStringList all;
+    for (const auto& bucket : m_files)
+        all << bucket;
+    return all;
+}
+
+QString SyntheticCorpus::playlistWithRows(int rows)
+{
+    auto it = m_playlists.constFind(rows);
+    if (it != m_playlists.constEnd())
+        return it.value();
+
+    const QStringList sources = allFiles();
+    const QString path = m_dir.filePath(QStringLiteral("rows-%1.m3u8").arg(rows));
+    QFile f(path);
+    if (sources.isEmpty() || !f.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+        return QString();
+
+    QTextStream out(&f);
+    out << "#EXTM3U\n";
+    for (int i = 0; i < rows; ++i)
+        out << sources.at(i % sources.size()) << "\n";
+    out.flush();
+
+    m_playlists.insert(rows, path);
+    return path;
+}
+
+const char* SyntheticCorpus::formatName(Format format)
+{
+    switch (format) {
+    case Flac: return "flac";
+    case Mp3: return "mp3";
+    case Opus: return "opus";
+    case M4a: return "m4a";
+    default: return "unknown";
+    }
+}
+
+QString SyntheticCorpus::writeFile(Format format, bool withArt, int serial)
+{
+    QByteArray skeleton;
+    switch (format) {
+    case Flac: skeleton = flacSkeleton(); break;
+    case Mp3: skeleton = mp3Skeleton(); break;
+    case Opus: skeleton = opusSkeleton(); break;
+    case M4a: skeleton = m4aSkeleton(); break;
+    default: return QString();
+    }
+
+    const QString path = m_dir.filePath(QStringLiteral("%1-%2.%3")
+                                        .arg(serial, 4, 10, QChar('0'))
+                                        .arg(QLatin1String(withArt ? "art" : "plain"),
+                                             QLatin1String(formatName(format))));
+    QFile f(path);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate) || f.write(skeleton) != skeleton.size())
+        return QString();
+    f.close();
+
+    if (!applyTags(path, format, withArt, serial)) {
+        qWarning() << "SyntheticCorpus: failed to tag" << path;
+        return QString();
+    }
+    return path;
+}
+
+bool SyntheticCorpus::applyTags(const QString& path, Format format, bool withArt, int serial)
+{
+    TagLib::PropertyMap props;
+    props["TITLE"] = TagLib::StringList(toTagLib(QStringLiteral("Synthetic Track %1").arg(serial)));
+    props["ARTIST"] = TagLib::StringList(toTagLib(QStringLiteral("Benchmark Artist %1").arg(serial % 7)));
+    props["ALBUMARTIST"] = TagLib::StringList(toTagLib(QStringLiteral("Benchmark Artist %1").arg(serial % 7)));
+    props["ALBUM"] = TagLib::StringList(toTagLib(QStringLiteral("Corpus Vol. %1").arg(serial % 5)));
+    props["GENRE"] = TagLib::StringList(toTagLib(QStringLiteral("Electronic")));
+    props["DATE"] = TagLib::StringList(toTagLib(QStringLiteral("%1-06-15").arg(1970 + serial % 50)));
+    props["TRACKNUMBER"] = TagLib::StringList(toTagLib(QStringLiteral("%1/12").arg(serial % 12 + 1)));
+
+    const QByteArray encodedPath = path.toUtf8();
+    const TagLib::FileName fileName(encodedPath.constData());
+    const QByteArray jpeg = withArt ? coverJpeg(serial) : QByteArray();
+    const TagLib::ByteVector jpegData(jpeg.constData(), static_cast<unsigned int>(jpeg.size()));
+
+    switch (format) {
+    case Flac: {
+        TagLib::FLAC::File file(fileName);
+        if (!file.isValid()) return false;
+        file.setProperties(props);
+        if (withArt)
+            file.addPicture(makeFlacPicture(jpeg));
+        return file.save();
+    }
+    case Mp3: {
+        TagLib::MPEG::File file(fileName);
+        if (!file.isValid()) return false;
+        file.ID3v2Tag(true)->setProperties(props);
+        if (withArt) {
+            auto* frame = new TagLib::ID3v2::AttachedPictureFrame;
+            frame->setMimeType("image/jpeg");
+            frame->setType(TagLib::ID3v2::AttachedPictureFrame::FrontCover);
+            frame->setPicture(jpegData);
+            file.ID3v2Tag()->addFrame(frame);
+        }
+        return file.save();
+    }
+    case Opus: {
+        TagLib::Ogg::Opus::File file(fileName);
+        if (!file.isValid()) return false;
+        file.setProperties(props);
+        if (withArt)
+            file.tag()->addPicture(makeFlacPicture(jpeg));
+        return file.save();
+    }
+    case M4a: {
+        TagLib::MP4::File file(fileName);
+        if (!file.isValid()) return false;
+        file.setProperties(props);
+        if (withArt) {
+            TagLib::MP4::CoverArtList covers;
+            covers.append(TagLib::MP4::CoverArt(TagLib::MP4::CoverArt::JPEG, jpegData));
+            file.tag()->setItem("covr", TagLib::MP4::Item(covers));
+        }
+        return file.save();
+    }
+    default:
+        return false;
+    }
+}
+
+QByteArray SyntheticCorpus::flacSkeleton()
+{
+    QByteArray out("fLaC");
+
+    // Single STREAMINFO block, flagged as last; tags are added by TagLib
+    out.append(char(0x80));
+    appendBE(out, 34, 3);
+    appendBE(out, 4096, 2);                  // min block size
+    appendBE(out, 4096, 2);                  // max block size
+    appendBE(out, 0, 3);                     // min frame size (unknown)
+    appendBE(out, 0, 3);                     // max frame size (unknown)
+    const quint64 totalSamples = quint64(SampleRate) * LengthSeconds;
+    const quint64 packed = (quint64(SampleRate) << 44) | (quint64(2 - 1) << 41)
+                         | (quint64(16 - 1) << 36) | totalSamples;
+    appendBE(out, packed, 8);
+    out.append(QByteArray(16, '\0'));        // MD5 of unencoded audio
+    return out;
+}
+
+QByteArray SyntheticCorpus::mp3Skeleton()
+{
+    // MPEG-1 Layer III, 128 kbps, 44.1 kHz, joint stereo: 417-byte silent frames
+    QByteArray frame(417, '\0');
+    frame[0] = char(0xFF);
+    frame[1] = char(0xFB);
+    frame[2] = char(0x90);
+    frame[3] = char(0x64);
+
+    QByteArray out;
+    out.reserve(frame.size() * 400);
+    for (int i = 0; i < 400; ++i)
+        out.append(frame);
+    return out;
+}
+
+QByteArray SyntheticCorpus::opusSkeleton()
+{
+    QByteArray head("OpusHead");
+    head.append(char(1));            // version
+    head.append(char(2));            // channels
+    appendLE(head, 312, 2);          // pre-skip
+    appendLE(head, 48000, 4);        // input sample rate
+    appendLE(head, 0, 2);            // output gain
+    head.append(char(0));            // channel mapping family
+
+    QByteArray tags("OpusTags");
+    const QByteArray vendor("musicplayer-bench");
+    appendLE(tags, quint64(vendor.size()), 4);
+    tags.append(vendor);
+    appendLE(tags, 0, 4);            // no user comments yet
+
+    // One empty 20 ms CELT frame; the final granule position sets the duration
+    const QByteArray audio(1, char(0xFC));
+    const quint64 granule = 312 + quint64(48000) * LengthSeconds;
+
+    return oggPage(head, 0x02, 0, 0)
+         + oggPage(tags, 0x00, 0, 1)
+         + oggPage(audio, 0x04, granule, 2);
+}
+
+QByteArray SyntheticCorpus::m4aSkeleton()
+{
+    const quint64 duration = quint64(SampleRate) * LengthSeconds;
+
+    QByteArray ftypPayload("M4A ");
+    appendBE(ftypPayload, 0, 4);
+    ftypPayload.append("M4A mp42isom");
+    const QByteArray ftyp = mp4Atom("ftyp", ftypPayload);
+
+    QByteArray mvhd;
+    appendBE(mvhd, 0, 8);            // creation/modification time
+    appendBE(mvhd, SampleRate, 4);   // timescale
+    appendBE(mvhd, duration, 4);
+    appendBE(mvhd, 0x00010000, 4);   // rate 1.0
+    appendBE(mvhd, 0x0100, 2);       // volume 1.0
+    mvhd.append(QByteArray(10, '\0'));
+    mvhd.append(identityMatrix());
+    mvhd.append(QByteArray(24, '\0'));
+    appendBE(mvhd, 2, 4);            // next track id
+
+    QByteArray tkhd;
+    appendBE(tkhd, 0, 8);
+    appendBE(tkhd, 1, 4);            // track id
+    appendBE(tkhd, 0, 4);
+    appendBE(tkhd, duration, 4);
+    tkhd.append(QByteArray(8, '\0'));
+    appendBE(tkhd, 0, 4);            // layer, alternate group
+    appendBE(tkhd, 0x0100, 2);       // volume
+    appendBE(tkhd, 0, 2);
+    tkhd.append(identityMatrix());
+    appendBE(tkhd, 0, 8);            // width, height
+
+    QByteArray mdhd;
+    appendBE(mdhd, 0, 8);
+    appendBE(mdhd, SampleRate, 4);
+    appendBE(mdhd, duration, 4);
+    appendBE(mdhd, 0x55C4, 2);       // language "und"
+    appendBE(mdhd, 0, 2);
+
+    QByteArray hdlr;
+    appendBE(hdlr, 0, 4);
+    hdlr.append("soun");
+    hdlr.append(QByteArray(12, '\0'));
+    hdlr.append('\0');
+
+    QByteArray mp4a;
+    mp4a.append(QByteArray(6, '\0'));
+    appendBE(mp4a, 1, 2);            // data reference index
+    mp4a.append(QByteArray(8, '\0'));
+    appendBE(mp4a, 2, 2);            // channels
+    appendBE(mp4a, 16, 2);           // sample size
+    appendBE(mp4a, 0, 4);
+    appendBE(mp4a, quint64(SampleRate) << 16, 4);
+
+    QByteArray stsd;
+    appendBE(stsd, 1, 4);
+    stsd.append(mp4Atom("mp4a", mp4a));
+
+    QByteArray emptyTable;
+    appendBE(emptyTable, 0, 4);
+    QByteArray stsz;
+    appendBE(stsz, 0, 8);            // sample size, sample count
+
+    const QByteArray stbl = mp4Atom("stbl",
+        mp4FullAtom("stsd", stsd)
+        + mp4FullAtom("stts", emptyTable)
+        + mp4FullAtom("stsc", emptyTable)
+        + mp4FullAtom("stsz", stsz)
+        + mp4FullAtom("stco", emptyTable));
+
+    QByteArray dref;
+    appendBE(dref, 1, 4);
+    QByteArray url;
+    appendBE(url, 1, 4);             // self-contained flag
+    dref.append(mp4Atom("url ", url));
+
+    QByteArray smhd;
+    appendBE(smhd, 0, 8);
+
+    const QByteArray minf = mp4Atom("minf",
+        mp4Atom("smhd", smhd)
+        + mp4Atom("dinf", mp4FullAtom("dref", dref))
+        + stbl);
+
+    const QByteArray mdia = mp4Atom("mdia",
+        mp4FullAtom("mdhd", mdhd) + mp4FullAtom("hdlr", hdlr) + minf);
+
+    const QByteArray trak = mp4Atom("trak", mp4Atom("tkhd", QByteArray::fromHex("00000007") + tkhd) + mdia);
+    const QByteArray moov = mp4Atom("moov", mp4FullAtom("mvhd", mvhd) + trak);
+
+    return ftyp + moov + mp4Atom("mdat", QByteArray(64, '\0'));
+}
+
+QByteArray SyntheticCorpus::coverJpeg(int serial)
+{
+    QImage image(500, 500, QImage::Format_RGB32);
+    image.fill(QColor::fromHsv((serial * 37) % 360, 160, 200));
+    {
+        QPainter p(&image);
+        p.setPen(Qt::white);
+        for (int i = 0; i < 500; i += 20)
+            p.drawLine(0, i, 500, 500 - i);
+    }
+
+    QByteArray jpeg;
+    QBuffer buffer(&jpeg);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "JPEG", 90);
+    return jpeg;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QVector>
+#include <QHash>
+
+// Generates small, validly structured and tagged audio files for benchmarking.
+// Files carry real tag blocks (and optionally embedded JPEG covers) but only
+// placeholder audio, so metadata and cover paths are exercised without large I/O.
+class SyntheticCorpus {
+public:
+    enum Format { Flac, Mp3, Opus, M4a, FormatCount };
+
+    static SyntheticCorpus& instance();
+
+    bool isValid() const { return m_dir.isValid(); }
+    QString directory() const { return m_dir.path(); }
+
+    // Files of one format, with or without embedded cover art
+    const QStringList& files(Format format, bool withArt) const;
+    QStringList allFiles() const;
+
+    // M3U8 playlist with the given number of rows cycling through the corpus
+    QString playlistWithRows(int rows);
+
+    static const char* formatName(Format format);
+
+private:
+    SyntheticCorpus();
+
+    QString writeFile(Format format, bool withArt, int serial);
+    bool applyTags(const QString& path, Format format, bool withArt, int serial);
+
+    static QByteArray flacSkeleton();
+    static QByteArray mp3Skeleton();
+    static QByteArray opusSkeleton();
+    static QByteArray m4aSkeleton();
+    static QByteArray coverJpeg(int serial);
+
+    QTemporaryDir m_dir;
+    QVector<QStringList> m_files;
+    QHash<int, QString> m_playlists;
+};
@@ -0,0 +1,519 @@
+#include <QCoreApplication>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QUrl>
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "AudioFingerprint.h"
+#include "FlacEncoder.h"
+#include "MetadataReader.h"
+#include "PlayHistory.h"
+#include "PlaylistModel.h"
+#include "SeekIndex.h"
+#include "SessionStore.h"
+#include "ShuffleEngine.h"
+#include "SmartPlaylist.h"
+#include "SmartQuery.h"
+#include "TrackMetadata.h"
+#include "SyntheticCorpus.h"
+
+// Row counts for playlist benchmarks: 10k, 100k, 1M
+static void playlistSizes(benchmark::internal::Benchmark* b)
+{
+    b->RangeMultiplier(10)->Range(10'000, 1'000'000)->Unit(benchmark::kMillisecond);
+}
+
+static QUrl playlistUrl(benchmark::State& state)
+{
+    return QUrl::fromLocalFile(SyntheticCorpus::instance().playlistWithRows(int(state.range(0))));
+}
+
+static void BM_ReadMetadataStandalone(benchmark::State& state)
+{
+    const auto format = SyntheticCorpus::Format(state.range(0));
+    const bool withArt = state.range(1) != 0;
+    const auto mode = state.range(2) ? MetadataReader::ReadMode::Fast : MetadataReader::ReadMode::Full;
+    const QStringList& files = SyntheticCorpus::instance().files(format, withArt);
+    if (files.isEmpty()) {
+        state.SkipWithError("corpus generation failed");
+        return;
+    }
+
+    QVector<QUrl> urls;
+    for (const QString& f : files)
+        urls << QUrl::fromLocalFile(f);
+
+    int i = 0;
+    for (auto _ : state) {
+        std::unique_ptr<TrackMetadata> metadata(
+            MetadataReader::readMetadataStandalone(urls.at(i++ % urls.size()), nullptr, mode));
+        benchmark::DoNotOptimize(metadata.get());
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel(std::string(SyntheticCorpus::formatName(format)) + (withArt ? "/art" : "/plain")
+                   + (state.range(2) ? "/fast" : "/full"));
+}
+BENCHMARK(BM_ReadMetadataStandalone)
+    ->ArgsProduct({{SyntheticCorpus::Flac, SyntheticCorpus::Mp3, SyntheticCorpus::Opus, SyntheticCorpus::M4a}, {0, 1}, {0, 1}})
+    ->ArgNames({"format", "art", "fast"})
+    ->Unit(benchmark::kMicrosecond);
+
+// First call encodes the cover to a PNG data URL; later calls hit the cache
+static void BM_CoverArtUrl(benchmark::State& state)
+{
+    const auto format = SyntheticCorpus::Format(state.range(0));
+    const bool cached = state.range(1) != 0;
+    const QStringList& files = SyntheticCorpus::instance().files(format, true);
+    if (files.isEmpty()) {
+        state.SkipWithError("corpus generation failed");
+        return;
+    }
+    const QUrl url = QUrl::fromLocalFile(files.first());
+
+    std::unique_ptr<TrackMetadata> metadata(MetadataReader::readMetadataStandalone(url));
+    for (auto _ : state) {
+        if (!cached) {
+            state.PauseTiming();
+            metadata.reset(MetadataReader::readMetadataStandalone(url));
+            state.ResumeTiming();
+        }
+        benchmark::DoNotOptimize(metadata->coverArtUrl());
+    }
+    state.SetLabel(std::string(SyntheticCorpus::formatName(format)) + (cached ? "/cached" : "/encode"));
+}
+BENCHMARK(BM_CoverArtUrl)
+    ->ArgsProduct({{SyntheticCorpus::Flac, SyntheticCorpus::Mp3, SyntheticCorpus::Opus, SyntheticCorpus::M4a}, {0, 1}})
+    ->ArgNames({"format", "cached"})
+    ->Unit(benchmark::kMicrosecond);
+
+static void BM_PlaylistImportM3U8(benchmark::State& state)
+{
+    const QUrl url = playlistUrl(state);
+    for (auto _ : state) {
+        PlaylistModel model;
+        if (!model.importM3U8(url)) {
+            state.SkipWithError("import failed");
+            return;
+        }
+        benchmark::DoNotOptimize(model.count());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PlaylistImportM3U8)->Apply(playlistSizes);
+
+static void BM_PlaylistExportM3U8(benchmark::State& state)
+{
+    PlaylistModel model;
+    model.importM3U8(playlistUrl(state));
+    QTemporaryDir out;
+    const QUrl target = QUrl::fromLocalFile(out.filePath(QStringLiteral("export.m3u8")));
+
+    for (auto _ : state) {
+        if (!model.exportM3U8(target)) {
+            state.SkipWithError("export failed");
+            return;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PlaylistExportM3U8)->Apply(playlistSizes);
+
+// Relaunch with 20 tabs of N rows: map the snapshots and build every model, no tag I/O
+static void BM_SessionRestore(benchmark::State& state)
+{
+    const int rows = int(state.range(0));
+    QTemporaryDir dir;
+    {
+        QVector<PlaylistModel::Item> items;
+        items.reserve(rows);
+        for (int i = 0; i < rows; ++i) {
+            PlaylistModel::Item item;
+            item.location = QStringLiteral("/music/artist %1/album %2/%3 track.flac").arg(i % 97).arg(i % 13).arg(i);
+            item.display = QStringLiteral("%1 track.flac").arg(i);
+            item.title = QStringLiteral("Track %1").arg(i);
+            item.artist = QStringLiteral("Artist %1").arg(i % 97);
+            item.album = QStringLiteral("Album %1").arg(i % 13);
+            item.genre = QStringLiteral("Genre");
+            item.year = QStringLiteral("1999");
+            item.trackNumber = i % 20 + 1;
+            item.duration = 180'000 + i;
+            items.append(item);
+        }
+
+        SessionStore session(dir.path());
+        session.load();
+        while (session.rowCount() < 20)
+            session.addPlaylist();
+        for (int tab = 0; tab < session.rowCount(); ++tab)
+            session.playlistAt(tab)->resetItems(items);
+        session.flush();
+    }
+
+    for (auto _ : state) {
+        SessionStore session(dir.path());
+        session.load();
+        benchmark::DoNotOptimize(session.playlistAt(19)->count());
+    }
+    state.SetItemsProcessed(state.iterations() * 20 * rows);
+}
+BENCHMARK(BM_SessionRestore)->Arg(10'000)->Unit(benchmark::kMillisecond);
+
+// CBR 32 kbps mono MP3 of the given length (~14 MiB per hour), silent frames
+static QString writeLongMp3(const QTemporaryDir& dir, int minutes)
+{
+    const QString path = dir.filePath(QStringLiteral("long-%1.mp3").arg(minutes));
+    QByteArray frame(104, '\0');
+    frame[0] = char(0xFF);
+    frame[1] = char(0xFB);
+    frame[2] = char(0x10);
+    frame[3] = char(0xC0);
+    const qint64 frames = qint64(minutes) * 60 * 44100 / 1152;
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return QString();
+    QByteArray block;
+    for (int i = 0; i < 4096; ++i)
+        block += frame;
+    for (qint64 i = 0; i < frames; i += 4096)
+        file.write(block.constData(), qMin<qint64>(4096, frames - i) * frame.size());
+    return path;
+}
+
+// Index build for a 3-hour file; the MP3 walk visits every frame header
+static void BM_SeekIndexBuildMp3(benchmark::State& state)
+{
+    QTemporaryDir dir;
+    const QString path = writeLongMp3(dir, int(state.range(0)));
+    for (auto _ : state) {
+        const auto index = SeekIndex::build(path);
+        if (!index) {
+            state.SkipWithError("index build failed");
+            return;
+        }
+        benchmark::DoNotOptimize(index->points().size());
+    }
+    state.SetBytesProcessed(state.iterations() * QFileInfo(path).size());
+}
+BENCHMARK(BM_SeekIndexBuildMp3)->Arg(180)->Unit(benchmark::kMillisecond);
+
+// What a scrubbing seek costs before it reaches the backend: frame snap + offset lookup
+static void BM_SeekIndexLookup(benchmark::State& state)
+{
+    QTemporaryDir dir;
+    const auto index = SeekIndex::build(writeLongMp3(dir, 180));
+    if (!index) {
+        state.SkipWithError("index build failed");
+        return;
+    }
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<qint64> positions(0, index->durationMs());
+    for (auto _ : state) {
+        const qint64 target = index->frameStartMs(positions(rng));
+        benchmark::DoNotOptimize(index->offsetFor(target));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SeekIndexLookup)->Unit(benchmark::kNanosecond);
+
+// Live stream encode cost per second of music-like stereo audio (tone plus noise); the
+// stream server pays this once however many listeners there are
+static void BM_FlacEncodeStream(benchmark::State& state)
+{
+    constexpr int SampleRate = 44100;
+    std::vector<qint16> pcm(size_t(SampleRate) * 2);
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> noise(-64, 64);
+    for (int i = 0; i < SampleRate; ++i) {
+        const double tone = 12000.0 * std::sin(2.0 * M_PI * 440.0 * i / SampleRate);
+        pcm[size_t(2 * i)] = qint16(tone + noise(rng));
+        pcm[size_t(2 * i + 1)] = qint16(0.8 * tone + noise(rng));
+    }
+
+    FlacEncoder encoder(SampleRate, 2);
+    qint64 bytes = 0;
+    for (auto _ : state) {
+        // In player-sized buffers, as delivered by the audio tap
+        for (int frame = 0; frame < SampleRate; frame += 1024) {
+            const int frames = qMin(1024, SampleRate - frame);
+            for (const QByteArray& encoded : encoder.encode(pcm.data() + 2 * frame, frames))
+                bytes += encoded.size();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * SampleRate);
+    state.counters["ratio"] = double(bytes) / double(state.iterations() * qint64(pcm.size()) * 2);
+}
+BENCHMARK(BM_FlacEncodeStream)->Unit(benchmark::kMillisecond);
+
+// Fingerprint cost per track (the first two minutes, decoded) on one core; the items rate
+// reads as seconds of audio per second, i.e. times realtime. Three-note chords that change
+// every two seconds, plus noise, so the chroma moves like music
+static void BM_Fingerprint(benchmark::State& state)
+{
+    constexpr int SampleRate = AudioFingerprint::SampleRate;
+    constexpr int Seconds = AudioFingerprint::MaxSeconds;
+    std::vector<qint16> pcm(size_t(SampleRate) * Seconds);
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> note(45, 75);
+    std::uniform_int_distribution<int> noise(-256, 256);
+    std::array<double, 3> frequencies {};
+    for (size_t i = 0; i < pcm.size(); ++i) {
+        if (i % (size_t(SampleRate) * 2) == 0) {
+            for (double& frequency : frequencies)
+                frequency = 440.0 * std::pow(2.0, (note(rng) - 69) / 12.0);
+        }
+        double sample = 0;
+        for (double frequency : frequencies)
+            sample += 6000.0 * std::sin(2.0 * M_PI * frequency * double(i) / SampleRate);
+        pcm[i] = qint16(sample + noise(rng));
+    }
+
+    size_t words = 0;
+    for (auto _ : state) {
+        const AudioFingerprint fingerprint = AudioFingerprint::compute(pcm.data(), qsizetype(pcm.size()));
+        words = fingerprint.words().size();
+        benchmark::DoNotOptimize(fingerprint.words().data());
+    }
+    state.SetItemsProcessed(state.iterations() * Seconds);
+    state.counters["words"] = double(words);
+}
+BENCHMARK(BM_Fingerprint)->Unit(benchmark::kMillisecond);
+
+// Worst case for the vector-backed model: move between the two ends
+static void BM_PlaylistMoveRowTo(benchmark::State& state)
+{
+    PlaylistModel model;
+    model.importM3U8(playlistUrl(state));
+    const int last = model.count() - 1;
+
+    bool forward = true;
+    for (auto _ : state) {
+        if (forward)
+            model.moveRowTo(0, last);
+        else
+            model.moveRowTo(last, 0);
+        forward = !forward;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PlaylistMoveRowTo)->RangeMultiplier(10)->Range(10'000, 1'000'000)->Unit(benchmark::kMicrosecond);
+
+// Random-row lookups across every role a delegate binds to
+static void BM_PlaylistDataRoles(benchmark::State& state)
+{
+    PlaylistModel model;
+    model.importM3U8(playlistUrl(state));
+    const QList<int> roles = model.roleNames().keys();
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> rows(0, model.count() - 1);
+    for (auto _ : state) {
+        const QModelIndex index = model.index(rows(rng));
+        for (int role : roles)
+            benchmark::DoNotOptimize(model.data(index, role));
+    }
+    state.SetItemsProcessed(state.iterations() * roles.size());
+}
+BENCHMARK(BM_PlaylistDataRoles)->RangeMultiplier(10)->Range(10'000, 1'000'000)->Unit(benchmark::kNanosecond);
+
+// What the track delegate fetches for a row: its three preformatted roles in one call
+static void BM_PlaylistDelegateRoles(benchmark::State& state)
+{
+    PlaylistModel model;
+    model.importM3U8(playlistUrl(state));
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> rows(0, model.count() - 1);
+    std::array<QModelRoleData, 3> roleData {QModelRoleData(PlaylistModel::PrimaryTextRole),
+                                            QModelRoleData(PlaylistModel::SecondaryTextRole),
+                                            QModelRoleData(PlaylistModel::DurationTextRole)};
+    for (auto _ : state) {
+        model.multiData(model.index(rows(rng)), roleData);
+        benchmark::DoNotOptimize(roleData);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PlaylistDelegateRoles)->RangeMultiplier(10)->Range(10'000, 1'000'000)->Unit(benchmark::kNanosecond);
+
+// Artist/album/track order over tagged rows; 100k rows should stay under 100 ms
+static void BM_PlaylistSortBy(benchmark::State& state)
+{
+    const int rows = int(state.range(0));
+    QVector<PlaylistModel::Item> items;
+    items.reserve(rows);
+    std::mt19937 rng(42);
+    for (int i = 0; i < rows; ++i) {
+        PlaylistModel::Item item;
+        item.location = QStringLiteral("/music/%1.flac").arg(i);
+        item.artist = QStringLiteral("Artist %1").arg(rng() % 2000);
+        item.album = QStringLiteral("Album %1").arg(rng() % 8000);
+        item.title = QStringLiteral("Track %1").arg(i);
+        item.trackNumber = int(rng() % 20) + 1;
+        items.append(item);
+    }
+    PlaylistModel model;
+    const QStringList roles {QStringLiteral("artist"), QStringLiteral("album"), QStringLiteral("trackNumber")};
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        model.resetItems(items);
+        state.ResumeTiming();
+        model.sortBy(roles);
+    }
+    state.SetItemsProcessed(state.iterations() * rows);
+}
+BENCHMARK(BM_PlaylistSortBy)->RangeMultiplier(10)->Range(10'000, 1'000'000)->Unit(benchmark::kMillisecond);
+
+// Shuffle steps through a tagged queue, with the artist spread and cycle refills included
+static void BM_ShuffleNext(benchmark::State& state)
+{
+    const int rows = int(state.range(0));
+    QVector<PlaylistModel::Item> items(rows);
+    std::mt19937 rng(42);
+    for (int i = 0; i < rows; ++i) {
+        items[i].location = QStringLiteral("/music/%1.flac").arg(i);
+        items[i].artist = QStringLiteral("Artist %1").arg(rng() % 2000);
+    }
+    PlaylistModel model;
+    model.resetItems(items);
+    ShuffleEngine shuffle(&model);
+    shuffle.setSpread(QStringLiteral("artist"));
+
+    int row = -1;
+    for (auto _ : state) {
+        row = shuffle.next(row);
+        benchmark::DoNotOptimize(row);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ShuffleNext)->RangeMultiplier(10)->Range(10'000, 1'000'000)->Unit(benchmark::kNanosecond);
+
+// A library of tagged rows for smart playlist benchmarks
+static QVector<PlaylistModel::Item> libraryItems(int rows)
+{
+    static const char* const genres[] = {"Jazz", "Rock", "Classical", "Electronic", "Folk", "Hip-Hop", "Soul", "Pop"};
+    QVector<PlaylistModel::Item> items(rows);
+    std::mt19937 rng(42);
+    for (int i = 0; i < rows; ++i) {
+        items[i].location = QStringLiteral("/music/%1.flac").arg(i);
+        items[i].artist = QStringLiteral("Artist %1").arg(rng() % 5000);
+        items[i].album = QStringLiteral("Album %1").arg(rng() % 20000);
+        items[i].genre = QString::fromLatin1(genres[rng() % 8]);
+        items[i].year = QString::number(1940 + rng() % 85);
+        items[i].duration = qint64(60 + rng() % 600) * 1000;
+    }
+    return items;
+}
+
+static const QString BenchRule = QStringLiteral("genre = Jazz AND year < 1970 AND duration > 5 min");
+
+// One full evaluation of a rule over the library; 200k tracks should take milliseconds
+static void BM_SmartQueryEvaluate(benchmark::State& state)
+{
+    PlaylistModel source;
+    source.resetItems(libraryItems(int(state.range(0))));
+    LibraryIndex library;
+    library.watch(&source);
+    SmartQuery query = SmartQuery::parse(BenchRule);
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(query.matchAll(library));
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SmartQueryEvaluate)->Arg(10'000)->Arg(200'000)->Arg(1'000'000)->Unit(benchmark::kMillisecond);
+
+// A tag edit that moves one track in and out of a sorted smart playlist
+static void BM_SmartPlaylistEdit(benchmark::State& state)
+{
+    QVector<PlaylistModel::Item> items = libraryItems(int(state.range(0)));
+    items[0].duration = 400'000;
+    PlaylistModel source;
+    source.resetItems(std::move(items));
+    LibraryIndex library;
+    library.watch(&source);
+    PlaylistModel smart;
+    SmartPlaylist playlist(&library, &smart);
+    playlist.setQuery(BenchRule + QStringLiteral(", sorted by artist, album"));
+    QCoreApplication::processEvents();
+
+    const QSet<QString> location {source.items().at(0).location};
+    bool jazz = false;
+    for (auto _ : state) {
+        jazz = !jazz;
+        source.applyTagEdits(location, {{QStringLiteral("genre"), jazz ? QStringLiteral("Jazz") : QStringLiteral("Rock")},
+                                        {QStringLiteral("year"), QStringLiteral("1965")}});
+        QCoreApplication::processEvents();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SmartPlaylistEdit)->Arg(10'000)->Arg(200'000)->Unit(benchmark::kMicrosecond);
+
+// A history of range(0) events over 20k tracks, most of them this month, written and
+// compacted as they would be over years of listening
+static void fillHistory(PlayHistory& history, int events)
+{
+    std::mt19937 rng(7);
+    // Skewed like real listening: a few favourites, a long tail
+    std::geometric_distribution<int> track(0.0005);
+    std::uniform_int_distribution<int> played(0, 240'000);
+    for (int i = 0; i < events; ++i) {
+        const QUrl url = QUrl::fromLocalFile(QStringLiteral("/music/track %1.flac").arg(track(rng) % 20'000));
+        history.recordPlay(url, played(rng), 240'000);
+    }
+    history.flush();
+}
+
+// "Most played this month" from the aggregates; the request budget is 1 ms
+static void BM_PlayHistoryMostPlayed(benchmark::State& state)
+{
+    QTemporaryDir dir;
+    PlayHistory history(nullptr, dir.path());
+    history.load();
+    fillHistory(history, int(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(history.mostPlayed(50));
+        benchmark::DoNotOptimize(history.recentlyPlayed(50));
+        benchmark::DoNotOptimize(history.skipRate());
+    }
+}
+BENCHMARK(BM_PlayHistoryMostPlayed)->Arg(100'000)->Arg(1'000'000)->Unit(benchmark::kMicrosecond);
+
+// Startup cost: snapshot plus whatever the log holds since the last compaction
+static void BM_PlayHistoryLoad(benchmark::State& state)
+{
+    QTemporaryDir dir;
+    {
+        PlayHistory history(nullptr, dir.path());
+        history.load();
+        fillHistory(history, int(state.range(0)));
+    }
+    for (auto _ : state) {
+        PlayHistory history(nullptr, dir.path());
+        history.load();
+    }
+}
+BENCHMARK(BM_PlayHistoryLoad)->Arg(1'000'000)->Unit(benchmark::kMillisecond);
+
+int main(int argc, char** argv)
+{
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+
+    QCoreApplication app(argc, argv);
+    if (!SyntheticCorpus::instance().isValid())
+        return 1;
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
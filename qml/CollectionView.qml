@@ -0,0 +1,80 @@
+import QtQuick 2.15
+import QtQuick.Controls 2.15
+import QtQuick.Layouts 1.15
+
+// Album grid for the Collection browser mode
+Item {
+    GridView {
+        id: collectionGrid
+        anchors.fill: parent
+        anchors.margins: 4
+        cellWidth: 120
+        cellHeight: 150
+        model: 24
+        delegate: Rectangle {
+            width: collectionGrid.cellWidth - 8
+            height: collectionGrid.cellHeight - 8
+            color: "#2a2a2a"
+            border.color: "#444"
+            border.width: 1
+            radius: 4
+            anchors.margins: 4
+
+            ColumnLayout {
+                anchors.fill: parent
+                anchors.margins: 8
+                spacing: 4
+
+                Rectangle {
+                    width: 60
+                    height: 60
+                    color: "#333"
+                    border.color: "#555"
+                    border.width: 1
+                    radius: 4
+                    Layout.alignment: Qt.AlignHCenter
+
+                    Text {
+                        anchors.centerIn: parent
+                        text: "♪"
+                        color: "#666"
+                        font.pixelSize: 24
+                    }
+                }
+
+                Text {
+                    Layout.fillWidth: true
+                    text: "Album " + (index + 1)
+                    color: "#ccc"
+                    font.pixelSize: 11
+                    font.bold: true
+                    elide: Text.ElideRight
+                    horizontalAlignment: Text.AlignHCenter
+                }
+
+                Text {
+                    Layout.fillWidth: true
+                    text: "Artist Name"
+                    color: "#999"
+                    font.pixelSize: 10
+                    elide: Text.ElideRight
+                    horizontalAlignment: Text.AlignHCenter
+                }
+
+                Text {
+                    Layout.fillWidth: true
+                    text: "2000"
+                    color: "#666"
+                    font.pixelSize: 10
+                    horizontalAlignment: Text.AlignHCenter
+                }
+            }
+
+            MouseArea {
+                anchors.fill: parent
+                onClicked: console.log("Selected album", index)
+            }
+        }
+        ScrollBar.vertical: ScrollBar {}
+    }
+}
@@ -0,0 +1,113 @@
+import QtQuick 2.15
+import QtQuick.Controls 2.15
+import QtQuick.Layouts 1.15
+
+// Grid over folderBrowser for the Files browser mode. Folders are entered in place;
+// activated files are handed to the window, which owns the queue logic.
+Item {
+    id: root
+
+    signal fileActivated(url file)
+
+    GridView {
+        id: filesGrid
+        anchors.fill: parent
+        anchors.margins: 4
+        cellWidth: 140
+        cellHeight: 140
+        model: folderBrowser
+        delegate: Rectangle {
+            width: filesGrid.cellWidth - 12
+            height: filesGrid.cellHeight - 12
+            color: "#2a2a2a"
+            border.color: "#444"
+            border.width: 1
+            radius: 4
+            anchors.margins: 6
+
+            ColumnLayout {
+                anchors.fill: parent
+                anchors.margins: 8
+                spacing: 6
+
+                Rectangle {
+                    width: 64
+                    height: 64
+                    color: "#333"
+                    border.color: "#555"
+                    border.width: 1
+                    radius: 4
+                    Layout.alignment: Qt.AlignHCenter
+
+                    Text {
+                        anchors.centerIn: parent
+                        text: fileIsDir ? "📁" : "♪"
+                        color: "#bbb"
+                        font.pixelSize: 28
+                        visible: !(cover.status === Image.Ready && cover.implicitWidth > 1)
+                    }
+
+                    // Thumbnail decoded off the GUI thread, only for delegates that exist
+                    Image {
+                        id: cover
+                        anchors.fill: parent
+                        anchors.margins: 1
+                        source: coverSource
+                        sourceSize.width: 128
+                        sourceSize.height: 128
+                        fillMode: Image.PreserveAspectCrop
+                        asynchronous: true
+                        cache: false
+                    }
+                }
+
+                Text {
+                    Layout.fillWidth: true
+                    text: fileName
+                    color: "#ccc"
+                    font.pixelSize: 11
+                    elide: Text.ElideRight
+                    wrapMode: Text.NoWrap
+                    horizontalAlignment: Text.AlignHCenter
+                }
+
+                Text {
+                    Layout.fillWidth: true
+                    text: duration > 0 ? Math.floor(duration / 60000) + ":" + String(Math.floor(duration / 1000) % 60).padStart(2, "0") : ""
+                    visible: !fileIsDir
+                    color: "#888"
+                    font.pixelSize: 10
+                    horizontalAlignment: Text.AlignHCenter
+                }
+            }
+
+            MouseArea {
+                anchors.fill: parent
+                hoverEnabled: true
+                cursorShape: Qt.PointingHandCursor
+                acceptedButtons: Qt.LeftButton
+                onClicked: {
+                    console.log("filesGrid clicked", fileName)
+                    const urlRole = (typeof fileURL !== 'undefined') ? fileURL : (typeof fileUrl !== 'undefined' ? fileUrl : null)
+                    if (urlRole === null) { console.warn('No fileURL role in delegate'); return }
+                    if (fileIsDir) {
+                        folderBrowser.folder = urlRole
+                    } else {
+                        root.fileActivated(urlRole)
+                    }
+                }
+                onDoubleClicked: {
+                    console.log("filesGrid doubleClicked", fileName)
+                    const urlRole = (typeof fileURL !== 'undefined') ? fileURL : (typeof fileUrl !== 'undefined' ? fileUrl : null)
+                    if (urlRole === null) { console.warn('No fileURL role in delegate'); return }
+                    if (fileIsDir) {
+                        folderBrowser.folder = urlRole
+                    } else {
+                        root.fileActivated(urlRole)
+                    }
+                }
+            }
+        }
+        ScrollBar.vertical: ScrollBar {}
+    }
+}
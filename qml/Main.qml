@@ -1,9 +1,9 @@
-import QtQuick 2.15
+import QtQuick
 import QtQuick.Controls 2.15
 import QtQuick.Layouts 1.15
 import QtQuick.Dialogs
-import Qt.labs.folderlistmodel 2.15
 import Qt.labs.platform 1.1
+import QtQuick.Controls 2.15 as Controls
 
 ApplicationWindow {
     id: window
@@ -15,6 +15,42 @@ ApplicationWindow {
     // Tracks the index of the currently playing item to handle duplicates
     property int currentIdx: -1
     property int browserMode: 0 // 0 = Collection, 1 = Files
+    // player.position sampled once per rendered frame while playing, so the seek bar and
+    // elapsed time move smoothly without a signal per backend tick
+    property real playbackPosition: 0
+
+    FrameAnimation {
+        running: player.playing && !positionSlider.pressed
+        onTriggered: playbackPosition = player.position
+    }
+    // Model and view of the selected playlist tab; the playlist buttons act on them
+    readonly property var currentTracks: session.playlistAt(playlistTabBar.currentIndex)
+    readonly property var currentTrackView: playlistRepeater.count > 0 ? playlistRepeater.itemAt(playlistTabBar.currentIndex) : null
+    // Smart playlists are filled by their rule, not edited by hand
+    readonly property bool currentSmart: session.count > 0 && session.queryAt(playlistTabBar.currentIndex) !== ""
+
+    onCurrentIdxChanged: session.currentIndex = currentIdx
+
+    // Resume the queue where the last session stopped, paused
+    Component.onCompleted: {
+        const idx = session.restoredIndex
+        if (idx >= 0 && idx < playlist.count()) {
+            currentIdx = idx
+            player.cueFile(playlist.get(idx).url, session.restoredPosition)
+        }
+    }
+
+    onBrowserModeChanged: if (browserMode === 1) filesLoader.active = true
+
+    // Appends to the queue; arms gapless playback when the playing track was the last one
+    function enqueue(u) {
+        const beforeCount = playlist.count()
+        playlist.add(u)
+        const idx = currentIdx
+        if (idx >= 0 && (idx === beforeCount - 1 || beforeCount === 0)) {
+            player.setNextFile(u)
+        }
+    }
 
     function indexOfUrl(u) {
         const s = u.toString()
@@ -41,14 +77,17 @@ ApplicationWindow {
         return -1
     }
 
+    // Row that plays after idx, or -1 at the end of the queue
+    function followingIndex(idx) {
+        if (shuffle.enabled) return shuffle.peekNext(idx)
+        return idx + 1 < playlist.count() ? idx + 1 : -1
+    }
+
     function armNextFromQueue() {
         const idx = currentIdx
-        if (idx >= 0 && idx + 1 < playlist.count()) {
-            const it = playlist.get(idx + 1)
-            if (it) player.setNextFile(it.url)
-        } else {
-            player.setNextFile("")
-        }
+        const nx = idx >= 0 ? followingIndex(idx) : -1
+        const it = nx >= 0 ? playlist.get(nx) : null
+        player.setNextFile(it ? it.url : "")
     }
 
     function playIndex(i) {
@@ -58,16 +97,15 @@ ApplicationWindow {
         const u = it.url
         player.openFile(u)
         currentIdx = i
-        if (i + 1 < playlist.count()) {
-            const nx = playlist.get(i + 1)
-            if (nx) player.setNextFile(nx.url)
-        } else {
-            player.setNextFile("")
-        }
+        armNextFromQueue()
     }
 
     function nextFromQueue() {
         const idx = currentIdx
+        if (shuffle.enabled) {
+            playIndex(shuffle.next(idx))
+            return
+        }
         if (idx === -1) {
             if (playlist.count() > 0) playIndex(0)
             return
@@ -84,7 +122,24 @@ ApplicationWindow {
         }
     }
 
+    // Sorts the selected playlist; in the queue the playing track stays current
+    function sortTracks(roles) {
+        const order = sortDescending.checked ? Qt.DescendingOrder : Qt.AscendingOrder
+        if (currentTracks === playlist) {
+            currentIdx = playlist.sortBy(roles, order, currentIdx)
+            armNextFromQueue()
+            if (currentTrackView) currentTrackView.currentIndex = currentIdx
+        } else {
+            currentTracks.sortBy(roles, order)
+            if (currentTrackView) currentTrackView.currentIndex = -1
+        }
+    }
+
     function prevFromQueue() {
+        if (shuffle.enabled) {
+            playIndex(shuffle.previous())
+            return
+        }
         const idx = currentIdx
         if (idx > 0) playIndex(idx - 1)
     }
@@ -98,7 +153,7 @@ ApplicationWindow {
         const finished = player.duration > 0 && player.position >= (player.duration - 5)
         if (idx === -1) {
             if (playlist.count() > 0) {
-                playIndex(0)
+                playIndex(shuffle.enabled ? shuffle.next(-1) : 0)
             } else {
                 player.play()
             }
@@ -136,26 +191,73 @@ ApplicationWindow {
                     anchors.margins: 8
                     spacing: 8
 
-                    // Playlist tabs area
-                    TabBar {
-                        id: playlistTabBar
+                    // Playlist tabs area; tab 0 is the play queue, the rest are saved playlists.
+                    // "+" sits outside the bar so tab indexes always match session rows.
+                    RowLayout {
                         Layout.fillWidth: true
-                        height: 40
-                        
-                        TabButton {
-                            text: "Queue"
-                            width: implicitWidth
-                        }
-                        
-                        TabButton {
-                            text: "Playlist 1"
-                            width: implicitWidth
+                        spacing: 0
+
+                        TabBar {
+                            id: playlistTabBar
+                            Layout.fillWidth: true
+                            height: 40
+                            // Adding the first tab selects it; don't let that overwrite the saved tab
+                            property bool restored: false
+                            Component.onCompleted: {
+                                currentIndex = session.currentTab
+                                restored = true
+                            }
+                            onCurrentIndexChanged: {
+                                if (restored && currentIndex >= 0) session.currentTab = currentIndex
+                            }
+
+                            Repeater {
+                                model: session
+                                TabButton {
+                                    text: model.name
+                                    width: implicitWidth
+                                    font.italic: model.query !== ""
+
+                                    TapHandler {
+                                        acceptedButtons: Qt.RightButton
+                                        onTapped: if (index > 0) tabMenu.popup()
+                                    }
+
+                                    // Qualified: Qt.labs.platform's native Menu needs QApplication
+                                    Controls.Menu {
+                                        id: tabMenu
+                                        Controls.MenuItem {
+                                            text: "Edit rule..."
+                                            enabled: model.query !== ""
+                                            onTriggered: smartDialog.edit(index)
+                                        }
+                                        Controls.MenuItem {
+                                            text: "Remove playlist"
+                                            onTriggered: session.removePlaylist(index)
+                                        }
+                                    }
+                                }
+                            }
                         }
-                        
+
                         TabButton {
                             text: "+"
-                            width: 30
+                            Layout.preferredWidth: 30
                             font.pixelSize: 16
+                            checkable: false
+                            onClicked: addTabMenu.popup()
+
+                            Controls.Menu {
+                                id: addTabMenu
+                                Controls.MenuItem {
+                                    text: "Playlist"
+                                    onTriggered: playlistTabBar.currentIndex = session.addPlaylist("")
+                                }
+                                Controls.MenuItem {
+                                    text: "Smart playlist..."
+                                    onTriggered: smartDialog.edit(-1)
+                                }
+                            }
                         }
                     }
 
@@ -165,81 +267,21 @@ ApplicationWindow {
                         Layout.fillHeight: true
                         currentIndex: playlistTabBar.currentIndex
 
-                        // Queue view
-                        ListView {
-                            id: queueView
-                            clip: true
-                            model: playlist
-                            delegate: Rectangle {
-                                width: queueView.width
-                                height: 48
-                                color: ListView.isCurrentItem ? "#334155" : (index % 2 === 0 ? "#1f2937" : "#111827")
-                                
-                                ColumnLayout {
-                                    anchors.fill: parent
-                                    anchors.leftMargin: 8
-                                    anchors.rightMargin: 8
-                                    spacing: 2
-                                    
-                                    Text { 
-                                        Layout.fillWidth: true
-                                        color: "#e5e7eb"
-                                        text: title ? `${title} - ${artist || "Unknown Artist"}` : display
-                                        font.pixelSize: 13
-                                        font.bold: true
-                                        elide: Text.ElideRight
-                                    }
-                                    
-                                    Text {
-                                        Layout.fillWidth: true
-                                        color: "#9ca3af"
-                                        font.pixelSize: 11
-                                        elide: Text.ElideRight
-                                        text: {
-                                            const parts = []
-                                            if (album) parts.push(album)
-                                            if (year) parts.push(year)
-                                            if (genre) parts.push(genre)
-                                            return parts.join(" • ")
-                                        }
-                                        visible: album || year || genre
-                                    }
-                                    
-                                    Text {
-                                        color: "#6b7280"
-                                        font.pixelSize: 10
-                                        text: duration > 0 ? 
-                                              `${Math.floor(duration / 60000)}:${String(Math.floor((duration % 60000) / 1000)).padStart(2, '0')}` : 
-                                              ""
-                                        visible: duration > 0
-                                    }
-                                }
-                                
-                                MouseArea { 
-                                    anchors.fill: parent
-                                    onClicked: queueView.currentIndex = index 
-                                }
-                            }
-                            ScrollBar.vertical: ScrollBar {}
-                        }
-
-                        // Other playlist tabs (placeholder)
-                        Rectangle {
-                            color: "#1a1a1a"
-                            Text {
-                                anchors.centerIn: parent
-                                text: "Playlist content"
-                                color: "#666"
-                            }
-                        }
+                        Repeater {
+                            id: playlistRepeater
+                            model: session
 
-                        // New playlist button content
-                        Rectangle {
-                            color: "#1a1a1a"
-                            Text {
-                                anchors.centerIn: parent
-                                text: "Create new playlist"
-                                color: "#666"
+                            ListView {
+                                id: trackView
+                                clip: true
+                                reuseItems: true
+                                model: tracks
+                                delegate: TrackDelegate {
+                                    width: trackView.width
+                                    current: ListView.isCurrentItem
+                                    onClicked: trackView.currentIndex = index
+                                }
+                                ScrollBar.vertical: ScrollBar {}
                             }
                         }
                     }
@@ -254,6 +296,7 @@ ApplicationWindow {
                             text: "Add"
                             Layout.preferredWidth: 60
                             Layout.preferredHeight: 30
+                            enabled: !currentSmart
                             onClicked: addDialog.open()
                         }
                         
@@ -261,8 +304,8 @@ ApplicationWindow {
                             text: "Remove"
                             Layout.preferredWidth: 70
                             Layout.preferredHeight: 30
-                            enabled: queueView.currentIndex >= 0
-                            onClicked: playlist.removeAt(queueView.currentIndex)
+                            enabled: !currentSmart && currentTrackView !== null && currentTrackView.currentIndex >= 0
+                            onClicked: currentTracks.removeAt(currentTrackView.currentIndex)
                         }
                         
                         Button {
@@ -277,8 +320,82 @@ ApplicationWindow {
                             Layout.preferredHeight: 30
                             onClicked: exportDialog.open()
                         }
-                        
-                        Item { Layout.fillWidth: true }
+
+                        Button {
+                            id: sortButton
+                            text: "Sort"
+                            Layout.preferredWidth: 60
+                            Layout.preferredHeight: 30
+                            enabled: currentTracks !== null && !currentSmart
+                            onClicked: sortMenu.popup()
+
+                            Controls.Menu {
+                                id: sortMenu
+                                Repeater {
+                                    model: [
+                                        ["Artist", ["artist", "album", "trackNumber"]],
+                                        ["Album", ["album", "trackNumber"]],
+                                        ["Year", ["year", "artist", "album", "trackNumber"]],
+                                        ["Title", ["title"]],
+                                        ["Track number", ["trackNumber"]],
+                                        ["Duration", ["duration"]]
+                                    ]
+                                    Controls.MenuItem {
+                                        required property var modelData
+                                        text: modelData[0]
+                                        onTriggered: sortTracks(modelData[1])
+                                    }
+                                }
+                                Controls.MenuSeparator {}
+                                Controls.MenuItem {
+                                    id: sortDescending
+                                    text: "Descending"
+                                    checkable: true
+                                }
+                            }
+                        }
+
+                        // Transcode the playlist to a device folder; resumes an interrupted sync first
+                        Button {
+                            text: transcoder.running ? "Stop" : (transcoder.resumable ? "Resume" : "Sync")
+                            Layout.preferredWidth: 70
+                            Layout.preferredHeight: 30
+                            onClicked: {
+                                if (transcoder.running)
+                                    transcoder.cancel()
+                                else if (transcoder.resumable)
+                                    transcoder.resume()
+                                else
+                                    syncDialog.open()
+                            }
+                        }
+
+                        // Acoustic duplicates across every playlist
+                        Button {
+                            text: "Dupes"
+                            Layout.preferredWidth: 60
+                            Layout.preferredHeight: 30
+                            onClicked: duplicatesDialog.open()
+                        }
+
+                        Text {
+                            Layout.fillWidth: true
+                            color: transcoder.error ? "#f87171" : "#9ca3af"
+                            font.pixelSize: 11
+                            elide: Text.ElideRight
+                            text: {
+                                if (transcoder.error)
+                                    return transcoder.error
+                                if (transcoder.jobCount === 0)
+                                    return ""
+                                let status = `${transcoder.finishedCount}/${transcoder.jobCount} synced`
+                                if (transcoder.throughput > 0)
+                                    status += ` · ${transcoder.throughput.toFixed(1)}× realtime`
+                                if (transcoder.failedCount > 0)
+                                    status += ` · ${transcoder.failedCount} failed`
+                                return status
+                            }
+                        }
                         
                         Button {
                             text: "Clear"
@@ -375,11 +492,27 @@ ApplicationWindow {
                         
                         Text {
                             anchors.left: parent.left
+                            anchors.right: upButton.left
                             anchors.verticalCenter: parent.verticalCenter
                             anchors.leftMargin: 8
-                            text: browserMode === 1 ? filesModel.folder : "Album Artist > The Beatles > Abbey Road"
+                            text: browserMode === 1 ? folderBrowser.folder.toString().replace("file://", "") + (folderBrowser.loading ? "  …" : "")
+                                                    : "Album Artist > The Beatles > Abbey Road"
                             color: "#ccc"
                             font.pixelSize: 12
+                            elide: Text.ElideMiddle
+                        }
+
+                        Button {
+                            id: upButton
+                            anchors.right: parent.right
+                            anchors.verticalCenter: parent.verticalCenter
+                            anchors.rightMargin: 2
+                            width: 26
+                            height: 26
+                            text: "↑"
+                            visible: browserMode === 1
+                            enabled: folderBrowser.parentFolder.toString() !== ""
+                            onClicked: folderBrowser.folder = folderBrowser.parentFolder
                         }
                     }
 
@@ -405,20 +538,6 @@ ApplicationWindow {
                         }
                     }
 
-                    FolderListModel {
-                        id: filesModel
-                        folder: StandardPaths.writableLocation(StandardPaths.HomeLocation)
-                        showDirs: true
-                        showDotAndDotDot: false
-                        showFiles: true
-                        nameFilters: [
-                            "*.wav", "*.flac", "*.mp3", "*.ogg", "*.opus", "*.aac", "*.m4a", "*.mp4", "*.mkv"
-                        ]
-                        sortField: FolderListModel.Name
-                        sortReversed: false
-                        caseSensitive: false
-                    }
-
                     // Collection grid area
                     Rectangle {
                         Layout.fillWidth: true
@@ -431,169 +550,22 @@ ApplicationWindow {
                             anchors.fill: parent
                             currentIndex: browserMode
                             
-                            GridView {
-                                id: collectionGrid
-                                anchors.fill: parent
-                                anchors.margins: 4
-                                cellWidth: 120
-                                cellHeight: 150
-                                model: 24
-                                delegate: Rectangle {
-                                    width: collectionGrid.cellWidth - 8
-                                    height: collectionGrid.cellHeight - 8
-                                    color: "#2a2a2a"
-                                    border.color: "#444"
-                                    border.width: 1
-                                    radius: 4
-                                    anchors.margins: 4
-                                    
-                                    ColumnLayout {
-                                        anchors.fill: parent
-                                        anchors.margins: 8
-                                        spacing: 4
-                                        
-                                        Rectangle {
-                                            width: 60
-                                            height: 60
-                                            color: "#333"
-                                            border.color: "#555"
-                                            border.width: 1
-                                            radius: 4
-                                            Layout.alignment: Qt.AlignHCenter
-                                            
-                                            Text {
-                                                anchors.centerIn: parent
-                                                text: "♪"
-                                                color: "#666"
-                                                font.pixelSize: 24
-                                            }
-                                        }
-                                        
-                                        Text {
-                                            Layout.fillWidth: true
-                                            text: "Album " + (index + 1)
-                                            color: "#ccc"
-                                            font.pixelSize: 11
-                                            font.bold: true
-                                            elide: Text.ElideRight
-                                            horizontalAlignment: Text.AlignHCenter
-                                        }
-                                        
-                                        Text {
-                                            Layout.fillWidth: true
-                                            text: "Artist Name"
-                                            color: "#999"
-                                            font.pixelSize: 10
-                                            elide: Text.ElideRight
-                                            horizontalAlignment: Text.AlignHCenter
-                                        }
-                                        
-                                        Text {
-                                            Layout.fillWidth: true
-                                            text: "2000"
-                                            color: "#666"
-                                            font.pixelSize: 10
-                                            horizontalAlignment: Text.AlignHCenter
-                                        }
-                                    }
-                                    
-                                    MouseArea {
-                                        anchors.fill: parent
-                                        onClicked: console.log("Selected album", index)
-                                    }
-                                }
-                                ScrollBar.vertical: ScrollBar {}
+                            // Browser panes are compiled ahead of time but only instantiated when shown;
+                            // the files pane stays loaded once visited so it keeps its scroll position
+                            Loader {
+                                asynchronous: true
+                                sourceComponent: Component { CollectionView {} }
                             }
 
-                            GridView {
-                                id: filesGrid
-                                anchors.fill: parent
-                                anchors.margins: 4
-                                cellWidth: 140
-                                cellHeight: 140
-                                model: filesModel
-                                delegate: Rectangle {
-                                    width: filesGrid.cellWidth - 12
-                                    height: filesGrid.cellHeight - 12
-                                    color: "#2a2a2a"
-                                    border.color: "#444"
-                                    border.width: 1
-                                    radius: 4
-                                    anchors.margins: 6
-                                    
-                                    ColumnLayout {
-                                        anchors.fill: parent
-                                        anchors.margins: 8
-                                        spacing: 6
-                                        
-                                        Rectangle {
-                                            width: 64
-                                            height: 64
-                                            color: "#333"
-                                            border.color: "#555"
-                                            border.width: 1
-                                            radius: 4
-                                            Layout.alignment: Qt.AlignHCenter
-                                            
-                                            Text {
-                                                anchors.centerIn: parent
-                                                text: fileIsDir ? "📁" : "♪"
-                                                color: "#bbb"
-                                                font.pixelSize: 28
-                                            }
-                                        }
-                                        
-                                        Text {
-                                            Layout.fillWidth: true
-                                            text: fileName
-                                            color: "#ccc"
-                                            font.pixelSize: 11
-                                            elide: Text.ElideRight
-                                            wrapMode: Text.NoWrap
-                                            horizontalAlignment: Text.AlignHCenter
-                                        }
-                                    }
-                                    
-                                    MouseArea {
-                                        anchors.fill: parent
-                                        hoverEnabled: true
-                                        cursorShape: Qt.PointingHandCursor
-                                        acceptedButtons: Qt.LeftButton
-                                        onClicked: {
-                                            console.log("filesGrid clicked", fileName)
-                                            const urlRole = (typeof fileURL !== 'undefined') ? fileURL : (typeof fileUrl !== 'undefined' ? fileUrl : null)
-                                            if (urlRole === null) { console.warn('No fileURL role in delegate'); return }
-                                            const asString = (typeof urlRole === 'string') ? urlRole : urlRole.toString()
-                                            if (fileIsDir) {
-                                                filesModel.folder = asString
-                                            } else {
-                                                const beforeCount = playlist.count()
-                                                playlist.add(urlRole)
-                                                const idx = currentIdx
-                                                if (idx >= 0 && (idx === beforeCount - 1 || beforeCount === 0)) {
-                                                    player.setNextFile(urlRole)
-                                                }
-                                            }
-                                        }
-                                        onDoubleClicked: {
-                                            console.log("filesGrid doubleClicked", fileName)
-                                            const urlRole = (typeof fileURL !== 'undefined') ? fileURL : (typeof fileUrl !== 'undefined' ? fileUrl : null)
-                                            if (urlRole === null) { console.warn('No fileURL role in delegate'); return }
-                                            const asString = (typeof urlRole === 'string') ? urlRole : urlRole.toString()
-                                            if (fileIsDir) {
-                                                filesModel.folder = asString
-                                            } else {
-                                                const beforeCount = playlist.count()
-                                                playlist.add(urlRole)
-                                                const idx = currentIdx
-                                                if (idx >= 0 && (idx === beforeCount - 1 || beforeCount === 0)) {
-                                                    player.setNextFile(urlRole)
-                                                }
-                                            }
-                                        }
+                            Loader {
+                                id: filesLoader
+                                active: false
+                                asynchronous: true
+                                sourceComponent: Component {
+                                    FilesView {
+                                        onFileActivated: (file) => enqueue(file)
                                     }
                                 }
-                                ScrollBar.vertical: ScrollBar {}
                             }
                         }
                     }
@@ -665,14 +637,28 @@ ApplicationWindow {
                 }
 
                 // Quick actions
+                // No history while attached to musicplayerd; it is kept by the daemon
                 RowLayout {
                     spacing: 8
+                    visible: history !== null
 
                     Button {
                         text: "♥"
                         Layout.preferredWidth: 32
                         Layout.preferredHeight: 32
                         font.pixelSize: 14
+                        enabled: player.currentSource.toString() !== ""
+                        // Not checkable: a toggle would break the binding to the history.
+                        // revision re-runs the lookups whenever the history changes.
+                        highlighted: history !== null && history.revision >= 0 && history.isLoved(player.currentSource)
+                        onClicked: history.setLoved(player.currentSource, !highlighted)
+                        ToolTip.visible: hovered && enabled
+                        ToolTip.text: {
+                            if (history === null) return ""
+                            const plays = history.revision >= 0 ? history.playCount(player.currentSource) : 0
+                            const skipped = Math.round(history.trackSkipRate(player.currentSource) * 100)
+                            return `Played ${plays} times · skipped ${skipped}%`
+                        }
                     }
 
                     Button {
@@ -680,6 +666,7 @@ ApplicationWindow {
                         Layout.preferredWidth: 32
                         Layout.preferredHeight: 32
                         font.pixelSize: 14
+                        onClicked: historyDialog.open()
                     }
                 }
             }
@@ -707,7 +694,7 @@ ApplicationWindow {
                     spacing: 8
 
                     Text {
-                        text: formatTime(player.position)
+                        text: formatTime(playbackPosition)
                         color: "#ccc"
                         font.pixelSize: 11
                         Layout.preferredWidth: 50
@@ -718,7 +705,7 @@ ApplicationWindow {
                         Layout.fillWidth: true
                         from: 0
                         to: player.duration
-                        value: player.position
+                        value: playbackPosition
                         onMoved: player.seek(value)
                     }
 
@@ -768,6 +755,41 @@ ApplicationWindow {
                             Layout.preferredWidth: 32
                             Layout.preferredHeight: 32
                             font.pixelSize: 12
+                            checkable: true
+                            checked: shuffle.enabled
+                            onToggled: {
+                                shuffle.enabled = checked
+                                armNextFromQueue()
+                            }
+
+                            TapHandler {
+                                acceptedButtons: Qt.RightButton
+                                onTapped: shuffleMenu.popup()
+                            }
+
+                            Controls.Menu {
+                                id: shuffleMenu
+                                Controls.MenuItem {
+                                    text: "Spread artists"
+                                    checkable: true
+                                    checked: shuffle.spread === "artist"
+                                    onTriggered: shuffle.spread = checked ? "artist" : "none"
+                                }
+                                Controls.MenuItem {
+                                    text: "Spread albums"
+                                    checkable: true
+                                    checked: shuffle.spread === "album"
+                                    onTriggered: shuffle.spread = checked ? "album" : "none"
+                                }
+                                Controls.MenuSeparator {}
+                                Controls.MenuItem {
+                                    text: "Start over"
+                                    onTriggered: {
+                                        shuffle.reset()
+                                        armNextFromQueue()
+                                    }
+                                }
+                            }
                         }
 
                         Button {
@@ -821,12 +843,28 @@ ApplicationWindow {
         return `${minutes}:${secs.toString().padStart(2, '0')}`
     }
 
+    // Debug overlay with playback/scan telemetry (Ctrl+Shift+D)
+    Shortcut {
+        sequence: "Ctrl+Shift+D"
+        onActivated: telemetryOverlay.active = !telemetryOverlay.active
+    }
+
+    Loader {
+        id: telemetryOverlay
+        active: false
+        z: 100
+        anchors.top: parent.top
+        anchors.right: parent.right
+        anchors.margins: 12
+        sourceComponent: Component { TelemetryOverlay {} }
+    }
+
     // File dialogs (kept for functionality)
     FileDialog {
         id: fileDialog
         title: "Open Audio File"
         nameFilters: [
-            "Audio files (*.wav *.flac *.mp3 *.ogg *.opus *.aac *.m4a *.mp4 *.mkv)",
+            "Audio files (*.wav *.flac *.mp3 *.ogg *.opus *.aac *.m4a *.mp4 *.mkv *.mka *.aif *.aiff *.wv *.ape)",
             "All files (*)"
         ]
         onAccepted: player.openFile(selectedFile)
@@ -836,7 +874,7 @@ ApplicationWindow {
         id: nextDialog
         title: "Select Next Track (Gapless)"
         nameFilters: [
-            "Audio files (*.wav *.flac *.mp3 *.ogg *.opus *.aac *.m4a *.mp4 *.mkv)",
+            "Audio files (*.wav *.flac *.mp3 *.ogg *.opus *.aac *.m4a *.mp4 *.mkv *.mka *.aif *.aiff *.wv *.ape)",
             "All files (*)"
         ]
         onAccepted: player.setNextFile(selectedFile)
@@ -846,16 +884,14 @@ ApplicationWindow {
         id: addDialog
         title: "Add to Playlist"
         nameFilters: [
-            "Audio files (*.wav *.flac *.mp3 *.ogg *.opus *.aac *.m4a *.mp4 *.mkv)",
+            "Audio files (*.wav *.flac *.mp3 *.ogg *.opus *.aac *.m4a *.mp4 *.mkv *.mka *.aif *.aiff *.wv *.ape)",
             "All files (*)"
         ]
         onAccepted: {
-            const beforeCount = playlist.count()
-            playlist.add(selectedFile)
-            const idx = currentIdx
-            if (idx >= 0 && (idx === beforeCount - 1 || beforeCount === 0)) {
-                player.setNextFile(selectedFile)
-            }
+            if (currentTracks !== playlist)
+                currentTracks.add(selectedFile)
+            else
+                enqueue(selectedFile)
         }
     }
 
@@ -866,7 +902,7 @@ ApplicationWindow {
             "Playlists (*.m3u *.m3u8)",
             "All files (*)"
         ]
-        onAccepted: playlist.importM3U8(selectedFile)
+        onAccepted: currentTracks.importM3U8(selectedFile)
     }
 
     FileDialog {
@@ -876,7 +912,227 @@ ApplicationWindow {
             "Playlists (*.m3u8)",
             "All files (*)"
         ]
-        onAccepted: playlist.exportM3U8(selectedFile)
+        onAccepted: currentTracks.exportM3U8(selectedFile)
+    }
+
+    // Creates a smart playlist, or edits the rule of tab editIndex
+    Controls.Dialog {
+        id: smartDialog
+        property int editIndex: -1
+        readonly property string error: session.queryError(ruleField.text)
+
+        function edit(index) {
+            editIndex = index
+            nameField.text = ""
+            ruleField.text = index > 0 ? session.queryAt(index) : ""
+            open()
+        }
+
+        title: editIndex > 0 ? "Edit smart playlist" : "New smart playlist"
+        anchors.centerIn: parent
+        width: Math.min(parent.width - 40, 520)
+        modal: true
+        standardButtons: Controls.Dialog.Ok | Controls.Dialog.Cancel
+        onOpened: ruleField.forceActiveFocus()
+
+        ColumnLayout {
+            anchors.fill: parent
+            spacing: 6
+
+            TextField {
+                id: nameField
+                Layout.fillWidth: true
+                visible: smartDialog.editIndex <= 0
+                placeholderText: "Name"
+            }
+            TextField {
+                id: ruleField
+                Layout.fillWidth: true
+                placeholderText: "genre = Jazz AND year < 1970 AND duration > 5 min, sorted by album"
+            }
+            Text {
+                Layout.fillWidth: true
+                color: "#f87171"
+                font.pixelSize: 11
+                wrapMode: Text.Wrap
+                text: ruleField.text.length > 0 ? smartDialog.error : ""
+            }
+        }
+
+        Component.onCompleted: standardButton(Controls.Dialog.Ok).enabled = Qt.binding(() => smartDialog.error === "")
+
+        onAccepted: {
+            if (editIndex > 0)
+                session.setQuery(editIndex, ruleField.text)
+            else
+                playlistTabBar.currentIndex = session.addSmartPlaylist(nameField.text, ruleField.text)
+        }
+    }
+
+    // Recently played and this month's most played, from the play history's aggregates
+    Controls.Dialog {
+        id: historyDialog
+        property bool monthly: false
+        readonly property var entries: history !== null && history.revision >= 0 && visible
+            ? (monthly ? history.mostPlayed(100) : history.recentlyPlayed(100)) : []
+
+        title: "History"
+        anchors.centerIn: parent
+        width: Math.min(parent.width - 40, 520)
+        height: Math.min(parent.height - 40, 560)
+        modal: true
+        standardButtons: Controls.Dialog.Close
+
+        ColumnLayout {
+            anchors.fill: parent
+            spacing: 6
+
+            RowLayout {
+                Layout.fillWidth: true
+                Button {
+                    text: "Recently played"
+                    checkable: true
+                    checked: !historyDialog.monthly
+                    onClicked: historyDialog.monthly = false
+                }
+                Button {
+                    text: "Most played this month"
+                    checkable: true
+                    checked: historyDialog.monthly
+                    onClicked: historyDialog.monthly = true
+                }
+                Text {
+                    Layout.fillWidth: true
+                    horizontalAlignment: Text.AlignRight
+                    color: "#9ca3af"
+                    font.pixelSize: 11
+                    text: history !== null ? `${Math.round(history.skipRate * 100)}% skipped this month` : ""
+                }
+            }
+
+            ListView {
+                Layout.fillWidth: true
+                Layout.fillHeight: true
+                clip: true
+                model: historyDialog.entries
+                delegate: RowLayout {
+                    id: historyRow
+                    required property int index
+                    required property var modelData
+                    width: ListView.view.width
+                    spacing: 4
+
+                    TrackDelegate {
+                        Layout.fillWidth: true
+                        index: historyRow.index
+                        primaryText: historyRow.modelData.primaryText
+                        secondaryText: historyRow.modelData.secondaryText
+                        durationText: ""
+                        onClicked: enqueue(historyRow.modelData.url)
+                    }
+                    Text {
+                        color: "#9ca3af"
+                        font.pixelSize: 11
+                        text: {
+                            const plays = historyDialog.monthly ? historyRow.modelData.monthPlays : historyRow.modelData.plays
+                            return `${historyRow.modelData.loved ? "♥ " : ""}${plays}× · ${Math.round(historyRow.modelData.skipRate * 100)}% skipped`
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Groups of tracks that sound the same; a click queues a track to compare by ear
+    Controls.Dialog {
+        id: duplicatesDialog
+        title: "Duplicates"
+        anchors.centerIn: parent
+        width: Math.min(parent.width - 40, 560)
+        height: Math.min(parent.height - 40, 560)
+        modal: true
+        standardButtons: Controls.Dialog.Close
+
+        ColumnLayout {
+            anchors.fill: parent
+            spacing: 6
+
+            RowLayout {
+                Layout.fillWidth: true
+                Button {
+                    text: duplicates.running ? "Stop" : "Scan"
+                    onClicked: duplicates.running ? duplicates.cancel() : duplicates.start()
+                }
+                Text {
+                    Layout.fillWidth: true
+                    color: duplicates.error ? "#f87171" : "#9ca3af"
+                    font.pixelSize: 11
+                    elide: Text.ElideRight
+                    text: {
+                        if (duplicates.error)
+                            return duplicates.error
+                        if (duplicates.trackCount === 0)
+                            return ""
+                        let status = duplicates.running
+                            ? `${duplicates.scannedCount}/${duplicates.trackCount} fingerprinted`
+                            : `${duplicates.groupCount} groups in ${duplicates.trackCount} tracks`
+                        if (duplicates.throughput > 0)
+                            status += ` · ${duplicates.throughput.toFixed(0)}× realtime`
+                        return status
+                    }
+                }
+            }
+
+            ListView {
+                Layout.fillWidth: true
+                Layout.fillHeight: true
+                clip: true
+                model: duplicates
+                section.property: "group"
+                section.delegate: Text {
+                    required property string section
+                    color: "#9ca3af"
+                    font.pixelSize: 11
+                    topPadding: 6
+                    text: `Group ${section}`
+                }
+                delegate: RowLayout {
+                    id: duplicateRow
+                    required property int index
+                    required property url url
+                    required property string primaryText
+                    required property string secondaryText
+                    required property string durationText
+                    required property real similarity
+                    width: ListView.view.width
+                    spacing: 4
+
+                    TrackDelegate {
+                        Layout.fillWidth: true
+                        index: duplicateRow.index
+                        primaryText: duplicateRow.primaryText
+                        secondaryText: duplicateRow.secondaryText
+                        durationText: duplicateRow.durationText
+                        onClicked: enqueue(duplicateRow.url)
+                    }
+                    Text {
+                        color: "#9ca3af"
+                        font.pixelSize: 11
+                        text: `${Math.round(duplicateRow.similarity * 100)}%`
+                    }
+                    Button {
+                        text: "Not a duplicate"
+                        onClicked: duplicates.dismiss(duplicateRow.index)
+                    }
+                }
+            }
+        }
+    }
+
+    FolderDialog {
+        id: syncDialog
+        title: "Sync Playlist to Folder (Opus)"
+        onAccepted: transcoder.start(currentTracks, folder)
     }
 
     // Output device selector (kept for functionality)
@@ -885,11 +1141,15 @@ ApplicationWindow {
         visible: false
         model: player.audioOutputs
         onActivated: player.selectOutputByIndex(index)
-        Component.onCompleted: currentIndex = Math.max(0, player.audioOutputs.indexOf(player.currentOutput))
+        // Outputs are enumerated after the first frame, so follow the list rather than reading it once
+        currentIndex: Math.max(0, player.audioOutputs.indexOf(player.currentOutput))
     }
 
     Connections {
         target: player
+        function onPositionChanged() {
+            playbackPosition = player.position
+        }
         function onCurrentSourceChanged() {
             // Resync currentIdx on source changes, prefer next index if duplicates
             if (currentIdx >= 0)
@@ -0,0 +1,132 @@
+import QtQuick 2.15
+import QtQuick.Controls 2.15
+import QtQuick.Layouts 1.15
+
+// Debug overlay with playback/scan telemetry; created on demand by Main.qml
+Rectangle {
+    id: telemetryOverlay
+    width: 320
+    height: telemetryColumn.implicitHeight + 16
+    color: "#e0111827"
+    border.color: "#334155"
+    radius: 4
+
+    property var stats: ({})
+    property var frames: ({})
+
+    function fmtHist(h) {
+        if (!h || !h.count) return "–"
+        return `n=${h.count} p50=${(h.p50 / 1000).toFixed(1)}ms p99=${(h.p99 / 1000).toFixed(1)}ms max=${(h.max / 1000).toFixed(1)}ms`
+    }
+
+    function fmtReadAhead(r) {
+        if (!r || !r.capacityBytes) return "–"
+        const mb = b => (b / 1048576).toFixed(1)
+        return `${mb(r.bufferedBytes)} / ${mb(r.capacityBytes)} MB buffered`
+    }
+
+    function fmtFrames(f) {
+        if (!f || !f.frames || !f.total) return "–"
+        return `n=${f.frames} slow=${f.slow} p50=${f.total.p50.toFixed(1)}ms p99=${f.total.p99.toFixed(1)}ms max=${f.total.max.toFixed(1)}ms`
+    }
+
+    function fmtFramePhases(f) {
+        if (!f || !f.frames || !f.total) return "–"
+        return `polish ${f.polish.p99.toFixed(1)} sync ${f.sync.p99.toFixed(1)} render ${f.render.p99.toFixed(1)} swap ${f.swap.p99.toFixed(1)} ms`
+    }
+
+    function fmtStartup(s) {
+        if (!s || !s.phases || !s.phases.length) return "–"
+        return `${s.totalMs.toFixed(0)}ms (` + s.phases.map(p => `${p.name} ${p.ms.toFixed(0)}`).join(", ") + ")"
+    }
+
+    Timer {
+        interval: 500
+        repeat: true
+        running: true
+        triggeredOnStart: true
+        onTriggered: {
+            telemetryOverlay.stats = telemetry.snapshot()
+            telemetryOverlay.frames = frameStats.summary()
+        }
+    }
+
+    ColumnLayout {
+        id: telemetryColumn
+        anchors.fill: parent
+        anchors.margins: 8
+        spacing: 2
+
+        Repeater {
+            model: [
+                ["Open → audio", telemetryOverlay.fmtHist(telemetryOverlay.stats.openToFirstAudio)],
+                ["Transition gap", telemetryOverlay.fmtHist(telemetryOverlay.stats.trackTransitionGap)],
+                ["Cover decode", telemetryOverlay.fmtHist(telemetryOverlay.stats.coverDecode)],
+                ["Cover encode", telemetryOverlay.fmtHist(telemetryOverlay.stats.coverEncode)],
+                ["Scan", telemetryOverlay.stats.scan ? `${telemetryOverlay.stats.scan.files} files, ${telemetryOverlay.stats.scan.filesPerSecond.toFixed(0)}/s` : "–"],
+                ["Underruns", String(telemetryOverlay.stats.bufferUnderruns || 0)],
+                ["Device switch", telemetryOverlay.fmtHist(telemetryOverlay.stats.deviceSwitch)],
+                ["Stream encode", telemetryOverlay.fmtHist(telemetryOverlay.stats.streamEncode)],
+                ["Read-ahead", telemetryOverlay.fmtReadAhead(telemetryOverlay.stats.readAhead)],
+                ["Read stalls", telemetryOverlay.fmtHist(telemetryOverlay.stats.readAhead ? telemetryOverlay.stats.readAhead.stall : null)],
+                ["Read retries", String(telemetryOverlay.stats.readAhead ? telemetryOverlay.stats.readAhead.retries : 0)],
+                ["Errors", String(telemetryOverlay.stats.playerErrors || 0)],
+                ["Startup", telemetryOverlay.fmtStartup(telemetryOverlay.stats.startup)],
+                ["Renderer", frameStats.backend || "–"],
+                ["Frames", telemetryOverlay.fmtFrames(telemetryOverlay.frames)],
+                ["Frame p99", telemetryOverlay.fmtFramePhases(telemetryOverlay.frames)]
+            ]
+            delegate: Text {
+                Layout.fillWidth: true
+                text: `${modelData[0]}: ${modelData[1]}`
+                color: "#e5e7eb"
+                font.pixelSize: 10
+                elide: Text.ElideRight
+            }
+        }
+
+        Repeater {
+            model: telemetryOverlay.stats.metadataRead ? Object.keys(telemetryOverlay.stats.metadataRead) : []
+            delegate: Text {
+                Layout.fillWidth: true
+                text: `Tags (${modelData}): ${telemetryOverlay.fmtHist(telemetryOverlay.stats.metadataRead[modelData])}`
+                color: "#9ca3af"
+                font.pixelSize: 10
+                elide: Text.ElideRight
+            }
+        }
+
+        Text {
+            Layout.fillWidth: true
+            visible: !!telemetryOverlay.stats.lastError
+            text: `Last error: ${telemetryOverlay.stats.lastError}`
+            color: "#f87171"
+            font.pixelSize: 10
+            elide: Text.ElideRight
+        }
+
+        RowLayout {
+            spacing: 8
+            Button {
+                text: "Dump JSON"
+                Layout.preferredHeight: 24
+                onClicked: console.log("Telemetry written to", telemetry.dumpJson())
+            }
+            Button {
+                text: "Export frames"
+                Layout.preferredHeight: 24
+                onClicked: console.log("Frame times written to", frameStats.exportCsv())
+            }
+            Button {
+                text: "Reset"
+                Layout.preferredHeight: 24
+                onClicked: {
+                    telemetry.reset()
+                    frameStats.reset()
+                    telemetryOverlay.stats = telemetry.snapshot()
+                    telemetryOverlay.frames = frameStats.summary()
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,60 @@
+import QtQuick
+
+// One playlist row. The strings come preformatted from PlaylistModel and only the roles
+// declared here are fetched, so creating or recycling a row runs no JavaScript.
+Rectangle {
+    id: row
+
+    required property int index
+    required property string primaryText
+    required property string secondaryText
+    required property string durationText
+    property bool current: false
+
+    signal clicked()
+
+    height: 48
+    color: current ? "#334155" : (index % 2 === 0 ? "#1f2937" : "#111827")
+
+    Column {
+        anchors.left: parent.left
+        anchors.right: parent.right
+        anchors.verticalCenter: parent.verticalCenter
+        anchors.leftMargin: 8
+        anchors.rightMargin: 8
+        spacing: 2
+
+        Text {
+            width: parent.width
+            color: "#e5e7eb"
+            text: row.primaryText
+            textFormat: Text.PlainText
+            font.pixelSize: 13
+            font.bold: true
+            elide: Text.ElideRight
+        }
+
+        Text {
+            width: parent.width
+            color: "#9ca3af"
+            text: row.secondaryText
+            textFormat: Text.PlainText
+            font.pixelSize: 11
+            elide: Text.ElideRight
+            visible: text.length > 0
+        }
+
+        Text {
+            color: "#6b7280"
+            text: row.durationText
+            textFormat: Text.PlainText
+            font.pixelSize: 10
+            visible: text.length > 0
+        }
+    }
+
+    MouseArea {
+        anchors.fill: parent
+        onClicked: row.clicked()
+    }
+}
@@ -0,0 +1,240 @@
+#include "AudioFingerprint.h"
+
+#include <QHash>
+#include <QtAlgorithms>
+#include <QtMath>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+namespace {
+
+constexpr int FrameSize = 4096;
+constexpr int Hop = FrameSize / 3;
+constexpr int ChromaBins = 12;
+constexpr double MinFrequency = 28.0;
+constexpr double MaxFrequency = 3520.0;
+constexpr int SmoothFrames = 4;
+// Ten seconds of words
+constexpr int MinOverlap = 10 * AudioFingerprint::SampleRate / Hop;
+// Alignments tried by similarity(), besides none
+constexpr int OffsetCandidates = 4;
+
+// Radix-2 FFT over split real/imaginary arrays. Twiddles are stored per stage, so every
+// butterfly loop walks contiguous arrays and the compiler vectorizes it.
+class Fft {
+public:
+    Fft()
+        : m_reversed(FrameSize)
+        , m_window(FrameSize)
+        , m_chroma(FrameSize / 2 + 1, -1)
+    {
+        int bits = 0;
+        while ((1 << bits) < FrameSize)
+            ++bits;
+        for (int i = 0; i < FrameSize; ++i) {
+            int r = 0;
+            for (int b = 0; b < bits; ++b)
+                r |= ((i >> b) & 1) << (bits - 1 - b);
+            m_reversed[i] = r;
+        }
+
+        for (int len = 2; len <= FrameSize; len <<= 1) {
+            std::vector<float> re(len / 2), im(len / 2);
+            for (int j = 0; j < len / 2; ++j) {
+                const double angle = -2.0 * M_PI * j / len;
+                re[j] = float(std::cos(angle));
+                im[j] = float(std::sin(angle));
+            }
+            m_twiddleRe.push_back(std::move(re));
+            m_twiddleIm.push_back(std::move(im));
+        }
+
+        for (int i = 0; i < FrameSize; ++i)
+            m_window[i] = float(0.5 - 0.5 * std::cos(2.0 * M_PI * i / (FrameSize - 1)));
+
+        for (int k = 1; k <= FrameSize / 2; ++k) {
+            const double frequency = double(k) * AudioFingerprint::SampleRate / FrameSize;
+            if (frequency < MinFrequency || frequency > MaxFrequency) continue;
+            const int note = int(std::lround(12.0 * std::log2(frequency / 440.0))) + 69;
+            m_chroma[k] = ((note % ChromaBins) + ChromaBins) % ChromaBins;
+        }
+    }
+
+    const std::vector<float>& window() const { return m_window; }
+    // Pitch class of each bin up to FrameSize / 2, -1 outside the analysed range
+    const std::vector<int>& chroma() const { return m_chroma; }
+
+    void run(float* re, float* im) const
+    {
+        for (int i = 0; i < FrameSize; ++i) {
+            const int r = m_reversed[i];
+            if (i < r) {
+                std::swap(re[i], re[r]);
+                std::swap(im[i], im[r]);
+            }
+        }
+        int stage = 0;
+        for (int len = 2; len <= FrameSize; len <<= 1, ++stage) {
+            const int half = len / 2;
+            const float* wr = m_twiddleRe[stage].data();
+            const float* wi = m_twiddleIm[stage].data();
+            for (int start = 0; start < FrameSize; start += len) {
+                float* ar = re + start;
+                float* ai = im + start;
+                float* br = ar + half;
+                float* bi = ai + half;
+                for (int j = 0; j < half; ++j) {
+                    const float tr = br[j] * wr[j] - bi[j] * wi[j];
+                    const float ti = br[j] * wi[j] + bi[j] * wr[j];
+                    br[j] = ar[j] - tr;
+                    bi[j] = ai[j] - ti;
+                    ar[j] += tr;
+                    ai[j] += ti;
+                }
+            }
+        }
+    }
+
+private:
+    std::vector<int> m_reversed;
+    std::vector<std::vector<float>> m_twiddleRe;
+    std::vector<std::vector<float>> m_twiddleIm;
+    std::vector<float> m_window;
+    std::vector<int> m_chroma;
+};
+
+const Fft& fft()
+{
+    static const Fft instance;
+    return instance;
+}
+
+// splitmix64 finaliser, one independent hash per MinHash entry
+quint32 hashWord(quint32 word, int function)
+{
+    quint64 z = word + 0x9e3779b97f4a7c15ull * quint64(function + 1);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return quint32((z ^ (z >> 31)) >> 32);
+}
+
+} // namespace
+
+AudioFingerprint AudioFingerprint::compute(const qint16* samples, qsizetype count)
+{
+    count = qMin<qsizetype>(count, qsizetype(SampleRate) * MaxSeconds);
+    const int frames = count >= FrameSize ? int((count - FrameSize) / Hop) + 1 : 0;
+    const Fft& transform = fft();
+    const std::vector<float>& window = transform.window();
+    const std::vector<int>& pitchClass = transform.chroma();
+
+    std::vector<std::array<float, ChromaBins>> chroma(frames);
+    std::vector<float> re(FrameSize), im(FrameSize);
+    for (int frame = 0; frame < frames; ++frame) {
+        const qint16* in = samples + qsizetype(frame) * Hop;
+        for (int i = 0; i < FrameSize; ++i)
+            re[i] = float(in[i]) * window[i];
+        std::fill(im.begin(), im.end(), 0.0f);
+        transform.run(re.data(), im.data());
+
+        std::array<float, ChromaBins>& bins = chroma[frame];
+        bins.fill(0.0f);
+        for (int k = 1; k <= FrameSize / 2; ++k) {
+            if (pitchClass[k] >= 0)
+                bins[pitchClass[k]] += re[k] * re[k] + im[k] * im[k];
+        }
+        // Shares of the frame's energy, so loudness and gain don't matter
+        float total = 0;
+        for (float energy : bins)
+            total += energy;
+        if (total > 1.0f) {
+            for (float& energy : bins)
+                energy /= total;
+        } else {
+            bins.fill(0.0f);
+        }
+    }
+
+    std::vector<quint32> words;
+    words.reserve(frames);
+    std::array<float, ChromaBins> sum {};
+    for (int frame = 0; frame < frames; ++frame) {
+        for (int b = 0; b < ChromaBins; ++b) {
+            sum[b] += chroma[frame][b];
+            if (frame >= SmoothFrames)
+                sum[b] -= chroma[frame - SmoothFrames][b];
+        }
+        if (frame + 1 < SmoothFrames) continue;
+
+        // Semitone, minor third and fourth neighbours of each pitch class
+        quint32 word = 0;
+        for (int b = 0; b < ChromaBins; ++b) {
+            word |= quint32(sum[b] > sum[(b + 1) % ChromaBins]) << b;
+            word |= quint32(sum[b] > sum[(b + 3) % ChromaBins]) << (ChromaBins + b);
+        }
+        for (int b = 0; b < 32 - 2 * ChromaBins; ++b)
+            word |= quint32(sum[b] > sum[(b + 5) % ChromaBins]) << (2 * ChromaBins + b);
+        words.push_back(word);
+    }
+    return AudioFingerprint(std::move(words));
+}
+
+double AudioFingerprint::similarity(const AudioFingerprint& other) const
+{
+    const std::vector<quint32>& a = m_words;
+    const std::vector<quint32>& b = other.m_words;
+    if (int(a.size()) < MinOverlap || int(b.size()) < MinOverlap)
+        return 0.0;
+
+    // Offsets at which whole words agree, by votes; copies differ by a lead-in at most
+    QHash<quint32, int> firstAt;
+    firstAt.reserve(int(a.size()));
+    for (int i = 0; i < int(a.size()); ++i) {
+        if (a[i] && !firstAt.contains(a[i]))
+            firstAt.insert(a[i], i);
+    }
+    QHash<int, int> votes;
+    for (int j = 0; j < int(b.size()); ++j) {
+        const auto it = firstAt.constFind(b[j]);
+        if (it != firstAt.constEnd())
+            ++votes[it.value() - j];
+    }
+    std::vector<std::pair<int, int>> ranked; // (votes, offset)
+    for (auto it = votes.constBegin(); it != votes.constEnd(); ++it)
+        ranked.emplace_back(it.value(), it.key());
+    const int keep = qMin(OffsetCandidates, int(ranked.size()));
+    std::partial_sort(ranked.begin(), ranked.begin() + keep, ranked.end(), std::greater<>());
+    std::vector<int> offsets {0};
+    for (int i = 0; i < keep; ++i)
+        offsets.push_back(ranked[i].second);
+
+    double best = 0.0;
+    for (int offset : offsets) {
+        // a[i] lines up with b[i - offset]
+        const int first = qMax(0, offset);
+        const int last = qMin(int(a.size()), int(b.size()) + offset);
+        const int overlap = last - first;
+        if (overlap < MinOverlap) continue;
+        qint64 differing = 0;
+        for (int i = first; i < last; ++i)
+            differing += qPopulationCount(a[i] ^ b[i - offset]);
+        best = qMax(best, 1.0 - double(differing) / (32.0 * overlap));
+    }
+    return best;
+}
+
+std::array<quint32, AudioFingerprint::MinHashes> AudioFingerprint::minHash() const
+{
+    std::array<quint32, MinHashes> signature;
+    signature.fill(std::numeric_limits<quint32>::max());
+    for (quint32 word : m_words) {
+        // Silence carries no information about the track
+        if (!word) continue;
+        for (int h = 0; h < MinHashes; ++h)
+            signature[h] = qMin(signature[h], hashWord(word, h));
+    }
+    return signature;
+}
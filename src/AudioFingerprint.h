@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <array>
+#include <vector>
+
+// Acoustic fingerprint of the start of a track, in the manner of Chromaprint: robust to
+// re-encoding, bitrate and tags, so copies of one recording can be found whatever their
+// files say.
+//
+// Mono 11025 Hz PCM is cut into 4096-sample Hann windows every 1365 samples (~124 ms); each
+// window's spectrum is folded into a 12-bin chroma (28 Hz to 3.5 kHz), normalised and
+// smoothed over four windows. Each window then yields one 32-bit word whose bits say which
+// of two pitch classes is stronger, for 32 fixed pairs. Immutable once computed.
+class AudioFingerprint {
+public:
+    static constexpr int SampleRate = 11025;
+    static constexpr int MaxSeconds = 120;
+    static constexpr int MinHashes = 32;
+
+    AudioFingerprint() = default;
+    explicit AudioFingerprint(std::vector<quint32> words) : m_words(std::move(words)) {}
+
+    // Only the first MaxSeconds are used
+    static AudioFingerprint compute(const qint16* samples, qsizetype count);
+
+    const std::vector<quint32>& words() const { return m_words; }
+    bool isEmpty() const { return m_words.empty(); }
+
+    // Share of equal bits at the best alignment of the two (0.5 for unrelated audio), or 0
+    // when they overlap by less than ten seconds
+    double similarity(const AudioFingerprint& other) const;
+    // MinHash signature of the set of words, for locality-sensitive bucketing: two tracks
+    // agree on each entry with probability equal to the Jaccard similarity of their words
+    std::array<quint32, MinHashes> minHash() const;
+
+private:
+    std::vector<quint32> m_words;
+};
@@ -0,0 +1,195 @@
+#include "ControlClient.h"
+#include "MetadataReader.h"
+#include "TrackMetadata.h"
+
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+namespace {
+
+constexpr int ReconnectMs = 1000;
+
+} // namespace
+
+ControlClient::ControlClient(QObject* parent)
+    : QObject(parent)
+{
+    m_reconnectTimer.setSingleShot(true);
+    m_reconnectTimer.setInterval(ReconnectMs);
+    connect(&m_reconnectTimer, &QTimer::timeout, this, [this] { m_socket.connectToServer(m_serverName); });
+
+    connect(&m_socket, &QLocalSocket::connected, this, [this] {
+        m_pending.clear();
+        m_stateRequestId = m_nextId;
+        send(QStringLiteral("state"));
+        m_socket.write(m_outbox);
+        m_outbox.clear();
+        emit connectedChanged();
+    });
+    connect(&m_socket, &QLocalSocket::disconnected, this, [this] {
+        m_clock.setRunning(false);
+        emit connectedChanged();
+        m_reconnectTimer.start();
+    });
+    connect(&m_socket, &QLocalSocket::errorOccurred, this, [this](QLocalSocket::LocalSocketError) {
+        if (m_socket.state() == QLocalSocket::UnconnectedState && !m_reconnectTimer.isActive())
+            m_reconnectTimer.start();
+    });
+    connect(&m_socket, &QLocalSocket::readyRead, this, &ControlClient::onReadyRead);
+}
+
+void ControlClient::connectToServer(const QString& name)
+{
+    m_serverName = name;
+    m_socket.connectToServer(name);
+}
+
+void ControlClient::openFile(const QUrl& url)
+{
+    QJsonObject args;
+    args["url"] = url.toString();
+    send(QStringLiteral("open"), args);
+}
+
+void ControlClient::cueFile(const QUrl& url, qint64 positionMs)
+{
+    QJsonObject args;
+    args["url"] = url.toString();
+    args["position"] = positionMs;
+    send(QStringLiteral("cue"), args);
+}
+
+void ControlClient::play()
+{
+    send(QStringLiteral("play"));
+}
+
+void ControlClient::pause()
+{
+    send(QStringLiteral("pause"));
+}
+
+void ControlClient::seek(qint64 posMs)
+{
+    // Move the local clock right away; the daemon's next event confirms it
+    m_clock.reset(posMs);
+    emit positionChanged();
+
+    QJsonObject args;
+    args["position"] = posMs;
+    send(QStringLiteral("seek"), args);
+}
+
+void ControlClient::setNextFile(const QUrl& url)
+{
+    QJsonObject args;
+    args["url"] = url.toString();
+    send(QStringLiteral("setNext"), args);
+}
+
+void ControlClient::selectOutputByIndex(int index)
+{
+    QJsonObject args;
+    args["index"] = index;
+    send(QStringLiteral("selectOutput"), args);
+}
+
+void ControlClient::setVolume(float v)
+{
+    if (v == m_volume) return;
+    m_volume = v;
+    emit volumeChanged();
+
+    QJsonObject args;
+    args["value"] = double(v);
+    send(QStringLiteral("volume"), args);
+}
+
+void ControlClient::send(const QString& command, QJsonObject args)
+{
+    args["id"] = m_nextId++;
+    args["cmd"] = command;
+    const QByteArray line = QJsonDocument(args).toJson(QJsonDocument::Compact) + '\n';
+    if (isConnected()) {
+        m_socket.write(line);
+    } else if (m_stateRequestId == 0) {
+        // Not connected yet (startup): deliver once the first connection is up
+        m_outbox += line;
+    } else {
+        qWarning() << "Player daemon not connected; dropped" << command;
+    }
+}
+
+void ControlClient::onReadyRead()
+{
+    m_pending += m_socket.readAll();
+    const qsizetype end = m_pending.lastIndexOf('\n');
+    if (end < 0)
+        return;
+    const QByteArray lines = m_pending.left(end);
+    m_pending.remove(0, end + 1);
+
+    for (const QByteArray& line : lines.split('\n')) {
+        const QJsonObject message = QJsonDocument::fromJson(line).object();
+        if (message.value(QLatin1String("event")).toString() == QLatin1String("state")) {
+            applyState(message.value(QLatin1String("changes")).toObject());
+        } else if (message.value(QLatin1String("id")).toInt() == m_stateRequestId) {
+            applyState(message.value(QLatin1String("result")).toObject());
+        } else if (!message.value(QLatin1String("ok")).toBool(true)) {
+            qWarning() << "Player daemon:" << message.value(QLatin1String("error")).toString();
+        }
+    }
+}
+
+void ControlClient::applyState(const QJsonObject& changes)
+{
+    // playing before position, so the clock knows whether to extrapolate from it
+    if (changes.contains(QLatin1String("playing"))) {
+        const bool playing = changes.value(QLatin1String("playing")).toBool();
+        m_clock.setRunning(playing);
+        if (playing != m_playing) {
+            m_playing = playing;
+            emit playingChanged();
+        }
+    }
+    if (changes.contains(QLatin1String("position"))) {
+        m_clock.update(qint64(changes.value(QLatin1String("position")).toDouble()));
+        emit positionChanged();
+    }
+    if (changes.contains(QLatin1String("duration"))) {
+        m_duration = qint64(changes.value(QLatin1String("duration")).toDouble());
+        emit durationChanged();
+    }
+    if (changes.contains(QLatin1String("volume"))) {
+        const float volume = float(changes.value(QLatin1String("volume")).toDouble());
+        if (volume != m_volume) {
+            m_volume = volume;
+            emit volumeChanged();
+        }
+    }
+    if (changes.contains(QLatin1String("outputs")) || changes.contains(QLatin1String("currentOutput"))) {
+        if (changes.contains(QLatin1String("outputs"))) {
+            m_outputs.clear();
+            for (const QJsonValue& output : changes.value(QLatin1String("outputs")).toArray())
+                m_outputs << output.toString();
+        }
+        if (changes.contains(QLatin1String("currentOutput")))
+            m_currentOutput = changes.value(QLatin1String("currentOutput")).toString();
+        emit audioOutputsChanged();
+    }
+    if (changes.contains(QLatin1String("source"))) {
+        const QUrl source(changes.value(QLatin1String("source")).toString());
+        if (source != m_source) {
+            m_source = source;
+            if (m_currentMetadata) {
+                m_currentMetadata->deleteLater();
+                m_currentMetadata = nullptr;
+            }
+            if (!m_source.isEmpty())
+                m_currentMetadata = MetadataReader::readMetadataStandalone(m_source, this);
+            emit currentSourceChanged();
+            emit currentMetadataChanged();
+        }
+    }
+}
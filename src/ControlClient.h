@@ -0,0 +1,89 @@
+#pragma once
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QLocalSocket>
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+#include <QUrl>
+
+#include "PlaybackClock.h"
+
+class TrackMetadata;
+
+// Remote control for a musicplayerd instance with the same QML-facing API as
+// PlayerController, so the GUI can drive a daemon by exposing this as "player".
+// Commands are sent without waiting for replies; state arrives as the server's batched
+// events and the position is interpolated locally between them. Metadata for the current
+// track is read from the file here, as the daemon shares the filesystem.
+// Reconnects every ReconnectMs while the daemon is unreachable; commands issued before the
+// first connection are held until it is up, later ones are dropped while disconnected.
+class ControlClient : public QObject {
+    Q_OBJECT
+    Q_PROPERTY(bool connected READ isConnected NOTIFY connectedChanged)
+    Q_PROPERTY(bool playing READ playing NOTIFY playingChanged)
+    Q_PROPERTY(qint64 position READ position NOTIFY positionChanged)
+    Q_PROPERTY(qint64 duration READ duration NOTIFY durationChanged)
+    Q_PROPERTY(float volume READ volume WRITE setVolume NOTIFY volumeChanged)
+    Q_PROPERTY(QStringList audioOutputs READ audioOutputs NOTIFY audioOutputsChanged)
+    Q_PROPERTY(QString currentOutput READ currentOutput NOTIFY audioOutputsChanged)
+    Q_PROPERTY(QUrl currentSource READ currentSource NOTIFY currentSourceChanged)
+    Q_PROPERTY(TrackMetadata* currentMetadata READ currentMetadata NOTIFY currentMetadataChanged)
+public:
+    explicit ControlClient(QObject* parent = nullptr);
+
+    void connectToServer(const QString& name);
+    bool isConnected() const { return m_socket.state() == QLocalSocket::ConnectedState; }
+
+    Q_INVOKABLE void openFile(const QUrl& url);
+    Q_INVOKABLE void cueFile(const QUrl& url, qint64 positionMs);
+    Q_INVOKABLE void play();
+    Q_INVOKABLE void pause();
+    Q_INVOKABLE void seek(qint64 posMs);
+    Q_INVOKABLE void setNextFile(const QUrl& url);
+    Q_INVOKABLE void selectOutputByIndex(int index);
+    Q_INVOKABLE QUrl currentSource() const { return m_source; }
+    Q_INVOKABLE TrackMetadata* currentMetadata() const { return m_currentMetadata; }
+
+    bool playing() const { return m_playing; }
+    qint64 position() const { return m_clock.position(); }
+    qint64 duration() const { return m_duration; }
+    float volume() const { return m_volume; }
+    void setVolume(float v);
+
+    QStringList audioOutputs() const { return m_outputs; }
+    QString currentOutput() const { return m_currentOutput; }
+
+signals:
+    void connectedChanged();
+    void playingChanged();
+    void positionChanged();
+    void durationChanged();
+    void volumeChanged();
+    void currentSourceChanged();
+    void audioOutputsChanged();
+    void currentMetadataChanged();
+
+private:
+    void send(const QString& command, QJsonObject args = QJsonObject());
+    void onReadyRead();
+    void applyState(const QJsonObject& changes);
+
+    QLocalSocket m_socket;
+    QString m_serverName;
+    QTimer m_reconnectTimer;
+    QByteArray m_pending;
+    QByteArray m_outbox; // commands issued before the first connection
+    int m_nextId {1};
+    int m_stateRequestId {0};
+
+    bool m_playing {false};
+    qint64 m_duration {0};
+    float m_volume {0.8f};
+    QUrl m_source;
+    QStringList m_outputs;
+    QString m_currentOutput;
+    PlaybackClock m_clock;
+    TrackMetadata* m_currentMetadata {nullptr};
+};
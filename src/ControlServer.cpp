@@ -0,0 +1,436 @@
+#include "ControlServer.h"
+#include "PlayerController.h"
+#include "PlaylistModel.h"
+#include "SessionStore.h"
+#include "TrackMetadata.h"
+
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QStandardPaths>
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+// Coalescing window for state events
+constexpr int EventBatchMs = 50;
+// A client that sends a longer line than this without a newline is dropped
+constexpr qsizetype MaxRequestBytes = 1024 * 1024;
+
+QUrl urlArgument(const QJsonObject& args, const char* key)
+{
+    const QString value = args.value(QLatin1String(key)).toString();
+    return value.isEmpty() ? QUrl() : QUrl::fromUserInput(value, QString(), QUrl::AssumeLocalFile);
+}
+
+// First match at or after from, then from the start; duplicates resolve towards from
+int indexOfUrl(const PlaylistModel* queue, const QUrl& url, int from)
+{
+    const QVector<PlaylistModel::Item>& items = queue->items();
+    from = qBound(0, from, int(items.size()));
+    for (int i = from; i < items.size(); ++i) {
+        if (items.at(i).url() == url) return i;
+    }
+    for (int i = 0; i < from; ++i) {
+        if (items.at(i).url() == url) return i;
+    }
+    return -1;
+}
+
+} // namespace
+
+ControlServer::ControlServer(SessionStore* session, QObject* parent)
+    : QObject(parent)
+    , m_server(new QLocalServer(this))
+    , m_session(session)
+{
+    connect(m_server, &QLocalServer::newConnection, this, &ControlServer::onNewConnection);
+
+    m_eventTimer.setSingleShot(true);
+    m_eventTimer.setInterval(EventBatchMs);
+    connect(&m_eventTimer, &QTimer::timeout, this, &ControlServer::flushEvents);
+
+    PlaylistModel* queue = m_session->queue();
+    const auto queueChanged = [this] { markChanged(QStringLiteral("queueCount")); };
+    connect(queue, &QAbstractItemModel::rowsInserted, this, queueChanged);
+    connect(queue, &QAbstractItemModel::rowsRemoved, this, queueChanged);
+    connect(queue, &QAbstractItemModel::modelReset, this, queueChanged);
+    connect(m_session, &SessionStore::currentIndexChanged, this, [this] { markChanged(QStringLiteral("queueIndex")); });
+}
+
+ControlServer::~ControlServer()
+{
+    for (const Client& client : m_clients)
+        client.socket->disconnect(this);
+}
+
+QString ControlServer::defaultSocketName()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation) + QStringLiteral("/musicplayerd.sock");
+}
+
+bool ControlServer::listen(const QString& name)
+{
+    // Only remove the socket file if nobody is answering on it
+    QLocalSocket probe;
+    probe.connectToServer(name);
+    if (probe.waitForConnected(200)) {
+        m_error = QStringLiteral("another server is already listening on %1").arg(name);
+        return false;
+    }
+    QLocalServer::removeServer(name);
+
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+    if (!m_server->listen(name)) {
+        m_error = m_server->errorString();
+        return false;
+    }
+    return true;
+}
+
+QString ControlServer::errorString() const
+{
+    return m_error;
+}
+
+PlayerController* ControlServer::player()
+{
+    if (m_player)
+        return m_player;
+
+    m_player = new PlayerController(this);
+    m_player->initializeAudioDevices();
+
+    connect(m_player, &PlayerController::playingChanged, this, [this] {
+        markChanged(QStringLiteral("playing"));
+        markChanged(QStringLiteral("position"));
+    });
+    connect(m_player, &PlayerController::positionChanged, this, [this] {
+        m_session->setPosition(m_player->position());
+        markChanged(QStringLiteral("position"));
+    });
+    connect(m_player, &PlayerController::durationChanged, this, [this] { markChanged(QStringLiteral("duration")); });
+    connect(m_player, &PlayerController::volumeChanged, this, [this] { markChanged(QStringLiteral("volume")); });
+    connect(m_player, &PlayerController::audioOutputsChanged, this, [this] {
+        markChanged(QStringLiteral("outputs"));
+        markChanged(QStringLiteral("currentOutput"));
+    });
+    connect(m_player, &PlayerController::currentMetadataChanged, this, [this] { markChanged(QStringLiteral("metadata")); });
+    connect(m_player, &PlayerController::currentSourceChanged, this, &ControlServer::onCurrentSourceChanged);
+
+    // Resume where the previous run stopped, paused
+    const int index = m_session->currentIndex();
+    PlaylistModel* queue = m_session->queue();
+    if (index >= 0 && index < queue->count()) {
+        m_player->cueFile(queue->items().at(index).url(), m_session->restoredPosition());
+        armNext();
+    }
+    emit engineCreated(m_player);
+    return m_player;
+}
+
+QJsonObject ControlServer::state() const
+{
+    QJsonObject s;
+    s["queueCount"] = m_session->queue()->count();
+    s["queueIndex"] = m_session->currentIndex();
+    if (!m_player) {
+        s["playing"] = false;
+        s["position"] = 0;
+        s["duration"] = 0;
+        s["source"] = QString();
+        s["outputs"] = QJsonArray();
+        s["currentOutput"] = QString();
+        s["metadata"] = QJsonValue::Null;
+        return s;
+    }
+
+    s["playing"] = m_player->playing();
+    s["position"] = m_player->position();
+    s["duration"] = m_player->duration();
+    s["volume"] = double(m_player->volume());
+    s["source"] = m_player->currentSource().toString();
+    s["outputs"] = QJsonArray::fromStringList(m_player->audioOutputs());
+    s["currentOutput"] = m_player->currentOutput();
+
+    if (const TrackMetadata* metadata = m_player->currentMetadata()) {
+        QJsonObject m;
+        m["title"] = metadata->title();
+        m["artist"] = metadata->artist();
+        m["album"] = metadata->album();
+        m["genre"] = metadata->genre();
+        m["year"] = metadata->year();
+        m["trackNumber"] = metadata->trackNumber();
+        m["duration"] = metadata->duration();
+        s["metadata"] = m;
+    } else {
+        s["metadata"] = QJsonValue::Null;
+    }
+    return s;
+}
+
+void ControlServer::onNewConnection()
+{
+    while (QLocalSocket* socket = m_server->nextPendingConnection()) {
+        m_clients.append({socket, QByteArray()});
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket] { onReadyRead(socket); });
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket] {
+            for (int i = 0; i < m_clients.size(); ++i) {
+                if (m_clients.at(i).socket == socket) {
+                    m_clients.removeAt(i);
+                    break;
+                }
+            }
+            socket->deleteLater();
+        });
+    }
+}
+
+void ControlServer::onReadyRead(QLocalSocket* socket)
+{
+    auto it = std::find_if(m_clients.begin(), m_clients.end(), [socket](const Client& c) { return c.socket == socket; });
+    if (it == m_clients.end())
+        return;
+
+    it->pending += socket->readAll();
+    QByteArray lines;
+    const qsizetype end = it->pending.lastIndexOf('\n');
+    if (end >= 0) {
+        lines = it->pending.left(end);
+        it->pending.remove(0, end + 1);
+    }
+    if (it->pending.size() > MaxRequestBytes) {
+        qWarning() << "Control client sent an oversized request; disconnecting";
+        socket->disconnectFromServer();
+        return;
+    }
+
+    for (const QByteArray& line : lines.split('\n')) {
+        if (line.trimmed().isEmpty())
+            continue;
+        QJsonParseError parseError;
+        const QJsonDocument document = QJsonDocument::fromJson(line, &parseError);
+        if (!document.isObject()) {
+            QJsonObject reply;
+            reply["ok"] = false;
+            reply["error"] = parseError.error != QJsonParseError::NoError ? parseError.errorString()
+                                                                          : QStringLiteral("request must be an object");
+            send(socket, reply);
+            continue;
+        }
+        handleRequest(socket, document.object());
+    }
+}
+
+void ControlServer::handleRequest(QLocalSocket* socket, const QJsonObject& request)
+{
+    QString error;
+    const QJsonValue result = execute(request.value(QLatin1String("cmd")).toString(), request, error);
+
+    QJsonObject reply;
+    if (request.contains(QLatin1String("id")))
+        reply["id"] = request.value(QLatin1String("id"));
+    reply["ok"] = error.isEmpty();
+    if (error.isEmpty()) {
+        if (!result.isUndefined())
+            reply["result"] = result;
+    } else {
+        reply["error"] = error;
+    }
+    send(socket, reply);
+}
+
+QJsonValue ControlServer::execute(const QString& command, const QJsonObject& args, QString& error)
+{
+    PlaylistModel* queue = m_session->queue();
+
+    // Queries and queue edits don't need the engine
+    if (command == QLatin1String("state"))
+        return state();
+    if (command == QLatin1String("metadata"))
+        return state().value(QLatin1String("metadata"));
+    if (command == QLatin1String("queue")) {
+        QJsonArray rows;
+        for (const PlaylistModel::Item& item : queue->items()) {
+            QJsonObject row;
+            row["url"] = item.url().toString();
+            row["title"] = item.title.isEmpty() ? item.display : item.title;
+            row["artist"] = item.artist;
+            row["album"] = item.album;
+            row["duration"] = item.duration;
+            rows.append(row);
+        }
+        return rows;
+    }
+    if (command == QLatin1String("enqueue")) {
+        QJsonArray urls = args.value(QLatin1String("urls")).toArray();
+        if (args.contains(QLatin1String("url")))
+            urls.append(args.value(QLatin1String("url")));
+        const int before = queue->count();
+        for (const QJsonValue& value : urls) {
+            const QUrl url = QUrl::fromUserInput(value.toString(), QString(), QUrl::AssumeLocalFile);
+            if (url.isValid())
+                queue->add(url);
+        }
+        // The playing track was the last one: the first new row becomes the gapless next
+        if (m_player && m_session->currentIndex() == before - 1)
+            armNext();
+        return queue->count() - before;
+    }
+    if (command == QLatin1String("clearQueue")) {
+        queue->clear();
+        m_session->setCurrentIndex(-1);
+        if (m_player)
+            armNext();
+        return QJsonValue();
+    }
+
+    if (command == QLatin1String("play")) {
+        PlayerController* p = player();
+        if (p->currentSource().isEmpty() && queue->count() > 0)
+            playIndex(qMax(0, m_session->currentIndex()));
+        else
+            p->play();
+        return QJsonValue();
+    }
+    if (command == QLatin1String("pause")) {
+        if (m_player)
+            m_player->pause();
+        return QJsonValue();
+    }
+    if (command == QLatin1String("toggle")) {
+        if (m_player && m_player->playing())
+            m_player->pause();
+        else
+            return execute(QStringLiteral("play"), args, error);
+        return QJsonValue();
+    }
+    if (command == QLatin1String("seek")) {
+        const QJsonValue position = args.value(QLatin1String("position"));
+        if (!position.isDouble()) {
+            error = QStringLiteral("seek needs a numeric position (ms)");
+            return QJsonValue();
+        }
+        player()->seek(qint64(position.toDouble()));
+        return QJsonValue();
+    }
+    if (command == QLatin1String("open") || command == QLatin1String("cue") || command == QLatin1String("setNext")) {
+        const QUrl url = urlArgument(args, "url");
+        if (!url.isValid() && command != QLatin1String("setNext")) {
+            error = QStringLiteral("%1 needs a url").arg(command);
+            return QJsonValue();
+        }
+        if (command == QLatin1String("open"))
+            player()->openFile(url);
+        else if (command == QLatin1String("cue"))
+            player()->cueFile(url, qint64(args.value(QLatin1String("position")).toDouble()));
+        else
+            player()->setNextFile(url);
+        return QJsonValue();
+    }
+    if (command == QLatin1String("volume")) {
+        const QJsonValue value = args.value(QLatin1String("value"));
+        if (!value.isDouble()) {
+            error = QStringLiteral("volume needs a numeric value (0-1)");
+            return QJsonValue();
+        }
+        player()->setVolume(float(qBound(0.0, value.toDouble(), 1.0)));
+        return QJsonValue();
+    }
+    if (command == QLatin1String("selectOutput")) {
+        player()->selectOutputByIndex(args.value(QLatin1String("index")).toInt(-1));
+        return QJsonValue();
+    }
+    if (command == QLatin1String("playIndex") || command == QLatin1String("next") || command == QLatin1String("previous")) {
+        int index = m_session->currentIndex();
+        if (command == QLatin1String("playIndex"))
+            index = args.value(QLatin1String("index")).toInt(-1);
+        else
+            index += command == QLatin1String("next") ? 1 : -1;
+        if (index < 0 || index >= queue->count()) {
+            error = QStringLiteral("no queue entry at %1").arg(index);
+            return QJsonValue();
+        }
+        playIndex(index);
+        return QJsonValue();
+    }
+
+    error = command.isEmpty() ? QStringLiteral("missing cmd") : QStringLiteral("unknown command: %1").arg(command);
+    return QJsonValue();
+}
+
+void ControlServer::send(QLocalSocket* socket, const QJsonObject& message)
+{
+    if (socket->state() != QLocalSocket::ConnectedState)
+        return;
+    socket->write(QJsonDocument(message).toJson(QJsonDocument::Compact) + '\n');
+}
+
+void ControlServer::markChanged(const QString& field)
+{
+    m_changed.insert(field);
+    if (!m_eventTimer.isActive())
+        m_eventTimer.start();
+}
+
+void ControlServer::flushEvents()
+{
+    if (m_changed.isEmpty() || m_clients.isEmpty()) {
+        m_changed.clear();
+        return;
+    }
+
+    const QJsonObject full = state();
+    QJsonObject changes;
+    for (const QString& field : std::as_const(m_changed))
+        changes[field] = full.value(field);
+    m_changed.clear();
+
+    QJsonObject event;
+    event["event"] = QStringLiteral("state");
+    event["changes"] = changes;
+    for (const Client& client : std::as_const(m_clients))
+        send(client.socket, event);
+}
+
+void ControlServer::playIndex(int index)
+{
+    PlaylistModel* queue = m_session->queue();
+    if (index < 0 || index >= queue->count())
+        return;
+    m_session->setCurrentIndex(index);
+    // openFile() emits currentSourceChanged, whose handler arms the next row
+    player()->openFile(queue->items().at(index).url());
+}
+
+void ControlServer::armNext()
+{
+    PlaylistModel* queue = m_session->queue();
+    const int next = m_session->currentIndex() + 1;
+    if (m_session->currentIndex() >= 0 && next < queue->count())
+        m_player->setNextFile(queue->items().at(next).url());
+    else
+        m_player->setNextFile(QUrl());
+}
+
+void ControlServer::onCurrentSourceChanged()
+{
+    markChanged(QStringLiteral("source"));
+    markChanged(QStringLiteral("duration"));
+
+    // A gapless switch moved to the next row (or the queue ran out). A source from outside the
+    // queue (opened by an attached GUI from its own playlist) leaves the position and the
+    // armed next track alone.
+    const QUrl source = m_player->currentSource();
+    if (source.isEmpty())
+        return;
+    const int index = indexOfUrl(m_session->queue(), source, qMax(0, m_session->currentIndex()));
+    if (index < 0)
+        return;
+    m_session->setCurrentIndex(index);
+    armNext();
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QTimer>
+#include <QVector>
+
+class PlayerController;
+class SessionStore;
+class QLocalServer;
+class QLocalSocket;
+
+// Local control API for the playback engine, served on a Unix-domain socket (a named pipe
+// on Windows). Used by musicplayerd and by the GUI when it attaches to a daemon.
+//
+// Wire format: one JSON object per line in both directions.
+//   request  {"id": 7, "cmd": "seek", "position": 61000}
+//   reply    {"id": 7, "ok": true, "result": ...} or {"id": 7, "ok": false, "error": "..."}
+//   event    {"event": "state", "changes": {"playing": true, "position": 61000, ...}}
+// Commands: state, play, pause, toggle, seek, open, cue, setNext, volume, selectOutput,
+// enqueue, playIndex, next, previous, clearQueue, queue, metadata.
+//
+// Every connected client receives events. Changes are collected and sent as one batch per
+// EventBatchMs, so a seek or track change costs clients one message, not one per property.
+//
+// The engine (PlayerController and its media backend) is only created by the first command
+// that needs it; an idle daemon holds just the socket and the restored queue.
+class ControlServer : public QObject {
+    Q_OBJECT
+
+public:
+    // The queue and the current index in it live in session, which must outlive the server
+    explicit ControlServer(SessionStore* session, QObject* parent = nullptr);
+    ~ControlServer() override;
+
+    // musicplayerd.sock in the user's runtime directory
+    static QString defaultSocketName();
+    // Fails if another server is already answering on name; a stale socket file is replaced
+    bool listen(const QString& name);
+    QString errorString() const;
+
+    // Full state as sent in reply to "state"; also the shape of event changes
+    QJsonObject state() const;
+
+signals:
+    // The first command that needs the engine has created it
+    void engineCreated(PlayerController* player);
+
+private:
+    struct Client {
+        QLocalSocket* socket {nullptr};
+        QByteArray pending; // partial request line
+    };
+
+    void onNewConnection();
+    void onReadyRead(QLocalSocket* socket);
+    void handleRequest(QLocalSocket* socket, const QJsonObject& request);
+    QJsonValue execute(const QString& command, const QJsonObject& args, QString& error);
+    void send(QLocalSocket* socket, const QJsonObject& message);
+
+    PlayerController* player();
+    void markChanged(const QString& field);
+    void flushEvents();
+
+    // Same queue handling as the QML front end
+    void playIndex(int index);
+    void armNext();
+    void onCurrentSourceChanged();
+
+    QLocalServer* m_server {nullptr};
+    QString m_error;
+    SessionStore* m_session {nullptr};
+    PlayerController* m_player {nullptr};
+    QVector<Client> m_clients;
+
+    QSet<QString> m_changed;
+    QTimer m_eventTimer;
+};
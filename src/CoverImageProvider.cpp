@@ -0,0 +1,95 @@
+#include "CoverImageProvider.h"
+#include "MetadataReader.h"
+
+#include <QRunnable>
+#include <QUrl>
+
+#include <atomic>
+
+namespace {
+
+// Cost is in KiB; 32 MiB holds a few thousand 128px thumbnails
+constexpr int CacheCostKiB = 32 * 1024;
+
+class CoverImageResponse : public QQuickImageResponse, public QRunnable {
+public:
+    CoverImageResponse(CoverImageProvider* provider, const QString& filePath, const QSize& requestedSize)
+        : m_provider(provider)
+        , m_filePath(filePath)
+        , m_requestedSize(requestedSize)
+    {
+        setAutoDelete(false);
+    }
+
+    QQuickTextureFactory* textureFactory() const override
+    {
+        return QQuickTextureFactory::textureFactoryForImage(m_image);
+    }
+
+    void cancel() override { m_cancelled = true; }
+
+    void run() override
+    {
+        const QString key = m_filePath + QLatin1Char('@') + QString::number(m_requestedSize.width())
+                          + QLatin1Char('x') + QString::number(m_requestedSize.height());
+        if (!m_cancelled && !m_provider->cached(key, &m_image)) {
+            QImage cover = MetadataReader::readCoverArt(QUrl::fromLocalFile(m_filePath));
+            if (!cover.isNull() && m_requestedSize.isValid()) {
+                cover = cover.scaled(m_requestedSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+            }
+            // A 1x1 transparent image stands in for "no cover" so QML doesn't log an error per file
+            if (cover.isNull()) {
+                cover = QImage(1, 1, QImage::Format_ARGB32_Premultiplied);
+                cover.fill(Qt::transparent);
+            }
+            m_provider->insert(key, cover);
+            m_image = cover;
+        }
+        emit finished();
+    }
+
+private:
+    CoverImageProvider* m_provider;
+    QString m_filePath;
+    QSize m_requestedSize;
+    QImage m_image;
+    std::atomic<bool> m_cancelled {false};
+};
+
+} // namespace
+
+CoverImageProvider::CoverImageProvider()
+    : m_cache(CacheCostKiB)
+{
+    m_pool.setMaxThreadCount(2);
+}
+
+CoverImageProvider::~CoverImageProvider()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+QQuickImageResponse* CoverImageProvider::requestImageResponse(const QString& id, const QSize& requestedSize)
+{
+    const QString filePath = QString::fromUtf8(
+        QByteArray::fromBase64(id.toLatin1(), QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals));
+    auto* response = new CoverImageResponse(this, filePath, requestedSize);
+    m_pool.start(response);
+    return response;
+}
+
+bool CoverImageProvider::cached(const QString& key, QImage* image)
+{
+    QMutexLocker lock(&m_cacheMutex);
+    const QImage* hit = m_cache.object(key);
+    if (!hit) return false;
+    *image = *hit;
+    return true;
+}
+
+void CoverImageProvider::insert(const QString& key, const QImage& image)
+{
+    QMutexLocker lock(&m_cacheMutex);
+    m_cache.insert(key, new QImage(image), qMax<int>(1, int(image.sizeInBytes() / 1024)));
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+#include <QQuickAsyncImageProvider>
+#include <QThreadPool>
+
+// Serves "image://covers/<base64url path>" thumbnails for the file browser.
+// Decoding runs on a small pool so scrolling never waits for TagLib or the image decoder;
+// Image elements only request sources for delegates that exist, so off-screen rows cost
+// nothing. Results are cached by path and requested size.
+class CoverImageProvider : public QQuickAsyncImageProvider {
+public:
+    CoverImageProvider();
+    ~CoverImageProvider() override;
+
+    QQuickImageResponse* requestImageResponse(const QString& id, const QSize& requestedSize) override;
+
+    // Shared with the responses running on the pool
+    bool cached(const QString& key, QImage* image);
+    void insert(const QString& key, const QImage& image);
+
+private:
+    QThreadPool m_pool;
+    QMutex m_cacheMutex;
+    QCache<QString, QImage> m_cache;
+};
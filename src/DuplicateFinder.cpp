@@ -0,0 +1,462 @@
+#include "DuplicateFinder.h"
+#include "LibraryIndex.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QThread>
+#include <QtEndian>
+
+#include <limits>
+#include <numeric>
+#include <utility>
+
+namespace {
+
+constexpr quint32 CacheMagic = 0x5046504d; // "MPFP"
+constexpr quint32 FormatVersion = 1;
+const char CacheFileName[] = "fingerprints.dat";
+// Copies of one recording score 0.85 and up even through lossy encoding, unrelated
+// tracks around 0.5
+constexpr double MatchThreshold = 0.75;
+// Buckets this full hold a word common to many recordings (silence, a test tone) rather
+// than copies of one, and would cost a quadratic number of comparisons
+constexpr int MaxBucket = 64;
+// How quickly a cancel reaches the running decoders
+constexpr int CancelPollMs = 100;
+
+int findRoot(std::vector<int>& parent, int i)
+{
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+} // namespace
+
+struct DuplicateFinder::Run {
+    std::atomic<bool> cancelled {false};
+    int pending {0}; // GUI thread
+    QString ffmpeg;
+};
+
+DuplicateFinder::DuplicateFinder(LibraryIndex* library, const QString& stateDirectory, QObject* parent)
+    : QAbstractListModel(parent)
+    , m_library(library)
+    , m_stateDirectory(stateDirectory)
+{
+    // Each job is one single-threaded decoder
+    m_pool.setMaxThreadCount(QThread::idealThreadCount());
+}
+
+DuplicateFinder::~DuplicateFinder()
+{
+    if (m_run)
+        m_run->cancelled = true;
+    m_pool.waitForDone();
+    if (m_cacheDirty)
+        saveCache();
+}
+
+int DuplicateFinder::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : int(m_rows.size());
+}
+
+QVariant DuplicateFinder::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_rows.size()) return QVariant();
+    const Row& row = m_rows.at(index.row());
+    switch (role) {
+    case UrlRole:
+        return row.item.url();
+    case Qt::DisplayRole:
+    case PrimaryTextRole:
+        return row.item.primaryText;
+    case SecondaryTextRole:
+        return row.item.secondaryText;
+    case DurationTextRole:
+        return row.item.durationText;
+    case GroupRole:
+        return row.group;
+    case SimilarityRole:
+        return row.similarity;
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> DuplicateFinder::roleNames() const
+{
+    return {
+        {UrlRole, "url"},
+        {PrimaryTextRole, "primaryText"},
+        {SecondaryTextRole, "secondaryText"},
+        {DurationTextRole, "durationText"},
+        {GroupRole, "group"},
+        {SimilarityRole, "similarity"},
+    };
+}
+
+bool DuplicateFinder::start()
+{
+    if (m_run) {
+        setError(QStringLiteral("A scan is already running"));
+        return false;
+    }
+    const QString ffmpeg = QStandardPaths::findExecutable(QStringLiteral("ffmpeg"));
+    if (ffmpeg.isEmpty()) {
+        setError(QStringLiteral("ffmpeg was not found on PATH"));
+        return false;
+    }
+    if (!m_cacheLoaded) {
+        loadCache();
+        m_cacheLoaded = true;
+    }
+
+    // Remote streams have no file to fingerprint
+    m_items.clear();
+    for (int track = 0; track < m_library->trackCount(); ++track) {
+        if (m_library->isLive(track) && !m_library->item(track).remote)
+            m_items.push_back(m_library->item(track));
+    }
+
+    beginResetModel();
+    m_rows.clear();
+    m_groupCount = 0;
+    endResetModel();
+
+    auto run = std::make_shared<Run>();
+    run->ffmpeg = ffmpeg;
+    run->pending = int(m_items.size());
+    m_run = run;
+    m_scanned = 0;
+    m_audioMs = 0;
+    m_wallMs = 0;
+    m_wallClock.start();
+    setError(QString());
+    emit runningChanged();
+    emit progressChanged();
+    emit groupsChanged();
+
+    for (int index = 0; index < int(m_items.size()); ++index) {
+        const QString location = m_items[index].location;
+        const CacheEntry cached = m_cache.value(location);
+        m_pool.start([this, run, index, location, cached] {
+            const JobResult result = runJob(location, cached, *run);
+            QMetaObject::invokeMethod(this, [this, run, index, result] {
+                onJobFinished(run, index, result);
+            }, Qt::QueuedConnection);
+        });
+    }
+    if (m_items.empty())
+        groupAll(run);
+    return true;
+}
+
+DuplicateFinder::JobResult DuplicateFinder::runJob(const QString& location, const CacheEntry& cached, const Run& run)
+{
+    JobResult result;
+    if (run.cancelled)
+        return result;
+
+    const QFileInfo info(location);
+    if (!info.isFile())
+        return result;
+    result.entry.size = info.size();
+    result.entry.mtimeMs = info.lastModified().toMSecsSinceEpoch();
+    if (cached.size == result.entry.size && cached.mtimeMs == result.entry.mtimeMs) {
+        result.entry.fingerprint = cached.fingerprint;
+        result.ok = true;
+        return result;
+    }
+
+    QProcess ffmpeg;
+    ffmpeg.start(run.ffmpeg, {
+        QStringLiteral("-nostdin"), QStringLiteral("-hide_banner"), QStringLiteral("-nostats"),
+        QStringLiteral("-loglevel"), QStringLiteral("error"),
+        QStringLiteral("-i"), location,
+        QStringLiteral("-map"), QStringLiteral("0:a:0"),
+        QStringLiteral("-t"), QString::number(AudioFingerprint::MaxSeconds),
+        QStringLiteral("-ac"), QStringLiteral("1"),
+        QStringLiteral("-ar"), QString::number(AudioFingerprint::SampleRate),
+        QStringLiteral("-threads"), QStringLiteral("1"),
+        QStringLiteral("-f"), QStringLiteral("s16le"),
+        QStringLiteral("pipe:1"),
+    });
+    if (!ffmpeg.waitForStarted())
+        return result;
+    while (ffmpeg.state() != QProcess::NotRunning && !ffmpeg.waitForFinished(CancelPollMs)) {
+        if (run.cancelled) {
+            ffmpeg.kill();
+            ffmpeg.waitForFinished();
+            return result;
+        }
+    }
+    if (ffmpeg.exitStatus() != QProcess::NormalExit || ffmpeg.exitCode() != 0)
+        return result;
+
+    const QByteArray pcm = ffmpeg.readAllStandardOutput();
+    std::vector<qint16> samples(size_t(pcm.size() / 2));
+    qFromLittleEndian<qint16>(pcm.constData(), qsizetype(samples.size()), samples.data());
+    result.entry.fingerprint = AudioFingerprint::compute(samples.data(), qsizetype(samples.size()));
+    result.decodedMs = qint64(samples.size()) * 1000 / AudioFingerprint::SampleRate;
+    result.decoded = true;
+    result.ok = true;
+    return result;
+}
+
+void DuplicateFinder::onJobFinished(const std::shared_ptr<Run>& run, int index, const JobResult& result)
+{
+    if (run != m_run) return;
+    if (result.ok)
+        m_cache.insert(m_items[index].location, result.entry);
+    if (result.decoded) {
+        m_audioMs += double(result.decodedMs);
+        m_cacheDirty = true;
+    }
+    ++m_scanned;
+    emit progressChanged();
+
+    if (--run->pending == 0)
+        groupAll(run);
+}
+
+void DuplicateFinder::groupAll(const std::shared_ptr<Run>& run)
+{
+    if (run->cancelled) {
+        finishRun();
+        return;
+    }
+
+    // Files gone from the library leave the cache
+    QSet<QString> scanned;
+    scanned.reserve(int(m_items.size()));
+    for (const PlaylistModel::Item& item : m_items)
+        scanned.insert(item.location);
+    for (auto it = m_cache.begin(); it != m_cache.end();) {
+        if (scanned.contains(it.key())) {
+            ++it;
+        } else {
+            it = m_cache.erase(it);
+            m_cacheDirty = true;
+        }
+    }
+
+    // The cache is left alone until onGrouped(), so the workers can read it in place
+    std::vector<const AudioFingerprint*> fingerprints;
+    std::vector<int> itemOf;
+    for (int index = 0; index < int(m_items.size()); ++index) {
+        const auto it = m_cache.constFind(m_items[index].location);
+        if (it == m_cache.constEnd() || it->fingerprint.isEmpty()) continue;
+        fingerprints.push_back(&it->fingerprint);
+        itemOf.push_back(index);
+    }
+    m_pool.start([this, run, fingerprints, itemOf] {
+        std::vector<std::vector<Match>> groups = group(fingerprints, run->cancelled);
+        for (std::vector<Match>& matches : groups) {
+            for (Match& match : matches)
+                match.track = itemOf[match.track];
+        }
+        QMetaObject::invokeMethod(this, [this, run, groups] {
+            onGrouped(run, groups);
+        }, Qt::QueuedConnection);
+    });
+}
+
+std::vector<std::vector<DuplicateFinder::Match>> DuplicateFinder::group(const std::vector<const AudioFingerprint*>& fingerprints,
+                                                                        const std::atomic<bool>& cancelled)
+{
+    const int count = int(fingerprints.size());
+    std::vector<std::array<quint32, AudioFingerprint::MinHashes>> signatures(count);
+    for (int i = 0; i < count; ++i)
+        signatures[i] = fingerprints[i]->minHash();
+
+    // Each MinHash entry is one bucketing: tracks land together when their smallest word
+    // under that hash is the same, which copies of a recording almost always share in a
+    // few of the entries
+    std::vector<int> parent(count);
+    std::iota(parent.begin(), parent.end(), 0);
+    QSet<quint64> compared;
+    for (int h = 0; h < AudioFingerprint::MinHashes; ++h) {
+        if (cancelled)
+            return {};
+        QHash<quint32, std::vector<int>> buckets;
+        for (int i = 0; i < count; ++i) {
+            if (signatures[i][h] != std::numeric_limits<quint32>::max())
+                buckets[signatures[i][h]].push_back(i);
+        }
+        for (const std::vector<int>& bucket : std::as_const(buckets)) {
+            if (bucket.size() < 2 || bucket.size() > size_t(MaxBucket)) continue;
+            for (size_t a = 0; a < bucket.size(); ++a) {
+                for (size_t b = a + 1; b < bucket.size(); ++b) {
+                    const int x = bucket[a];
+                    const int y = bucket[b];
+                    if (findRoot(parent, x) == findRoot(parent, y)) continue;
+                    const quint64 pair = quint64(x) << 32 | quint64(y);
+                    if (compared.contains(pair)) continue;
+                    compared.insert(pair);
+                    if (fingerprints[x]->similarity(*fingerprints[y]) >= MatchThreshold)
+                        parent[findRoot(parent, y)] = findRoot(parent, x);
+                }
+            }
+        }
+    }
+
+    // Groups in order of their lowest track, which leads
+    std::vector<std::vector<Match>> members;
+    QHash<int, int> groupOf; // by root
+    for (int i = 0; i < count; ++i) {
+        const int root = findRoot(parent, i);
+        auto it = groupOf.find(root);
+        if (it == groupOf.end()) {
+            it = groupOf.insert(root, int(members.size()));
+            members.emplace_back();
+        }
+        members[it.value()].push_back({i, 1.0});
+    }
+    std::vector<std::vector<Match>> groups;
+    for (std::vector<Match>& matches : members) {
+        if (matches.size() < 2) continue;
+        const AudioFingerprint& leader = *fingerprints[matches.front().track];
+        for (size_t m = 1; m < matches.size(); ++m)
+            matches[m].similarity = leader.similarity(*fingerprints[matches[m].track]);
+        groups.push_back(std::move(matches));
+    }
+    return groups;
+}
+
+void DuplicateFinder::onGrouped(const std::shared_ptr<Run>& run, const std::vector<std::vector<Match>>& groups)
+{
+    if (run != m_run) return;
+    beginResetModel();
+    m_rows.clear();
+    for (int number = 1; number <= int(groups.size()); ++number) {
+        for (const Match& match : groups[number - 1])
+            m_rows.append({m_items[match.track], number, match.similarity});
+    }
+    m_groupCount = int(groups.size());
+    endResetModel();
+    emit groupsChanged();
+    finishRun();
+}
+
+void DuplicateFinder::finishRun()
+{
+    m_wallMs = m_wallClock.elapsed();
+    m_run.reset();
+    if (m_cacheDirty && saveCache())
+        m_cacheDirty = false;
+    emit runningChanged();
+    emit progressChanged();
+}
+
+void DuplicateFinder::cancel()
+{
+    if (m_run)
+        m_run->cancelled = true;
+}
+
+void DuplicateFinder::dismiss(int row)
+{
+    if (row < 0 || row >= m_rows.size()) return;
+    const int number = m_rows.at(row).group;
+    beginRemoveRows(QModelIndex(), row, row);
+    m_rows.removeAt(row);
+    endRemoveRows();
+
+    int first = row;
+    while (first > 0 && m_rows.at(first - 1).group == number)
+        --first;
+    int last = first;
+    while (last < m_rows.size() && m_rows.at(last).group == number)
+        ++last;
+    if (last - first == 1) {
+        beginRemoveRows(QModelIndex(), first, first);
+        m_rows.removeAt(first);
+        endRemoveRows();
+        --m_groupCount;
+        emit groupsChanged();
+    }
+}
+
+double DuplicateFinder::throughput() const
+{
+    const qint64 wallMs = m_run ? m_wallClock.elapsed() : m_wallMs;
+    return wallMs > 0 ? m_audioMs / double(wallMs) : 0.0;
+}
+
+void DuplicateFinder::setError(const QString& error)
+{
+    if (error == m_error) return;
+    m_error = error;
+    emit errorChanged();
+}
+
+QString DuplicateFinder::cachePath() const
+{
+    return m_stateDirectory + QLatin1Char('/') + QLatin1String(CacheFileName);
+}
+
+bool DuplicateFinder::loadCache()
+{
+    m_cache.clear();
+    QFile file(cachePath());
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0, version = 0, count = 0;
+    in >> magic >> version >> count;
+    if (magic != CacheMagic || version != FormatVersion)
+        return false;
+    m_cache.reserve(int(count));
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        QString location;
+        CacheEntry entry;
+        quint32 words = 0;
+        in >> location >> entry.size >> entry.mtimeMs >> words;
+        std::vector<quint32> fingerprint;
+        // A corrupt count must not allocate the world
+        for (quint32 w = 0; w < words && in.status() == QDataStream::Ok; ++w) {
+            quint32 word = 0;
+            in >> word;
+            fingerprint.push_back(word);
+        }
+        entry.fingerprint = AudioFingerprint(std::move(fingerprint));
+        m_cache.insert(location, entry);
+    }
+    if (in.status() != QDataStream::Ok) {
+        m_cache.clear();
+        return false;
+    }
+    return true;
+}
+
+bool DuplicateFinder::saveCache() const
+{
+    QDir().mkpath(m_stateDirectory);
+    QSaveFile file(cachePath());
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << CacheMagic << FormatVersion << quint32(m_cache.size());
+    for (auto it = m_cache.constBegin(); it != m_cache.constEnd(); ++it) {
+        const CacheEntry& entry = it.value();
+        out << it.key() << entry.size << entry.mtimeMs << quint32(entry.fingerprint.words().size());
+        for (quint32 word : entry.fingerprint.words())
+            out << word;
+    }
+    return file.commit();
+}
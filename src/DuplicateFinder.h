@@ -0,0 +1,135 @@
+#pragma once
+
+#include "AudioFingerprint.h"
+#include "PlaylistModel.h"
+
+#include <QAbstractListModel>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+class LibraryIndex;
+
+// Finds copies of one recording across the library, whatever their tags, format or bitrate.
+//
+// Every local track gets an AudioFingerprint of its first two minutes, decoded to 11 kHz mono
+// by a single-threaded ffmpeg (which must be on PATH) on a pool with one worker per core.
+// Fingerprints are cached in the state directory by path, size and mtime, so a rescan only
+// decodes new and changed files.
+//
+// Tracks are paired up by MinHash buckets rather than all against all, and a pair is a
+// duplicate when its fingerprints agree on MatchThreshold of their bits; pairs chain into
+// groups. One row per grouped track, ordered by group, for a sectioned view. GUI thread only.
+class DuplicateFinder : public QAbstractListModel {
+    Q_OBJECT
+    Q_PROPERTY(bool running READ running NOTIFY runningChanged)
+    // Tracks to fingerprint in the current or last scan, and how many are done
+    Q_PROPERTY(int trackCount READ trackCount NOTIFY progressChanged)
+    Q_PROPERTY(int scannedCount READ scannedCount NOTIFY progressChanged)
+    // Seconds of audio decoded per second of wall time, all workers together
+    Q_PROPERTY(double throughput READ throughput NOTIFY progressChanged)
+    Q_PROPERTY(int groupCount READ groupCount NOTIFY groupsChanged)
+    Q_PROPERTY(QString error READ error NOTIFY errorChanged)
+
+public:
+    DuplicateFinder(LibraryIndex* library, const QString& stateDirectory, QObject* parent = nullptr);
+    ~DuplicateFinder() override;
+
+    enum Roles {
+        UrlRole = Qt::UserRole + 1,
+        PrimaryTextRole,
+        SecondaryTextRole,
+        DurationTextRole,
+        GroupRole,     // 1-based, shared by the rows of one group
+        SimilarityRole // 0..1, against the first row of the group
+    };
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    // Fails (see error) while a scan is active or when ffmpeg is missing
+    Q_INVOKABLE bool start();
+    // Stops after killing the running decoders; fingerprints taken so far are kept
+    Q_INVOKABLE void cancel();
+    // Takes the row out of its group, and the group away once a single row is left
+    Q_INVOKABLE void dismiss(int row);
+
+    bool running() const { return m_run != nullptr; }
+    int trackCount() const { return int(m_items.size()); }
+    int scannedCount() const { return m_scanned; }
+    double throughput() const;
+    int groupCount() const { return m_groupCount; }
+    QString error() const { return m_error; }
+
+    struct Match {
+        int track;
+        double similarity;
+    };
+    // Worker thread: groups of two or more, each led by its lowest index
+    static std::vector<std::vector<Match>> group(const std::vector<const AudioFingerprint*>& fingerprints,
+                                                 const std::atomic<bool>& cancelled);
+
+signals:
+    void runningChanged();
+    void progressChanged();
+    void groupsChanged();
+    void errorChanged();
+
+private:
+    struct CacheEntry {
+        qint64 size {-1};
+        qint64 mtimeMs {-1};
+        AudioFingerprint fingerprint;
+    };
+
+    struct JobResult {
+        bool ok {false};
+        bool decoded {false}; // not from the cache
+        qint64 decodedMs {0};
+        CacheEntry entry;
+    };
+
+    struct Row {
+        PlaylistModel::Item item;
+        int group {0};
+        double similarity {1.0};
+    };
+
+    struct Run;
+
+    // Worker thread
+    static JobResult runJob(const QString& location, const CacheEntry& cached, const Run& run);
+    void onJobFinished(const std::shared_ptr<Run>& run, int index, const JobResult& result);
+    void groupAll(const std::shared_ptr<Run>& run);
+    void onGrouped(const std::shared_ptr<Run>& run, const std::vector<std::vector<Match>>& groups);
+    void finishRun();
+    void setError(const QString& error);
+
+    bool loadCache();
+    bool saveCache() const;
+    QString cachePath() const;
+
+    LibraryIndex* m_library;
+    QString m_stateDirectory;
+    QThreadPool m_pool;
+    std::shared_ptr<Run> m_run; // null when idle
+    QHash<QString, CacheEntry> m_cache; // by location; loaded by the first scan
+    bool m_cacheLoaded {false};
+    bool m_cacheDirty {false};
+
+    std::vector<PlaylistModel::Item> m_items; // tracks of the current or last scan
+    QVector<Row> m_rows;
+    int m_groupCount {0};
+    int m_scanned {0};
+    QElapsedTimer m_wallClock;
+    qint64 m_wallMs {0};
+    double m_audioMs {0};
+    QString m_error;
+};
@@ -0,0 +1,746 @@
+#include "FastTagReader.h"
+
+#include <QByteArray>
+#include <QPair>
+#include <QVector>
+#include <QtEndian>
+
+#include <cstring>
+
+namespace {
+
+const char* const Id3v1Genres[] = {
+    "Blues", "Classic Rock", "Country", "Dance", "Disco", "Funk", "Grunge", "Hip-Hop",
+    "Jazz", "Metal", "New Age", "Oldies", "Other", "Pop", "R&B", "Rap", "Reggae", "Rock",
+    "Techno", "Industrial", "Alternative", "Ska", "Death Metal", "Pranks", "Soundtrack",
+    "Euro-Techno", "Ambient", "Trip-Hop", "Vocal", "Jazz+Funk", "Fusion", "Trance",
+    "Classical", "Instrumental", "Acid", "House", "Game", "Sound Clip", "Gospel", "Noise",
+    "Alternative Rock", "Bass", "Soul", "Punk", "Space", "Meditative", "Instrumental Pop",
+    "Instrumental Rock", "Ethnic", "Gothic", "Darkwave", "Techno-Industrial", "Electronic",
+    "Pop-Folk", "Eurodance", "Dream", "Southern Rock", "Comedy", "Cult", "Gangsta", "Top 40",
+    "Christian Rap", "Pop/Funk", "Jungle", "Native American", "Cabaret", "New Wave",
+    "Psychedelic", "Rave", "Showtunes", "Trailer", "Lo-Fi", "Tribal", "Acid Punk",
+    "Acid Jazz", "Polka", "Retro", "Musical", "Rock & Roll", "Hard Rock", "Folk",
+    "Folk Rock", "National Folk", "Swing", "Fast Fusion", "Bebop", "Latin", "Revival",
+    "Celtic", "Bluegrass", "Avantgarde", "Gothic Rock", "Progressive Rock",
+    "Psychedelic Rock", "Symphonic Rock", "Slow Rock", "Big Band", "Chorus",
+    "Easy Listening", "Acoustic", "Humour", "Speech", "Chanson", "Opera", "Chamber Music",
+    "Sonata", "Symphony", "Booty Bass", "Primus", "Porn Groove", "Satire", "Slow Jam",
+    "Club", "Tango", "Samba", "Folklore", "Ballad", "Power Ballad", "Rhythmic Soul",
+    "Freestyle", "Duet", "Punk Rock", "Drum Solo", "A Cappella", "Euro-House", "Dance Hall",
+    "Goa", "Drum & Bass", "Club-House", "Hardcore Techno", "Terror", "Indie", "Britpop",
+    "Worldbeat", "Polsk Punk", "Beat", "Christian Gangsta Rap", "Heavy Metal", "Black Metal",
+    "Crossover", "Contemporary Christian", "Christian Rock", "Merengue", "Salsa",
+    "Thrash Metal", "Anime", "Jpop", "Synthpop", "Abstract", "Art Rock", "Baroque",
+    "Bhangra", "Big Beat", "Breakbeat", "Chillout", "Downtempo", "Dub", "EBM", "Eclectic",
+    "Electro", "Electroclash", "Emo", "Experimental", "Garage", "Global", "IDM", "Illbient",
+    "Industro-Goth", "Jam Band", "Krautrock", "Leftfield", "Lounge", "Math Rock",
+    "New Romantic", "Nu-Breakz", "Post-Punk", "Post-Rock", "Psytrance", "Shoegaze",
+    "Space Rock", "Trop Rock", "World Music", "Neoclassical", "Audiobook", "Audio Theatre",
+    "Neue Deutsche Welle", "Podcast", "Indie Rock", "G-Funk", "Dubstep", "Garage Rock",
+    "Psybient"
+};
+
+quint32 be32(const uchar* p) { return qFromBigEndian<quint32>(p); }
+quint16 be16(const uchar* p) { return qFromBigEndian<quint16>(p); }
+quint32 le32(const uchar* p) { return qFromLittleEndian<quint32>(p); }
+quint32 be24(const uchar* p) { return (quint32(p[0]) << 16) | (quint32(p[1]) << 8) | p[2]; }
+quint32 syncsafe32(const uchar* p)
+{
+    return (quint32(p[0] & 0x7F) << 21) | (quint32(p[1] & 0x7F) << 14)
+         | (quint32(p[2] & 0x7F) << 7) | quint32(p[3] & 0x7F);
+}
+
+void setIfEmpty(QString& field, const QString& value)
+{
+    if (field.isEmpty() && !value.isEmpty())
+        field = value;
+}
+
+QString latin1UpToNul(const uchar* p, qint64 len)
+{
+    const void* nul = std::memchr(p, 0, size_t(len));
+    const qint64 n = nul ? static_cast<const uchar*>(nul) - p : len;
+    return QString::fromLatin1(reinterpret_cast<const char*>(p), qsizetype(n));
+}
+
+QString utf8UpToNul(const uchar* p, qint64 len)
+{
+    const void* nul = std::memchr(p, 0, size_t(len));
+    const qint64 n = nul ? static_cast<const uchar*>(nul) - p : len;
+    return QString::fromUtf8(reinterpret_cast<const char*>(p), qsizetype(n));
+}
+
+QString utf16UpToNul(const uchar* p, qint64 len, bool bigEndian)
+{
+    QString out;
+    out.reserve(int(len / 2));
+    for (qint64 i = 0; i + 1 < len; i += 2) {
+        const char16_t c = bigEndian ? char16_t((p[i] << 8) | p[i + 1]) : char16_t((p[i + 1] << 8) | p[i]);
+        if (c == 0) break;
+        out.append(QChar(c));
+    }
+    return out;
+}
+
+// ID3v2 text frame payload: encoding byte followed by (possibly NUL-separated) text
+QString decodeId3Text(const uchar* p, qint64 len)
+{
+    if (len < 2) return QString();
+    const uchar encoding = p[0];
+    ++p;
+    --len;
+    switch (encoding) {
+    case 0:
+        return latin1UpToNul(p, len);
+    case 1:
+        if (len >= 2 && p[0] == 0xFE && p[1] == 0xFF)
+            return utf16UpToNul(p + 2, len - 2, true);
+        if (len >= 2 && p[0] == 0xFF && p[1] == 0xFE)
+            return utf16UpToNul(p + 2, len - 2, false);
+        return utf16UpToNul(p, len, false);
+    case 2:
+        return utf16UpToNul(p, len, true);
+    case 3:
+        return utf8UpToNul(p, len);
+    default:
+        return QString();
+    }
+}
+
+// Reverse ID3v2 unsynchronisation (0xFF 0x00 -> 0xFF)
+QByteArray removeUnsync(const uchar* p, qint64 len)
+{
+    QByteArray out;
+    out.reserve(int(len));
+    for (qint64 i = 0; i < len; ++i) {
+        out.append(char(p[i]));
+        if (p[i] == 0xFF && i + 1 < len && p[i + 1] == 0x00)
+            ++i;
+    }
+    return out;
+}
+
+struct Mp4Atom {
+    qint64 offset = 0;     // start of the atom header
+    qint64 payload = 0;    // start of the payload
+    qint64 end = 0;        // one past the last byte
+    char type[4] = {};
+};
+
+bool readMp4Atom(const uchar* data, qint64 pos, qint64 limit, Mp4Atom& atom)
+{
+    if (pos + 8 > limit) return false;
+    quint64 size = be32(data + pos);
+    qint64 header = 8;
+    if (size == 1) {
+        if (pos + 16 > limit) return false;
+        size = qFromBigEndian<quint64>(data + pos + 8);
+        header = 16;
+    } else if (size == 0) {
+        size = quint64(limit - pos);
+    }
+    if (size < quint64(header) || qint64(size) > limit - pos) return false;
+
+    atom.offset = pos;
+    atom.payload = pos + header;
+    atom.end = pos + qint64(size);
+    std::memcpy(atom.type, data + pos + 4, 4);
+    return true;
+}
+
+bool isAtom(const Mp4Atom& atom, const char* type)
+{
+    return std::memcmp(atom.type, type, 4) == 0;
+}
+
+struct EbmlElement {
+    quint64 id = 0;
+    qint64 payload = 0;
+    qint64 end = 0;
+    bool unknownSize = false;
+};
+
+// EBML variable-length integer; element IDs keep their length marker bit
+bool readEbmlVint(const uchar* data, qint64 pos, qint64 limit, bool keepMarker, quint64& value, int& length)
+{
+    if (pos >= limit || data[pos] == 0) return false;
+    const uchar first = data[pos];
+    uchar mask = 0x80;
+    length = 1;
+    while (!(first & mask)) {
+        mask >>= 1;
+        ++length;
+    }
+    if (pos + length > limit) return false;
+
+    value = keepMarker ? first : (first & (mask - 1));
+    for (int i = 1; i < length; ++i)
+        value = (value << 8) | data[pos + i];
+    return true;
+}
+
+bool readEbmlElement(const uchar* data, qint64 pos, qint64 limit, EbmlElement& element)
+{
+    quint64 id = 0;
+    quint64 size = 0;
+    int idLength = 0;
+    int sizeLength = 0;
+    if (!readEbmlVint(data, pos, limit, true, id, idLength) || idLength > 4)
+        return false;
+    if (!readEbmlVint(data, pos + idLength, limit, false, size, sizeLength))
+        return false;
+
+    element.id = id;
+    element.payload = pos + idLength + sizeLength;
+    element.unknownSize = size == (quint64(1) << (7 * sizeLength)) - 1;
+    if (element.unknownSize) {
+        element.end = limit;
+    } else {
+        if (size > quint64(limit - element.payload)) return false;
+        element.end = element.payload + qint64(size);
+    }
+    return true;
+}
+
+quint64 ebmlUInt(const uchar* data, const EbmlElement& e)
+{
+    quint64 v = 0;
+    for (qint64 i = e.payload; i < e.end && i < e.payload + 8; ++i)
+        v = (v << 8) | data[i];
+    return v;
+}
+
+double ebmlFloat(const uchar* data, const EbmlElement& e)
+{
+    const qint64 len = e.end - e.payload;
+    if (len == 4) {
+        const quint32 bits = be32(data + e.payload);
+        float f;
+        std::memcpy(&f, &bits, sizeof f);
+        return f;
+    }
+    if (len == 8) {
+        const quint64 bits = qFromBigEndian<quint64>(data + e.payload);
+        double d;
+        std::memcpy(&d, &bits, sizeof d);
+        return d;
+    }
+    return 0.0;
+}
+
+QString ebmlString(const uchar* data, const EbmlElement& e)
+{
+    return utf8UpToNul(data + e.payload, e.end - e.payload);
+}
+
+} // namespace
+
+bool FastTagReader::supports(AudioFormat format)
+{
+    switch (format) {
+    case AudioFormat::Flac:
+    case AudioFormat::Mpeg:
+    case AudioFormat::Aac:
+    case AudioFormat::Mp4:
+    case AudioFormat::Matroska:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool FastTagReader::parse(AudioFormat format, const uchar* data, qint64 size, FastTags& tags)
+{
+    if (!data || size <= 0)
+        return false;
+
+    switch (format) {
+    case AudioFormat::Flac: return parseFlac(data, size, tags);
+    case AudioFormat::Mpeg: return parseMpeg(data, size, tags);
+    case AudioFormat::Aac: return parseAac(data, size, tags);
+    case AudioFormat::Mp4: return parseMp4(data, size, tags);
+    case AudioFormat::Matroska: return parseMatroska(data, size, tags);
+    default: return false;
+    }
+}
+
+qint64 FastTagReader::id3v2TagSize(const uchar* data, qint64 size)
+{
+    if (size < 10 || std::memcmp(data, "ID3", 3) != 0)
+        return 0;
+    const bool footer = data[5] & 0x10;
+    return 10 + qint64(syncsafe32(data + 6)) + (footer ? 10 : 0);
+}
+
+bool FastTagReader::parseMpegFrameHeader(const uchar* p, MpegFrameHeader& h)
+{
+    if (p[0] != 0xFF || (p[1] & 0xE0) != 0xE0) return false;
+
+    const int version = (p[1] >> 3) & 0x03;   // 0 = 2.5, 2 = 2, 3 = 1
+    const int layer = (p[1] >> 1) & 0x03;     // 1 = III, 2 = II, 3 = I
+    const int bitrateIndex = p[2] >> 4;
+    const int rateIndex = (p[2] >> 2) & 0x03;
+    if (version == 1 || layer == 0 || bitrateIndex == 0 || bitrateIndex == 15 || rateIndex == 3)
+        return false;
+
+    static const int bitrates[5][15] = {
+        {0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448}, // V1 L1
+        {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384},    // V1 L2
+        {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320},     // V1 L3
+        {0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},    // V2 L1
+        {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160}          // V2 L2/L3
+    };
+    static const int rates[3][3] = {
+        {44100, 48000, 32000}, {22050, 24000, 16000}, {11025, 12000, 8000}
+    };
+
+    const bool v1 = version == 3;
+    const int table = v1 ? (3 - layer) : (layer == 3 ? 3 : 4);
+    h.version = version;
+    h.layer = layer;
+    h.bitrateKbps = bitrates[table][bitrateIndex];
+    h.sampleRate = rates[v1 ? 0 : (version == 2 ? 1 : 2)][rateIndex];
+    h.samplesPerFrame = layer == 3 ? 384 : (layer == 2 || v1 ? 1152 : 576);
+
+    const bool mono = (p[3] >> 6) == 3;
+    h.sideInfoSize = v1 ? (mono ? 17 : 32) : (mono ? 9 : 17);
+
+    // Layer I frames are counted in 4-byte slots
+    const int padding = (p[2] >> 1) & 0x01;
+    h.frameLength = layer == 3
+        ? (12 * h.bitrateKbps * 1000 / h.sampleRate + padding) * 4
+        : h.samplesPerFrame / 8 * h.bitrateKbps * 1000 / h.sampleRate + padding;
+    return true;
+}
+
+bool FastTagReader::parseFlac(const uchar* data, qint64 size, FastTags& tags)
+{
+    // Some taggers prepend an ID3v2 tag to FLAC files; skip it
+    qint64 pos = id3v2TagSize(data, size);
+    if (pos + 4 > size || std::memcmp(data + pos, "fLaC", 4) != 0)
+        return false;
+    pos += 4;
+
+    bool haveStreamInfo = false;
+    bool last = false;
+    while (!last && pos + 4 <= size) {
+        const uchar header = data[pos];
+        last = header & 0x80;
+        const int type = header & 0x7F;
+        const qint64 length = be24(data + pos + 1);
+        const qint64 body = pos + 4;
+        if (body + length > size)
+            return false;
+
+        if (type == 0 && length >= 18) {
+            // STREAMINFO: 20-bit sample rate, 36-bit total sample count
+            const uchar* s = data + body + 10;
+            const quint64 bits = qFromBigEndian<quint64>(s);
+            const quint32 sampleRate = quint32(bits >> 44);
+            const quint64 totalSamples = bits & 0xFFFFFFFFFull;
+            if (sampleRate > 0)
+                tags.durationMs = qint64(totalSamples * 1000 / sampleRate);
+            haveStreamInfo = true;
+        } else if (type == 4) {
+            parseVorbisComment(data + body, length, tags);
+        } else if (type == 127) {
+            return false;
+        }
+        pos = body + length;
+    }
+    return haveStreamInfo;
+}
+
+void FastTagReader::parseVorbisComment(const uchar* data, qint64 size, FastTags& tags)
+{
+    if (size < 8) return;
+    qint64 pos = 4 + qint64(le32(data));    // skip vendor string
+    if (pos + 4 > size) return;
+    const quint32 count = le32(data + pos);
+    pos += 4;
+
+    for (quint32 i = 0; i < count && pos + 4 <= size; ++i) {
+        const qint64 len = le32(data + pos);
+        pos += 4;
+        if (len > size - pos) return;
+
+        const char* entry = reinterpret_cast<const char*>(data + pos);
+        const void* eq = std::memchr(entry, '=', size_t(len));
+        pos += len;
+        if (!eq) continue;
+
+        const qsizetype keyLen = static_cast<const char*>(eq) - entry;
+        const QByteArray key = QByteArray(entry, keyLen).toUpper();
+        const QString value = QString::fromUtf8(entry + keyLen + 1, qsizetype(len - keyLen - 1));
+
+        if (key == "TITLE") setIfEmpty(tags.title, value);
+        else if (key == "ARTIST") setIfEmpty(tags.artist, value);
+        else if (key == "ALBUMARTIST" || key == "ALBUM ARTIST") setIfEmpty(tags.albumArtist, value);
+        else if (key == "PERFORMER") setIfEmpty(tags.performer, value);
+        else if (key == "ALBUM") setIfEmpty(tags.album, value);
+        else if (key == "GENRE") setIfEmpty(tags.genre, value);
+        else if (key == "DATE" || key == "YEAR") setIfEmpty(tags.date, value);
+        else if (key == "TRACKNUMBER") setIfEmpty(tags.trackNumber, value);
+    }
+}
+
+bool FastTagReader::parseMpeg(const uchar* data, qint64 size, FastTags& tags)
+{
+    const qint64 tagSize = id3v2TagSize(data, size);
+    if (tagSize > size)
+        return false;
+    if (tagSize > 0)
+        parseId3v2(data, tagSize, tags);
+    parseId3v1(data, size, tags);
+
+    tags.durationMs = mpegDurationMs(data, size, tagSize);
+    return tags.durationMs > 0 || tagSize > 0;
+}
+
+bool FastTagReader::parseAac(const uchar* data, qint64 size, FastTags& tags)
+{
+    // Raw ADTS streams only carry tags in a leading ID3v2 block
+    const qint64 tagSize = id3v2TagSize(data, size);
+    if (tagSize <= 0 || tagSize > size)
+        return false;
+    parseId3v2(data, tagSize, tags);
+    return true;
+}
+
+void FastTagReader::parseId3v2(const uchar* data, qint64 size, FastTags& tags)
+{
+    const int major = data[3];
+    const uchar flags = data[5];
+    if (major < 2 || major > 4)
+        return;
+
+    // Tag-level unsynchronisation (v2.2/v2.3) applies to the whole frame area
+    QByteArray unsynced;
+    const uchar* frames = data + 10;
+    qint64 framesSize = size - 10 - ((flags & 0x10) ? 10 : 0);
+    if ((flags & 0x80) && major < 4) {
+        unsynced = removeUnsync(frames, framesSize);
+        frames = reinterpret_cast<const uchar*>(unsynced.constData());
+        framesSize = unsynced.size();
+    }
+
+    qint64 pos = 0;
+    if ((flags & 0x40) && major >= 3 && framesSize >= 4) {
+        // Extended header: v2.4 size includes itself, v2.3 does not
+        pos = major == 4 ? qint64(syncsafe32(frames)) : qint64(be32(frames)) + 4;
+    }
+
+    const int idLen = major == 2 ? 3 : 4;
+    const int headerLen = major == 2 ? 6 : 10;
+    QString year;
+    while (pos + headerLen <= framesSize) {
+        const uchar* h = frames + pos;
+        if (h[0] == 0)
+            break; // padding
+
+        const qint64 frameSize = major == 2 ? qint64(be24(h + 3))
+                               : major == 4 ? qint64(syncsafe32(h + 4)) : qint64(be32(h + 4));
+        const qint64 body = pos + headerLen;
+        if (frameSize <= 0 || frameSize > framesSize - body)
+            break;
+        pos = body + frameSize;
+
+        const QByteArray id(reinterpret_cast<const char*>(h), idLen);
+        if (id.at(0) != 'T')
+            continue; // only text frames are needed; APIC and friends are skipped unread
+
+        const uchar* payload = frames + body;
+        qint64 payloadSize = frameSize;
+        QByteArray frameUnsynced;
+        if (major >= 3) {
+            const uchar format = h[9];
+            const bool compressed = major == 4 ? (format & 0x08) : (format & 0x80);
+            const bool encrypted = major == 4 ? (format & 0x04) : (format & 0x40);
+            if (compressed || encrypted)
+                continue;
+            if (major == 4 && (format & 0x01) && payloadSize >= 4) {
+                payload += 4; // data length indicator
+                payloadSize -= 4;
+            }
+            if (major == 4 && ((format & 0x02) || (flags & 0x80))) {
+                frameUnsynced = removeUnsync(payload, payloadSize);
+                payload = reinterpret_cast<const uchar*>(frameUnsynced.constData());
+                payloadSize = frameUnsynced.size();
+            }
+        }
+
+        const QString value = decodeId3Text(payload, payloadSize);
+        if (id == "TIT2" || id == "TT2") setIfEmpty(tags.title, value);
+        else if (id == "TPE1" || id == "TP1") setIfEmpty(tags.artist, value);
+        else if (id == "TPE2" || id == "TP2") setIfEmpty(tags.albumArtist, value);
+        else if (id == "TALB" || id == "TAL") setIfEmpty(tags.album, value);
+        else if (id == "TCON" || id == "TCO") {
+            // "(17)", "17", "(17)Rock" or plain text
+            QString genre = value;
+            if (genre.startsWith('(')) {
+                const int close = genre.indexOf(')');
+                const QString rest = close > 0 ? genre.mid(close + 1) : QString();
+                genre = !rest.isEmpty() ? rest : id3v1Genre(genre.mid(1, close - 1).toInt());
+            } else {
+                bool numeric = false;
+                const int index = genre.toInt(&numeric);
+                if (numeric) genre = id3v1Genre(index);
+            }
+            setIfEmpty(tags.genre, genre);
+        }
+        else if (id == "TDRC" || id == "TDOR") setIfEmpty(tags.date, value);
+        else if (id == "TYER" || id == "TYE") setIfEmpty(year, value);
+        else if (id == "TRCK" || id == "TRK") setIfEmpty(tags.trackNumber, value);
+    }
+    setIfEmpty(tags.date, year);
+}
+
+void FastTagReader::parseId3v1(const uchar* data, qint64 size, FastTags& tags)
+{
+    if (size < 128) return;
+    const uchar* t = data + size - 128;
+    if (std::memcmp(t, "TAG", 3) != 0) return;
+
+    auto field = [t](int offset, int len) {
+        return latin1UpToNul(t + offset, len).trimmed();
+    };
+    setIfEmpty(tags.title, field(3, 30));
+    setIfEmpty(tags.artist, field(33, 30));
+    setIfEmpty(tags.album, field(63, 30));
+    setIfEmpty(tags.date, field(93, 4));
+    if (t[125] == 0 && t[126] != 0)
+        setIfEmpty(tags.trackNumber, QString::number(t[126]));
+    setIfEmpty(tags.genre, id3v1Genre(t[127]));
+}
+
+qint64 FastTagReader::mpegDurationMs(const uchar* data, qint64 size, qint64 audioStart)
+{
+    qint64 audioEnd = size;
+    if (size >= 128 && std::memcmp(data + size - 128, "TAG", 3) == 0)
+        audioEnd -= 128;
+
+    // Locate the first frame; tolerate a little junk/padding after the tag
+    const qint64 searchEnd = qMin(audioEnd - 4, audioStart + 64 * 1024);
+    MpegFrameHeader header;
+    qint64 frame = -1;
+    for (qint64 pos = audioStart; pos < searchEnd; ++pos) {
+        if (data[pos] == 0xFF && parseMpegFrameHeader(data + pos, header)) {
+            frame = pos;
+            break;
+        }
+    }
+    if (frame < 0 || header.sampleRate == 0)
+        return 0;
+
+    // Xing/Info (LAME) or VBRI header gives the exact frame count
+    quint32 frames = 0;
+    const qint64 xing = frame + 4 + header.sideInfoSize;
+    if (xing + 12 <= audioEnd
+        && (std::memcmp(data + xing, "Xing", 4) == 0 || std::memcmp(data + xing, "Info", 4) == 0)) {
+        if (be32(data + xing + 4) & 0x01)
+            frames = be32(data + xing + 8);
+    } else if (frame + 36 + 18 <= audioEnd && std::memcmp(data + frame + 36, "VBRI", 4) == 0) {
+        frames = be32(data + frame + 36 + 14);
+    }
+
+    if (frames > 0)
+        return qint64(quint64(frames) * quint64(header.samplesPerFrame) * 1000 / quint64(header.sampleRate));
+
+    // Constant bitrate estimate
+    return header.bitrateKbps > 0 ? (audioEnd - frame) * 8 / header.bitrateKbps : 0;
+}
+
+bool FastTagReader::parseMp4(const uchar* data, qint64 size, FastTags& tags)
+{
+    Mp4Atom top;
+    qint64 pos = 0;
+    bool haveMoov = false;
+    while (readMp4Atom(data, pos, size, top)) {
+        pos = top.end;
+        if (!isAtom(top, "moov"))
+            continue; // mdat and friends are skipped without being touched
+        haveMoov = true;
+
+        Mp4Atom child;
+        qint64 cpos = top.payload;
+        while (readMp4Atom(data, cpos, top.end, child)) {
+            cpos = child.end;
+            if (isAtom(child, "mvhd") && child.end - child.payload >= 32) {
+                const uchar* p = data + child.payload;
+                const bool v1 = p[0] == 1;
+                const quint32 timescale = be32(p + (v1 ? 20 : 12));
+                const quint64 duration = v1 ? qFromBigEndian<quint64>(p + 24) : be32(p + 16);
+                if (timescale > 0)
+                    tags.durationMs = qint64(duration * 1000 / timescale);
+            } else if (isAtom(child, "udta") || isAtom(child, "meta")) {
+                // moov/udta/meta/ilst (iTunes) or moov/meta/ilst
+                Mp4Atom meta = child;
+                if (isAtom(child, "udta")) {
+                    Mp4Atom inner;
+                    qint64 upos = child.payload;
+                    bool found = false;
+                    while (readMp4Atom(data, upos, child.end, inner)) {
+                        upos = inner.end;
+                        if (isAtom(inner, "meta")) { meta = inner; found = true; break; }
+                    }
+                    if (!found) continue;
+                }
+
+                // meta is normally a full atom (4 bytes version/flags); QuickTime writes it without
+                qint64 mpos = meta.payload;
+                if (mpos + 8 <= meta.end && std::memcmp(data + mpos + 4, "hdlr", 4) != 0)
+                    mpos += 4;
+                Mp4Atom item;
+                while (readMp4Atom(data, mpos, meta.end, item)) {
+                    mpos = item.end;
+                    if (isAtom(item, "ilst"))
+                        parseMp4Ilst(data, item.payload, item.end, tags);
+                }
+            }
+        }
+        break;
+    }
+    return haveMoov;
+}
+
+void FastTagReader::parseMp4Ilst(const uchar* data, qint64 begin, qint64 end, FastTags& tags)
+{
+    Mp4Atom item;
+    qint64 pos = begin;
+    while (readMp4Atom(data, pos, end, item)) {
+        pos = item.end;
+
+        Mp4Atom dataAtom;
+        if (!readMp4Atom(data, item.payload, item.end, dataAtom) || !isAtom(dataAtom, "data"))
+            continue;
+        if (dataAtom.end - dataAtom.payload < 8)
+            continue;
+
+        // data: 1 byte version, 3 bytes type, 4 bytes locale, then the value
+        const quint32 type = be32(data + dataAtom.payload) & 0x00FFFFFF;
+        const uchar* value = data + dataAtom.payload + 8;
+        const qint64 valueSize = dataAtom.end - dataAtom.payload - 8;
+
+        auto text = [&]() {
+            if (type == 2)
+                return utf16UpToNul(value, valueSize, true);
+            return QString::fromUtf8(reinterpret_cast<const char*>(value), qsizetype(valueSize));
+        };
+
+        if (isAtom(item, "\xA9nam")) setIfEmpty(tags.title, text());
+        else if (isAtom(item, "\xA9" "ART")) setIfEmpty(tags.artist, text());
+        else if (isAtom(item, "aART")) setIfEmpty(tags.albumArtist, text());
+        else if (isAtom(item, "\xA9" "alb")) setIfEmpty(tags.album, text());
+        else if (isAtom(item, "\xA9gen")) setIfEmpty(tags.genre, text());
+        else if (isAtom(item, "\xA9" "day")) setIfEmpty(tags.date, text());
+        else if (isAtom(item, "gnre") && valueSize >= 2) setIfEmpty(tags.genre, id3v1Genre(int(be16(value)) - 1));
+        else if (isAtom(item, "trkn") && valueSize >= 4) {
+            const int track = be16(value + 2);
+            if (track > 0) setIfEmpty(tags.trackNumber, QString::number(track));
+        }
+    }
+}
+
+QString FastTagReader::id3v1Genre(int index)
+{
+    const int count = int(sizeof(Id3v1Genres) / sizeof(Id3v1Genres[0]));
+    return index >= 0 && index < count ? QString::fromLatin1(Id3v1Genres[index]) : QString();
+}
+
+bool FastTagReader::parseMatroska(const uchar* data, qint64 size, FastTags& tags)
+{
+    EbmlElement element;
+    if (!readEbmlElement(data, 0, size, element) || element.id != 0x1A45DFA3)
+        return false;
+
+    qint64 pos = element.end;
+    while (readEbmlElement(data, pos, size, element)) {
+        if (element.id != 0x18538067) {
+            if (element.unknownSize) break;
+            pos = element.end;
+            continue;
+        }
+
+        // Segment: Info gives duration, Tags gives metadata; Clusters are skipped by size
+        quint64 timecodeScale = 1000000;
+        double duration = 0.0;
+        QString segmentTitle;
+        EbmlElement child;
+        qint64 cpos = element.payload;
+        while (readEbmlElement(data, cpos, element.end, child)) {
+            if (child.id == 0x1549A966) {
+                EbmlElement info;
+                qint64 ipos = child.payload;
+                while (readEbmlElement(data, ipos, child.end, info)) {
+                    if (info.id == 0x2AD7B1) timecodeScale = ebmlUInt(data, info);
+                    else if (info.id == 0x4489) duration = ebmlFloat(data, info);
+                    else if (info.id == 0x7BA9) segmentTitle = ebmlString(data, info);
+                    ipos = info.end;
+                }
+            } else if (child.id == 0x1254C367) {
+                parseMatroskaTags(data, child.payload, child.end, tags);
+            }
+            if (child.unknownSize) break;
+            cpos = child.end;
+        }
+
+        if (duration > 0.0)
+            tags.durationMs = qint64(duration * double(timecodeScale) / 1e6);
+        setIfEmpty(tags.title, segmentTitle);
+        return true;
+    }
+    return false;
+}
+
+void FastTagReader::parseMatroskaTags(const uchar* data, qint64 begin, qint64 end, FastTags& tags)
+{
+    EbmlElement tag;
+    qint64 pos = begin;
+    while (readEbmlElement(data, pos, end, tag)) {
+        pos = tag.end;
+        if (tag.id != 0x7373)
+            continue;
+
+        // Targets decide whether TITLE/ARTIST describe the album (50) or the track (30 / unset)
+        quint64 targetType = 0;
+        QVector<QPair<QString, QString>> simpleTags;
+        EbmlElement child;
+        qint64 cpos = tag.payload;
+        while (readEbmlElement(data, cpos, tag.end, child)) {
+            cpos = child.end;
+            if (child.id == 0x63C0) {
+                EbmlElement target;
+                qint64 tpos = child.payload;
+                while (readEbmlElement(data, tpos, child.end, target)) {
+                    if (target.id == 0x68CA) targetType = ebmlUInt(data, target);
+                    tpos = target.end;
+                }
+            } else if (child.id == 0x67C8) {
+                QString name;
+                QString value;
+                EbmlElement field;
+                qint64 fpos = child.payload;
+                while (readEbmlElement(data, fpos, child.end, field)) {
+                    if (field.id == 0x45A3) name = ebmlString(data, field).toUpper();
+                    else if (field.id == 0x4487) value = ebmlString(data, field);
+                    fpos = field.end;
+                }
+                if (!name.isEmpty() && !value.isEmpty())
+                    simpleTags.append({name, value});
+            }
+        }
+
+        const bool albumLevel = targetType >= 50;
+        for (const auto& [name, value] : simpleTags) {
+            if (name == QLatin1String("TITLE")) setIfEmpty(albumLevel ? tags.album : tags.title, value);
+            else if (name == QLatin1String("ARTIST")) setIfEmpty(albumLevel ? tags.albumArtist : tags.artist, value);
+            else if (name == QLatin1String("ALBUM")) setIfEmpty(tags.album, value);
+            else if (name == QLatin1String("ALBUM_ARTIST")) setIfEmpty(tags.albumArtist, value);
+            else if (name == QLatin1String("PERFORMER")) setIfEmpty(tags.performer, value);
+            else if (name == QLatin1String("GENRE")) setIfEmpty(tags.genre, value);
+            else if (name.startsWith(QLatin1String("DATE"))) setIfEmpty(tags.date, value);
+            else if (name == QLatin1String("PART_NUMBER") && !albumLevel) setIfEmpty(tags.trackNumber, value);
+        }
+    }
+}
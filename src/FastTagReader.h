@@ -0,0 +1,63 @@
+#pragma once
+
+#include <QString>
+
+#include "FormatSniffer.h"
+
+// Tag fields needed for browsing and library scans
+struct FastTags {
+    QString title;
+    QString artist;
+    QString albumArtist;
+    QString performer;
+    QString album;
+    QString genre;
+    QString date;
+    QString trackNumber;
+    qint64 durationMs = 0;
+};
+
+// Fields of an MPEG audio (layer I-III) frame header
+struct MpegFrameHeader {
+    int version = 0;          // 0 = 2.5, 2 = 2, 3 = 1
+    int layer = 0;            // 1 = III, 2 = II, 3 = I
+    int bitrateKbps = 0;
+    int sampleRate = 0;
+    int samplesPerFrame = 0;
+    int sideInfoSize = 0;
+    int frameLength = 0;      // bytes, header and padding included
+};
+
+// Minimal tag parsers that bypass TagLib for library scans.
+// They work on a memory-mapped file and only touch header regions: FLAC STREAMINFO and
+// VORBIS_COMMENT, ID3v2 (+ the first MPEG frame's Xing/VBRI header for duration), the
+// MP4 moov/mvhd + udta/meta/ilst atoms and Matroska Info/Tags. Audio data is never
+// scanned and pictures are skipped without being read.
+class FastTagReader {
+public:
+    static bool supports(AudioFormat format);
+
+    // Returns false if the buffer is not a well-formed container of that format;
+    // callers should then fall back to TagLib.
+    static bool parse(AudioFormat format, const uchar* data, qint64 size, FastTags& tags);
+
+    static bool parseFlac(const uchar* data, qint64 size, FastTags& tags);
+    static bool parseMpeg(const uchar* data, qint64 size, FastTags& tags);
+    static bool parseAac(const uchar* data, qint64 size, FastTags& tags);
+    static bool parseMp4(const uchar* data, qint64 size, FastTags& tags);
+    static bool parseMatroska(const uchar* data, qint64 size, FastTags& tags);
+
+    // p must have 4 readable bytes; false for anything that is not a valid frame header
+    static bool parseMpegFrameHeader(const uchar* p, MpegFrameHeader& h);
+    // Size of a leading ID3v2 tag including its footer, 0 if there is none
+    static qint64 id3v2TagSize(const uchar* data, qint64 size);
+
+private:
+    static void parseId3v2(const uchar* data, qint64 size, FastTags& tags);
+    static void parseId3v1(const uchar* data, qint64 size, FastTags& tags);
+    static void parseVorbisComment(const uchar* data, qint64 size, FastTags& tags);
+    static qint64 mpegDurationMs(const uchar* data, qint64 size, qint64 audioStart);
+    static void parseMp4Ilst(const uchar* data, qint64 begin, qint64 end, FastTags& tags);
+    static void parseMatroskaTags(const uchar* data, qint64 begin, qint64 end, FastTags& tags);
+    static QString id3v1Genre(int index);
+};
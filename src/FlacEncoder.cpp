@@ -0,0 +1,409 @@
+#include "FlacEncoder.h"
+
+#include <array>
+#include <cstdlib>
+#include <limits>
+
+namespace {
+
+constexpr int BitsPerSample = 16;
+constexpr int MaxFixedOrder = 4;
+constexpr int MaxPartitionOrder = 6;
+constexpr int MaxRiceParameter = 14; // 15 is the escape code
+
+// Subframe type codes (6 bits, after the zero padding bit)
+constexpr quint32 SubframeConstant = 0x00;
+constexpr quint32 SubframeVerbatim = 0x01;
+constexpr quint32 SubframeFixed = 0x08; // | order
+
+enum ChannelAssignment : quint32 {
+    LeftSide = 8,
+    RightSide = 9,
+    MidSide = 10,
+};
+
+class BitWriter {
+public:
+    explicit BitWriter(QByteArray& out) : m_out(out) {}
+
+    // bits <= 32
+    void write(quint32 value, int bits)
+    {
+        if (bits == 0) return;
+        m_acc = (m_acc << bits) | (value & (bits == 32 ? 0xffffffffu : ((1u << bits) - 1)));
+        m_bits += bits;
+        while (m_bits >= 8) {
+            m_bits -= 8;
+            m_out.append(char(m_acc >> m_bits));
+        }
+    }
+    void writeSigned(qint32 value, int bits) { write(quint32(value), bits); }
+    void writeUnary(quint32 zeros)
+    {
+        for (; zeros >= 32; zeros -= 32)
+            write(0, 32);
+        write(1, int(zeros) + 1);
+    }
+    void writeRice(qint32 value, int parameter)
+    {
+        const quint32 folded = (quint32(value) << 1) ^ quint32(value >> 31);
+        writeUnary(folded >> parameter);
+        write(folded, parameter);
+    }
+    void alignToByte()
+    {
+        if (m_bits) write(0, 8 - m_bits);
+    }
+
+private:
+    QByteArray& m_out;
+    quint64 m_acc {0};
+    int m_bits {0};
+};
+
+quint8 crc8(const char* data, qsizetype size)
+{
+    // Polynomial x^8 + x^2 + x + 1
+    static const auto table = [] {
+        std::array<quint8, 256> t {};
+        for (int i = 0; i < 256; ++i) {
+            quint8 c = quint8(i);
+            for (int bit = 0; bit < 8; ++bit)
+                c = (c & 0x80) ? quint8((c << 1) ^ 0x07) : quint8(c << 1);
+            t[size_t(i)] = c;
+        }
+        return t;
+    }();
+    quint8 crc = 0;
+    for (qsizetype i = 0; i < size; ++i)
+        crc = table[crc ^ quint8(data[i])];
+    return crc;
+}
+
+quint16 crc16(const char* data, qsizetype size)
+{
+    // Polynomial x^16 + x^15 + x^2 + 1
+    static const auto table = [] {
+        std::array<quint16, 256> t {};
+        for (int i = 0; i < 256; ++i) {
+            quint16 c = quint16(i << 8);
+            for (int bit = 0; bit < 8; ++bit)
+                c = (c & 0x8000) ? quint16((c << 1) ^ 0x8005) : quint16(c << 1);
+            t[size_t(i)] = c;
+        }
+        return t;
+    }();
+    quint16 crc = 0;
+    for (qsizetype i = 0; i < size; ++i)
+        crc = quint16((crc << 8) ^ table[(crc >> 8) ^ quint8(data[i])]);
+    return crc;
+}
+
+quint32 sampleRateCode(int sampleRate)
+{
+    switch (sampleRate) {
+    case 88200: return 1;
+    case 176400: return 2;
+    case 192000: return 3;
+    case 8000: return 4;
+    case 16000: return 5;
+    case 22050: return 6;
+    case 24000: return 7;
+    case 32000: return 8;
+    case 44100: return 9;
+    case 48000: return 10;
+    case 96000: return 11;
+    default: return 0; // take it from STREAMINFO
+    }
+}
+
+// Frame numbers use the UTF-8 style variable-length coding
+void writeUtf8(BitWriter& bits, quint64 value)
+{
+    if (value < 0x80) {
+        bits.write(quint32(value), 8);
+        return;
+    }
+    int continuation = value < 0x800 ? 1 : value < 0x10000 ? 2 : value < 0x200000 ? 3
+                     : value < 0x4000000 ? 4 : 5;
+    const quint32 lead = (0xff00u >> (continuation + 1)) & 0xffu;
+    bits.write(lead | quint32(value >> (6 * continuation)), 8);
+    while (continuation--)
+        bits.write(0x80 | quint32((value >> (6 * continuation)) & 0x3f), 8);
+}
+
+// Sum of |residual| after samples[MaxFixedOrder..] for each fixed predictor order
+std::array<quint64, MaxFixedOrder + 1> fixedResidualSums(const qint32* x, int n)
+{
+    std::array<quint64, MaxFixedOrder + 1> sums {};
+    for (int i = MaxFixedOrder; i < n; ++i) {
+        const qint64 e0 = x[i];
+        const qint64 e1 = e0 - x[i - 1];
+        const qint64 e2 = e1 - (qint64(x[i - 1]) - x[i - 2]);
+        const qint64 e3 = e2 - (qint64(x[i - 1]) - 2 * qint64(x[i - 2]) + x[i - 3]);
+        const qint64 e4 = e3 - (qint64(x[i - 1]) - 3 * qint64(x[i - 2]) + 3 * qint64(x[i - 3]) - x[i - 4]);
+        sums[0] += quint64(std::llabs(e0));
+        sums[1] += quint64(std::llabs(e1));
+        sums[2] += quint64(std::llabs(e2));
+        sums[3] += quint64(std::llabs(e3));
+        sums[4] += quint64(std::llabs(e4));
+    }
+    return sums;
+}
+
+int bestFixedOrder(const std::array<quint64, MaxFixedOrder + 1>& sums)
+{
+    int order = 0;
+    for (int o = 1; o <= MaxFixedOrder; ++o) {
+        if (sums[size_t(o)] < sums[size_t(order)])
+            order = o;
+    }
+    return order;
+}
+
+void computeFixedResidual(const qint32* x, int n, int order, qint32* residual)
+{
+    for (int i = order; i < n; ++i) {
+        switch (order) {
+        case 0: residual[i] = x[i]; break;
+        case 1: residual[i] = x[i] - x[i - 1]; break;
+        case 2: residual[i] = x[i] - 2 * x[i - 1] + x[i - 2]; break;
+        case 3: residual[i] = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3]; break;
+        default: residual[i] = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4]; break;
+        }
+    }
+}
+
+int riceParameter(quint64 sum, quint64 count, quint64& bits)
+{
+    if (count == 0) {
+        bits = 0;
+        return 0;
+    }
+    int k = 0;
+    while (k < MaxRiceParameter && (count << (k + 1)) <= sum)
+        ++k;
+    bits = count * quint64(k + 1) + (sum >> k);
+    return k;
+}
+
+struct RicePartitioning {
+    int order {0};
+    std::array<int, 1 << MaxPartitionOrder> parameters {};
+    quint64 bits {std::numeric_limits<quint64>::max()};
+};
+
+// Picks the partition order and per-partition parameters with the smallest estimated size
+RicePartitioning choosePartitioning(const qint32* residual, int n, int predictorOrder)
+{
+    int maxOrder = 0;
+    while (maxOrder < MaxPartitionOrder && (n % (2 << maxOrder)) == 0
+           && (n >> (maxOrder + 1)) > predictorOrder)
+        ++maxOrder;
+
+    // Folded residual sums at the finest partitioning, merged pairwise for coarser ones
+    std::array<quint64, 1 << MaxPartitionOrder> sums {};
+    const int finest = 1 << maxOrder;
+    const int partitionSize = n >> maxOrder;
+    for (int p = 0; p < finest; ++p) {
+        quint64 sum = 0;
+        for (int i = qMax(p * partitionSize, predictorOrder); i < (p + 1) * partitionSize; ++i)
+            sum += (quint32(residual[i]) << 1) ^ quint32(residual[i] >> 31);
+        sums[size_t(p)] = sum;
+    }
+
+    RicePartitioning best;
+    for (int order = maxOrder; order >= 0; --order) {
+        RicePartitioning candidate;
+        candidate.order = order;
+        candidate.bits = 0;
+        const int partitions = 1 << order;
+        const int size = n >> order;
+        for (int p = 0; p < partitions; ++p) {
+            const quint64 count = quint64(size - (p == 0 ? predictorOrder : 0));
+            quint64 bits = 0;
+            candidate.parameters[size_t(p)] = riceParameter(sums[size_t(p)], count, bits);
+            candidate.bits += 4 + bits;
+        }
+        if (candidate.bits < best.bits)
+            best = candidate;
+        for (int p = 0; p < partitions / 2; ++p)
+            sums[size_t(p)] = sums[size_t(2 * p)] + sums[size_t(2 * p + 1)];
+    }
+    return best;
+}
+
+void writeSubframe(BitWriter& bits, const qint32* x, int n, int bps, std::vector<qint32>& residual)
+{
+    bool constant = true;
+    for (int i = 1; i < n && constant; ++i)
+        constant = x[i] == x[0];
+    if (constant) {
+        bits.write(SubframeConstant << 1, 8);
+        bits.writeSigned(x[0], bps);
+        return;
+    }
+
+    int order = -1;
+    RicePartitioning partitioning;
+    if (n > MaxFixedOrder) {
+        order = bestFixedOrder(fixedResidualSums(x, n));
+        residual.resize(size_t(n));
+        computeFixedResidual(x, n, order, residual.data());
+        partitioning = choosePartitioning(residual.data(), n, order);
+        if (quint64(order) * quint64(bps) + 6 + partitioning.bits >= quint64(n) * quint64(bps))
+            order = -1;
+    }
+
+    if (order < 0) {
+        bits.write(SubframeVerbatim << 1, 8);
+        for (int i = 0; i < n; ++i)
+            bits.writeSigned(x[i], bps);
+        return;
+    }
+
+    bits.write((SubframeFixed | quint32(order)) << 1, 8);
+    for (int i = 0; i < order; ++i)
+        bits.writeSigned(x[i], bps);
+    bits.write(0, 2); // 4-bit Rice parameters
+    bits.write(quint32(partitioning.order), 4);
+    const int partitions = 1 << partitioning.order;
+    const int size = n >> partitioning.order;
+    for (int p = 0; p < partitions; ++p) {
+        const int parameter = partitioning.parameters[size_t(p)];
+        bits.write(quint32(parameter), 4);
+        for (int i = qMax(p * size, order); i < (p + 1) * size; ++i)
+            bits.writeRice(residual[size_t(i)], parameter);
+    }
+}
+
+} // namespace
+
+FlacEncoder::FlacEncoder(int sampleRate, int channels)
+    : m_sampleRate(sampleRate)
+    , m_channels(qBound(1, channels, 8))
+{
+}
+
+QByteArray FlacEncoder::streamHeader() const
+{
+    QByteArray header("fLaC");
+    BitWriter bits(header);
+    bits.write(1, 1);  // last metadata block
+    bits.write(0, 7);  // STREAMINFO
+    bits.write(34, 24);
+    bits.write(BlockSize, 16);
+    bits.write(BlockSize, 16);
+    bits.write(0, 24); // frame sizes unknown
+    bits.write(0, 24);
+    bits.write(quint32(m_sampleRate), 20);
+    bits.write(quint32(m_channels - 1), 3);
+    bits.write(BitsPerSample - 1, 5);
+    bits.write(0, 4);  // total samples unknown (36 bits)
+    bits.write(0, 32);
+    for (int i = 0; i < 4; ++i)
+        bits.write(0, 32); // no MD5 for a live stream
+    return header;
+}
+
+QVector<QByteArray> FlacEncoder::encode(const qint16* interleaved, int frames)
+{
+    QVector<QByteArray> out;
+    m_pending.insert(m_pending.end(), interleaved, interleaved + qsizetype(frames) * m_channels);
+
+    const size_t blockSamples = size_t(BlockSize) * size_t(m_channels);
+    size_t consumed = 0;
+    while (m_pending.size() - consumed >= blockSamples) {
+        out.append(encodeBlock(m_pending.data() + consumed, BlockSize));
+        consumed += blockSamples;
+    }
+    m_pending.erase(m_pending.begin(), m_pending.begin() + qsizetype(consumed));
+    return out;
+}
+
+QByteArray FlacEncoder::flush()
+{
+    const int frames = int(m_pending.size() / size_t(m_channels));
+    if (frames == 0)
+        return QByteArray();
+    QByteArray frame = encodeBlock(m_pending.data(), frames);
+    m_pending.clear();
+    return frame;
+}
+
+QByteArray FlacEncoder::encodeBlock(const qint16* interleaved, int blockSize)
+{
+    // Deinterleave; for stereo also derive mid and side to pick a decorrelation
+    std::array<std::vector<qint32>, 8> channel;
+    for (int c = 0; c < m_channels; ++c) {
+        channel[size_t(c)].resize(size_t(blockSize));
+        for (int i = 0; i < blockSize; ++i)
+            channel[size_t(c)][size_t(i)] = interleaved[size_t(i) * size_t(m_channels) + size_t(c)];
+    }
+
+    quint32 assignment = quint32(m_channels - 1);
+    const qint32* subframes[8] = {};
+    int subframeBps[8] = {};
+    for (int c = 0; c < m_channels; ++c) {
+        subframes[c] = channel[size_t(c)].data();
+        subframeBps[c] = BitsPerSample;
+    }
+
+    std::vector<qint32> mid, side;
+    if (m_channels == 2 && blockSize > MaxFixedOrder) {
+        mid.resize(size_t(blockSize));
+        side.resize(size_t(blockSize));
+        const qint32* left = channel[0].data();
+        const qint32* right = channel[1].data();
+        for (int i = 0; i < blockSize; ++i) {
+            mid[size_t(i)] = (left[i] + right[i]) >> 1;
+            side[size_t(i)] = left[i] - right[i];
+        }
+        const auto cost = [blockSize](const qint32* x) {
+            const auto sums = fixedResidualSums(x, blockSize);
+            return sums[size_t(bestFixedOrder(sums))];
+        };
+        const quint64 l = cost(left), r = cost(right), m = cost(mid.data()), s = cost(side.data());
+        const quint64 independent = l + r, leftSide = l + s, rightSide = r + s, midSide = m + s;
+        const quint64 best = qMin(qMin(independent, leftSide), qMin(rightSide, midSide));
+        if (best == midSide && best < independent) {
+            assignment = MidSide;
+            subframes[0] = mid.data();
+            subframes[1] = side.data();
+            subframeBps[1] = BitsPerSample + 1;
+        } else if (best == leftSide && best < independent) {
+            assignment = LeftSide;
+            subframes[1] = side.data();
+            subframeBps[1] = BitsPerSample + 1;
+        } else if (best == rightSide && best < independent) {
+            assignment = RightSide;
+            subframes[0] = side.data();
+            subframeBps[0] = BitsPerSample + 1;
+        }
+    }
+
+    QByteArray frame;
+    frame.reserve(blockSize * m_channels * 2 / 3);
+    BitWriter bits(frame);
+
+    bits.write(0x3ffe, 14); // sync
+    bits.write(0, 1);
+    bits.write(0, 1);       // fixed block size
+    const bool standardBlock = blockSize == BlockSize;
+    bits.write(standardBlock ? 12 : 7, 4);
+    bits.write(sampleRateCode(m_sampleRate), 4);
+    bits.write(assignment, 4);
+    bits.write(4, 3);       // 16 bits per sample
+    bits.write(0, 1);
+    writeUtf8(bits, m_frameNumber++);
+    if (!standardBlock)
+        bits.write(quint32(blockSize - 1), 16);
+    bits.write(crc8(frame.constData(), frame.size()), 8);
+
+    std::vector<qint32> residual;
+    for (int c = 0; c < m_channels; ++c)
+        writeSubframe(bits, subframes[c], blockSize, subframeBps[c], residual);
+    bits.alignToByte();
+    bits.write(crc16(frame.constData(), frame.size()), 16);
+    return frame;
+}
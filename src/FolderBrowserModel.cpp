@@ -0,0 +1,518 @@
+#include "FolderBrowserModel.h"
+#include "MetadataReader.h"
+#include "TrackMetadata.h"
+
+#include <QCollator>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QRegularExpression>
+#include <QThread>
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#ifdef Q_OS_LINUX
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <QDateTime>
+#include <QDirIterator>
+#include <QFileInfo>
+#endif
+
+namespace {
+
+// Rows are handed to the model at most this often while a listing is in progress
+constexpr qint64 BatchIntervalMs = 50;
+constexpr int CachedFolders = 64;
+// Older duration requests are dropped beyond this; their delegates have scrolled away
+constexpr int MaxQueuedDurations = 256;
+
+#ifdef Q_OS_LINUX
+// 256 KiB per getdents64() call: a few thousand entries per round trip on NFS/SMB
+// instead of the ~32 KiB readdir() uses
+constexpr size_t DirentBufferSize = 256 * 1024;
+
+struct LinuxDirent64 {
+    quint64 d_ino;
+    qint64 d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+#endif
+
+// "*.ext" patterns become a suffix check; anything else goes through a wildcard regex
+class NameFilter {
+public:
+    explicit NameFilter(const QStringList& patterns)
+    {
+        for (const QString& pattern : patterns) {
+            if (pattern.startsWith(QLatin1String("*.")) && !pattern.mid(1).contains(QLatin1Char('*'))
+                && !pattern.contains(QLatin1Char('?')) && !pattern.contains(QLatin1Char('['))) {
+                m_suffixes.append(pattern.mid(1));
+            } else {
+                m_patterns.append(QRegularExpression(QRegularExpression::wildcardToRegularExpression(pattern),
+                                                     QRegularExpression::CaseInsensitiveOption));
+            }
+        }
+    }
+
+    bool matches(const QString& name) const
+    {
+        if (m_suffixes.isEmpty() && m_patterns.isEmpty()) return true;
+        for (const QString& suffix : m_suffixes) {
+            if (name.endsWith(suffix, Qt::CaseInsensitive)) return true;
+        }
+        for (const QRegularExpression& re : m_patterns) {
+            if (re.match(name).hasMatch()) return true;
+        }
+        return false;
+    }
+
+private:
+    QStringList m_suffixes;
+    QVector<QRegularExpression> m_patterns;
+};
+
+// Directories first, then natural, case-insensitive name order ("Track 2" before "Track 10")
+QVector<FolderEntry> sortedEntries(const QVector<FolderEntry>& entries)
+{
+    QCollator collator;
+    collator.setNumericMode(true);
+    collator.setCaseSensitivity(Qt::CaseInsensitive);
+
+    std::vector<QCollatorSortKey> keys;
+    keys.reserve(entries.size());
+    for (const FolderEntry& entry : entries) {
+        keys.push_back(collator.sortKey(entry.name));
+    }
+
+    std::vector<int> order(entries.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        if (entries[a].isDir != entries[b].isDir) return entries[a].isDir;
+        return keys[a].compare(keys[b]) < 0;
+    });
+
+    QVector<FolderEntry> sorted;
+    sorted.reserve(entries.size());
+    for (int i : order) {
+        sorted.append(entries[i]);
+    }
+    return sorted;
+}
+
+} // namespace
+
+FolderBrowserModel::FolderBrowserModel(QObject* parent)
+    : QAbstractListModel(parent)
+    , m_path(QDir::homePath())
+    , m_nameFilters({"*.wav", "*.flac", "*.mp3", "*.ogg", "*.opus", "*.aac", "*.m4a", "*.mp4", "*.mkv",
+                     "*.mka", "*.aif", "*.aiff", "*.wv", "*.ape"})
+{
+    // One lister at a time: a newer navigation cancels the older one via m_generation
+    m_listPool.setMaxThreadCount(1);
+    m_metadataPool.setMaxThreadCount(qBound(1, QThread::idealThreadCount() / 2, 4));
+
+    startListing(true);
+}
+
+FolderBrowserModel::~FolderBrowserModel()
+{
+    ++m_generation;
+    m_listPool.clear();
+    m_metadataPool.clear();
+    m_listPool.waitForDone();
+    m_metadataPool.waitForDone();
+}
+
+int FolderBrowserModel::rowCount(const QModelIndex& parent) const
+{
+    if (parent.isValid()) return 0;
+    return m_entries.size();
+}
+
+QVariant FolderBrowserModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() < 0 || index.row() >= m_entries.size())
+        return {};
+    const auto& entry = m_entries.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+    case FileNameRole:
+        return entry.name;
+    case FileUrlRole:
+        return QUrl::fromLocalFile(filePath(index.row()));
+    case FileIsDirRole:
+        return entry.isDir;
+    case DurationRole: {
+        if (entry.isDir) return qint64(0);
+        // Only delegates that exist ask for this, so reads follow what is on screen
+        const QString path = filePath(index.row());
+        const auto it = m_durations.constFind(path);
+        if (it == m_durations.constEnd()) {
+            requestDuration(path);
+            return qint64(0);
+        }
+        return qMax<qint64>(0, it.value());
+    }
+    case CoverSourceRole: {
+        if (entry.isDir) return QString();
+        // Base64url keeps arbitrary file names intact through the image:// URL
+        const QByteArray id = filePath(index.row()).toUtf8().toBase64(QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals);
+        return QStringLiteral("image://covers/") + QString::fromLatin1(id);
+    }
+    default:
+        return {};
+    }
+}
+
+QHash<int, QByteArray> FolderBrowserModel::roleNames() const
+{
+    QHash<int, QByteArray> r;
+    r[FileNameRole] = "fileName";
+    r[FileUrlRole] = "fileURL";
+    r[FileIsDirRole] = "fileIsDir";
+    r[DurationRole] = "duration";
+    r[CoverSourceRole] = "coverSource";
+    return r;
+}
+
+void FolderBrowserModel::setFolder(const QUrl& folder)
+{
+    const QString path = QDir::cleanPath(folder.isLocalFile() ? folder.toLocalFile() : folder.toString());
+    if (path.isEmpty() || path == m_path) return;
+
+    m_path = path;
+    emit folderChanged();
+    startListing(true);
+}
+
+QUrl FolderBrowserModel::parentFolder() const
+{
+    QDir dir(m_path);
+    if (!dir.cdUp()) return QUrl();
+    return QUrl::fromLocalFile(dir.absolutePath());
+}
+
+void FolderBrowserModel::setNameFilters(const QStringList& filters)
+{
+    if (filters == m_nameFilters) return;
+
+    m_nameFilters = filters;
+    emit nameFiltersChanged();
+
+    // Cached listings were filtered with the old patterns
+    m_cache.clear();
+    m_cacheOrder.clear();
+    startListing(false);
+}
+
+void FolderBrowserModel::refresh()
+{
+    m_cache.remove(m_path);
+    m_cacheOrder.removeAll(m_path);
+    m_durations.clear();
+    startListing(false);
+}
+
+void FolderBrowserModel::startListing(bool useCache)
+{
+    const quint64 generation = ++m_generation;
+
+    // Queued duration reads belong to the folder being left
+    for (const QString& path : std::as_const(m_durationQueue)) {
+        m_durations.remove(path);
+    }
+    m_durationQueue.clear();
+
+    qint64 knownMtimeNs = 0;
+    beginResetModel();
+    m_entries.clear();
+    m_streamed = false;
+    if (useCache) {
+        const auto it = m_cache.constFind(m_path);
+        if (it != m_cache.constEnd()) {
+            // Show the cached rows now; the lister only re-reads if the directory changed
+            m_entries = it->entries;
+            knownMtimeNs = it->mtimeNs;
+            m_cacheOrder.removeAll(m_path);
+            m_cacheOrder.append(m_path);
+        }
+    }
+    endResetModel();
+    emit countChanged();
+
+    setLoading(true);
+    m_listPool.start([this, path = m_path, knownMtimeNs, filters = m_nameFilters, generation] {
+        listDirectory(path, knownMtimeNs, filters, generation);
+    });
+}
+
+void FolderBrowserModel::setLoading(bool loading)
+{
+    if (m_loading == loading) return;
+    m_loading = loading;
+    emit loadingChanged();
+}
+
+void FolderBrowserModel::listDirectory(const QString& path, qint64 knownMtimeNs, const QStringList& filters, quint64 generation)
+{
+    const NameFilter filter(filters);
+    QVector<FolderEntry> all;
+    QVector<FolderEntry> pending;
+    // Rows already on screen come from the cache; streaming would duplicate them
+    const bool stream = knownMtimeNs == 0;
+    bool streamed = false;
+    QElapsedTimer batchTimer;
+    batchTimer.start();
+
+    auto cancelled = [&] { return m_generation.load(std::memory_order_relaxed) != generation; };
+    auto add = [&](FolderEntry&& entry) {
+        if (entry.name.startsWith(QLatin1Char('.'))) return;
+        if (!entry.isDir && !filter.matches(entry.name)) return;
+        all.append(entry);
+        if (stream) pending.append(std::move(entry));
+    };
+    auto flush = [&] {
+        if (pending.isEmpty()) return;
+        QMetaObject::invokeMethod(this, [this, generation, batch = std::move(pending)] {
+            appendBatch(generation, batch);
+        }, Qt::QueuedConnection);
+        pending = QVector<FolderEntry>();
+        streamed = true;
+        batchTimer.restart();
+    };
+    auto fail = [&] {
+        qWarning() << "Cannot list directory:" << path;
+        QMetaObject::invokeMethod(this, [this, generation] {
+            if (generation == m_generation.load()) setLoading(false);
+        }, Qt::QueuedConnection);
+    };
+
+    qint64 mtimeNs = 0;
+#ifdef Q_OS_LINUX
+    const int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        fail();
+        return;
+    }
+
+    struct stat dirStat;
+    if (::fstat(fd, &dirStat) == 0) {
+        mtimeNs = qint64(dirStat.st_mtim.tv_sec) * 1000000000 + dirStat.st_mtim.tv_nsec;
+    }
+    if (knownMtimeNs != 0 && mtimeNs == knownMtimeNs) {
+        ::close(fd);
+        QMetaObject::invokeMethod(this, [this, generation] {
+            if (generation == m_generation.load()) setLoading(false);
+        }, Qt::QueuedConnection);
+        return;
+    }
+
+    std::vector<quint64> buffer(DirentBufferSize / sizeof(quint64));
+    char* const base = reinterpret_cast<char*>(buffer.data());
+    for (;;) {
+        const long n = ::syscall(SYS_getdents64, fd, base, DirentBufferSize);
+        if (n <= 0) break;
+
+        for (long offset = 0; offset < n;) {
+            const auto* d = reinterpret_cast<const LinuxDirent64*>(base + offset);
+            offset += d->d_reclen;
+
+            bool isDir = d->d_type == DT_DIR;
+            if (d->d_type == DT_LNK || d->d_type == DT_UNKNOWN) {
+                // Some filesystems don't report types; symlinks are followed like QDir does
+                struct stat st;
+                if (::fstatat(fd, d->d_name, &st, 0) != 0) continue;
+                if (!S_ISDIR(st.st_mode) && !S_ISREG(st.st_mode)) continue;
+                isDir = S_ISDIR(st.st_mode);
+            } else if (d->d_type != DT_DIR && d->d_type != DT_REG) {
+                continue;
+            }
+            add({QFile::decodeName(d->d_name), isDir});
+        }
+
+        if (cancelled()) {
+            ::close(fd);
+            return;
+        }
+        if (stream && batchTimer.elapsed() >= BatchIntervalMs) flush();
+    }
+    ::close(fd);
+#else
+    const QFileInfo dirInfo(path);
+    if (!dirInfo.isDir()) {
+        fail();
+        return;
+    }
+    mtimeNs = dirInfo.lastModified().toMSecsSinceEpoch() * 1000000;
+    if (knownMtimeNs != 0 && mtimeNs == knownMtimeNs) {
+        QMetaObject::invokeMethod(this, [this, generation] {
+            if (generation == m_generation.load()) setLoading(false);
+        }, Qt::QueuedConnection);
+        return;
+    }
+
+    QDirIterator it(path, QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot);
+    while (it.hasNext()) {
+        const QFileInfo info = it.nextFileInfo();
+        add({info.fileName(), info.isDir()});
+        if ((all.size() & 255) == 0) {
+            if (cancelled()) return;
+            if (stream && batchTimer.elapsed() >= BatchIntervalMs) flush();
+        }
+    }
+#endif
+
+    if (cancelled()) return;
+    // Once streaming has started every row must arrive as a row insert before the re-sort
+    if (streamed) flush();
+
+    QVector<FolderEntry> sorted = sortedEntries(all);
+    QMetaObject::invokeMethod(this, [this, generation, path, mtimeNs, sorted = std::move(sorted)] {
+        finishListing(generation, path, mtimeNs, sorted);
+    }, Qt::QueuedConnection);
+}
+
+void FolderBrowserModel::appendBatch(quint64 generation, const QVector<FolderEntry>& batch)
+{
+    if (generation != m_generation.load() || batch.isEmpty()) return;
+
+    beginInsertRows(QModelIndex(), m_entries.size(), m_entries.size() + batch.size() - 1);
+    m_entries.append(batch);
+    endInsertRows();
+    m_streamed = true;
+    emit countChanged();
+}
+
+void FolderBrowserModel::finishListing(quint64 generation, const QString& path, qint64 mtimeNs, const QVector<FolderEntry>& sorted)
+{
+    if (generation != m_generation.load()) return;
+
+    storeInCache(path, mtimeNs, sorted);
+    applySorted(sorted);
+    setLoading(false);
+}
+
+void FolderBrowserModel::applySorted(const QVector<FolderEntry>& sorted)
+{
+    if (!m_streamed || m_entries.size() != sorted.size()) {
+        beginResetModel();
+        m_entries = sorted;
+        endResetModel();
+        emit countChanged();
+        return;
+    }
+
+    // Rows were streamed in directory order; reorder in place so views keep their delegates
+    emit layoutAboutToBeChanged({}, QAbstractItemModel::VerticalSortHint);
+    const QModelIndexList from = persistentIndexList();
+    QModelIndexList to;
+    if (!from.isEmpty()) {
+        QHash<QString, int> newRows;
+        newRows.reserve(sorted.size());
+        for (int i = 0; i < sorted.size(); ++i) {
+            newRows.insert(sorted.at(i).name, i);
+        }
+        to.reserve(from.size());
+        for (const QModelIndex& idx : from) {
+            const int row = newRows.value(m_entries.at(idx.row()).name, -1);
+            to.append(row >= 0 ? index(row) : QModelIndex());
+        }
+    }
+    m_entries = sorted;
+    changePersistentIndexList(from, to);
+    emit layoutChanged({}, QAbstractItemModel::VerticalSortHint);
+}
+
+void FolderBrowserModel::storeInCache(const QString& path, qint64 mtimeNs, const QVector<FolderEntry>& entries)
+{
+    m_cache.insert(path, {mtimeNs, entries});
+    m_cacheOrder.removeAll(path);
+    m_cacheOrder.append(path);
+    while (m_cacheOrder.size() > CachedFolders) {
+        m_cache.remove(m_cacheOrder.takeFirst());
+    }
+}
+
+QString FolderBrowserModel::filePath(int row) const
+{
+    const QString& name = m_entries.at(row).name;
+    return m_path.endsWith(QLatin1Char('/')) ? m_path + name : m_path + QLatin1Char('/') + name;
+}
+
+void FolderBrowserModel::requestDuration(const QString& filePath) const
+{
+    m_durations.insert(filePath, -1);
+    m_durationQueue.append(filePath);
+    if (m_durationQueue.size() > MaxQueuedDurations) {
+        m_durations.remove(m_durationQueue.takeFirst());
+    }
+
+    // data() is const and may be called mid-layout; start the reads from the event loop
+    if (!m_pumpScheduled) {
+        m_pumpScheduled = true;
+        QMetaObject::invokeMethod(const_cast<FolderBrowserModel*>(this), [this] {
+            const_cast<FolderBrowserModel*>(this)->pumpDurations();
+        }, Qt::QueuedConnection);
+    }
+}
+
+void FolderBrowserModel::pumpDurations()
+{
+    m_pumpScheduled = false;
+    while (m_durationsInFlight < m_metadataPool.maxThreadCount() && !m_durationQueue.isEmpty()) {
+        const QString path = m_durationQueue.takeLast();
+        const quint64 generation = m_generation.load();
+        ++m_durationsInFlight;
+        m_metadataPool.start([this, path, generation] {
+            qint64 duration = -1;
+            if (generation == m_generation.load(std::memory_order_relaxed)) {
+                // Scan mode: header-only parsers, no cover art
+                TrackMetadata* metadata = MetadataReader::readMetadataStandalone(
+                    QUrl::fromLocalFile(path), nullptr, MetadataReader::ReadMode::Fast);
+                if (metadata) {
+                    duration = metadata->duration();
+                    delete metadata;
+                }
+            }
+            QMetaObject::invokeMethod(this, [this, path, generation, duration] {
+                durationReady(path, generation, duration);
+            }, Qt::QueuedConnection);
+        });
+    }
+}
+
+void FolderBrowserModel::durationReady(const QString& filePath, quint64 generation, qint64 durationMs)
+{
+    --m_durationsInFlight;
+
+    if (generation != m_generation.load() && durationMs < 0) {
+        // Skipped because the folder changed; allow a later request
+        m_durations.remove(filePath);
+    } else {
+        m_durations.insert(filePath, durationMs);
+
+        const int slash = filePath.lastIndexOf(QLatin1Char('/'));
+        if (QDir::cleanPath(filePath.left(qMax(slash, 1))) == m_path) {
+            const QString name = filePath.mid(slash + 1);
+            for (int row = 0; row < m_entries.size(); ++row) {
+                if (m_entries.at(row).name == name) {
+                    const QModelIndex idx = index(row);
+                    emit dataChanged(idx, idx, {DurationRole});
+                    break;
+                }
+            }
+        }
+    }
+
+    pumpDurations();
+}
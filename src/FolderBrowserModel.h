@@ -0,0 +1,109 @@
+#pragma once
+
+#include <QAbstractListModel>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QUrl>
+#include <QVector>
+
+#include <atomic>
+
+// One directory entry; file size/mtime are not collected while listing (that would be a
+// stat() per file, which is what makes network shares slow)
+struct FolderEntry {
+    QString name;
+    bool isDir = false;
+};
+
+// Directory model for the file browser.
+// Listing runs on a worker thread with large getdents64() batches and rows are streamed in
+// as they arrive; the final name-sorted order is applied once the listing completes.
+// Listings are cached per directory and revalidated against the directory mtime, so going
+// back to a folder shows it immediately. Duration and cover thumbnails are produced lazily,
+// only for rows whose delegates ask for them.
+class FolderBrowserModel : public QAbstractListModel {
+    Q_OBJECT
+    Q_PROPERTY(QUrl folder READ folder WRITE setFolder NOTIFY folderChanged)
+    Q_PROPERTY(QUrl parentFolder READ parentFolder NOTIFY folderChanged)
+    Q_PROPERTY(QStringList nameFilters READ nameFilters WRITE setNameFilters NOTIFY nameFiltersChanged)
+    Q_PROPERTY(bool loading READ loading NOTIFY loadingChanged)
+    Q_PROPERTY(int count READ rowCount NOTIFY countChanged)
+
+public:
+    explicit FolderBrowserModel(QObject* parent = nullptr);
+    ~FolderBrowserModel() override;
+
+    // Role names match Qt.labs FolderListModel so delegates work unchanged
+    enum Roles {
+        FileNameRole = Qt::UserRole + 1,
+        FileUrlRole,
+        FileIsDirRole,
+        DurationRole,
+        CoverSourceRole
+    };
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    QUrl folder() const { return QUrl::fromLocalFile(m_path); }
+    void setFolder(const QUrl& folder);
+    QUrl parentFolder() const;
+    QStringList nameFilters() const { return m_nameFilters; }
+    void setNameFilters(const QStringList& filters);
+    bool loading() const { return m_loading; }
+
+    // Re-list the current folder, bypassing the cache
+    Q_INVOKABLE void refresh();
+
+signals:
+    void folderChanged();
+    void nameFiltersChanged();
+    void loadingChanged();
+    void countChanged();
+
+private:
+    struct CachedListing {
+        qint64 mtimeNs = 0;
+        QVector<FolderEntry> entries;
+    };
+
+    void startListing(bool useCache);
+    void setLoading(bool loading);
+    void appendBatch(quint64 generation, const QVector<FolderEntry>& batch);
+    void finishListing(quint64 generation, const QString& path, qint64 mtimeNs, const QVector<FolderEntry>& sorted);
+    void applySorted(const QVector<FolderEntry>& sorted);
+    void storeInCache(const QString& path, qint64 mtimeNs, const QVector<FolderEntry>& entries);
+
+    QString filePath(int row) const;
+    void requestDuration(const QString& filePath) const;
+    void pumpDurations();
+    void durationReady(const QString& filePath, quint64 generation, qint64 durationMs);
+
+    // Runs on the listing pool; results are posted back to the model's thread
+    void listDirectory(const QString& path, qint64 knownMtimeNs, const QStringList& filters, quint64 generation);
+
+    QString m_path;
+    QStringList m_nameFilters;
+    QVector<FolderEntry> m_entries;
+    bool m_loading {false};
+    bool m_streamed {false};
+
+    // Bumped on every navigation; stale listing and duration jobs check it and bail out.
+    // Both pools are drained in the destructor, so jobs may touch it without extra ownership.
+    std::atomic<quint64> m_generation {0};
+
+    QHash<QString, CachedListing> m_cache;
+    QStringList m_cacheOrder; // least recently used first
+
+    // Keyed by absolute path so results survive navigation; -1 while pending or if unreadable
+    mutable QHash<QString, qint64> m_durations;
+    mutable QStringList m_durationQueue; // newest last; served LIFO so visible rows win
+    mutable bool m_pumpScheduled {false};
+    int m_durationsInFlight {0};
+
+    QThreadPool m_listPool;
+    QThreadPool m_metadataPool;
+};
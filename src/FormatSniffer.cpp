@@ -0,0 +1,97 @@
+#include "FormatSniffer.h"
+
+#include <cstring>
+
+namespace {
+
+bool startsWith(const uchar* data, qint64 size, qint64 offset, const char* magic, int len)
+{
+    return offset + len <= size && std::memcmp(data + offset, magic, size_t(len)) == 0;
+}
+
+bool isMpegSync(const uchar* p)
+{
+    // 11-bit frame sync, valid version, layer I-III, usable bitrate/sample rate indices
+    if (p[0] != 0xFF || (p[1] & 0xE0) != 0xE0) return false;
+    const int version = (p[1] >> 3) & 0x03;
+    const int layer = (p[1] >> 1) & 0x03;
+    const int bitrate = p[2] >> 4;
+    const int rate = (p[2] >> 2) & 0x03;
+    return version != 1 && layer != 0 && bitrate != 0 && bitrate != 15 && rate != 3;
+}
+
+bool isAdtsSync(const uchar* p)
+{
+    // 12-bit sync, layer 00, sampling index < 13
+    return p[0] == 0xFF && (p[1] & 0xF6) == 0xF0 && ((p[2] >> 2) & 0x0F) < 13;
+}
+
+AudioFormat sniffOgg(const uchar* data, qint64 size)
+{
+    // First page carries exactly one packet: the codec identification header
+    if (size < 28) return AudioFormat::Unknown;
+    const qint64 packet = 27 + data[26];
+    if (startsWith(data, size, packet, "OpusHead", 8)) return AudioFormat::OggOpus;
+    if (startsWith(data, size, packet, "\x01vorbis", 7)) return AudioFormat::OggVorbis;
+    if (startsWith(data, size, packet, "\x7F" "FLAC", 5)) return AudioFormat::OggFlac;
+    return AudioFormat::Unknown;
+}
+
+} // namespace
+
+AudioFormat FormatSniffer::sniff(const uchar* data, qint64 size)
+{
+    if (!data || size < 4)
+        return AudioFormat::Unknown;
+
+    qint64 pos = 0;
+    if (startsWith(data, size, 0, "ID3", 3) && size >= 10) {
+        // Skip the tag; what follows decides between MPEG, FLAC and ADTS AAC
+        const qint64 tagSize = (qint64(data[6] & 0x7F) << 21) | (qint64(data[7] & 0x7F) << 14)
+                             | (qint64(data[8] & 0x7F) << 7) | qint64(data[9] & 0x7F);
+        pos = 10 + tagSize + ((data[5] & 0x10) ? 10 : 0);
+        if (startsWith(data, size, pos, "fLaC", 4))
+            return AudioFormat::Flac;
+        // Tolerate zero padding written past the declared tag size
+        const qint64 end = qMin(size - 4, pos + 4096);
+        while (pos < end && data[pos] == 0)
+            ++pos;
+        if (pos + 4 <= size && isAdtsSync(data + pos))
+            return AudioFormat::Aac;
+        return AudioFormat::Mpeg;
+    }
+
+    if (startsWith(data, size, 0, "fLaC", 4)) return AudioFormat::Flac;
+    if (startsWith(data, size, 0, "OggS", 4)) return sniffOgg(data, size);
+    if (startsWith(data, size, 4, "ftyp", 4)) return AudioFormat::Mp4;
+    if (startsWith(data, size, 0, "RIFF", 4) && startsWith(data, size, 8, "WAVE", 4)) return AudioFormat::Wav;
+    if (startsWith(data, size, 0, "FORM", 4)
+        && (startsWith(data, size, 8, "AIFF", 4) || startsWith(data, size, 8, "AIFC", 4)))
+        return AudioFormat::Aiff;
+    if (startsWith(data, size, 0, "wvpk", 4)) return AudioFormat::WavPack;
+    if (startsWith(data, size, 0, "MAC ", 4)) return AudioFormat::Ape;
+    if (startsWith(data, size, 0, "\x1A\x45\xDF\xA3", 4)) return AudioFormat::Matroska;
+    if (isAdtsSync(data)) return AudioFormat::Aac;
+    if (isMpegSync(data)) return AudioFormat::Mpeg;
+
+    return AudioFormat::Unknown;
+}
+
+QString FormatSniffer::formatName(AudioFormat format)
+{
+    switch (format) {
+    case AudioFormat::Flac: return QStringLiteral("flac");
+    case AudioFormat::Mpeg: return QStringLiteral("mpeg");
+    case AudioFormat::Aac: return QStringLiteral("aac");
+    case AudioFormat::OggVorbis: return QStringLiteral("vorbis");
+    case AudioFormat::OggOpus: return QStringLiteral("opus");
+    case AudioFormat::OggFlac: return QStringLiteral("oggflac");
+    case AudioFormat::Mp4: return QStringLiteral("mp4");
+    case AudioFormat::Wav: return QStringLiteral("wav");
+    case AudioFormat::Aiff: return QStringLiteral("aiff");
+    case AudioFormat::WavPack: return QStringLiteral("wavpack");
+    case AudioFormat::Ape: return QStringLiteral("ape");
+    case AudioFormat::Matroska: return QStringLiteral("matroska");
+    default: return QStringLiteral("unknown");
+    }
+}
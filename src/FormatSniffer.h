@@ -0,0 +1,30 @@
+#pragma once
+
+#include <QString>
+
+enum class AudioFormat {
+    Unknown,
+    Flac,
+    Mpeg,
+    Aac,
+    OggVorbis,
+    OggOpus,
+    OggFlac,
+    Mp4,
+    Wav,
+    Aiff,
+    WavPack,
+    Ape,
+    Matroska,
+    Count
+};
+
+// Detects the container from magic bytes rather than the file extension
+class FormatSniffer {
+public:
+    // Only the first few dozen bytes are inspected, except that a leading ID3v2 tag is
+    // skipped by its declared size; pass the whole mapping so MPEG/FLAC/AAC can be told apart
+    static AudioFormat sniff(const uchar* data, qint64 size);
+
+    static QString formatName(AudioFormat format);
+};
@@ -0,0 +1,178 @@
+#include "FrameStats.h"
+#include "GraphicsBackend.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QMutexLocker>
+#include <QQuickWindow>
+#include <QSaveFile>
+#include <QScreen>
+#include <QStandardPaths>
+
+#include <algorithm>
+
+namespace {
+
+// A frame is slow when it takes this many refresh intervals
+constexpr double SlowFrameFactor = 1.5;
+
+double ms(qint64 from, qint64 to)
+{
+    return from >= 0 && to >= from ? double(to - from) / 1e6 : 0.0;
+}
+
+QVariantMap distribution(QVector<float> values)
+{
+    QVariantMap m;
+    if (values.isEmpty())
+        return m;
+    std::sort(values.begin(), values.end());
+    const auto at = [&values](double p) { return double(values.at(qsizetype(p * double(values.size() - 1) + 0.5))); };
+    m["p50"] = at(0.50);
+    m["p95"] = at(0.95);
+    m["p99"] = at(0.99);
+    m["max"] = double(values.last());
+    return m;
+}
+
+} // namespace
+
+FrameStats::FrameStats(QObject* parent)
+    : QObject(parent)
+{
+    m_clock.start();
+    m_ring.reserve(Capacity);
+}
+
+void FrameStats::attach(QQuickWindow* window)
+{
+    if (QScreen* screen = window->screen(); screen && screen->refreshRate() > 0)
+        m_budgetMs = 1000.0 / screen->refreshRate();
+
+    // Render thread signals are handled where they are emitted
+    connect(window, &QQuickWindow::afterAnimating, this, [this] {
+        m_polishStart.store(m_clock.nsecsElapsed(), std::memory_order_relaxed);
+    }, Qt::DirectConnection);
+    connect(window, &QQuickWindow::beforeSynchronizing, this, [this] {
+        m_syncStart = m_clock.nsecsElapsed();
+        // The GUI thread is blocked from here until the sync is done, so this is the polish
+        // of this frame and not of the next one
+        m_framePolishStart = m_polishStart.exchange(-1, std::memory_order_relaxed);
+    }, Qt::DirectConnection);
+    connect(window, &QQuickWindow::afterSynchronizing, this, [this] { m_syncEnd = m_clock.nsecsElapsed(); }, Qt::DirectConnection);
+    connect(window, &QQuickWindow::beforeRendering, this, [this] { m_renderStart = m_clock.nsecsElapsed(); }, Qt::DirectConnection);
+    connect(window, &QQuickWindow::afterRendering, this, [this] { m_renderEnd = m_clock.nsecsElapsed(); }, Qt::DirectConnection);
+    connect(window, &QQuickWindow::frameSwapped, this, &FrameStats::onFrameSwapped, Qt::DirectConnection);
+    emit attached();
+}
+
+QString FrameStats::backend() const
+{
+    return GraphicsBackend::current();
+}
+
+void FrameStats::onFrameSwapped()
+{
+    const qint64 now = m_clock.nsecsElapsed();
+    const qint64 polishStart = m_framePolishStart;
+    const qint64 frameStart = polishStart >= 0 ? polishStart : m_syncStart;
+    const bool continuous = m_lastSwap >= 0 && frameStart >= 0 && ms(m_lastSwap, frameStart) <= m_budgetMs;
+
+    const Frame frame {
+        float(ms(polishStart, m_syncStart)),
+        float(ms(m_syncStart, m_syncEnd)),
+        float(ms(m_renderStart, m_renderEnd)),
+        float(ms(m_renderEnd, now)),
+        continuous ? float(ms(m_lastSwap, now)) : 0.0f,
+    };
+    m_lastSwap = now;
+
+    QMutexLocker lock(&m_mutex);
+    if (m_ring.size() < Capacity) {
+        m_ring.append(frame);
+    } else {
+        m_ring[m_next] = frame;
+        m_next = (m_next + 1) % Capacity;
+    }
+}
+
+QVector<FrameStats::Frame> FrameStats::frames() const
+{
+    QMutexLocker lock(&m_mutex);
+    QVector<Frame> ordered;
+    ordered.reserve(m_ring.size());
+    for (int i = 0; i < m_ring.size(); ++i)
+        ordered.append(m_ring.at((m_next + i) % m_ring.size()));
+    return ordered;
+}
+
+QVariantMap FrameStats::summary() const
+{
+    const QVector<Frame> all = frames();
+    QVector<float> polish, sync, render, swap, total, interval;
+    int slow = 0;
+    for (const Frame& f : all) {
+        polish.append(f.polishMs);
+        sync.append(f.syncMs);
+        render.append(f.renderMs);
+        swap.append(f.swapMs);
+        const float t = f.polishMs + f.syncMs + f.renderMs + f.swapMs;
+        total.append(t);
+        if (f.intervalMs > 0)
+            interval.append(f.intervalMs);
+        if (t > SlowFrameFactor * m_budgetMs)
+            ++slow;
+    }
+
+    QVariantMap m;
+    m["backend"] = backend();
+    m["frames"] = int(all.size());
+    m["slow"] = slow;
+    m["budgetMs"] = m_budgetMs;
+    m["polish"] = distribution(polish);
+    m["sync"] = distribution(sync);
+    m["render"] = distribution(render);
+    m["swap"] = distribution(swap);
+    m["total"] = distribution(total);
+    m["interval"] = distribution(interval);
+    return m;
+}
+
+QString FrameStats::exportCsv(const QUrl& url) const
+{
+    QString path;
+    if (url.isEmpty()) {
+        const QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+        QDir().mkpath(dir);
+        path = QDir(dir).filePath(QStringLiteral("frames-%1.csv")
+                                  .arg(QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss")));
+    } else {
+        path = url.isLocalFile() ? url.toLocalFile() : url.toString();
+    }
+
+    QSaveFile f(path);
+    if (!f.open(QIODevice::WriteOnly)) {
+        qWarning() << "FrameStats: cannot write" << path << f.errorString();
+        return QString();
+    }
+    QByteArray out = "# backend " + backend().toUtf8() + "\npolish_ms,sync_ms,render_ms,swap_ms,interval_ms\n";
+    for (const Frame& frame : frames()) {
+        out += QByteArray::number(frame.polishMs, 'f', 3) + ',' + QByteArray::number(frame.syncMs, 'f', 3) + ','
+               + QByteArray::number(frame.renderMs, 'f', 3) + ',' + QByteArray::number(frame.swapMs, 'f', 3) + ','
+               + QByteArray::number(frame.intervalMs, 'f', 3) + '\n';
+    }
+    f.write(out);
+    if (!f.commit()) {
+        qWarning() << "FrameStats: cannot write" << path << f.errorString();
+        return QString();
+    }
+    return path;
+}
+
+void FrameStats::reset()
+{
+    QMutexLocker lock(&m_mutex);
+    m_ring.clear();
+    m_next = 0;
+}
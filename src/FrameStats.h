@@ -0,0 +1,77 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QObject>
+#include <QUrl>
+#include <QVariantMap>
+#include <QVector>
+
+#include <atomic>
+
+class QQuickWindow;
+
+// Per-frame timing of one window, kept for the last Capacity frames.
+//
+// Phases follow the scene graph's own signals: polish (animations advanced until the scene
+// graph takes over: QML bindings, layouts, delegate creation), sync (item state copied into
+// the scene graph), render (commands recorded, or pixels drawn by the software renderer) and
+// swap (submission and present, including any wait for vsync). The interval is present to
+// present; it is 0 for the first frame after the window was idle.
+//
+// With the threaded render loop sync..swap are recorded on the render thread; reads take a
+// snapshot under a lock.
+class FrameStats : public QObject {
+    Q_OBJECT
+    Q_PROPERTY(QString backend READ backend NOTIFY attached)
+
+public:
+    static constexpr int Capacity = 1024;
+
+    struct Frame {
+        float polishMs;
+        float syncMs;
+        float renderMs;
+        float swapMs;
+        float intervalMs;
+    };
+
+    explicit FrameStats(QObject* parent = nullptr);
+
+    void attach(QQuickWindow* window);
+    QString backend() const;
+
+    // Over the buffered frames: { backend, frames, slow, budgetMs, polish, sync, render, swap,
+    // total, interval }, each phase as { p50, p95, p99, max } in ms. A frame is slow when
+    // its total exceeds 1.5 refresh intervals.
+    Q_INVOKABLE QVariantMap summary() const;
+    // One line per buffered frame, oldest first; an empty url writes to the app data
+    // directory. Returns the path or empty on failure.
+    Q_INVOKABLE QString exportCsv(const QUrl& url = QUrl()) const;
+    Q_INVOKABLE void reset();
+
+    // Oldest first
+    QVector<Frame> frames() const;
+
+signals:
+    void attached();
+
+private:
+    void onFrameSwapped();
+
+    QElapsedTimer m_clock;
+    double m_budgetMs {1000.0 / 60};
+
+    // Stamps of the frame in flight, ns on m_clock. Polish starts on the GUI thread.
+    std::atomic<qint64> m_polishStart {-1};
+    qint64 m_framePolishStart {-1};
+    qint64 m_syncStart {-1};
+    qint64 m_syncEnd {-1};
+    qint64 m_renderStart {-1};
+    qint64 m_renderEnd {-1};
+    qint64 m_lastSwap {-1};
+
+    mutable QMutex m_mutex;
+    QVector<Frame> m_ring; // Capacity entries once full
+    int m_next {0};
+};
@@ -0,0 +1,196 @@
+#include "GraphicsBackend.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QOffscreenSurface>
+#include <QQuickWindow>
+#include <QSGRendererInterface>
+#include <QSettings>
+
+#include <rhi/qrhi.h>
+
+#if QT_CONFIG(vulkan)
+#include <QVulkanInstance>
+#endif
+
+#include <memory>
+
+namespace {
+
+constexpr char ApiKey[] = "graphics/api";
+// Backend being probed, or whose window is being brought up; removed once that is over
+constexpr char PendingKey[] = "graphics/pending";
+// Backends that went down while pending
+constexpr char FailedKey[] = "graphics/failed";
+// Hardware backend that last reached its first frame, used by "auto" without probing
+constexpr char LastGoodKey[] = "graphics/lastGood";
+
+struct Backend {
+    const char* name;
+    QSGRendererInterface::GraphicsApi api;
+};
+
+constexpr Backend Backends[] = {
+    {"software", QSGRendererInterface::Software},
+    {"opengl", QSGRendererInterface::OpenGL},
+    {"vulkan", QSGRendererInterface::Vulkan},
+    {"d3d11", QSGRendererInterface::Direct3D11},
+    {"d3d12", QSGRendererInterface::Direct3D12},
+    {"metal", QSGRendererInterface::Metal},
+};
+
+constexpr const char* ProbeOrder[] = {
+#if defined(Q_OS_WIN)
+    "d3d11", "d3d12", "opengl", "vulkan",
+#elif defined(Q_OS_MACOS)
+    "metal", "opengl",
+#else
+    "opengl", "vulkan",
+#endif
+};
+
+const Backend* find(const QString& name)
+{
+    for (const Backend& backend : Backends) {
+        if (name == QLatin1String(backend.name))
+            return &backend;
+    }
+    return nullptr;
+}
+
+// Whether a QRhi can be created for api on this machine
+bool probe(QSGRendererInterface::GraphicsApi api)
+{
+    switch (api) {
+    case QSGRendererInterface::OpenGL: {
+#if QT_CONFIG(opengl)
+        QRhiGles2InitParams params;
+        const std::unique_ptr<QOffscreenSurface> surface(QRhiGles2InitParams::newFallbackSurface());
+        params.fallbackSurface = surface.get();
+        return QRhi::probe(QRhi::OpenGLES2, &params);
+#else
+        return false;
+#endif
+    }
+    case QSGRendererInterface::Vulkan: {
+#if QT_CONFIG(vulkan)
+        QVulkanInstance instance;
+        if (!instance.create())
+            return false;
+        QRhiVulkanInitParams params;
+        params.inst = &instance;
+        return QRhi::probe(QRhi::Vulkan, &params);
+#else
+        return false;
+#endif
+    }
+#if defined(Q_OS_WIN)
+    case QSGRendererInterface::Direct3D11: {
+        QRhiD3D11InitParams params;
+        return QRhi::probe(QRhi::D3D11, &params);
+    }
+    case QSGRendererInterface::Direct3D12: {
+        QRhiD3D12InitParams params;
+        return QRhi::probe(QRhi::D3D12, &params);
+    }
+#endif
+#if QT_CONFIG(metal)
+    case QSGRendererInterface::Metal: {
+        QRhiMetalInitParams params;
+        return QRhi::probe(QRhi::Metal, &params);
+    }
+#endif
+    case QSGRendererInterface::Software:
+        return true;
+    default:
+        return false;
+    }
+}
+
+QString s_current;
+bool s_shown = false;
+
+} // namespace
+
+QStringList GraphicsBackend::names()
+{
+    QStringList names {QStringLiteral("auto")};
+    for (const Backend& backend : Backends)
+        names.append(QLatin1String(backend.name));
+    return names;
+}
+
+QString GraphicsBackend::select(const QString& requested)
+{
+    QSettings settings;
+    QStringList failed = settings.value(FailedKey).toStringList();
+    const QString pending = settings.value(PendingKey).toString();
+    if (!pending.isEmpty() && pending != QLatin1String("software") && !failed.contains(pending)) {
+        qWarning() << "Graphics backend" << pending << "went down while starting last time; it is no longer used by auto";
+        failed.append(pending);
+        settings.setValue(FailedKey, failed);
+    }
+    settings.remove(PendingKey);
+
+    QString choice = (requested.isEmpty() ? settings.value(ApiKey, QStringLiteral("auto")).toString() : requested).toLower();
+    const QString lastGood = settings.value(LastGoodKey).toString();
+    if (choice == QLatin1String("auto") && find(lastGood) && !failed.contains(lastGood)) {
+        choice = lastGood;
+    } else if (choice == QLatin1String("auto")) {
+        choice = QStringLiteral("software");
+        for (const char* candidate : ProbeOrder) {
+            if (failed.contains(QLatin1String(candidate)))
+                continue;
+            // On disk before the driver gets a chance to take the process down
+            settings.setValue(PendingKey, QLatin1String(candidate));
+            settings.sync();
+            if (probe(find(QLatin1String(candidate))->api)) {
+                choice = QLatin1String(candidate);
+                break;
+            }
+        }
+        settings.remove(PendingKey);
+    } else if (!find(choice)) {
+        qWarning() << "Unknown graphics API" << choice << "- expected one of" << names().join(QLatin1String(", "));
+        choice = QStringLiteral("software");
+    }
+
+    const QSGRendererInterface::GraphicsApi api = find(choice)->api;
+    QQuickWindow::setGraphicsApi(api);
+    if (api == QSGRendererInterface::Software) {
+        qputenv("QSG_RHI_BACKEND", QByteArray("software"));
+        qputenv("QT_QUICK_BACKEND", QByteArray("software"));
+    }
+    s_current = choice;
+    return choice;
+}
+
+QString GraphicsBackend::current()
+{
+    return s_current;
+}
+
+void GraphicsBackend::windowCreated()
+{
+    QSettings settings;
+    settings.setValue(PendingKey, s_current);
+    settings.sync();
+    // Quitting before the first frame says nothing about the backend
+    QObject::connect(qApp, &QCoreApplication::aboutToQuit, [] {
+        if (!s_shown)
+            QSettings().remove(PendingKey);
+    });
+}
+
+void GraphicsBackend::firstFrameShown()
+{
+    s_shown = true;
+    QSettings settings;
+    settings.remove(PendingKey);
+    QStringList failed = settings.value(FailedKey).toStringList();
+    if (failed.removeAll(s_current) > 0)
+        settings.setValue(FailedKey, failed);
+    // The software renderer is the fallback, not a finding; keep probing for hardware
+    if (s_current != QLatin1String("software"))
+        settings.setValue(LastGoodKey, s_current);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+
+// Chooses the scene graph backend; call after the QGuiApplication exists and before the first
+// window is created.
+//
+// "auto" uses the hardware API that last reached its first frame. Until one has, it probes the
+// hardware APIs in the platform's order of preference (Direct3D 11/12 on Windows, Metal on
+// macOS, then OpenGL and Vulkan) by bringing up and tearing down a QRhi for each, and falls
+// back to the software renderer when none comes up. A backend that was being probed, or whose
+// window was being brought up, when the app last went down is not used by "auto" again, so a
+// driver that crashes rather than failing cleanly costs one launch, not every launch.
+//
+// An explicit name (--graphics-api, or the "graphics/api" setting) is used without probing;
+// reaching the first frame with it clears an earlier failure.
+class GraphicsBackend {
+public:
+    // "auto", then every backend select() accepts
+    static QStringList names();
+
+    // requested overrides the setting when not empty. Returns the backend in use.
+    static QString select(const QString& requested = QString());
+    static QString current();
+
+    // Call once the window exists, before the event loop brings it up
+    static void windowCreated();
+    // Call once the first frame has been presented
+    static void firstFrameShown();
+};
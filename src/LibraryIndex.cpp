@@ -0,0 +1,264 @@
+#include "LibraryIndex.h"
+
+#include <algorithm>
+
+namespace {
+
+// "1969", "1969-05-01": the leading digits
+qint64 leadingNumber(const QString& s)
+{
+    qint64 value = 0;
+    for (const QChar c : s) {
+        if (!c.isDigit()) break;
+        value = value * 10 + c.digitValue();
+    }
+    return value;
+}
+
+// Takes a use of value's id, adding it the first time
+int intern(LibraryIndex::TextColumn& column, const QString& value)
+{
+    auto it = column.index.constFind(value);
+    if (it == column.index.constEnd()) {
+        it = column.index.insert(value, int(column.values.size()));
+        column.values.append(value);
+        column.uses.push_back(0);
+    } else if (column.uses[it.value()] == 0) {
+        --column.dead;
+    }
+    ++column.uses[it.value()];
+    return it.value();
+}
+
+void drop(LibraryIndex::TextColumn& column, int id)
+{
+    if (--column.uses[id] == 0)
+        ++column.dead;
+}
+
+// Keeps the values some track holds, in their old order, and renumbers them
+void compact(LibraryIndex::TextColumn& column)
+{
+    std::vector<int> renumbered(column.values.size(), -1);
+    QVector<QString> values;
+    std::vector<int> uses;
+    QHash<QString, int> index;
+    values.reserve(column.values.size() - column.dead);
+    uses.reserve(column.values.size() - column.dead);
+    index.reserve(int(column.values.size() - column.dead));
+    for (int id = 0; id < int(column.values.size()); ++id) {
+        if (column.uses[id] == 0) continue;
+        renumbered[id] = int(values.size());
+        index.insert(column.values.at(id), int(values.size()));
+        values.append(column.values.at(id));
+        uses.push_back(column.uses[id]);
+    }
+    for (int& id : column.ids)
+        id = renumbered[id];
+    column.values.swap(values);
+    column.uses.swap(uses);
+    column.index.swap(index);
+    column.dead = 0;
+    ++column.generation;
+}
+
+} // namespace
+
+LibraryIndex::LibraryIndex(QObject* parent)
+    : QObject(parent)
+{
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(0);
+    connect(&m_flushTimer, &QTimer::timeout, this, &LibraryIndex::flush);
+}
+
+int LibraryIndex::trackOf(const QString& location) const
+{
+    const int track = m_byLocation.value(location, -1);
+    return track >= 0 && isLive(track) ? track : -1;
+}
+
+QString LibraryIndex::textOf(const PlaylistModel::Item& item, Field field)
+{
+    switch (field) {
+    case Title: return item.title;
+    case Artist: return item.artist;
+    case Album: return item.album;
+    case Genre: return item.genre;
+    case Path: return item.location;
+    default: return QString();
+    }
+}
+
+qint64 LibraryIndex::numberOf(const PlaylistModel::Item& item, Field field)
+{
+    switch (field) {
+    case Year: return leadingNumber(item.year);
+    case TrackNumber: return item.trackNumber;
+    case Duration: return item.duration;
+    default: return 0;
+    }
+}
+
+void LibraryIndex::watch(PlaylistModel* model)
+{
+    if (m_rows.contains(model)) return;
+    std::vector<int>& rows = m_rows[model];
+    rows.reserve(model->count());
+    for (const PlaylistModel::Item& item : model->items())
+        rows.push_back(acquire(item));
+
+    connect(model, &QAbstractItemModel::rowsInserted, this, [this, model](const QModelIndex&, int first, int last) {
+        std::vector<int> added;
+        added.reserve(last - first + 1);
+        for (int row = first; row <= last; ++row)
+            added.push_back(acquire(model->items().at(row)));
+        std::vector<int>& rows = m_rows[model];
+        rows.insert(rows.begin() + first, added.begin(), added.end());
+    });
+    connect(model, &QAbstractItemModel::rowsRemoved, this, [this, model](const QModelIndex&, int first, int last) {
+        std::vector<int>& rows = m_rows[model];
+        for (int row = first; row <= last; ++row)
+            release(rows[row]);
+        rows.erase(rows.begin() + first, rows.begin() + last + 1);
+    });
+    connect(model, &QAbstractItemModel::rowsMoved, this,
+            [this, model](const QModelIndex&, int first, int last, const QModelIndex&, int destination) {
+                std::vector<int>& rows = m_rows[model];
+                if (destination > last)
+                    std::rotate(rows.begin() + first, rows.begin() + last + 1, rows.begin() + destination);
+                else
+                    std::rotate(rows.begin() + destination, rows.begin() + first, rows.begin() + last + 1);
+            });
+    connect(model, &QAbstractItemModel::dataChanged, this,
+            [this, model](const QModelIndex& topLeft, const QModelIndex& bottomRight) {
+                for (int row = topLeft.row(); row <= bottomRight.row(); ++row)
+                    update(model, row);
+            });
+    connect(model, &QAbstractItemModel::layoutChanged, this, [this, model] { resync(model); });
+    connect(model, &QAbstractItemModel::modelReset, this, [this, model] { resync(model); });
+    connect(model, &QObject::destroyed, this, [this, model] { unwatch(model); });
+}
+
+void LibraryIndex::unwatch(PlaylistModel* model)
+{
+    const auto it = m_rows.find(model);
+    if (it == m_rows.end()) return;
+    disconnect(model, nullptr, this, nullptr);
+    for (int track : std::as_const(it.value()))
+        release(track);
+    m_rows.erase(it);
+}
+
+int LibraryIndex::acquire(const PlaylistModel::Item& item)
+{
+    // A track that is already known keeps its fields; edits arrive through dataChanged
+    const auto it = m_byLocation.constFind(item.location);
+    if (it != m_byLocation.constEnd()) {
+        if (m_refs[it.value()]++ == 0)
+            markChanged(it.value());
+        return it.value();
+    }
+
+    int track;
+    if (!m_free.empty()) {
+        track = m_free.back();
+        m_free.pop_back();
+    } else {
+        track = int(m_items.size());
+        m_items.emplace_back();
+        for (TextColumn& column : m_text)
+            column.ids.push_back(intern(column, QString()));
+        for (std::vector<qint64>& column : m_numbers)
+            column.push_back(0);
+        m_refs.push_back(0);
+        m_pending.push_back(0);
+    }
+    store(track, item);
+    m_byLocation.insert(item.location, track);
+    m_refs[track] = 1;
+    markChanged(track);
+    return track;
+}
+
+void LibraryIndex::release(int track)
+{
+    if (--m_refs[track] > 0) return;
+    markChanged(track);
+    m_dead.push_back(track);
+}
+
+void LibraryIndex::store(int track, const PlaylistModel::Item& item)
+{
+    m_items[track] = item;
+    for (int field = 0; field < TextFields; ++field) {
+        TextColumn& column = m_text[field];
+        // Taken before the old one is dropped, so an unchanged value never counts as dead
+        const int id = intern(column, textOf(item, Field(field)));
+        drop(column, column.ids[track]);
+        column.ids[track] = id;
+    }
+    for (int field = Year; field <= Duration; ++field)
+        m_numbers[field - Year][track] = numberOf(item, Field(field));
+}
+
+void LibraryIndex::update(PlaylistModel* model, int row)
+{
+    std::vector<int>& rows = m_rows[model];
+    const PlaylistModel::Item& item = model->items().at(row);
+    const int track = rows[row];
+    if (item.location != m_items[track].location) {
+        rows[row] = acquire(item);
+        release(track);
+    } else if (!item.sameFields(m_items[track])) {
+        store(track, item);
+        markChanged(track);
+    }
+}
+
+void LibraryIndex::resync(PlaylistModel* model)
+{
+    // Acquire first, so tracks that only moved are never released
+    std::vector<int> rows;
+    rows.reserve(model->count());
+    for (const PlaylistModel::Item& item : model->items())
+        rows.push_back(acquire(item));
+    std::vector<int>& old = m_rows[model];
+    for (int track : old)
+        release(track);
+    old.swap(rows);
+}
+
+void LibraryIndex::markChanged(int track)
+{
+    if (m_pending[track]) return;
+    m_pending[track] = 1;
+    m_changed.append(track);
+    if (!m_flushTimer.isActive())
+        m_flushTimer.start();
+}
+
+void LibraryIndex::flush()
+{
+    QVector<int> changed;
+    changed.swap(m_changed);
+    for (int track : std::as_const(changed))
+        m_pending[track] = 0;
+    emit tracksChanged(changed);
+
+    // Everyone has seen these go; their ids can be handed out again
+    std::sort(m_dead.begin(), m_dead.end());
+    m_dead.erase(std::unique(m_dead.begin(), m_dead.end()), m_dead.end());
+    for (int track : m_dead) {
+        if (m_refs[track] > 0) continue; // came back before the report
+        m_byLocation.remove(m_items[track].location);
+        store(track, PlaylistModel::Item());
+        m_free.push_back(track);
+    }
+    m_dead.clear();
+
+    for (TextColumn& column : m_text) {
+        if (column.dead > int(column.values.size()) - column.dead)
+            compact(column);
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "PlaylistModel.h"
+
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QVector>
+
+#include <array>
+#include <vector>
+
+// Every track held by the watched playlists, once per location, stored by column for
+// smart playlist queries.
+//
+// A track keeps its id for as long as any watched row refers to it. Text columns store ids
+// into a per-column dictionary, so a string test runs once per distinct value rather than
+// once per track; values no track holds any more are dropped, and the rest renumbered, once
+// they outnumber the live ones. Edits, additions and removals in the watched models are
+// coalesced and reported once per event loop pass; a track whose last row went away is
+// reported dead, and its id is only reused after that report. GUI thread only.
+class LibraryIndex : public QObject {
+    Q_OBJECT
+
+public:
+    // Title..Path are text columns, the rest numbers
+    enum Field { Title, Artist, Album, Genre, Path, Year, TrackNumber, Duration };
+    static constexpr int TextFields = Path + 1;
+    static constexpr int NumberFields = Duration - Year + 1;
+
+    struct TextColumn {
+        std::vector<int> ids;    // per track
+        QVector<QString> values; // per id, append-only between renumberings
+        QHash<QString, int> index;
+        std::vector<int> uses;   // per id, tracks holding it
+        int dead {0};            // ids no track holds
+        // Bumped when the ids are renumbered; whatever is cached by id must start over
+        quint32 generation {0};
+    };
+
+    explicit LibraryIndex(QObject* parent = nullptr);
+
+    // Adds the model's rows now and follows its changes until unwatch() or its destruction
+    void watch(PlaylistModel* model);
+    void unwatch(PlaylistModel* model);
+
+    // Ids run from 0 to trackCount() - 1; dead ones are skipped by isLive()
+    int trackCount() const { return int(m_items.size()); }
+    bool isLive(int track) const { return m_refs[track] > 0; }
+    const PlaylistModel::Item& item(int track) const { return m_items[track]; }
+    // -1 when no watched row has it
+    int trackOf(const QString& location) const;
+    const TextColumn& text(Field field) const { return m_text[field]; }
+    // Year, TrackNumber or Duration (ms); 0 when unknown
+    const std::vector<qint64>& numbers(Field field) const { return m_numbers[field - Year]; }
+
+    static bool isText(Field field) { return field < TextFields; }
+    static QString textOf(const PlaylistModel::Item& item, Field field);
+    static qint64 numberOf(const PlaylistModel::Item& item, Field field);
+
+signals:
+    // Tracks added, edited or removed since the last report, each listed once
+    void tracksChanged(const QVector<int>& tracks);
+
+private:
+    int acquire(const PlaylistModel::Item& item);
+    void release(int track);
+    void store(int track, const PlaylistModel::Item& item);
+    void update(PlaylistModel* model, int row);
+    void resync(PlaylistModel* model);
+    void markChanged(int track);
+    void flush();
+
+    std::vector<PlaylistModel::Item> m_items;
+    std::array<TextColumn, TextFields> m_text;
+    std::array<std::vector<qint64>, NumberFields> m_numbers;
+    std::vector<int> m_refs; // watched rows per track
+    QHash<QString, int> m_byLocation;
+    std::vector<int> m_free;
+
+    // Track per row of each watched model
+    QHash<PlaylistModel*, std::vector<int>> m_rows;
+
+    QVector<int> m_changed;
+    std::vector<quint8> m_pending;
+    std::vector<int> m_dead;
+    QTimer m_flushTimer;
+};
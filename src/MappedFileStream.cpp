@@ -0,0 +1,65 @@
+#include "MappedFileStream.h"
+
+#include <QDebug>
+
+MappedFileStream::MappedFileStream(const QString& filePath)
+    : m_file(filePath)
+    , m_name(QFile::encodeName(filePath))
+{
+    if (!m_file.open(QIODevice::ReadOnly))
+        return;
+
+    m_size = m_file.size();
+    if (m_size > 0)
+        m_data = m_file.map(0, m_size);
+}
+
+MappedFileStream::~MappedFileStream()
+{
+    if (m_data)
+        m_file.unmap(m_data);
+}
+
+TagLib::FileName MappedFileStream::name() const
+{
+    return m_name.constData();
+}
+
+TagLib::ByteVector MappedFileStream::readBlock(TagLibSize length)
+{
+    if (!m_data || m_pos >= m_size)
+        return TagLib::ByteVector();
+
+    const qint64 n = qMin<qint64>(qint64(length), m_size - m_pos);
+    TagLib::ByteVector block(reinterpret_cast<const char*>(m_data + m_pos), static_cast<unsigned int>(n));
+    m_pos += n;
+    return block;
+}
+
+void MappedFileStream::writeBlock(const TagLib::ByteVector&)
+{
+    qWarning() << "MappedFileStream is read-only:" << m_name;
+}
+
+void MappedFileStream::insert(const TagLib::ByteVector&, TagLibOffset, TagLibSize)
+{
+    qWarning() << "MappedFileStream is read-only:" << m_name;
+}
+
+void MappedFileStream::removeBlock(TagLibOffset, TagLibSize)
+{
+    qWarning() << "MappedFileStream is read-only:" << m_name;
+}
+
+void MappedFileStream::seek(TagLibOffset offset, Position p)
+{
+    qint64 base = 0;
+    if (p == Current) base = m_pos;
+    else if (p == End) base = m_size;
+    m_pos = qBound<qint64>(0, base + qint64(offset), m_size);
+}
+
+void MappedFileStream::truncate(TagLibOffset)
+{
+    qWarning() << "MappedFileStream is read-only:" << m_name;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+#include <taglib/taglib.h>
+#include <taglib/tiostream.h>
+
+#if TAGLIB_MAJOR_VERSION >= 2
+using TagLibOffset = TagLib::offset_t;
+using TagLibSize = size_t;
+#else
+using TagLibOffset = long;
+using TagLibSize = unsigned long;
+#endif
+
+// Read-only TagLib stream over a memory-mapped file. One open serves format sniffing,
+// the fast parsers and TagLib itself; only pages that are actually read get faulted in.
+class MappedFileStream : public TagLib::IOStream {
+public:
+    explicit MappedFileStream(const QString& filePath);
+    ~MappedFileStream() override;
+
+    const uchar* data() const { return m_data; }
+    qint64 size() const { return m_size; }
+
+    TagLib::FileName name() const override;
+    TagLib::ByteVector readBlock(TagLibSize length) override;
+    void writeBlock(const TagLib::ByteVector& data) override;
+    void insert(const TagLib::ByteVector& data, TagLibOffset start = 0, TagLibSize replace = 0) override;
+    void removeBlock(TagLibOffset start = 0, TagLibSize length = 0) override;
+    bool readOnly() const override { return true; }
+    bool isOpen() const override { return m_data != nullptr; }
+    void seek(TagLibOffset offset, Position p = Beginning) override;
+    void clear() override {}
+    TagLibOffset tell() const override { return TagLibOffset(m_pos); }
+    TagLibOffset length() override { return TagLibOffset(m_size); }
+    void truncate(TagLibOffset length) override;
+
+private:
+    QFile m_file;
+    QByteArray m_name;
+    uchar* m_data {nullptr};
+    qint64 m_size {0};
+    qint64 m_pos {0};
+};
@@ -1,5 +1,8 @@
 #include "MetadataReader.h"
 #include "TrackMetadata.h"
+#include "Telemetry.h"
+#include "FastTagReader.h"
+#include "MappedFileStream.h"
 
 #include <taglib/tag.h>
 #include <taglib/fileref.h>
@@ -11,10 +14,17 @@
 #include <taglib/opusfile.h>
 #include <taglib/mp4file.h>
 #include <taglib/mpegfile.h>
+#include <taglib/wavfile.h>
+#include <taglib/aifffile.h>
+#include <taglib/wavpackfile.h>
+#include <taglib/apefile.h>
+#include <taglib/apetag.h>
+#include <taglib/xiphcomment.h>
 #include <taglib/flacpicture.h>
 #include <taglib/id3v2tag.h>
 #include <taglib/attachedpictureframe.h>
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QImage>
 
 MetadataReader::MetadataReader(QObject* parent)
@@ -22,13 +32,13 @@ MetadataReader::MetadataReader(QObject* parent)
 {
 }
 
-TrackMetadata* MetadataReader::readMetadataStandalone(const QUrl& url, QObject* parent)
+TrackMetadata* MetadataReader::readMetadataStandalone(const QUrl& url, QObject* parent, ReadMode mode)
 {
     if (!url.isValid() || url.isEmpty() || !url.isLocalFile()) {
         return nullptr;
     }
     
-    return readFromTagLib(url.toLocalFile(), parent);
+    return readFromTagLib(url.toLocalFile(), parent, mode);
 }
 
 TrackMetadata* MetadataReader::readMetadata(const QUrl& url)
@@ -46,38 +56,53 @@ bool MetadataReader::hasMetadata(const QUrl& url)
     return hasData;
 }
 
-TrackMetadata* MetadataReader::readFromTagLib(const QString& filePath, QObject* parent)
+TrackMetadata* MetadataReader::readFromTagLib(const QString& filePath, QObject* parent, ReadMode mode)
 {
     TrackMetadata* metadata = new TrackMetadata(parent);
+    QElapsedTimer timer;
+    timer.start();
     
-    // Convert QString to TagLib::FileName (UTF-8 encoded)
-    TagLib::FileName fileName(filePath.toUtf8().constData());
-    
-    // Try format-specific readers first for better compatibility
-    TagLib::File* file = nullptr;
-    
-    if (filePath.endsWith(".flac", Qt::CaseInsensitive)) {
-        file = new TagLib::FLAC::File(fileName);
-    } else if (filePath.endsWith(".opus", Qt::CaseInsensitive)) {
-        file = new TagLib::Ogg::Opus::File(fileName);
-    } else if (filePath.endsWith(".ogg", Qt::CaseInsensitive)) {
-        file = new TagLib::Ogg::Vorbis::File(fileName);
-    } else if (filePath.endsWith(".mp4", Qt::CaseInsensitive) || 
-               filePath.endsWith(".m4a", Qt::CaseInsensitive)) {
-        file = new TagLib::MP4::File(fileName);
-    } else if (filePath.endsWith(".mp3", Qt::CaseInsensitive)) {
-        file = new TagLib::MPEG::File(fileName);
-    } else {
-        // Fallback to generic FileRef
-        TagLib::FileRef fileRef(fileName);
+    // One mapping serves the sniffer, the fast parsers and TagLib; nothing is opened twice
+    MappedFileStream stream(filePath);
+    if (!stream.isOpen()) {
+        qWarning() << "Cannot open:" << filePath;
+        return metadata;
+    }
+    
+    const AudioFormat format = FormatSniffer::sniff(stream.data(), stream.size());
+    
+    // Scan mode: header-only parsers, no TagLib objects at all.
+    // TagLib has no reader for raw ADTS or Matroska, so those always take this path.
+    const bool fastOnly = format == AudioFormat::Aac || format == AudioFormat::Matroska;
+    if (FastTagReader::supports(format) && (mode == ReadMode::Fast || fastOnly)) {
+        FastTags tags;
+        if (FastTagReader::parse(format, stream.data(), stream.size(), tags) || fastOnly) {
+            extractFromFastTags(tags, metadata);
+            Telemetry::instance()->recordMetadataRead(format, quint64(timer.nsecsElapsed() / 1000), 0);
+            return metadata;
+        }
+    }
+    
+    // Fast style reads audio properties from headers only (no MPEG frame scanning)
+    const auto readStyle = mode == ReadMode::Fast ? TagLib::AudioProperties::Fast
+                                                  : TagLib::AudioProperties::Average;
+    
+    // Pick the format-specific reader from the sniffed content, not the extension
+    TagLib::File* file = createTagLibFile(&stream, format, true, readStyle);
+    if (!file) {
+        // Unrecognised content: let TagLib try its own detection on the same stream
+        TagLib::FileRef fileRef(&stream, true, readStyle);
         if (fileRef.isNull()) {
             qDebug() << "FileRef is null for:" << filePath;
             return metadata;
         }
-        return extractFromGeneric(fileRef, metadata, filePath);
+        extractFromGeneric(fileRef, metadata, format, mode);
+        Telemetry::instance()->recordMetadataRead(format, quint64(timer.nsecsElapsed() / 1000),
+                                                  quint64(stream.size()));
+        return metadata;
     }
     
-    if (!file || !file->isValid()) {
+    if (!file->isValid()) {
         delete file;
         return metadata;
     }
@@ -86,8 +111,10 @@ TrackMetadata* MetadataReader::readFromTagLib(const QString& filePath, QObject*
     TagLib::PropertyMap properties = file->properties();
     extractFromProperties(properties, metadata);
     
-    // Extract cover art (format-specific)
-    extractCoverArt(file, filePath, metadata);
+    // Extract cover art (format-specific); scans never need it
+    if (mode == ReadMode::Full) {
+        extractCoverArt(file, format, metadata);
+    }
     
     // Get audio properties
     if (file->audioProperties()) {
@@ -96,9 +123,100 @@ TrackMetadata* MetadataReader::readFromTagLib(const QString& filePath, QObject*
     }
     
     delete file;
+    Telemetry::instance()->recordMetadataRead(format, quint64(timer.nsecsElapsed() / 1000), quint64(stream.size()));
     return metadata;
 }
 
+TagLib::File* MetadataReader::createTagLibFile(MappedFileStream* stream, AudioFormat format, bool readProperties,
+                                              TagLib::AudioProperties::ReadStyle readStyle)
+{
+    switch (format) {
+    case AudioFormat::Flac:
+#if TAGLIB_MAJOR_VERSION >= 2
+        return new TagLib::FLAC::File(stream, readProperties, readStyle);
+#else
+        return new TagLib::FLAC::File(stream, TagLib::ID3v2::FrameFactory::instance(), readProperties, readStyle);
+#endif
+    case AudioFormat::Mpeg:
+#if TAGLIB_MAJOR_VERSION >= 2
+        return new TagLib::MPEG::File(stream, readProperties, readStyle);
+#else
+        return new TagLib::MPEG::File(stream, TagLib::ID3v2::FrameFactory::instance(), readProperties, readStyle);
+#endif
+    case AudioFormat::OggOpus:
+        return new TagLib::Ogg::Opus::File(stream, readProperties, readStyle);
+    case AudioFormat::OggVorbis:
+        return new TagLib::Ogg::Vorbis::File(stream, readProperties, readStyle);
+    case AudioFormat::OggFlac:
+        return new TagLib::Ogg::FLAC::File(stream, readProperties, readStyle);
+    case AudioFormat::Mp4:
+        return new TagLib::MP4::File(stream, readProperties, readStyle);
+    case AudioFormat::Wav:
+        return new TagLib::RIFF::WAV::File(stream, readProperties, readStyle);
+    case AudioFormat::Aiff:
+        return new TagLib::RIFF::AIFF::File(stream, readProperties, readStyle);
+    case AudioFormat::WavPack:
+        return new TagLib::WavPack::File(stream, readProperties, readStyle);
+    case AudioFormat::Ape:
+        return new TagLib::APE::File(stream, readProperties, readStyle);
+    default:
+        return nullptr;
+    }
+}
+
+QImage MetadataReader::readCoverArt(const QUrl& url)
+{
+    if (!url.isLocalFile()) return QImage();
+    
+    MappedFileStream stream(url.toLocalFile());
+    if (!stream.isOpen()) return QImage();
+    
+    const AudioFormat format = FormatSniffer::sniff(stream.data(), stream.size());
+    TagLib::File* file = createTagLibFile(&stream, format, false, TagLib::AudioProperties::Fast);
+    if (!file) return QImage();
+    
+    QImage image;
+    if (file->isValid()) {
+        QElapsedTimer decodeTimer;
+        decodeTimer.start();
+        image = coverArtFromFile(file, format);
+        if (!image.isNull()) {
+            Telemetry::instance()->coverDecode().record(quint64(decodeTimer.nsecsElapsed() / 1000));
+        }
+    }
+    delete file;
+    return image;
+}
+
+void MetadataReader::extractFromFastTags(const FastTags& tags, TrackMetadata* metadata)
+{
+    metadata->m_title = tags.title.isEmpty() ? "Unknown Title" : tags.title;
+    
+    QString artist = tags.artist;
+    if (artist.isEmpty()) artist = tags.albumArtist;
+    if (artist.isEmpty()) artist = tags.performer;
+    metadata->m_artist = artist.isEmpty() ? "Unknown Artist" : artist;
+    
+    metadata->m_album = tags.album;
+    metadata->m_genre = tags.genre;
+    metadata->m_year = yearFromDate(tags.date);
+    metadata->m_trackNumber = parseTrackNumber(tags.trackNumber);
+    metadata->m_duration = tags.durationMs;
+}
+
+QString MetadataReader::yearFromDate(const QString& date)
+{
+    // "YYYY-MM-DD" or just "YYYY"
+    return date.length() >= 4 ? date.left(4) : QString();
+}
+
+int MetadataReader::parseTrackNumber(const QString& track)
+{
+    // Handle "3/12" format
+    const int slashPos = track.indexOf('/');
+    return slashPos > 0 ? track.left(slashPos).toInt() : track.toInt();
+}
+
 void MetadataReader::extractFromProperties(const TagLib::PropertyMap& properties, TrackMetadata* metadata)
 {
     // Extract title
@@ -135,7 +253,7 @@ void MetadataReader::extractFromProperties(const TagLib::PropertyMap& properties
         QString dateStr = tagLibStringToQString(properties["DATE"].front());
         // Extract year from date string (YYYY-MM-DD or just YYYY)
         if (dateStr.length() >= 4) {
-            metadata->m_year = dateStr.left(4);
+            metadata->m_year = yearFromDate(dateStr);
         }
     } else if (properties.contains("YEAR")) {
         metadata->m_year = tagLibStringToQString(properties["YEAR"].front());
@@ -143,64 +261,60 @@ void MetadataReader::extractFromProperties(const TagLib::PropertyMap& properties
     
     // Extract track number
     if (properties.contains("TRACKNUMBER")) {
-        QString trackStr = tagLibStringToQString(properties["TRACKNUMBER"].front());
-        // Handle "3/12" format
-        int slashPos = trackStr.indexOf('/');
-        if (slashPos > 0) {
-            metadata->m_trackNumber = trackStr.left(slashPos).toInt();
-        } else {
-            metadata->m_trackNumber = trackStr.toInt();
-        }
+        metadata->m_trackNumber = parseTrackNumber(tagLibStringToQString(properties["TRACKNUMBER"].front()));
     }
 }
 
-void MetadataReader::extractCoverArt(TagLib::File* file, const QString& filePath, TrackMetadata* metadata)
+void MetadataReader::extractCoverArt(TagLib::File* file, AudioFormat format, TrackMetadata* metadata)
 {
     if (!file || !metadata) return;
     
+    QElapsedTimer decodeTimer;
+    decodeTimer.start();
+    const QImage coverImage = coverArtFromFile(file, format);
+    
+    // Set the cover art if found
+    if (!coverImage.isNull()) {
+        metadata->m_coverArt = coverImage;
+        Telemetry::instance()->coverDecode().record(quint64(decodeTimer.nsecsElapsed() / 1000));
+    }
+}
+
+QImage MetadataReader::coverArtFromFile(TagLib::File* file, AudioFormat format)
+{
     QImage coverImage;
     
+    switch (format) {
     // FLAC files
-    if (filePath.endsWith(".flac", Qt::CaseInsensitive)) {
+    case AudioFormat::Flac: {
         TagLib::FLAC::File* flacFile = static_cast<TagLib::FLAC::File*>(file);
-        if (flacFile && !flacFile->pictureList().isEmpty()) {
-            const TagLib::List<TagLib::FLAC::Picture*>& pictures = flacFile->pictureList();
-            for (auto it = pictures.begin(); it != pictures.end(); ++it) {
-                TagLib::FLAC::Picture* picture = *it;
-                if (picture && picture->type() == TagLib::FLAC::Picture::FrontCover) {
-                    coverImage = QImage::fromData(
-                        reinterpret_cast<const uchar*>(picture->data().data()),
-                        picture->data().size()
-                    );
-                    if (!coverImage.isNull()) break;
-                }
-            }
-        }
+        coverImage = imageFromPictures(flacFile->pictureList());
+        break;
     }
-    // MP3 files with ID3v2 tags
-    else if (filePath.endsWith(".mp3", Qt::CaseInsensitive)) {
-        TagLib::MPEG::File* mpegFile = static_cast<TagLib::MPEG::File*>(file);
-        if (mpegFile && mpegFile->ID3v2Tag()) {
-            TagLib::ID3v2::Tag* tag = mpegFile->ID3v2Tag();
-            TagLib::ID3v2::FrameList frames = tag->frameList("APIC");
-            for (auto it = frames.begin(); it != frames.end(); ++it) {
-                TagLib::ID3v2::AttachedPictureFrame* frame = 
-                    static_cast<TagLib::ID3v2::AttachedPictureFrame*>(*it);
-                if (frame) {
-                    coverImage = QImage::fromData(
-                        reinterpret_cast<const uchar*>(frame->picture().data()),
-                        frame->picture().size()
-                    );
-                    if (!coverImage.isNull()) break;
-                }
-            }
+    // Ogg containers keep METADATA_BLOCK_PICTURE in the Xiph comment
+    case AudioFormat::OggVorbis:
+    case AudioFormat::OggOpus:
+    case AudioFormat::OggFlac: {
+        auto* xiph = dynamic_cast<TagLib::Ogg::XiphComment*>(file->tag());
+        if (xiph) {
+            coverImage = imageFromPictures(xiph->pictureList());
         }
+        break;
     }
+    // ID3v2 APIC frames: MP3, and the id3 chunk of WAV/AIFF
+    case AudioFormat::Mpeg:
+        coverImage = imageFromId3v2(static_cast<TagLib::MPEG::File*>(file)->ID3v2Tag());
+        break;
+    case AudioFormat::Wav:
+        coverImage = imageFromId3v2(static_cast<TagLib::RIFF::WAV::File*>(file)->ID3v2Tag());
+        break;
+    case AudioFormat::Aiff:
+        coverImage = imageFromId3v2(static_cast<TagLib::RIFF::AIFF::File*>(file)->tag());
+        break;
     // MP4/M4A files
-    else if (filePath.endsWith(".mp4", Qt::CaseInsensitive) || 
-             filePath.endsWith(".m4a", Qt::CaseInsensitive)) {
+    case AudioFormat::Mp4: {
         TagLib::MP4::File* mp4File = static_cast<TagLib::MP4::File*>(file);
-        if (mp4File && mp4File->tag()) {
+        if (mp4File->tag()) {
             TagLib::MP4::Tag* tag = mp4File->tag();
             if (tag->itemMap().contains("covr")) {
                 TagLib::MP4::Item coverItem = tag->itemMap()["covr"];
@@ -214,21 +328,77 @@ void MetadataReader::extractCoverArt(TagLib::File* file, const QString& filePath
                 }
             }
         }
+        break;
+    }
+    // APEv2 binary item: "<description>\0<image data>"
+    case AudioFormat::WavPack:
+        coverImage = imageFromApe(static_cast<TagLib::WavPack::File*>(file)->APETag());
+        break;
+    case AudioFormat::Ape:
+        coverImage = imageFromApe(static_cast<TagLib::APE::File*>(file)->APETag());
+        break;
+    default:
+        break;
+    }
+    
+    return coverImage;
+}
+
+QImage MetadataReader::imageFromPictures(const TagLib::List<TagLib::FLAC::Picture*>& pictures)
+{
+    for (auto it = pictures.begin(); it != pictures.end(); ++it) {
+        TagLib::FLAC::Picture* picture = *it;
+        if (picture && picture->type() == TagLib::FLAC::Picture::FrontCover) {
+            QImage image = QImage::fromData(
+                reinterpret_cast<const uchar*>(picture->data().data()),
+                picture->data().size()
+            );
+            if (!image.isNull()) return image;
+        }
     }
+    return QImage();
+}
+
+QImage MetadataReader::imageFromId3v2(TagLib::ID3v2::Tag* tag)
+{
+    if (!tag) return QImage();
     
-    // Set the cover art if found
-    if (!coverImage.isNull()) {
-        metadata->m_coverArt = coverImage;
+    TagLib::ID3v2::FrameList frames = tag->frameList("APIC");
+    for (auto it = frames.begin(); it != frames.end(); ++it) {
+        TagLib::ID3v2::AttachedPictureFrame* frame = 
+            static_cast<TagLib::ID3v2::AttachedPictureFrame*>(*it);
+        if (frame) {
+            QImage image = QImage::fromData(
+                reinterpret_cast<const uchar*>(frame->picture().data()),
+                frame->picture().size()
+            );
+            if (!image.isNull()) return image;
+        }
     }
+    return QImage();
 }
 
-TrackMetadata* MetadataReader::extractFromGeneric(TagLib::FileRef& fileRef, TrackMetadata* metadata, const QString& filePath)
+QImage MetadataReader::imageFromApe(TagLib::APE::Tag* tag)
+{
+    if (!tag || !tag->itemListMap().contains("COVER ART (FRONT)")) return QImage();
+    
+    const TagLib::ByteVector data = tag->itemListMap()["COVER ART (FRONT)"].binaryData();
+    const int nul = data.find(TagLib::ByteVector(1, '\0'));
+    if (nul < 0) return QImage();
+    
+    return QImage::fromData(reinterpret_cast<const uchar*>(data.data()) + nul + 1,
+                            int(data.size()) - nul - 1);
+}
+
+TrackMetadata* MetadataReader::extractFromGeneric(TagLib::FileRef& fileRef, TrackMetadata* metadata, AudioFormat format, ReadMode mode)
 {
     TagLib::PropertyMap properties = fileRef.file()->properties();
     extractFromProperties(properties, metadata);
     
     // Try to extract cover art from generic file if possible
-    extractCoverArt(fileRef.file(), filePath, metadata);
+    if (mode == ReadMode::Full) {
+        extractCoverArt(fileRef.file(), format, metadata);
+    }
     
     if (fileRef.audioProperties()) {
         TagLib::AudioProperties* props = fileRef.audioProperties();
@@ -5,8 +5,19 @@
 #include <QString>
 #include <taglib/tag.h>
 #include <taglib/fileref.h>
+#include <taglib/flacpicture.h>
 
+#include "FormatSniffer.h"
+
+class QImage;
 class TrackMetadata;
+class MappedFileStream;
+struct FastTags;
+
+namespace TagLib {
+namespace ID3v2 { class Tag; }
+namespace APE { class Tag; }
+}
 
 class MetadataReader : public QObject {
     Q_OBJECT
@@ -14,17 +25,33 @@ class MetadataReader : public QObject {
 public:
     explicit MetadataReader(QObject* parent = nullptr);
     
+    // Full: tags, cover art and accurate audio properties (now playing).
+    // Fast: scan mode - header-only parsing, no cover art, no frame scanning.
+    enum class ReadMode { Full, Fast };
+    
     // Static method for standalone metadata reading (perfect for collection browser)
-    static TrackMetadata* readMetadataStandalone(const QUrl& url, QObject* parent = nullptr);
+    static TrackMetadata* readMetadataStandalone(const QUrl& url, QObject* parent = nullptr, ReadMode mode = ReadMode::Full);
+    
+    // Front cover only, without reading tags or audio properties (thumbnails)
+    static QImage readCoverArt(const QUrl& url);
     
     // Instance methods
     Q_INVOKABLE TrackMetadata* readMetadata(const QUrl& url);
     Q_INVOKABLE bool hasMetadata(const QUrl& url);
 
 private:
-    static TrackMetadata* readFromTagLib(const QString& filePath, QObject* parent);
+    static TrackMetadata* readFromTagLib(const QString& filePath, QObject* parent, ReadMode mode);
     static QString tagLibStringToQString(const TagLib::String& str);
     static void extractFromProperties(const TagLib::PropertyMap& properties, TrackMetadata* metadata);
-    static void extractCoverArt(TagLib::File* file, const QString& filePath, TrackMetadata* metadata);
-    static TrackMetadata* extractFromGeneric(TagLib::FileRef& fileRef, TrackMetadata* metadata, const QString& filePath);
+    static void extractFromFastTags(const FastTags& tags, TrackMetadata* metadata);
+    static TagLib::File* createTagLibFile(MappedFileStream* stream, AudioFormat format, bool readProperties,
+                                          TagLib::AudioProperties::ReadStyle readStyle);
+    static void extractCoverArt(TagLib::File* file, AudioFormat format, TrackMetadata* metadata);
+    static QImage coverArtFromFile(TagLib::File* file, AudioFormat format);
+    static QImage imageFromPictures(const TagLib::List<TagLib::FLAC::Picture*>& pictures);
+    static QImage imageFromId3v2(TagLib::ID3v2::Tag* tag);
+    static QImage imageFromApe(TagLib::APE::Tag* tag);
+    static TrackMetadata* extractFromGeneric(TagLib::FileRef& fileRef, TrackMetadata* metadata, AudioFormat format, ReadMode mode);
+    static QString yearFromDate(const QString& date);
+    static int parseTrackNumber(const QString& track);
 };
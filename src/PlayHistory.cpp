@@ -0,0 +1,531 @@
+#include "PlayHistory.h"
+#include "LibraryIndex.h"
+
+#include <QDataStream>
+#include <QDate>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Stored in native byte order, like the session files
+constexpr quint32 SnapshotMagic = 0x5348504d; // "MPHS"
+constexpr quint32 TracksMagic = 0x5448504d;   // "MPHT"
+constexpr quint32 LogMagic = 0x4c48504d;      // "MPHL"
+constexpr quint32 EventMagic = 0x4548504d;    // "MPHE"
+constexpr quint32 FormatVersion = 1;
+
+constexpr int FlushMs = 2000;
+// Or sooner, once this many events are waiting (96 KiB)
+constexpr int FlushRecords = 4096;
+// Fold the log into history.dat once it holds this many events (1.5 MiB)
+constexpr int CompactRecords = 65536;
+constexpr int RecentLimit = 200;
+// A long track counts as played after this much, even short of half of it
+constexpr qint64 FullPlayMs = 4 * 60 * 1000;
+
+enum EventFlag : quint32 {
+    Played = 1,
+    Skipped = 2,
+    Loved = 4,
+    Unloved = 8
+};
+
+struct FileHeader {
+    quint32 magic;
+    quint32 version;
+    quint64 generation;
+};
+static_assert(sizeof(FileHeader) == 16, "history headers are fixed-size");
+
+struct EventRecord {
+    quint32 magic;
+    quint32 track;
+    qint64 timeMs; // since the epoch
+    quint32 playedMs;
+    quint32 flags;
+};
+static_assert(sizeof(EventRecord) == 24, "history records are fixed-size");
+
+QByteArray header(quint32 magic, quint64 generation)
+{
+    const FileHeader h {magic, FormatVersion, generation};
+    return QByteArray(reinterpret_cast<const char*>(&h), sizeof(h));
+}
+
+bool validHeader(const QByteArray& data, quint32 magic, quint64 generation)
+{
+    if (data.size() < qsizetype(sizeof(FileHeader))) return false;
+    FileHeader h;
+    std::memcpy(&h, data.constData(), sizeof(h));
+    return h.magic == magic && h.version == FormatVersion && h.generation == generation;
+}
+
+QString locationOf(const QUrl& source)
+{
+    return source.isLocalFile() ? source.toLocalFile() : source.toString();
+}
+
+qint64 monthStart(const QDate& date)
+{
+    return QDate(date.year(), date.month(), 1).startOfDay().toMSecsSinceEpoch();
+}
+
+QByteArray readFile(const QString& path)
+{
+    QFile file(path);
+    return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+}
+
+void writeFile(const QString& path, const QByteArray& data)
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit())
+        qWarning() << "Failed to write history file:" << path << file.errorString();
+}
+
+// Appends and waits for the data to reach the disk
+void appendFile(const QString& path, const QByteArray& data)
+{
+    if (data.isEmpty()) return;
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append) || file.write(data) != data.size() || !file.flush()) {
+        qWarning() << "Failed to append to history file:" << path << file.errorString();
+        return;
+    }
+#ifdef Q_OS_WIN
+    _commit(file.handle());
+#else
+    ::fsync(file.handle());
+#endif
+}
+
+} // namespace
+
+PlayHistory::PlayHistory(LibraryIndex* library, const QString& directory, QObject* parent)
+    : QObject(parent)
+    , m_library(library)
+    , m_directory(directory)
+{
+    m_writer.setMaxThreadCount(1);
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(FlushMs);
+    connect(&m_flushTimer, &QTimer::timeout, this, &PlayHistory::writePending);
+
+    const QDate today = QDate::currentDate();
+    m_monthStartMs = monthStart(today);
+    m_nextMonthStartMs = monthStart(today.addMonths(1));
+}
+
+PlayHistory::~PlayHistory()
+{
+    flush();
+}
+
+void PlayHistory::load()
+{
+    QDir().mkpath(m_directory);
+    m_tracks.clear();
+    m_byLocation.clear();
+    m_monthTracks.clear();
+    m_recent.clear();
+    m_monthPlays = m_monthSkips = 0;
+    m_logRecords = 0;
+
+    if (!loadSnapshot()) {
+        m_tracks.clear();
+        m_byLocation.clear();
+        m_monthTracks.clear();
+        m_monthPlays = m_monthSkips = 0;
+        m_generation = 0;
+    }
+    loadTracks();
+    loadLog();
+
+    std::vector<int> played;
+    for (int track = 0; track < int(m_tracks.size()); ++track) {
+        if (m_tracks[track].lastPlayedMs > 0)
+            played.push_back(track);
+    }
+    const auto latest = played.begin() + qMin<qsizetype>(RecentLimit, qsizetype(played.size()));
+    std::partial_sort(played.begin(), latest, played.end(), [this](int a, int b) {
+        return m_tracks[a].lastPlayedMs > m_tracks[b].lastPlayedMs;
+    });
+    m_recent.assign(played.begin(), latest);
+
+    if (m_logRecords >= CompactRecords)
+        compact();
+    ++m_revision;
+    emit changed();
+}
+
+void PlayHistory::flush()
+{
+    writePending();
+    m_writer.waitForDone();
+}
+
+void PlayHistory::recordPlay(const QUrl& source, qint64 playedMs, qint64 durationMs)
+{
+    if (source.isEmpty()) return;
+    rollMonth();
+    const qint64 needed = durationMs > 0 ? qMin(durationMs / 2, FullPlayMs) : FullPlayMs;
+    const quint32 flags = playedMs >= needed ? Played : Skipped;
+    const int track = trackId(locationOf(source));
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    // Applied first: the append can fill a batch and compact, and the snapshot must include it
+    apply(track, now, flags);
+    append(track, now, playedMs, flags);
+    if (flags == Played)
+        touchRecent(track);
+    ++m_revision;
+    emit changed();
+}
+
+void PlayHistory::setLoved(const QUrl& source, bool loved)
+{
+    if (source.isEmpty() || isLoved(source) == loved) return;
+    const int track = trackId(locationOf(source));
+    const quint32 flags = loved ? Loved : Unloved;
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    apply(track, now, flags);
+    append(track, now, 0, flags);
+    ++m_revision;
+    emit changed();
+}
+
+QVariantList PlayHistory::recentlyPlayed(int count) const
+{
+    QVariantList result;
+    for (int i = 0; i < qMin(count, int(m_recent.size())); ++i)
+        result.append(entry(m_recent[i]));
+    return result;
+}
+
+QVariantList PlayHistory::mostPlayed(int count) const
+{
+    // Counts that belong to a month gone by until the next event rolls them over
+    if (monthIsOver()) return {};
+
+    std::vector<int> played;
+    played.reserve(m_monthTracks.size());
+    for (int track : m_monthTracks) {
+        if (m_tracks[track].monthPlays > 0)
+            played.push_back(track);
+    }
+    const auto top = played.begin() + qMin<qsizetype>(qMax(count, 0), qsizetype(played.size()));
+    std::partial_sort(played.begin(), top, played.end(), [this](int a, int b) {
+        const Track& ta = m_tracks[a];
+        const Track& tb = m_tracks[b];
+        if (ta.monthPlays != tb.monthPlays)
+            return ta.monthPlays > tb.monthPlays;
+        return ta.lastPlayedMs > tb.lastPlayedMs;
+    });
+
+    QVariantList result;
+    for (auto it = played.begin(); it != top; ++it)
+        result.append(entry(*it));
+    return result;
+}
+
+int PlayHistory::playCount(const QUrl& source) const
+{
+    const int track = findTrack(source);
+    return track >= 0 ? int(m_tracks[track].plays) : 0;
+}
+
+double PlayHistory::trackSkipRate(const QUrl& source) const
+{
+    const int track = findTrack(source);
+    if (track < 0) return 0.0;
+    const Track& t = m_tracks[track];
+    return t.plays + t.skips > 0 ? double(t.skips) / double(t.plays + t.skips) : 0.0;
+}
+
+bool PlayHistory::isLoved(const QUrl& source) const
+{
+    const int track = findTrack(source);
+    return track >= 0 && m_tracks[track].loved;
+}
+
+double PlayHistory::skipRate() const
+{
+    if (monthIsOver()) return 0.0;
+    const quint32 total = m_monthPlays + m_monthSkips;
+    return total > 0 ? double(m_monthSkips) / double(total) : 0.0;
+}
+
+int PlayHistory::addTrack(const QString& location)
+{
+    // Ids are positions in the files, so a repeated location still takes one
+    const int track = int(m_tracks.size());
+    Track t;
+    t.location = location;
+    m_tracks.push_back(t);
+    if (!m_byLocation.contains(location))
+        m_byLocation.insert(location, track);
+    return track;
+}
+
+int PlayHistory::trackId(const QString& location)
+{
+    const auto it = m_byLocation.constFind(location);
+    if (it != m_byLocation.constEnd())
+        return it.value();
+
+    const int track = addTrack(location);
+    // Length in UTF-16 units, the data, then padding to keep entries 4-byte aligned
+    const quint32 length = quint32(location.size());
+    m_pendingTracks.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    m_pendingTracks.append(reinterpret_cast<const char*>(location.utf16()), qsizetype(length) * 2);
+    if (length & 1)
+        m_pendingTracks.append(2, '\0');
+    return track;
+}
+
+int PlayHistory::findTrack(const QUrl& source) const
+{
+    return m_byLocation.value(locationOf(source), -1);
+}
+
+void PlayHistory::apply(int track, qint64 timeMs, quint32 flags)
+{
+    Track& t = m_tracks[track];
+    if (flags & Loved)
+        t.loved = true;
+    if (flags & Unloved)
+        t.loved = false;
+    if (!(flags & (Played | Skipped))) return;
+
+    const bool thisMonth = timeMs >= m_monthStartMs && timeMs < m_nextMonthStartMs;
+    if (thisMonth && t.monthPlays == 0 && t.monthSkips == 0)
+        m_monthTracks.push_back(track);
+    if (flags & Played) {
+        ++t.plays;
+        t.lastPlayedMs = qMax(t.lastPlayedMs, timeMs);
+        if (thisMonth) {
+            ++t.monthPlays;
+            ++m_monthPlays;
+        }
+    } else {
+        ++t.skips;
+        if (thisMonth) {
+            ++t.monthSkips;
+            ++m_monthSkips;
+        }
+    }
+}
+
+void PlayHistory::append(int track, qint64 timeMs, qint64 playedMs, quint32 flags)
+{
+    const EventRecord record {EventMagic, quint32(track), timeMs,
+                              quint32(qBound<qint64>(0, playedMs, std::numeric_limits<quint32>::max())), flags};
+    m_pendingEvents.append(reinterpret_cast<const char*>(&record), sizeof(record));
+    ++m_logRecords;
+    if (m_pendingEvents.size() >= qsizetype(FlushRecords * sizeof(EventRecord)))
+        writePending();
+    else if (!m_flushTimer.isActive())
+        m_flushTimer.start();
+}
+
+void PlayHistory::touchRecent(int track)
+{
+    const auto it = std::find(m_recent.begin(), m_recent.end(), track);
+    if (it != m_recent.end())
+        m_recent.erase(it);
+    m_recent.insert(m_recent.begin(), track);
+    if (int(m_recent.size()) > RecentLimit)
+        m_recent.pop_back();
+}
+
+bool PlayHistory::monthIsOver() const
+{
+    return QDateTime::currentMSecsSinceEpoch() >= m_nextMonthStartMs;
+}
+
+void PlayHistory::rollMonth()
+{
+    if (!monthIsOver()) return;
+    for (int track : m_monthTracks) {
+        m_tracks[track].monthPlays = 0;
+        m_tracks[track].monthSkips = 0;
+    }
+    m_monthTracks.clear();
+    m_monthPlays = m_monthSkips = 0;
+    const QDate today = QDate::currentDate();
+    m_monthStartMs = monthStart(today);
+    m_nextMonthStartMs = monthStart(today.addMonths(1));
+}
+
+QVariantMap PlayHistory::entry(int track) const
+{
+    const Track& t = m_tracks[track];
+    const bool local = !t.location.contains(QLatin1String("://"));
+    QVariantMap map;
+    map.insert(QStringLiteral("url"), local ? QUrl::fromLocalFile(t.location) : QUrl(t.location));
+    const int row = m_library ? m_library->trackOf(t.location) : -1;
+    if (row >= 0) {
+        map.insert(QStringLiteral("primaryText"), m_library->item(row).primaryText);
+        map.insert(QStringLiteral("secondaryText"), m_library->item(row).secondaryText);
+    } else {
+        map.insert(QStringLiteral("primaryText"), local ? QFileInfo(t.location).fileName() : t.location);
+        map.insert(QStringLiteral("secondaryText"), QString());
+    }
+    map.insert(QStringLiteral("plays"), t.plays);
+    map.insert(QStringLiteral("monthPlays"), t.monthPlays);
+    map.insert(QStringLiteral("skipRate"), t.plays + t.skips > 0 ? double(t.skips) / double(t.plays + t.skips) : 0.0);
+    map.insert(QStringLiteral("loved"), t.loved);
+    return map;
+}
+
+void PlayHistory::writePending()
+{
+    m_flushTimer.stop();
+    if (!m_pendingTracks.isEmpty() || !m_pendingEvents.isEmpty()) {
+        // Locations first, so no event on disk refers to a track that isn't
+        m_writer.start([tracks = tracksPath(), log = logPath(), names = m_pendingTracks, events = m_pendingEvents] {
+            appendFile(tracks, names);
+            appendFile(log, events);
+        });
+        m_pendingTracks.clear();
+        m_pendingEvents.clear();
+    }
+    if (m_logRecords >= CompactRecords)
+        compact();
+}
+
+// Folds everything into history.dat; expects nothing pending
+void PlayHistory::compact()
+{
+    ++m_generation;
+    m_logRecords = 0;
+    m_writer.start([snapshot = snapshotPath(), data = serializeSnapshot(), tracks = tracksPath(), log = logPath(),
+                    generation = m_generation] {
+        writeFile(snapshot, data);
+        // Until these land they carry the previous generation and are ignored on load
+        writeFile(tracks, header(TracksMagic, generation));
+        writeFile(log, header(LogMagic, generation));
+    });
+}
+
+QByteArray PlayHistory::serializeSnapshot() const
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << SnapshotMagic << FormatVersion << m_generation << m_monthStartMs << quint32(m_tracks.size());
+    for (const Track& t : m_tracks)
+        out << t.location << t.plays << t.skips << t.monthPlays << t.monthSkips << t.lastPlayedMs << t.loved;
+    return data;
+}
+
+bool PlayHistory::loadSnapshot()
+{
+    QFile file(snapshotPath());
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0, version = 0, count = 0;
+    qint64 monthStartMs = 0;
+    in >> magic >> version >> m_generation >> monthStartMs >> count;
+    if (magic != SnapshotMagic || version != FormatVersion) {
+        qWarning() << "Discarding unreadable play history:" << snapshotPath();
+        return false;
+    }
+    // Counts of a month gone by start over
+    const bool sameMonth = monthStartMs == m_monthStartMs;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        Track t;
+        in >> t.location >> t.plays >> t.skips >> t.monthPlays >> t.monthSkips >> t.lastPlayedMs >> t.loved;
+        if (!sameMonth)
+            t.monthPlays = t.monthSkips = 0;
+        const int track = addTrack(t.location);
+        m_tracks[track] = t;
+        if (t.monthPlays || t.monthSkips)
+            m_monthTracks.push_back(track);
+        m_monthPlays += t.monthPlays;
+        m_monthSkips += t.monthSkips;
+    }
+    if (in.status() != QDataStream::Ok) {
+        qWarning() << "Discarding unreadable play history:" << snapshotPath();
+        return false;
+    }
+    return true;
+}
+
+void PlayHistory::loadTracks()
+{
+    const QString path = tracksPath();
+    const QByteArray data = readFile(path);
+    if (!validHeader(data, TracksMagic, m_generation)) {
+        // Missing, or superseded by history.dat
+        m_writer.start([path, data = header(TracksMagic, m_generation)] { writeFile(path, data); });
+        return;
+    }
+
+    qsizetype pos = sizeof(FileHeader);
+    while (pos + 4 <= data.size()) {
+        quint32 length = 0;
+        std::memcpy(&length, data.constData() + pos, sizeof(length));
+        const qsizetype bytes = qsizetype(length) * 2 + ((length & 1) ? 2 : 0);
+        if (bytes > data.size() - pos - 4) break;
+        addTrack(QString(reinterpret_cast<const QChar*>(data.constData() + pos + 4), qsizetype(length)));
+        pos += 4 + bytes;
+    }
+    // A torn entry from a crash mid-append
+    if (pos != data.size())
+        m_writer.start([path, pos] { QFile::resize(path, pos); });
+}
+
+void PlayHistory::loadLog()
+{
+    const QString path = logPath();
+    const QByteArray data = readFile(path);
+    if (!validHeader(data, LogMagic, m_generation)) {
+        m_writer.start([path, data = header(LogMagic, m_generation)] { writeFile(path, data); });
+        return;
+    }
+
+    qsizetype pos = sizeof(FileHeader);
+    while (pos + qsizetype(sizeof(EventRecord)) <= data.size()) {
+        EventRecord record;
+        std::memcpy(&record, data.constData() + pos, sizeof(record));
+        if (record.magic != EventMagic || record.track >= m_tracks.size()) break;
+        apply(int(record.track), record.timeMs, record.flags);
+        ++m_logRecords;
+        pos += sizeof(record);
+    }
+    if (pos != data.size())
+        m_writer.start([path, pos] { QFile::resize(path, pos); });
+}
+
+QString PlayHistory::snapshotPath() const
+{
+    return m_directory + QStringLiteral("/history.dat");
+}
+
+QString PlayHistory::tracksPath() const
+{
+    return m_directory + QStringLiteral("/history.tracks");
+}
+
+QString PlayHistory::logPath() const
+{
+    return m_directory + QStringLiteral("/history.log");
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+#include <QTimer>
+#include <QUrl>
+#include <QVariantList>
+#include <QVariantMap>
+
+#include <vector>
+
+class LibraryIndex;
+
+// What was played, when, and what was skipped, kept for good.
+//
+// On disk, in the history directory:
+//   history.dat    snapshot: per track its location, play and skip counts (lifetime and this
+//                  month), last play and loved flag, as of the last compaction
+//   history.tracks append-only locations of the tracks first seen since then
+//   history.log    append-only fixed-size event records since then
+//
+// Events are batched and written with an fsync at most every FlushMs, so a crash loses at
+// most that much. A torn record at the end of either file is cut off on load. Once the log
+// holds CompactRecords events it is folded into a new snapshot; the snapshot and the files it
+// supersedes carry a generation number, so a crash halfway through never counts a play twice.
+//
+// Every query is answered from aggregates kept up to date per event, never by reading the
+// log. GUI thread only.
+class PlayHistory : public QObject {
+    Q_OBJECT
+    // Bumped on every change, for QML bindings over the queries below
+    Q_PROPERTY(int revision READ revision NOTIFY changed)
+    // Skips over plays and skips this month, all tracks together
+    Q_PROPERTY(double skipRate READ skipRate NOTIFY changed)
+
+public:
+    // library names the tracks in query results; it may be null
+    PlayHistory(LibraryIndex* library, const QString& directory, QObject* parent = nullptr);
+    ~PlayHistory() override;
+
+    // Reads the history written by earlier runs
+    void load();
+    // Writes pending events and waits for the writer (call on quit)
+    void flush();
+
+    // A track stopped playing after playedMs of durationMs (0 when unknown). It counts as
+    // played after half of it or FullPlayMs, whichever is shorter, and as skipped otherwise.
+    void recordPlay(const QUrl& source, qint64 playedMs, qint64 durationMs);
+
+    // Maps of url, primaryText, secondaryText, plays and skipRate; the latest play first
+    Q_INVOKABLE QVariantList recentlyPlayed(int count = 50) const;
+    // The same maps, most plays this calendar month first
+    Q_INVOKABLE QVariantList mostPlayed(int count = 50) const;
+    // Lifetime counts
+    Q_INVOKABLE int playCount(const QUrl& source) const;
+    Q_INVOKABLE double trackSkipRate(const QUrl& source) const;
+    Q_INVOKABLE bool isLoved(const QUrl& source) const;
+    Q_INVOKABLE void setLoved(const QUrl& source, bool loved);
+
+    int revision() const { return m_revision; }
+    double skipRate() const;
+
+signals:
+    void changed();
+
+private:
+    struct Track {
+        QString location;
+        quint32 plays {0};
+        quint32 skips {0};
+        quint32 monthPlays {0};
+        quint32 monthSkips {0};
+        qint64 lastPlayedMs {0};
+        bool loved {false};
+    };
+
+    int addTrack(const QString& location);
+    // Adds the track, and queues its location for history.tracks, the first time it is seen
+    int trackId(const QString& location);
+    int findTrack(const QUrl& source) const;
+    void apply(int track, qint64 timeMs, quint32 flags);
+    void append(int track, qint64 timeMs, qint64 playedMs, quint32 flags);
+    void touchRecent(int track);
+    // Starts a new month's counts once the calendar has moved on
+    void rollMonth();
+    QVariantMap entry(int track) const;
+    bool monthIsOver() const;
+    void writePending();
+
+    bool loadSnapshot();
+    void loadTracks();
+    void loadLog();
+    void compact();
+    QByteArray serializeSnapshot() const;
+
+    QString snapshotPath() const;
+    QString tracksPath() const;
+    QString logPath() const;
+
+    LibraryIndex* m_library;
+    QString m_directory;
+
+    std::vector<Track> m_tracks;
+    QHash<QString, int> m_byLocation;
+    std::vector<int> m_monthTracks; // played or skipped this month
+    std::vector<int> m_recent;      // distinct, latest first, at most RecentLimit
+    qint64 m_monthStartMs {0};
+    qint64 m_nextMonthStartMs {0};
+    quint32 m_monthPlays {0};
+    quint32 m_monthSkips {0};
+    int m_revision {0};
+
+    quint64 m_generation {0}; // of history.dat; the other files must match it
+    int m_logRecords {0};
+    QByteArray m_pendingTracks;
+    QByteArray m_pendingEvents;
+    QTimer m_flushTimer;
+    // Single thread so writes land in the order they were issued
+    QThreadPool m_writer;
+};
@@ -0,0 +1,55 @@
+#include "PlaybackClock.h"
+
+// Reports further off than this are treated as a discontinuity rather than drift
+static constexpr qint64 ResyncThresholdUs = 150'000;
+// Fraction of the remaining error corrected per report
+static constexpr qint64 SlewDivisor = 4;
+
+void PlaybackClock::reset(qint64 positionMs)
+{
+    anchor(positionMs * 1000);
+    m_lastReadUs = m_anchorUs;
+}
+
+void PlaybackClock::update(qint64 reportedMs)
+{
+    const qint64 reportedUs = reportedMs * 1000;
+    if (!m_running) {
+        reset(reportedMs);
+        return;
+    }
+
+    const qint64 predictedUs = extrapolatedUs();
+    const qint64 errorUs = reportedUs - predictedUs;
+    if (qAbs(errorUs) > ResyncThresholdUs)
+        reset(reportedMs);
+    else
+        anchor(predictedUs + errorUs / SlewDivisor);
+}
+
+void PlaybackClock::setRunning(bool running)
+{
+    if (running == m_running) return;
+    // Freeze (or restart) from where readers currently see the clock
+    anchor(positionUs());
+    m_running = running;
+}
+
+qint64 PlaybackClock::positionUs() const
+{
+    m_lastReadUs = qMax(m_lastReadUs, extrapolatedUs());
+    return m_lastReadUs;
+}
+
+qint64 PlaybackClock::extrapolatedUs() const
+{
+    if (!m_running)
+        return m_anchorUs;
+    return m_anchorUs + (m_wall.nsecsElapsed() - m_anchorWallNs) / 1000;
+}
+
+void PlaybackClock::anchor(qint64 positionUs)
+{
+    m_anchorUs = qMax<qint64>(0, positionUs);
+    m_anchorWallNs = m_wall.nsecsElapsed();
+}
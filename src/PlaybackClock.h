@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QtGlobal>
+
+// Interpolated playback position for the current deck.
+// The backend reports positions in coarse, jittery ticks; between ticks the clock advances
+// on the monotonic system clock. Each report nudges the clock a fraction of the way towards
+// the reported position instead of snapping to it, so readers see a smooth, non-decreasing
+// position while playing. Larger disagreements (seeks, stalls) re-anchor immediately.
+// GUI thread only.
+class PlaybackClock {
+public:
+    PlaybackClock() { m_wall.start(); }
+
+    // Discontinuity (new source, seek): jump to positionMs
+    void reset(qint64 positionMs);
+    // Position reported by the backend
+    void update(qint64 reportedMs);
+    void setRunning(bool running);
+    bool running() const { return m_running; }
+
+    qint64 position() const { return positionUs() / 1000; }
+    qint64 positionUs() const;
+
+private:
+    qint64 extrapolatedUs() const;
+    void anchor(qint64 positionUs);
+
+    QElapsedTimer m_wall;
+    qint64 m_anchorUs {0};
+    qint64 m_anchorWallNs {0};
+    bool m_running {false};
+    // Last value handed out since the previous discontinuity; keeps reads non-decreasing
+    mutable qint64 m_lastReadUs {0};
+};
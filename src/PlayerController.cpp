@@ -2,33 +2,85 @@
 #include "MetadataReader.h"
 #include "TrackMetadata.h"
 #include "PlaylistModel.h"
+#include "ReadAheadDevice.h"
+#include "SeekIndex.h"
+#include "Telemetry.h"
 
+#include <QAudioBufferOutput>
 #include <QFileInfo>
 #include <QDebug>
+#include <QSettings>
+#include <QStandardPaths>
+
+#include <limits>
+#include <utility>
+
+// Switch decks this long before the end; the backend's own end-of-media is later than that
+static constexpr qint64 GaplessLeadMs = 30;
+// Rate of positionChanged while playing, for listeners that don't animate (session journal)
+static constexpr qint64 PositionSignalIntervalMs = 1000;
+// One backend seek per frame at most while the slider is dragged
+static constexpr int SeekCoalesceMs = 16;
+// Read-ahead fetched per seek while the slider is dragged; the full window follows once it settles
+static constexpr qint64 ScrubPrefetchBytes = 2 * 1024 * 1024;
+// Position reports further than this from a pending seek target predate the seek...
+static constexpr qint64 SeekLandingToleranceMs = 500;
+// ...unless the backend hasn't reported the target this long after the seek
+static constexpr qint64 SeekLandingTimeoutMs = 1000;
+// Fade-in on the new sink after an output device switch
+static constexpr int DeviceFadeMs = 20;
+static const char PreferredOutputKey[] = "audio/outputDevice";
 
 PlayerController::PlayerController(QObject* parent)
     : QObject(parent)
     , m_currentMetadata(nullptr)
 {
     setupDeck(m_a);
-    setupDeck(m_b);
 
     m_current = &m_a;
     m_next = &m_b;
 
-    connect(&m_devices, &QMediaDevices::audioOutputsChanged,
+    m_gaplessTimer.setSingleShot(true);
+    m_gaplessTimer.setTimerType(Qt::PreciseTimer);
+    connect(&m_gaplessTimer, &QTimer::timeout, this, &PlayerController::onGaplessTimer);
+    m_sincePositionSignal.start();
+
+    m_seekIndexer = new SeekIndexer(
+        QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/seekindex"), this);
+    m_seekTimer.setSingleShot(true);
+    m_seekTimer.setInterval(SeekCoalesceMs);
+    m_seekTimer.setTimerType(Qt::PreciseTimer);
+    connect(&m_seekTimer, &QTimer::timeout, this, &PlayerController::onSeekTimer);
+
+    m_deviceFade.setStartValue(0.0);
+    m_deviceFade.setEndValue(1.0);
+    m_deviceFade.setDuration(DeviceFadeMs);
+    connect(&m_deviceFade, &QVariantAnimation::valueChanged, this, [this](const QVariant& value) {
+        const float gain = m_volume * value.toFloat();
+        if (m_a.audio) m_a.audio->setVolume(gain);
+        if (m_b.audio) m_b.audio->setVolume(gain);
+    });
+}
+
+void PlayerController::initializeAudioDevices()
+{
+    if (m_devices) return;
+
+    m_devices = new QMediaDevices(this);
+    connect(m_devices, &QMediaDevices::audioOutputsChanged,
             this, &PlayerController::onAudioOutputsChanged);
 
+    m_preferredOutputId = QSettings().value(PreferredOutputKey).toByteArray();
     refreshOutputs();
+    m_outputDevice = m_current->audio->device();
+    migrateOutput(outputById(m_preferredOutputId));
     emit audioOutputsChanged();
-
-    selectDefaultOutputDevice();
 }
 
 void PlayerController::setupDeck(Deck& deck)
 {
     deck.audio = new QAudioOutput(this);
-    deck.audio->setVolume(0.8f);
+    deck.audio->setVolume(m_volume);
 
     deck.player = new QMediaPlayer(this);
     deck.player->setAudioOutput(deck.audio);
@@ -36,13 +88,94 @@ void PlayerController::setupDeck(Deck& deck)
     connect(deck.player, &QMediaPlayer::positionChanged, this, &PlayerController::onPositionChanged);
     connect(deck.player, &QMediaPlayer::durationChanged, this, &PlayerController::onDurationChanged);
     connect(deck.player, &QMediaPlayer::mediaStatusChanged, this, &PlayerController::onMediaStatusChanged);
+    connect(deck.player, &QMediaPlayer::mediaStatusChanged, this, [this, &deck](QMediaPlayer::MediaStatus status) {
+        if (status == QMediaPlayer::LoadedMedia || status == QMediaPlayer::InvalidMedia || status == QMediaPlayer::NoMedia)
+            releaseRetiredDevices(deck);
+    });
+    connect(deck.player, &QMediaPlayer::playbackStateChanged, this, &PlayerController::onPlaybackStateChanged);
     connect(deck.player, &QMediaPlayer::errorOccurred, this, &PlayerController::onPlayerErrorOccurred);
     connect(deck.player, &QMediaPlayer::metaDataChanged, this, &PlayerController::onMetaDataChanged);
+
+    if (m_tapFormat.isValid())
+        attachTap(deck);
+}
+
+void PlayerController::enableAudioTap(const QAudioFormat& format)
+{
+    if (m_tapFormat.isValid() || !format.isValid()) return;
+    m_tapFormat = format;
+    if (m_a.player) attachTap(m_a);
+    if (m_b.player) attachTap(m_b);
+}
+
+void PlayerController::attachTap(Deck& deck)
+{
+    deck.tap = new QAudioBufferOutput(m_tapFormat, this);
+    deck.player->setAudioBufferOutput(deck.tap);
+    // Only the deck being heard feeds the tap; the outgoing deck's tail is dropped at a switch
+    connect(deck.tap, &QAudioBufferOutput::audioBufferReceived, this, [this, &deck](const QAudioBuffer& buffer) {
+        if (&deck == m_current)
+            emit audioBufferReady(buffer);
+    });
+}
+
+void PlayerController::setDeckSource(Deck& deck, const QUrl& url)
+{
+    // Local files (including network mounts) go through a read-ahead window so filesystem
+    // hiccups drain the buffer instead of starving the decoder
+    ReadAheadDevice* previous = deck.device;
+    deck.device = nullptr;
+    if (url.isLocalFile()) {
+        auto* device = new ReadAheadDevice(url.toLocalFile(), qint64(m_readAheadMB) * 1024 * 1024, this);
+        if (device->open(QIODevice::ReadOnly)) {
+            deck.device = device;
+            deck.player->setSourceDevice(device, url);
+            // Index in the background now so the first seek already has it
+            m_seekIndexer->indexFor(url.toLocalFile());
+        } else {
+            delete device;
+            deck.player->setSource(url);
+        }
+    } else {
+        deck.player->setSource(url);
+    }
+
+    // The backend tears the old demuxer down on its own thread, so the old device stays
+    // open until the new source has settled
+    if (previous)
+        deck.retired.append(previous);
+}
+
+void PlayerController::releaseRetiredDevices(Deck& deck)
+{
+    for (ReadAheadDevice* device : std::as_const(deck.retired)) {
+        device->close();
+        device->deleteLater();
+    }
+    deck.retired.clear();
+}
+
+void PlayerController::setReadAheadMB(int megabytes)
+{
+    megabytes = qBound(2, megabytes, 256);
+    if (megabytes == m_readAheadMB) return;
+    m_readAheadMB = megabytes;
+    emit readAheadMBChanged();
+}
+
+void PlayerController::ensureNextDeck()
+{
+    if (m_next->player) return;
+
+    setupDeck(*m_next);
+    m_next->audio->setVolume(m_volume);
+    m_next->audio->setDevice(m_current->audio->device());
 }
 
 void PlayerController::openFile(const QUrl& url)
 {
     if (!m_current->player || !m_current->audio) return;
+    reportTrackEnd();
     
     // Clear current metadata
     if (m_currentMetadata) {
@@ -50,27 +183,62 @@ void PlayerController::openFile(const QUrl& url)
         m_currentMetadata = nullptr;
     }
     
+    m_pendingLatency = PendingLatency::Open;
+    m_latencyTimer.start();
+    m_deviceSwitchFrom = -1;
+    m_pendingSeek = 0;
+    cancelSeek();
+    
     m_current->audio->setMuted(false);
     m_current->player->setAudioOutput(m_current->audio);
-    m_current->player->setSource(url);
+    setDeckSource(*m_current, url);
+    m_clock.reset(0);
     
     // Use TagLib to read metadata immediately
     updateCurrentMetadataFromSource();
     
     m_current->player->play();
     m_gaplessArmed = false;
+    m_reportEnd = true;
+    emit playingChanged();
+    emit currentSourceChanged();
+}
+
+void PlayerController::cueFile(const QUrl& url, qint64 positionMs)
+{
+    if (!m_current->player || !m_current->audio) return;
+    reportTrackEnd();
+    
+    if (m_currentMetadata) {
+        m_currentMetadata->deleteLater();
+        m_currentMetadata = nullptr;
+    }
+    
+    m_pendingLatency = PendingLatency::None;
+    m_pendingSeek = positionMs;
+    m_deviceSwitchFrom = -1;
+    cancelSeek();
+    
+    m_current->player->setAudioOutput(m_current->audio);
+    setDeckSource(*m_current, url);
+    m_clock.reset(positionMs);
+    updateCurrentMetadataFromSource();
+    
+    m_current->player->pause();
+    m_gaplessArmed = false;
     emit playingChanged();
     emit currentSourceChanged();
 }
 
 void PlayerController::setNextFile(const QUrl& url)
 {
-    if (!m_next->player) return;
+    ensureNextDeck();
     
     m_next->source = url;
-    m_next->player->setSource(url);
+    setDeckSource(*m_next, url);
     m_next->player->pause();
     m_gaplessArmed = false;
+    scheduleGaplessSwitch();
 }
 
 void PlayerController::play()
@@ -81,6 +249,7 @@ void PlayerController::play()
     m_current->player->setAudioOutput(m_current->audio);
     m_current->player->play();
     m_gaplessArmed = false;
+    m_reportEnd = true;
     emit playingChanged();
 }
 
@@ -94,7 +263,62 @@ void PlayerController::pause()
 void PlayerController::seek(qint64 posMs)
 {
     if (!m_current->player) return;
-    m_current->player->setPosition(posMs);
+    // The clock (and so the slider) follows every request; the backend gets the latest one
+    m_clock.reset(posMs);
+    m_gaplessArmed = false;
+    m_seekTarget = posMs;
+    if (!m_seekTimer.isActive()) {
+        applySeek();
+        m_seekTimer.start();
+    }
+    emitPositionChanged();
+}
+
+void PlayerController::onSeekTimer()
+{
+    if (m_seekTarget < 0) {
+        // No new request for a whole interval: the drag has settled on the last target
+        if (m_settlePrefetch >= 0 && m_current->device)
+            m_current->device->prefetch(m_settlePrefetch);
+        m_settlePrefetch = -1;
+        return;
+    }
+    applySeek();
+    m_seekTimer.start();
+}
+
+void PlayerController::applySeek()
+{
+    qint64 target = m_seekTarget;
+    m_seekTarget = -1;
+
+    // Land on a frame boundary and have the read-ahead window fetching that frame before
+    // the demuxer asks for it. Only a few chunks until the drag settles, so each step doesn't
+    // ask the filesystem for a whole window the next step throws away.
+    const QUrl source = m_current->player->source();
+    if (source.isLocalFile()) {
+        if (const auto index = m_seekIndexer->indexFor(source.toLocalFile())) {
+            target = index->frameStartMs(target);
+            if (m_current->device) {
+                m_settlePrefetch = index->offsetFor(target);
+                m_current->device->prefetch(m_settlePrefetch, ScrubPrefetchBytes);
+            }
+        }
+    }
+
+    m_current->player->setPosition(target);
+    m_clock.reset(target);
+    m_seekLanding = target;
+    m_sinceSeek.start();
+    scheduleGaplessSwitch();
+}
+
+void PlayerController::cancelSeek()
+{
+    m_seekTimer.stop();
+    m_seekTarget = -1;
+    m_seekLanding = -1;
+    m_settlePrefetch = -1;
 }
 
 bool PlayerController::playing() const
@@ -104,7 +328,7 @@ bool PlayerController::playing() const
 
 qint64 PlayerController::position() const
 {
-    return m_current->player ? m_current->player->position() : 0;
+    return m_clock.position();
 }
 
 qint64 PlayerController::duration() const
@@ -114,11 +338,13 @@ qint64 PlayerController::duration() const
 
 float PlayerController::volume() const
 {
-    return m_current->audio ? m_current->audio->volume() : 0.0f;
+    return m_volume;
 }
 
 void PlayerController::setVolume(float v)
 {
+    m_deviceFade.stop();
+    m_volume = v;
     if (m_a.audio) m_a.audio->setVolume(v);
     if (m_b.audio) m_b.audio->setVolume(v);
     emit volumeChanged();
@@ -126,30 +352,110 @@ void PlayerController::setVolume(float v)
 
 void PlayerController::onPositionChanged()
 {
-    // Pre-switch just before end for tighter gapless behavior
-    const qint64 dur = m_current->player->duration();
+    if (sender() != m_current->player)
+        return;
+
     const qint64 pos = m_current->player->position();
-    if (dur > 0 && m_next->player->source().isValid() && !m_gaplessArmed) {
-        const qint64 remaining = dur - pos;
-        if (remaining <= 30) { // ~30ms window
-            m_gaplessArmed = true;
-            switchToNext();
+    if (m_pendingLatency != PendingLatency::None && pos > 0) {
+        auto* telemetry = Telemetry::instance();
+        LatencyHistogram& h = m_pendingLatency == PendingLatency::Open
+            ? telemetry->openToFirstAudio() : telemetry->trackTransitionGap();
+        h.record(quint64(m_latencyTimer.nsecsElapsed() / 1000));
+        m_pendingLatency = PendingLatency::None;
+    }
+    if (m_deviceSwitchFrom >= 0 && pos > m_deviceSwitchFrom) {
+        Telemetry::instance()->deviceSwitch().record(quint64(m_deviceSwitchTimer.nsecsElapsed() / 1000));
+        m_deviceSwitchFrom = -1;
+    }
+
+    // Until a seek has been carried out the backend keeps reporting where it was, and while
+    // a newer target is queued any report is out of date
+    if (m_seekTarget >= 0)
+        return;
+    if (m_seekLanding >= 0) {
+        if (qAbs(pos - m_seekLanding) > SeekLandingToleranceMs && m_sinceSeek.elapsed() < SeekLandingTimeoutMs)
             return;
-        }
+        m_seekLanding = -1;
     }
+
+    m_clock.update(pos);
+    scheduleGaplessSwitch();
+    if (m_sincePositionSignal.elapsed() >= PositionSignalIntervalMs)
+        emitPositionChanged();
+}
+
+void PlayerController::emitPositionChanged()
+{
+    m_sincePositionSignal.restart();
     emit positionChanged();
 }
 
 void PlayerController::onDurationChanged()
 {
+    if (sender() == m_current->player)
+        scheduleGaplessSwitch();
     emit durationChanged();
 }
 
+void PlayerController::onPlaybackStateChanged(QMediaPlayer::PlaybackState state)
+{
+    if (sender() != m_current->player)
+        return;
+
+    m_clock.setRunning(state == QMediaPlayer::PlayingState);
+    scheduleGaplessSwitch();
+    emitPositionChanged();
+}
+
+void PlayerController::scheduleGaplessSwitch()
+{
+    const bool armed = !m_gaplessArmed && playing() && m_next->player && m_next->player->source().isValid();
+    const qint64 dur = m_current->player ? m_current->player->duration() : 0;
+    if (!armed || dur <= 0) {
+        m_gaplessTimer.stop();
+        return;
+    }
+
+    const qint64 remaining = dur - GaplessLeadMs - m_clock.position();
+    m_gaplessTimer.start(int(qBound<qint64>(0, remaining, std::numeric_limits<int>::max())));
+}
+
+void PlayerController::onGaplessTimer()
+{
+    // The clock may have been corrected since the timer was armed
+    if (m_current->player->duration() - GaplessLeadMs - m_clock.position() > 1) {
+        scheduleGaplessSwitch();
+        return;
+    }
+    m_gaplessArmed = true;
+    switchToNext();
+}
+
 void PlayerController::onMediaStatusChanged(QMediaPlayer::MediaStatus status)
 {
     if (sender() != m_current->player)
         return;
 
+    if (status == QMediaPlayer::LoadedMedia && m_pendingSeek > 0) {
+        m_current->player->setPosition(m_pendingSeek);
+        m_clock.reset(m_pendingSeek);
+        m_pendingSeek = 0;
+        emitPositionChanged();
+        return;
+    }
+
+    if (status == QMediaPlayer::StalledMedia && playing()) {
+        Telemetry::instance()->recordBufferUnderrun();
+        // Don't run ahead of audio that isn't being produced
+        m_clock.setRunning(false);
+        return;
+    }
+
+    if (status == QMediaPlayer::BufferedMedia) {
+        m_clock.setRunning(playing());
+        return;
+    }
+
     if (status == QMediaPlayer::EndOfMedia) {
         // If no next track is armed, clear to empty state
         if (!m_next->player || m_next->player->source().isEmpty()) {
@@ -168,7 +474,14 @@ void PlayerController::switchToNext()
         return;
     }
     
+    reportTrackEnd();
     std::swap(m_current, m_next);
+    cancelSeek();
+    m_pendingLatency = PendingLatency::Transition;
+    m_latencyTimer.start();
+    m_deviceSwitchFrom = -1;
+    m_gaplessTimer.stop();
+    m_clock.reset(m_current->player->position());
     
     // Clear metadata for clean state
     if (m_currentMetadata) {
@@ -177,17 +490,20 @@ void PlayerController::switchToNext()
     
     m_current->player->play();
     m_gaplessArmed = false;
+    m_reportEnd = true;
     emit playingChanged();
     emit currentSourceChanged();
+    emitPositionChanged();
 }
 
 void PlayerController::clearCurrent()
 {
+    reportTrackEnd();
     // Stop playback and clear sources for both decks to ensure an empty state
     if (m_a.player) m_a.player->stop();
     if (m_b.player) m_b.player->stop();
-    if (m_a.player) m_a.player->setSource(QUrl());
-    if (m_b.player) m_b.player->setSource(QUrl());
+    if (m_a.player) setDeckSource(m_a, QUrl());
+    if (m_b.player) setDeckSource(m_b, QUrl());
     if (m_a.audio) m_a.player->setAudioOutput(m_a.audio);
     if (m_b.audio) m_b.player->setAudioOutput(m_b.audio);
 
@@ -202,34 +518,72 @@ void PlayerController::clearCurrent()
     }
 
     m_gaplessArmed = false;
+    m_gaplessTimer.stop();
+    m_clock.setRunning(false);
+    m_clock.reset(0);
+    m_pendingLatency = PendingLatency::None;
+    m_pendingSeek = 0;
+    m_deviceSwitchFrom = -1;
+    cancelSeek();
 
     // Notify QML bindings to reset UI state
     emit playingChanged();
     emit currentSourceChanged();
-    emit positionChanged();
+    emitPositionChanged();
     emit durationChanged();
 }
 
+void PlayerController::reportTrackEnd()
+{
+    if (!m_reportEnd) return;
+    m_reportEnd = false;
+    const QUrl source = currentSource();
+    if (!source.isEmpty())
+        emit trackEnded(source, position(), duration());
+}
+
 void PlayerController::onAudioOutputsChanged()
 {
     refreshOutputs();
-    selectDefaultOutputDevice();
+    // The user's device wins whenever it is connected, so plugging a DAC back in moves
+    // playback to it. Otherwise follow the system default, which also covers the current
+    // device going away.
+    const QAudioDevice preferred = outputById(m_preferredOutputId);
+    migrateOutput(preferred.isNull() ? QMediaDevices::defaultAudioOutput() : preferred);
     emit audioOutputsChanged();
 }
 
-void PlayerController::selectDefaultOutputDevice()
+void PlayerController::migrateOutput(const QAudioDevice& device)
 {
-    const auto outs = m_devices.audioOutputs();
-    if (outs.isEmpty()) {
+    if (device.isNull() || device == m_outputDevice)
         return;
+    m_outputDevice = device;
+
+    // setDevice() only reopens the sink; the player keeps its decoder, buffered audio and
+    // position. Re-attaching the output with setAudioOutput() would restart the pipeline.
+    const bool audible = playing();
+    if (audible) {
+        m_deviceFade.stop();
+        if (m_current->audio) m_current->audio->setVolume(0.0f);
+        m_deviceSwitchFrom = m_current->player->position();
+        m_deviceSwitchTimer.start();
     }
-    
-    auto dev = m_devices.defaultAudioOutput();
-    if (m_a.audio) m_a.audio->setDevice(dev);
-    if (m_b.audio) m_b.audio->setDevice(dev);
-    if (m_a.player && m_a.audio) m_a.player->setAudioOutput(m_a.audio);
-    if (m_b.player && m_b.audio) m_b.player->setAudioOutput(m_b.audio);
-    emit audioOutputsChanged();
+    if (m_a.audio) m_a.audio->setDevice(device);
+    if (m_b.audio) m_b.audio->setDevice(device);
+    // Come in with a short ramp rather than mid-waveform at full level
+    if (audible)
+        m_deviceFade.start();
+}
+
+QAudioDevice PlayerController::outputById(const QByteArray& id) const
+{
+    if (id.isEmpty())
+        return {};
+    for (const QAudioDevice& device : m_outputDevices) {
+        if (device.id() == id)
+            return device;
+    }
+    return {};
 }
 
 QStringList PlayerController::audioOutputs() const
@@ -251,28 +605,39 @@ void PlayerController::selectOutputByIndex(int index)
 {
     if (index < 0 || index >= m_outputDevices.size())
         return;
-    
-    const auto dev = m_outputDevices.at(index);
-    if (m_a.audio) m_a.audio->setDevice(dev);
-    if (m_b.audio) m_b.audio->setDevice(dev);
-    if (m_a.player && m_a.audio) m_a.player->setAudioOutput(m_a.audio);
-    if (m_b.player && m_b.audio) m_b.player->setAudioOutput(m_b.audio);
+
+    const QAudioDevice device = m_outputDevices.at(index);
+    m_preferredOutputId = device.id();
+    QSettings().setValue(PreferredOutputKey, m_preferredOutputId);
+    migrateOutput(device);
     emit audioOutputsChanged();
 }
 
 void PlayerController::refreshOutputs()
 {
-    m_outputDevices = m_devices.audioOutputs();
+    m_outputDevices = QMediaDevices::audioOutputs();
 }
 
 void PlayerController::onPlayerErrorOccurred(QMediaPlayer::Error error, const QString &errorString)
 {
-    Q_UNUSED(error)
-    Q_UNUSED(errorString)
+    if (error == QMediaPlayer::NoError)
+        return;
+
+    auto* player = qobject_cast<QMediaPlayer*>(sender());
+    const QUrl source = player ? player->source() : QUrl();
+    qWarning() << "Playback error" << error << errorString << source;
+    Telemetry::instance()->recordPlayerError(QStringLiteral("%1: %2").arg(source.toString(), errorString));
+
+    if (player == m_current->player)
+        m_pendingLatency = PendingLatency::None;
 }
 
 void PlayerController::refreshAudioDevices()
 {
+    if (!m_devices) {
+        initializeAudioDevices();
+        return;
+    }
     refreshOutputs();
     emit audioOutputsChanged();
 }
@@ -283,6 +648,12 @@ void PlayerController::onMetaDataChanged()
     // This method is now handled by updateCurrentMetadataFromSource()
 }
 
+void PlayerController::refreshMetadata(const QList<QUrl>& edited)
+{
+    if (edited.contains(currentSource()))
+        updateCurrentMetadataFromSource();
+}
+
 void PlayerController::updateCurrentMetadataFromSource()
 {
     if (!m_current->player || m_current->player->source().isEmpty()) {
@@ -5,19 +5,29 @@
 #include <QTimer>
 #include <QMediaPlayer>
 #include <QAudioOutput>
+#include <QAudioBuffer>
+#include <QAudioFormat>
 #include <QMediaDevices>
 #include <QAudioDevice>
 #include <QStringList>
 #include <QVector>
 #include <QMediaMetaData>
+#include <QElapsedTimer>
+#include <QVariantAnimation>
 
+#include "PlaybackClock.h"
 #include "TrackMetadata.h"
 
 class PlaylistModel;
+class QAudioBufferOutput;
+class ReadAheadDevice;
+class SeekIndexer;
 
 class PlayerController : public QObject {
     Q_OBJECT
     Q_PROPERTY(bool playing READ playing NOTIFY playingChanged)
+    // Interpolated between backend reports. positionChanged fires on seeks/track changes and
+    // about once a second while playing; views that animate should sample it once per frame.
     Q_PROPERTY(qint64 position READ position NOTIFY positionChanged)
     Q_PROPERTY(qint64 duration READ duration NOTIFY durationChanged)
     Q_PROPERTY(float volume READ volume WRITE setVolume NOTIFY volumeChanged)
@@ -25,18 +35,35 @@ class PlayerController : public QObject {
     Q_PROPERTY(QString currentOutput READ currentOutput NOTIFY audioOutputsChanged)
     Q_PROPERTY(QUrl currentSource READ currentSource NOTIFY currentSourceChanged)
     Q_PROPERTY(TrackMetadata* currentMetadata READ currentMetadata NOTIFY currentMetadataChanged)
+    // Read-ahead window per deck for local files; applies from the next track loaded
+    Q_PROPERTY(int readAheadMB READ readAheadMB WRITE setReadAheadMB NOTIFY readAheadMBChanged)
 public:
     explicit PlayerController(QObject* parent = nullptr);
 
     Q_INVOKABLE void openFile(const QUrl& url);
+    // Loads paused at positionMs (session restore)
+    Q_INVOKABLE void cueFile(const QUrl& url, qint64 positionMs);
     Q_INVOKABLE void play();
     Q_INVOKABLE void pause();
     Q_INVOKABLE void seek(qint64 posMs);
     Q_INVOKABLE void setNextFile(const QUrl& url);
+    // Moves playback to that device and keeps it there (by device ID, across launches and
+    // while it is unplugged) until the user picks another one
     Q_INVOKABLE void selectOutputByIndex(int index);
     Q_INVOKABLE void refreshAudioDevices();
+    // Enumerates output devices and starts following device changes. Deferred until after
+    // the first frame: until then playback uses the system default output.
+    void initializeAudioDevices();
+    // Also delivers what the current deck plays, converted to format, as audioBufferReady
+    // (HTTP streaming). Off until asked for, as every buffer then costs a conversion.
+    void enableAudioTap(const QAudioFormat& format);
     Q_INVOKABLE QUrl currentSource() const { return m_current && m_current->player ? m_current->player->source() : QUrl(); }
     Q_INVOKABLE TrackMetadata* currentMetadata() const { return m_currentMetadata; }
+    // Re-reads the tags of the current track if it is among the edited files
+    void refreshMetadata(const QList<QUrl>& edited);
+    // Emits trackEnded for the current track if it has been playing (on quit, as nothing
+    // else will)
+    void reportTrackEnd();
 
     bool playing() const;
     qint64 position() const;
@@ -47,6 +74,9 @@ public:
     QStringList audioOutputs() const;
     QString currentOutput() const;
 
+    int readAheadMB() const { return m_readAheadMB; }
+    void setReadAheadMB(int megabytes);
+
 signals:
     void playingChanged();
     void positionChanged();
@@ -55,11 +85,18 @@ signals:
     void currentSourceChanged();
     void audioOutputsChanged();
     void currentMetadataChanged();
+    void readAheadMBChanged();
+    void audioBufferReady(const QAudioBuffer& buffer);
+    // The track that was playing gave way to another one or to silence after playedMs
+    void trackEnded(const QUrl& source, qint64 playedMs, qint64 durationMs);
 
 private slots:
     void onPositionChanged();
     void onDurationChanged();
     void onMediaStatusChanged(QMediaPlayer::MediaStatus status);
+    void onPlaybackStateChanged(QMediaPlayer::PlaybackState state);
+    void onGaplessTimer();
+    void onSeekTimer();
     void onAudioOutputsChanged();
     void onPlayerErrorOccurred(QMediaPlayer::Error error, const QString &errorString);
     void onMetaDataChanged();
@@ -68,21 +105,66 @@ private:
     struct Deck {
         QMediaPlayer* player {nullptr};
         QAudioOutput* audio {nullptr};
+        ReadAheadDevice* device {nullptr}; // null for remote sources
+        // Replaced devices the backend's demuxer may still be reading from its own thread;
+        // freed once the deck reports its new media loaded, invalid or gone
+        QVector<ReadAheadDevice*> retired;
+        QAudioBufferOutput* tap {nullptr};
         QUrl source;
     };
 
+    // Deck B is created the first time a next track is armed
     Deck m_a;
     Deck m_b;
     Deck* m_current {nullptr};
     Deck* m_next {nullptr};
     bool m_gaplessArmed {false};
-    QMediaDevices m_devices;
+    PlaybackClock m_clock;
+    // Fires GaplessLeadMs before the current track ends, if a next track is armed
+    QTimer m_gaplessTimer;
+    QElapsedTimer m_sincePositionSignal;
+    SeekIndexer* m_seekIndexer {nullptr};
+    // Scrubbing: the first seek goes out at once, later ones at most every SeekCoalesceMs
+    QTimer m_seekTimer;
+    qint64 m_seekTarget {-1};  // not yet handed to the backend
+    qint64 m_seekLanding {-1}; // handed over; older position reports are ignored until it lands
+    qint64 m_settlePrefetch {-1}; // byte offset of the last seek, fetched in full once seeking stops
+    QElapsedTimer m_sinceSeek;
+    QMediaDevices* m_devices {nullptr};
     QVector<QAudioDevice> m_outputDevices;
+    QAudioDevice m_outputDevice;     // what the decks play on
+    QByteArray m_preferredOutputId;  // user's choice; empty follows the system default
+    float m_volume {0.8f};
+    // Ramps the decks back to m_volume after their sink has been reopened on another device
+    QVariantAnimation m_deviceFade;
+    QElapsedTimer m_deviceSwitchTimer;
+    qint64 m_deviceSwitchFrom {-1}; // position at the switch; the first report past it ends the measurement
     TrackMetadata* m_currentMetadata {nullptr};
 
+    // Latency measured until the current deck reports its first audible position
+    enum class PendingLatency { None, Open, Transition };
+    PendingLatency m_pendingLatency {PendingLatency::None};
+    QElapsedTimer m_latencyTimer;
+    // Applied once the cued source has loaded
+    qint64 m_pendingSeek {0};
+    int m_readAheadMB {16};
+    QAudioFormat m_tapFormat; // invalid while the tap is off
+    // The current track has been playing, so its end is reported; a cued one hasn't yet
+    bool m_reportEnd {false};
+
     void setupDeck(Deck& deck);
+    void attachTap(Deck& deck);
+    void setDeckSource(Deck& deck, const QUrl& url);
+    void releaseRetiredDevices(Deck& deck);
+    void ensureNextDeck();
     void switchToNext();
-    void selectDefaultOutputDevice();
+    void scheduleGaplessSwitch();
+    void applySeek();
+    void cancelSeek();
+    void emitPositionChanged();
+    // Callers emit audioOutputsChanged
+    void migrateOutput(const QAudioDevice& device);
+    QAudioDevice outputById(const QByteArray& id) const;
     void refreshOutputs();
     void updateCurrentMetadataFromSource();
     void clearCurrent();
@@ -1,6 +1,9 @@
 #include "PlaylistModel.h"
+#include "RowSorter.h"
 #include "TrackMetadata.h"
 
+#include <QDebug>
+
 PlaylistModel::PlaylistModel(QObject* parent)
     : QAbstractListModel(parent)
 {
@@ -16,29 +19,49 @@ QVariant PlaylistModel::data(const QModelIndex& index, int role) const
 {
     if (!index.isValid() || index.row() < 0 || index.row() >= m_items.size())
         return {};
-    const auto &it = m_items.at(index.row());
+    return roleData(m_items.at(index.row()), role);
+}
+
+void PlaylistModel::multiData(const QModelIndex& index, QModelRoleDataSpan roleDataSpan) const
+{
+    if (!index.isValid() || index.row() < 0 || index.row() >= m_items.size()) {
+        for (QModelRoleData& entry : roleDataSpan)
+            entry.clearData();
+        return;
+    }
+    const Item& item = m_items.at(index.row());
+    for (QModelRoleData& entry : roleDataSpan)
+        entry.setData(roleData(item, entry.role()));
+}
+
+QVariant PlaylistModel::roleData(const Item& it, int role)
+{
     switch (role) {
     case Qt::DisplayRole:
     case DisplayRole:
         return it.display;
     case UrlRole:
-        return it.url;
+        return it.url();
     case TitleRole:
-        return it.metadata ? it.metadata->title() : QString();
+        return it.title;
     case ArtistRole:
-        return it.metadata ? it.metadata->artist() : QString();
+        return it.artist;
     case AlbumRole:
-        return it.metadata ? it.metadata->album() : QString();
+        return it.album;
     case GenreRole:
-        return it.metadata ? it.metadata->genre() : QString();
+        return it.genre;
     case YearRole:
-        return it.metadata ? it.metadata->year() : QString();
+        return it.year;
     case TrackNumberRole:
-        return it.metadata ? it.metadata->trackNumber() : 0;
+        return it.trackNumber;
     case DurationRole:
-        return it.metadata ? it.metadata->duration() : 0;
-    case MetadataRole:
-        return QVariant::fromValue(it.metadata);
+        return it.duration;
+    case PrimaryTextRole:
+        return it.primaryText;
+    case SecondaryTextRole:
+        return it.secondaryText;
+    case DurationTextRole:
+        return it.durationText;
     default:
         return {};
     }
@@ -56,7 +79,9 @@ QHash<int, QByteArray> PlaylistModel::roleNames() const
     r[YearRole] = "year";
     r[TrackNumberRole] = "trackNumber";
     r[DurationRole] = "duration";
-    r[MetadataRole] = "metadata";
+    r[PrimaryTextRole] = "primaryText";
+    r[SecondaryTextRole] = "secondaryText";
+    r[DurationTextRole] = "durationText";
     return r;
 }
 
@@ -66,19 +91,56 @@ Qt::ItemFlags PlaylistModel::flags(const QModelIndex& index) const
     return Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsDragEnabled | Qt::ItemIsDropEnabled;
 }
 
-void PlaylistModel::add(const QUrl& url)
+void PlaylistModel::Item::updateText()
+{
+    primaryText = title.isEmpty() ? display
+                                  : title + QLatin1String(" - ") + (artist.isEmpty() ? QStringLiteral("Unknown Artist") : artist);
+
+    secondaryText.clear();
+    for (const QString* part : {&album, &year, &genre}) {
+        if (part->isEmpty()) continue;
+        if (!secondaryText.isEmpty())
+            secondaryText += QStringLiteral(" \u2022 ");
+        secondaryText += *part;
+    }
+
+    if (duration > 0) {
+        const qint64 seconds = duration / 1000;
+        durationText = QString::number(seconds / 60) + QLatin1Char(':')
+                       + QString::number(seconds % 60).rightJustified(2, QLatin1Char('0'));
+    } else {
+        durationText.clear();
+    }
+}
+
+bool PlaylistModel::Item::sameFields(const Item& other) const
+{
+    return location == other.location && remote == other.remote && display == other.display && title == other.title
+           && artist == other.artist && album == other.album && genre == other.genre && year == other.year
+           && trackNumber == other.trackNumber && duration == other.duration;
+}
+
+PlaylistModel::Item PlaylistModel::itemForUrl(const QUrl& url)
 {
-    QString disp;
+    Item item;
     const QString localFile = url.toLocalFile();
     if (!localFile.isEmpty()) {
+        item.location = localFile;
         QFileInfo fi(localFile);
-        disp = fi.exists() ? fi.fileName() : url.toString();
+        item.display = fi.exists() ? fi.fileName() : url.toString();
     } else {
-        disp = url.toString();
+        item.location = url.toString();
+        item.display = item.location;
+        item.remote = true;
     }
+    item.updateText();
+    return item;
+}
 
+void PlaylistModel::add(const QUrl& url)
+{
     beginInsertRows(QModelIndex(), m_items.size(), m_items.size());
-    m_items.push_back({url, disp});
+    m_items.push_back(itemForUrl(url));
     endInsertRows();
 }
 
@@ -86,10 +148,6 @@ void PlaylistModel::removeAt(int index)
 {
     if (index < 0 || index >= m_items.size()) return;
     
-    // Don't delete metadata - it belongs to PlayerController
-    // Just clear the reference
-    m_items[index].metadata = nullptr;
-    
     beginRemoveRows(QModelIndex(), index, index);
     m_items.removeAt(index);
     endRemoveRows();
@@ -112,29 +170,100 @@ void PlaylistModel::clear()
 {
     if (m_items.isEmpty()) return;
     beginResetModel();
-    
-    // Don't delete metadata objects - they belong to PlayerController
-    // Just clear the references
-    for (auto& item : m_items) {
-        item.metadata = nullptr;
-    }
-    
     m_items.clear();
     endResetModel();
 }
 
+void PlaylistModel::resetItems(QVector<Item> items)
+{
+    for (Item& item : items)
+        item.updateText();
+    beginResetModel();
+    m_items = std::move(items);
+    endResetModel();
+}
+
+void PlaylistModel::insertItem(int row, Item item)
+{
+    row = qBound(0, row, int(m_items.size()));
+    item.updateText();
+    beginInsertRows(QModelIndex(), row, row);
+    m_items.insert(row, std::move(item));
+    endInsertRows();
+}
+
+void PlaylistModel::setItem(int row, Item item)
+{
+    if (row < 0 || row >= m_items.size()) return;
+    item.updateText();
+    m_items[row] = std::move(item);
+    emit dataChanged(createIndex(row, 0), createIndex(row, 0));
+}
+
 QVariantMap PlaylistModel::get(int index) const
 {
     QVariantMap m;
     if (index < 0 || index >= m_items.size()) return m;
-    m["url"] = m_items.at(index).url;
+    m["url"] = m_items.at(index).url();
     m["display"] = m_items.at(index).display;
     return m;
 }
 
-static QString toLocalOrString(const QUrl& url)
+int PlaylistModel::sortBy(const QStringList& roles, Qt::SortOrder order, int trackRow)
 {
-    return url.isLocalFile() ? url.toLocalFile() : url.toString();
+    const int rows = m_items.size();
+    RowSorter sorter(rows);
+    for (const QString& role : roles) {
+        QVector<QString> text;
+        QVector<qint64> numbers;
+        if (role == QLatin1String("trackNumber") || role == QLatin1String("duration")) {
+            numbers.reserve(rows);
+            for (const Item& item : std::as_const(m_items))
+                numbers.append(role == QLatin1String("duration") ? item.duration : item.trackNumber);
+            sorter.addNumber(numbers, order);
+            continue;
+        }
+
+        QString Item::*field = nullptr;
+        if (role == QLatin1String("title")) field = &Item::title;
+        else if (role == QLatin1String("artist")) field = &Item::artist;
+        else if (role == QLatin1String("album")) field = &Item::album;
+        else if (role == QLatin1String("genre")) field = &Item::genre;
+        else if (role == QLatin1String("year")) field = &Item::year;
+        else if (role == QLatin1String("display")) field = &Item::display;
+        else if (role == QLatin1String("url")) field = &Item::location;
+        if (!field) {
+            qWarning() << "PlaylistModel: cannot sort by" << role;
+            return trackRow;
+        }
+        text.reserve(rows);
+        for (const Item& item : std::as_const(m_items))
+            text.append(item.*field);
+        sorter.addText(text, order);
+    }
+    const std::vector<int> sorted = sorter.order();
+
+    // One layout change; views keep their delegates and persistent indexes follow their rows
+    std::vector<int> newRow(rows);
+    for (int i = 0; i < rows; ++i)
+        newRow[sorted[i]] = i;
+
+    emit layoutAboutToBeChanged({}, QAbstractItemModel::VerticalSortHint);
+    QVector<Item> items;
+    items.reserve(rows);
+    for (int oldRow : sorted)
+        items.append(std::move(m_items[oldRow]));
+    m_items = std::move(items);
+
+    const QModelIndexList from = persistentIndexList();
+    QModelIndexList to;
+    to.reserve(from.size());
+    for (const QModelIndex& idx : from)
+        to.append(index(newRow[idx.row()]));
+    changePersistentIndexList(from, to);
+    emit layoutChanged({}, QAbstractItemModel::VerticalSortHint);
+
+    return trackRow >= 0 && trackRow < rows ? newRow[trackRow] : -1;
 }
 
 bool PlaylistModel::exportM3U8(const QUrl& url) const
@@ -146,7 +275,7 @@ bool PlaylistModel::exportM3U8(const QUrl& url) const
     QTextStream out(&f);
     out << "#EXTM3U\n";
     for (const auto &it : m_items) {
-        out << toLocalOrString(it.url) << "\n";
+        out << it.location << "\n";
     }
     return true;
 }
@@ -166,23 +295,11 @@ bool PlaylistModel::importM3U8(const QUrl& url)
         const QString line = in.readLine().trimmed();
         if (line.isEmpty() || line.startsWith("#")) continue;
         
-        QUrl u;
         if (line.startsWith("http://") || line.startsWith("https://")) {
-            u = QUrl(line);
-        } else {
-            u = QUrl::fromLocalFile(line);
-        }
-        
-        QString disp;
-        const QString localFile = u.toLocalFile();
-        if (!localFile.isEmpty()) {
-            QFileInfo fi(localFile);
-            disp = fi.exists() ? fi.fileName() : u.toString();
+            items.push_back(itemForUrl(QUrl(line)));
         } else {
-            disp = u.toString();
+            items.push_back(itemForUrl(QUrl::fromLocalFile(line)));
         }
-        
-        items.push_back({u, disp});
     }
     
     beginResetModel();
@@ -195,23 +312,50 @@ void PlaylistModel::updateMetadata(int index, TrackMetadata* metadata)
 {
     if (index < 0 || index >= m_items.size() || !metadata) return;
     
-    // Don't delete old metadata - it belongs to PlayerController
-    // Just clear the reference
-    m_items[index].metadata = nullptr;
-    
-    // Store reference to current metadata (don't copy, don't take ownership)
-    m_items[index].metadata = metadata;
+    // Copy, don't reference: PlayerController deletes its metadata on every track change
+    Item& item = m_items[index];
+    item.title = metadata->title();
+    item.artist = metadata->artist();
+    item.album = metadata->album();
+    item.genre = metadata->genre();
+    item.year = metadata->year();
+    item.trackNumber = metadata->trackNumber();
+    item.duration = metadata->duration();
     
     // Update display text with current metadata
     if (!metadata->title().isEmpty() && !metadata->artist().isEmpty()) {
-        m_items[index].display = QString("%1 - %2").arg(metadata->artist(), metadata->title());
+        item.display = QString("%1 - %2").arg(metadata->artist(), metadata->title());
     }
+    item.updateText();
     
     emit dataChanged(createIndex(index, 0), createIndex(index, 0));
 }
 
-TrackMetadata* PlaylistModel::getMetadata(int index) const
+void PlaylistModel::applyTagEdits(const QSet<QString>& locations, const QVariantMap& fields)
 {
-    if (index < 0 || index >= m_items.size()) return nullptr;
-    return m_items.at(index).metadata;
+    int first = -1;
+    int last = -1;
+    for (int i = 0; i < m_items.size(); ++i) {
+        Item& item = m_items[i];
+        if (item.remote || !locations.contains(item.location)) continue;
+
+        for (auto it = fields.constBegin(); it != fields.constEnd(); ++it) {
+            const QString value = it.value().toString();
+            if (it.key() == QLatin1String("title")) item.title = value;
+            else if (it.key() == QLatin1String("artist")) item.artist = value;
+            else if (it.key() == QLatin1String("album")) item.album = value;
+            else if (it.key() == QLatin1String("genre")) item.genre = value;
+            else if (it.key() == QLatin1String("year")) item.year = value;
+            else if (it.key() == QLatin1String("trackNumber")) item.trackNumber = value.toInt();
+        }
+        if (!item.title.isEmpty() && !item.artist.isEmpty()) {
+            item.display = QString("%1 - %2").arg(item.artist, item.title);
+        }
+        item.updateText();
+
+        if (first < 0) first = i;
+        last = i;
+    }
+    if (first >= 0)
+        emit dataChanged(createIndex(first, 0), createIndex(last, 0));
 }
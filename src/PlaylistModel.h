@@ -1,6 +1,7 @@
 #pragma once
 
 #include <QAbstractListModel>
+#include <QSet>
 #include <QUrl>
 #include <QVector>
 #include <QString>
@@ -26,11 +27,39 @@ public:
         YearRole,
         TrackNumberRole,
         DurationRole,
-        MetadataRole
+        // Preformatted for the track delegate, so scrolling runs no JavaScript
+        PrimaryTextRole,   // "title - artist", or the file name
+        SecondaryTextRole, // "album • year • genre"
+        DurationTextRole   // "m:ss", empty when unknown
+    };
+
+    // Everything a row shows is cached here, so rows outlive the TrackMetadata that filled
+    // them and a session can be restored without reading tags again
+    struct Item {
+        QString location; // local path, or the URL string for remote items
+        QString display;
+        QString title;
+        QString artist;
+        QString album;
+        QString genre;
+        QString year;
+        int trackNumber {0};
+        qint64 duration {0};
+        bool remote {false};
+        // Derived from the fields above by updateText(); not persisted
+        QString primaryText;
+        QString secondaryText;
+        QString durationText;
+
+        QUrl url() const { return remote ? QUrl(location) : QUrl::fromLocalFile(location); }
+        void updateText();
+        // Same location and stored fields; the derived text is not compared
+        bool sameFields(const Item& other) const;
     };
 
     int rowCount(const QModelIndex& parent = QModelIndex()) const override;
     QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    void multiData(const QModelIndex& index, QModelRoleDataSpan roleDataSpan) const override;
     QHash<int, QByteArray> roleNames() const override;
     Qt::ItemFlags flags(const QModelIndex& index) const override;
 
@@ -41,18 +70,29 @@ public:
     Q_INVOKABLE int count() const { return m_items.size(); }
     Q_INVOKABLE QVariantMap get(int index) const;
 
+    // Stable sort by role names, most significant first: title, artist, album, genre, year,
+    // trackNumber, duration, display or url. Returns the new row of trackRow (e.g. the playing
+    // track), or -1.
+    Q_INVOKABLE int sortBy(const QStringList& roles, Qt::SortOrder order = Qt::AscendingOrder, int trackRow = -1);
+
     Q_INVOKABLE bool exportM3U8(const QUrl& url) const;
     Q_INVOKABLE bool importM3U8(const QUrl& url);
     
-    // Metadata methods
+    // Copies the fields shown in the list; the metadata object is not retained
     Q_INVOKABLE void updateMetadata(int index, TrackMetadata* metadata);
-    Q_INVOKABLE TrackMetadata* getMetadata(int index) const;
+    // After a tag edit: fields (TagEditor names) applied to every row for one of the paths
+    void applyTagEdits(const QSet<QString>& locations, const QVariantMap& fields);
+
+    // Bulk access for session persistence
+    const QVector<Item>& items() const { return m_items; }
+    void resetItems(QVector<Item> items);
+    // Row-level edits for models filled from code (smart playlists)
+    void insertItem(int row, Item item);
+    void setItem(int row, Item item);
 
 private:
-    struct Item { 
-        QUrl url; 
-        QString display; 
-        TrackMetadata* metadata {nullptr}; 
-    };
+    static Item itemForUrl(const QUrl& url);
+    static QVariant roleData(const Item& item, int role);
+
     QVector<Item> m_items;
 };
@@ -0,0 +1,400 @@
+#include "ReadAheadDevice.h"
+#include "Telemetry.h"
+
+#include <QDeadlineTimer>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr qint64 ChunkSize = 1024 * 1024;
+// Per read() call; small enough that a re-anchor is picked up quickly on a slow share
+constexpr qint64 ReadStep = 256 * 1024;
+// Windows start on this boundary so reads stay aligned with filesystem blocks
+constexpr qint64 AnchorAlignment = 64 * 1024;
+// Kept behind the read position so short backward seeks (container probing) stay in memory
+constexpr int BackChunks = 1;
+// A failed or short read is retried after a backoff that doubles from RetryBaseMs up to
+// RetryMaxMs; after MaxReadRetries in a row (about seven seconds) the window ends there
+constexpr int MaxReadRetries = 8;
+constexpr int RetryBaseMs = 50;
+constexpr int RetryMaxMs = 2000;
+
+} // namespace
+
+struct ReadAheadDevice::State {
+    struct Chunk {
+        qint64 offset = 0;
+        qint64 filled = 0;
+        QByteArray data;
+    };
+
+    void readerLoop();
+    // Callers hold mutex
+    bool inWindow(qint64 pos) const;
+    void reanchor(qint64 pos, qint64 fetchLimit);
+    void releaseBehind(qint64 pos);
+    qint64 contiguousFrom(qint64 pos) const;
+    Chunk* takeChunk(qint64 offset);
+
+    QFile file; // used by the reader thread only once open() returns
+    qint64 size = 0;
+    qint64 capacity = 0;
+
+    mutable QMutex mutex;
+    QWaitCondition dataReady;  // reader -> readData()
+    QWaitCondition spaceReady; // readData()/seek -> reader
+    std::deque<Chunk*> window; // ascending, contiguous offsets
+    std::vector<std::unique_ptr<Chunk>> chunks; // owns every chunk
+    std::vector<Chunk*> spare;
+    qint64 anchor = 0;  // where the reader starts when the window is empty
+    qint64 readPos = 0;
+    qint64 limit = 0;   // the reader stays this far ahead of readPos, at most capacity
+    quint64 generation = 0; // bumped on re-anchor; in-flight reads for an old window are dropped
+    bool primed = false;    // a read has been served since the last re-anchor
+    bool stop = false;
+    bool error = false; // gave up on reading at the end of the window; cleared on re-anchor
+    int failures = 0;   // consecutive failed reads
+    quint64 stalls = 0;
+    qint64 stalledMicros = 0;
+    quint64 readRetries = 0;
+};
+
+ReadAheadDevice::ReadAheadDevice(const QString& filePath, qint64 capacityBytes, QObject* parent)
+    : QIODevice(parent)
+    , m_filePath(filePath)
+    , m_capacity(qMax(capacityBytes, 2 * ChunkSize))
+{
+}
+
+ReadAheadDevice::~ReadAheadDevice()
+{
+    close();
+}
+
+bool ReadAheadDevice::open(OpenMode mode)
+{
+    if ((mode & ReadWrite) != ReadOnly || (mode & (Append | Truncate))) {
+        setErrorString(QStringLiteral("ReadAheadDevice is read-only"));
+        return false;
+    }
+
+    auto state = std::make_shared<State>();
+    state->file.setFileName(m_filePath);
+    if (!state->file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        setErrorString(state->file.errorString());
+        return false;
+    }
+    m_size = state->size = state->file.size();
+    state->capacity = m_capacity;
+
+#ifdef Q_OS_LINUX
+    // Let the kernel use its largest readahead for this file in addition to ours
+    ::posix_fadvise(state->file.handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    {
+        QMutexLocker lock(&state->mutex);
+        state->reanchor(0, m_capacity);
+    }
+    m_state = state;
+
+    QIODevice::open(ReadOnly | Unbuffered);
+
+    // Nothing waits for the thread; it holds its own reference and cleans up after itself
+    QThread* reader = QThread::create([state] { state->readerLoop(); });
+    reader->setObjectName(QStringLiteral("ReadAhead"));
+    connect(reader, &QThread::finished, reader, &QObject::deleteLater);
+    reader->start();
+    return true;
+}
+
+void ReadAheadDevice::close()
+{
+    // Not joined: the reader may be blocked on an unresponsive share, and this runs on the
+    // GUI thread. It sees stop once the read returns and drops its reference to the state.
+    if (m_state) {
+        QMutexLocker lock(&m_state->mutex);
+        m_state->stop = true;
+        m_state->dataReady.wakeAll();
+        m_state->spaceReady.wakeAll();
+    }
+    m_state.reset();
+
+    if (isOpen())
+        QIODevice::close();
+}
+
+bool ReadAheadDevice::seek(qint64 pos)
+{
+    if (!QIODevice::seek(pos) || !m_state)
+        return false;
+
+    // Start fetching the new position now rather than on the backend's next read
+    QMutexLocker lock(&m_state->mutex);
+    if (!m_state->inWindow(pos))
+        m_state->reanchor(pos, m_capacity);
+    m_state->readPos = pos;
+    m_state->spaceReady.wakeAll();
+    return true;
+}
+
+void ReadAheadDevice::prefetch(qint64 offset, qint64 length)
+{
+    if (!m_state)
+        return;
+    const qint64 limit = length < 0 ? m_capacity : qBound(ChunkSize, length, m_capacity);
+    QMutexLocker lock(&m_state->mutex);
+    if (offset < 0 || offset >= m_size)
+        return;
+    if (!m_state->inWindow(offset)) {
+        m_state->reanchor(offset, limit);
+    } else if (limit > m_state->limit) {
+        m_state->limit = limit;
+#ifdef Q_OS_LINUX
+        ::posix_fadvise(m_state->file.handle(), offset, limit, POSIX_FADV_WILLNEED);
+#endif
+    } else {
+        return;
+    }
+    m_state->spaceReady.wakeAll();
+}
+
+qint64 ReadAheadDevice::bytesAvailable() const
+{
+    if (!m_state)
+        return QIODevice::bytesAvailable();
+    QMutexLocker lock(&m_state->mutex);
+    return m_state->contiguousFrom(pos()) + QIODevice::bytesAvailable();
+}
+
+ReadAheadDevice::Health ReadAheadDevice::health() const
+{
+    Health h;
+    h.capacity = m_capacity;
+    if (!m_state)
+        return h;
+    QMutexLocker lock(&m_state->mutex);
+    h.bufferedAhead = m_state->contiguousFrom(m_state->readPos);
+    h.stalls = m_state->stalls;
+    h.stalledMicros = m_state->stalledMicros;
+    h.readRetries = m_state->readRetries;
+    return h;
+}
+
+qint64 ReadAheadDevice::readData(char* data, qint64 maxSize)
+{
+    // Held for the whole call in case close() runs while this waits
+    const std::shared_ptr<State> state = m_state;
+    if (!state)
+        return -1;
+    const qint64 pos = this->pos();
+    if (pos >= m_size)
+        return 0;
+
+    QMutexLocker lock(&state->mutex);
+    if (pos != state->readPos) {
+        if (!state->inWindow(pos))
+            state->reanchor(pos, m_capacity);
+        state->readPos = pos;
+        state->spaceReady.wakeAll();
+    }
+
+    qint64 available = state->contiguousFrom(pos);
+    if (available == 0) {
+        // The first read after a re-anchor always waits; only count waits on a primed window
+        const bool stall = state->primed;
+        QElapsedTimer waited;
+        waited.start();
+        while ((available = state->contiguousFrom(pos)) == 0 && !state->stop && !state->error)
+            state->dataReady.wait(&state->mutex);
+        if (stall) {
+            const qint64 micros = waited.nsecsElapsed() / 1000;
+            ++state->stalls;
+            state->stalledMicros += micros;
+            Telemetry::instance()->readAheadStall().record(quint64(micros));
+        }
+        if (available == 0)
+            return state->stop ? -1 : 0;
+    }
+
+    qint64 copied = 0;
+    for (const State::Chunk* chunk : state->window) {
+        const qint64 at = pos + copied;
+        if (copied == maxSize || at < chunk->offset)
+            break;
+        const qint64 end = chunk->offset + chunk->filled;
+        if (at >= end)
+            continue;
+        const qint64 n = qMin(maxSize - copied, end - at);
+        std::memcpy(data + copied, chunk->data.constData() + (at - chunk->offset), size_t(n));
+        copied += n;
+        if (chunk->filled < ChunkSize)
+            break;
+    }
+
+    state->primed = true;
+    state->readPos = pos + copied;
+    state->releaseBehind(state->readPos);
+    state->spaceReady.wakeAll();
+    Telemetry::instance()->recordReadAheadLevel(state->contiguousFrom(state->readPos), m_capacity);
+    return copied;
+}
+
+qint64 ReadAheadDevice::writeData(const char*, qint64)
+{
+    return -1;
+}
+
+void ReadAheadDevice::State::readerLoop()
+{
+    QMutexLocker lock(&mutex);
+    while (!stop) {
+        const qint64 next = window.empty() ? anchor : window.back()->offset + window.back()->filled;
+        if (error || next >= size || next - readPos >= limit) {
+            spaceReady.wait(&mutex);
+            continue;
+        }
+
+        Chunk* chunk = nullptr;
+        if (!window.empty() && window.back()->filled < ChunkSize) {
+            chunk = window.back();
+        } else {
+            releaseBehind(readPos);
+            chunk = takeChunk(next);
+            if (!chunk) {
+                spaceReady.wait(&mutex);
+                continue;
+            }
+            window.push_back(chunk);
+        }
+
+        const quint64 readGeneration = generation;
+        const qint64 want = qMin(qMin(ReadStep, ChunkSize - chunk->filled), size - next);
+        char* target = chunk->data.data() + chunk->filled;
+
+        // A re-anchor while unlocked recycles the chunk; only this thread ever writes into
+        // chunks, so the stale bytes are simply dropped below
+        lock.unlock();
+        qint64 got = -1;
+#ifdef Q_OS_UNIX
+        do {
+            got = ::pread(file.handle(), target, size_t(want), off_t(next));
+        } while (got < 0 && errno == EINTR);
+#else
+        if (file.seek(next))
+            got = file.read(target, want);
+#endif
+        lock.relock();
+
+        if (readGeneration != generation)
+            continue;
+        if (got <= 0) {
+            // Nothing before the end of the file: a share timing out (EIO, ETIMEDOUT) or
+            // briefly reporting a short file. Try again rather than cut the track short; the
+            // decoder waits meanwhile. Only after repeated failures serve what we have, then EOF.
+            if (++failures > MaxReadRetries) {
+                error = true;
+                dataReady.wakeAll();
+                continue;
+            }
+            ++readRetries;
+            Telemetry::instance()->recordReadAheadRetry();
+            // The decoder's reads wake spaceReady too; only a re-anchor or close() cuts this short
+            const QDeadlineTimer backoff(qMin(RetryBaseMs << (failures - 1), RetryMaxMs));
+            while (!stop && readGeneration == generation && spaceReady.wait(&mutex, backoff)) { }
+            continue;
+        }
+        failures = 0;
+        chunk->filled += got;
+        dataReady.wakeAll();
+    }
+}
+
+bool ReadAheadDevice::State::inWindow(qint64 pos) const
+{
+    if (window.empty())
+        return pos >= anchor && pos < anchor + ChunkSize;
+    const Chunk* back = window.back();
+    // Slightly past the filled end is fine: the reader is about to get there
+    return pos >= window.front()->offset && pos < back->offset + back->filled + ChunkSize;
+}
+
+void ReadAheadDevice::State::reanchor(qint64 pos, qint64 fetchLimit)
+{
+    for (Chunk* chunk : window)
+        spare.push_back(chunk);
+    window.clear();
+    ++generation;
+    anchor = pos - pos % AnchorAlignment;
+    readPos = pos;
+    limit = fetchLimit;
+    error = false;
+    failures = 0;
+    primed = false;
+
+#ifdef Q_OS_LINUX
+    ::posix_fadvise(file.handle(), anchor, fetchLimit, POSIX_FADV_WILLNEED);
+#endif
+}
+
+void ReadAheadDevice::State::releaseBehind(qint64 pos)
+{
+    while (window.size() > size_t(BackChunks)) {
+        const Chunk* keep = window[BackChunks];
+        if (keep->offset + keep->filled > pos || keep->filled < ChunkSize)
+            break;
+        spare.push_back(window.front());
+        window.pop_front();
+    }
+}
+
+qint64 ReadAheadDevice::State::contiguousFrom(qint64 pos) const
+{
+    qint64 available = 0;
+    for (const Chunk* chunk : window) {
+        const qint64 end = chunk->offset + chunk->filled;
+        if (available == 0) {
+            if (pos < chunk->offset || pos >= end)
+                continue;
+            available = end - pos;
+        } else {
+            available += chunk->filled;
+        }
+        if (chunk->filled < ChunkSize)
+            break;
+    }
+    return available;
+}
+
+ReadAheadDevice::State::Chunk* ReadAheadDevice::State::takeChunk(qint64 offset)
+{
+    Chunk* chunk = nullptr;
+    if (!spare.empty()) {
+        chunk = spare.back();
+        spare.pop_back();
+    } else if (qint64(chunks.size()) < capacity / ChunkSize + BackChunks + 1) {
+        chunks.push_back(std::make_unique<Chunk>());
+        chunk = chunks.back().get();
+        chunk->data.resize(ChunkSize);
+    } else {
+        return nullptr;
+    }
+    chunk->offset = offset;
+    chunk->filled = 0;
+    return chunk;
+}
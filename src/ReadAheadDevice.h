@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QIODevice>
+#include <QString>
+
+#include <memory>
+
+// Random-access QIODevice over a local file that keeps a large window ahead of the read
+// position in memory, filled by its own reader thread. Handed to QMediaPlayer through
+// setSourceDevice() so a slow or briefly unresponsive network filesystem drains the window
+// instead of stalling the decoder.
+//
+// The window is a chain of fixed-size chunks recycled through a free list. A seek outside
+// the window re-anchors it at the new position right away (before the backend's next
+// read), and one chunk behind the read position is kept for small backward seeks.
+//
+// readData() is called from the media backend's thread. Everything the reader thread touches
+// lives in a State it shares with the device, so close() only tells the reader to stop: a
+// read stuck on a hung share finishes on its own and the last owner closes the file.
+class ReadAheadDevice : public QIODevice {
+    Q_OBJECT
+
+public:
+    struct Health {
+        qint64 bufferedAhead = 0; // contiguous bytes ready at the read position
+        qint64 capacity = 0;
+        quint64 stalls = 0;       // reads that had to wait for the reader thread
+        qint64 stalledMicros = 0;
+        quint64 readRetries = 0;  // failed or short reads that were tried again
+    };
+
+    explicit ReadAheadDevice(const QString& filePath, qint64 capacityBytes, QObject* parent = nullptr);
+    ~ReadAheadDevice() override;
+
+    // Only ReadOnly is supported; the device is always unbuffered
+    bool open(OpenMode mode) override;
+    void close() override;
+
+    bool isSequential() const override { return false; }
+    qint64 size() const override { return m_size; }
+    bool seek(qint64 pos) override;
+    qint64 bytesAvailable() const override;
+
+    Health health() const;
+    // Moves the window to offset ahead of a seek the backend is about to make, so the
+    // target is already on its way in when the demuxer asks for it. length caps how far
+    // ahead is fetched (-1 is the whole window); a later call at the same offset with a
+    // larger length extends it without dropping what is already in.
+    void prefetch(qint64 offset, qint64 length = -1);
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override;
+    qint64 writeData(const char* data, qint64 maxSize) override;
+
+private:
+    struct State;
+
+    QString m_filePath;
+    qint64 m_size {0};
+    qint64 m_capacity {0};
+    std::shared_ptr<State> m_state; // null while closed
+};
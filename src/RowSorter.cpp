@@ -0,0 +1,136 @@
+#include "RowSorter.h"
+
+#include <QCollator>
+#include <QHash>
+#include <QThread>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace {
+
+// Below this a single stable_sort beats starting workers
+constexpr int ParallelThreshold = 32 * 1024;
+constexpr int MinChunkRows = 8 * 1024;
+
+constexpr qint64 EmptyLast = std::numeric_limits<qint64>::max();
+
+} // namespace
+
+RowSorter::RowSorter(int rows)
+    : m_rows(rows)
+{
+}
+
+void RowSorter::addText(const QVector<QString>& values, Qt::SortOrder order)
+{
+    Q_ASSERT(values.size() == m_rows);
+
+    // Collate each distinct string once
+    QHash<QString, int> distinctIndex;
+    QVector<QString> distinct;
+    std::vector<int> rowDistinct(m_rows);
+    for (int row = 0; row < m_rows; ++row) {
+        auto it = distinctIndex.constFind(values.at(row));
+        if (it == distinctIndex.constEnd()) {
+            it = distinctIndex.insert(values.at(row), int(distinct.size()));
+            distinct.append(values.at(row));
+        }
+        rowDistinct[row] = it.value();
+    }
+
+    QCollator collator;
+    collator.setNumericMode(true);
+    collator.setCaseSensitivity(Qt::CaseInsensitive);
+    std::vector<QCollatorSortKey> sortKeys;
+    sortKeys.reserve(distinct.size());
+    for (const QString& s : std::as_const(distinct))
+        sortKeys.push_back(collator.sortKey(s));
+
+    std::vector<int> byKey(distinct.size());
+    std::iota(byKey.begin(), byKey.end(), 0);
+    std::sort(byKey.begin(), byKey.end(), [&sortKeys](int a, int b) { return sortKeys[a].compare(sortKeys[b]) < 0; });
+
+    // Strings that collate equal ("ABBA", "Abba") share a rank
+    std::vector<qint64> rank(distinct.size());
+    qint64 next = 0;
+    for (size_t i = 0; i < byKey.size(); ++i) {
+        if (i > 0 && sortKeys[byKey[i - 1]].compare(sortKeys[byKey[i]]) != 0)
+            ++next;
+        rank[byKey[i]] = distinct.at(byKey[i]).isEmpty() ? EmptyLast : (order == Qt::AscendingOrder ? next : -next);
+    }
+
+    std::vector<qint64> column(m_rows);
+    for (int row = 0; row < m_rows; ++row)
+        column[row] = rank[rowDistinct[row]];
+    m_columns.push_back(std::move(column));
+}
+
+void RowSorter::addNumber(const QVector<qint64>& values, Qt::SortOrder order)
+{
+    Q_ASSERT(values.size() == m_rows);
+    std::vector<qint64> column(values.begin(), values.end());
+    if (order == Qt::DescendingOrder) {
+        for (qint64& value : column)
+            value = -value;
+    }
+    m_columns.push_back(std::move(column));
+}
+
+std::vector<int> RowSorter::order() const
+{
+    // Interleave the keys so a comparison touches one cache line per row
+    const size_t columns = m_columns.size();
+    std::vector<qint64> keys(size_t(m_rows) * columns);
+    for (size_t c = 0; c < columns; ++c) {
+        for (int row = 0; row < m_rows; ++row)
+            keys[size_t(row) * columns + c] = m_columns[c][row];
+    }
+    const auto less = [&keys, columns](int a, int b) {
+        const qint64* ka = keys.data() + size_t(a) * columns;
+        const qint64* kb = keys.data() + size_t(b) * columns;
+        for (size_t c = 0; c < columns; ++c) {
+            if (ka[c] != kb[c])
+                return ka[c] < kb[c];
+        }
+        return false;
+    };
+
+    std::vector<int> order(m_rows);
+    std::iota(order.begin(), order.end(), 0);
+    const int chunks = m_rows < ParallelThreshold ? 1 : qMin(QThread::idealThreadCount(), m_rows / MinChunkRows);
+    if (chunks <= 1) {
+        std::stable_sort(order.begin(), order.end(), less);
+        return order;
+    }
+
+    // Sort contiguous chunks in parallel, then merge neighbours level by level; both steps
+    // keep equal rows in their original order
+    std::vector<int> bounds(chunks + 1);
+    for (int i = 0; i <= chunks; ++i)
+        bounds[i] = int(qint64(m_rows) * i / chunks);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(chunks);
+    for (int i = 0; i < chunks; ++i) {
+        pool.start([&order, &bounds, &less, i] {
+            std::stable_sort(order.begin() + bounds[i], order.begin() + bounds[i + 1], less);
+        });
+    }
+    pool.waitForDone();
+
+    for (int width = 1; width < chunks; width *= 2) {
+        for (int i = 0; i + width < chunks; i += 2 * width) {
+            const int first = bounds[i];
+            const int middle = bounds[i + width];
+            const int last = bounds[qMin(i + 2 * width, chunks)];
+            pool.start([&order, &less, first, middle, last] {
+                std::inplace_merge(order.begin() + first, order.begin() + middle, order.begin() + last, less);
+            });
+        }
+        pool.waitForDone();
+    }
+    return order;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+#include <vector>
+
+// Multi-key ordering of model rows.
+//
+// Text columns are collated once per distinct string (QCollatorSortKey, natural and
+// case-insensitive as in the file browser) and replaced by each string's rank, so the sort
+// itself only compares integers. Empty strings go last in either direction. The sort is
+// stable and splits large inputs across cores.
+//
+//     RowSorter sorter(rows);
+//     sorter.addText(artists);
+//     sorter.addNumber(trackNumbers);
+//     const std::vector<int> order = sorter.order(); // order[newRow] == oldRow
+class RowSorter {
+public:
+    explicit RowSorter(int rows);
+
+    // values.size() must equal the row count
+    void addText(const QVector<QString>& values, Qt::SortOrder order = Qt::AscendingOrder);
+    void addNumber(const QVector<qint64>& values, Qt::SortOrder order = Qt::AscendingOrder);
+
+    std::vector<int> order() const;
+
+private:
+    int m_rows;
+    // One value per row and key, compared as integers; descending keys are stored negated
+    std::vector<std::vector<qint64>> m_columns;
+};
@@ -0,0 +1,449 @@
+#include "SeekIndex.h"
+#include "FastTagReader.h"
+#include "FormatSniffer.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QThread>
+#include <QtEndian>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace {
+
+// Stored in native byte order like the session files
+constexpr quint32 IndexMagic = 0x4953504d; // "MPSI"
+constexpr quint32 FormatVersion = 1;
+
+// A FLAC SEEKTABLE sparser than this on average is replaced by a scan
+constexpr quint64 MaxSeekTableSpacingSeconds = 10;
+// How far past the estimated offset the FLAC scan looks for the next frame header
+constexpr qint64 FlacSearchWindow = 256 * 1024;
+// Decoded indexes kept in memory; a 3-hour file is ~170 KiB
+constexpr int MemoryCacheEntries = 32;
+
+struct CacheHeader {
+    quint32 magic;
+    quint32 version;
+    qint32 sampleRate;
+    qint32 samplesPerFrame;
+    qint64 fileSize;
+    qint64 mtimeMs;
+    quint64 totalSamples;
+    quint64 pointCount;
+};
+static_assert(sizeof(CacheHeader) == 48, "cache header is fixed-size");
+
+quint32 le32(const uchar* p)
+{
+    return qFromLittleEndian<quint32>(p);
+}
+
+bool sameStream(const MpegFrameHeader& a, const MpegFrameHeader& b)
+{
+    return a.version == b.version && a.layer == b.layer && a.sampleRate == b.sampleRate;
+}
+
+// A frame header that is followed by another one (or the end of the audio); a lone valid
+// header inside junk or tag data is too likely to be a false sync
+bool mpegFrameAt(const uchar* data, qint64 pos, qint64 end, const MpegFrameHeader* stream, MpegFrameHeader& h)
+{
+    if (pos + 4 > end || data[pos] != 0xFF || !FastTagReader::parseMpegFrameHeader(data + pos, h))
+        return false;
+    if (stream && !sameStream(*stream, h))
+        return false;
+    const qint64 next = pos + h.frameLength;
+    if (next > end)
+        return false;
+    if (next + 4 > end)
+        return true;
+    MpegFrameHeader following;
+    return FastTagReader::parseMpegFrameHeader(data + next, following) && sameStream(h, following);
+}
+
+qint64 findMpegFrame(const uchar* data, qint64 from, qint64 end, const MpegFrameHeader* stream, MpegFrameHeader& h)
+{
+    for (qint64 pos = from; pos + 4 <= end; ++pos) {
+        const void* ff = std::memchr(data + pos, 0xFF, size_t(end - pos));
+        if (!ff) break;
+        pos = static_cast<const uchar*>(ff) - data;
+        if (mpegFrameAt(data, pos, end, stream, h))
+            return pos;
+    }
+    return -1;
+}
+
+// LAME/Xing and VBRI headers sit in a frame of silence that decoders don't output
+bool isInfoFrame(const uchar* data, qint64 frame, qint64 end, const MpegFrameHeader& h)
+{
+    const qint64 xing = frame + 4 + h.sideInfoSize;
+    if (xing + 4 <= end
+        && (std::memcmp(data + xing, "Xing", 4) == 0 || std::memcmp(data + xing, "Info", 4) == 0))
+        return true;
+    return frame + 40 <= end && std::memcmp(data + frame + 36, "VBRI", 4) == 0;
+}
+
+// Audio ends before ID3v1 and APEv2 tags
+qint64 mpegAudioEnd(const uchar* data, qint64 size)
+{
+    qint64 end = size;
+    if (end >= 128 && std::memcmp(data + end - 128, "TAG", 3) == 0)
+        end -= 128;
+    if (end >= 32 && std::memcmp(data + end - 32, "APETAGEX", 8) == 0) {
+        const qint64 tagSize = le32(data + end - 32 + 12);
+        const bool hasHeader = le32(data + end - 32 + 20) & 0x80000000u;
+        end -= qMin(end, tagSize + (hasHeader ? 32 : 0));
+    }
+    return end;
+}
+
+quint8 crc8(const uchar* data, qint64 size)
+{
+    // Polynomial x^8 + x^2 + x + 1, as used by FLAC frame headers
+    static const auto table = [] {
+        std::array<quint8, 256> t {};
+        for (int i = 0; i < 256; ++i) {
+            quint8 c = quint8(i);
+            for (int bit = 0; bit < 8; ++bit)
+                c = (c & 0x80) ? quint8((c << 1) ^ 0x07) : quint8(c << 1);
+            t[size_t(i)] = c;
+        }
+        return t;
+    }();
+    quint8 crc = 0;
+    for (qint64 i = 0; i < size; ++i)
+        crc = table[crc ^ data[i]];
+    return crc;
+}
+
+// Validates a FLAC frame header at p and returns the first sample of the frame.
+// Fixed-blocksize streams code the frame number, variable ones the sample number.
+bool flacFrameAt(const uchar* p, qint64 available, int blockSize, quint64& sample)
+{
+    if (available < 6 || p[0] != 0xFF || (p[1] & 0xFE) != 0xF8)
+        return false;
+    const bool variable = p[1] & 0x01;
+    const int blockCode = p[2] >> 4;
+    const int rateCode = p[2] & 0x0F;
+    const int channels = p[3] >> 4;
+    const int sampleSize = (p[3] >> 1) & 0x07;
+    if (blockCode == 0 || rateCode == 15 || channels > 10 || sampleSize == 3 || (p[3] & 0x01))
+        return false;
+
+    // UTF-8 style coded number: the leading ones give the count of continuation bytes
+    quint64 number = p[4];
+    qint64 at = 5;
+    if (number & 0x80) {
+        uchar mask = 0x40;
+        int extra = 0;
+        while (number & mask) {
+            ++extra;
+            mask >>= 1;
+        }
+        if (extra == 0 || extra > 6 || 5 + extra > available)
+            return false;
+        number &= mask - 1;
+        for (int i = 0; i < extra; ++i, ++at) {
+            if ((p[at] & 0xC0) != 0x80)
+                return false;
+            number = (number << 6) | (p[at] & 0x3F);
+        }
+    }
+
+    if (blockCode == 6) at += 1;
+    else if (blockCode == 7) at += 2;
+    if (rateCode == 12) at += 1;
+    else if (rateCode == 13 || rateCode == 14) at += 2;
+    if (at >= available || crc8(p, at) != p[at])
+        return false;
+
+    sample = variable ? number : number * quint64(blockSize);
+    return true;
+}
+
+} // namespace
+
+std::shared_ptr<const SeekIndex> SeekIndex::build(const QString& filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return nullptr;
+    const qint64 size = file.size();
+    if (size <= 0)
+        return nullptr;
+    // Only the pages the walk touches are read; for FLAC that is a few per second of audio
+    const uchar* data = file.map(0, size);
+    if (!data)
+        return nullptr;
+
+    auto index = std::make_shared<SeekIndex>();
+    index->m_fileSize = size;
+    index->m_mtimeMs = QFileInfo(file).lastModified().toMSecsSinceEpoch();
+
+    bool ok = false;
+    switch (FormatSniffer::sniff(data, size)) {
+    case AudioFormat::Mpeg: ok = index->buildMpeg(data, size); break;
+    case AudioFormat::Flac: ok = index->buildFlac(data, size); break;
+    default: break;
+    }
+    file.unmap(const_cast<uchar*>(data));
+
+    if (!ok || index->m_points.empty() || index->m_sampleRate <= 0)
+        return nullptr;
+    return index;
+}
+
+bool SeekIndex::buildMpeg(const uchar* data, qint64 size)
+{
+    const qint64 end = mpegAudioEnd(data, size);
+    MpegFrameHeader stream;
+    qint64 frame = findMpegFrame(data, qMin(end, FastTagReader::id3v2TagSize(data, size)), end, nullptr, stream);
+    if (frame < 0)
+        return false;
+
+    m_sampleRate = stream.sampleRate;
+    m_samplesPerFrame = stream.samplesPerFrame;
+    if (isInfoFrame(data, frame, end, stream))
+        frame += stream.frameLength;
+
+    quint64 samples = 0;
+    quint64 nextPoint = 0;
+    MpegFrameHeader h;
+    while (frame >= 0 && frame + 4 <= end) {
+        if (data[frame] != 0xFF || !FastTagReader::parseMpegFrameHeader(data + frame, h)
+            || !sameStream(stream, h) || frame + h.frameLength > end) {
+            // Junk between frames: skip to the next pair of consistent headers
+            frame = findMpegFrame(data, frame + 1, end, &stream, h);
+            continue;
+        }
+        if (samples >= nextPoint) {
+            m_points.push_back({samples, frame});
+            nextPoint = samples + quint64(m_sampleRate);
+        }
+        samples += quint64(h.samplesPerFrame);
+        frame += h.frameLength;
+    }
+    m_totalSamples = samples;
+    return true;
+}
+
+bool SeekIndex::buildFlac(const uchar* data, qint64 size)
+{
+    qint64 pos = FastTagReader::id3v2TagSize(data, size);
+    if (pos + 4 > size || std::memcmp(data + pos, "fLaC", 4) != 0)
+        return false;
+    pos += 4;
+
+    int minBlock = 0;
+    int maxBlock = 0;
+    std::vector<Point> table;
+    bool last = false;
+    while (!last && pos + 4 <= size) {
+        last = data[pos] & 0x80;
+        const int type = data[pos] & 0x7F;
+        const qint64 length = qFromBigEndian<quint32>(data + pos) & 0xFFFFFF;
+        const qint64 body = pos + 4;
+        if (body + length > size)
+            return false;
+
+        if (type == 0 && length >= 18) {
+            minBlock = qFromBigEndian<quint16>(data + body);
+            maxBlock = qFromBigEndian<quint16>(data + body + 2);
+            const quint64 bits = qFromBigEndian<quint64>(data + body + 10);
+            m_sampleRate = int(bits >> 44);
+            m_totalSamples = bits & 0xFFFFFFFFFull;
+        } else if (type == 3) {
+            // 18-byte points; offsets are relative to the first frame, placeholders are all ones
+            for (qint64 p = body; p + 18 <= body + length; p += 18) {
+                const quint64 sample = qFromBigEndian<quint64>(data + p);
+                if (sample != ~quint64(0))
+                    table.push_back({sample, qint64(qFromBigEndian<quint64>(data + p + 8))});
+            }
+        }
+        pos = body + length;
+    }
+    const qint64 firstFrame = pos;
+    if (m_sampleRate <= 0 || maxBlock <= 0 || firstFrame >= size)
+        return false;
+
+    quint64 firstSample = 0;
+    if (!flacFrameAt(data + firstFrame, size - firstFrame, maxBlock, firstSample))
+        return false;
+    const bool variable = data[firstFrame + 1] & 0x01;
+    m_samplesPerFrame = !variable && minBlock == maxBlock ? maxBlock : 0;
+
+    // Trust the SEEKTABLE only where its points land on real frame headers
+    const quint64 maxSpacing = MaxSeekTableSpacingSeconds * quint64(m_sampleRate);
+    for (const Point& point : table) {
+        const qint64 offset = firstFrame + point.offset;
+        quint64 sample = 0;
+        if (offset < 0 || offset >= size || !flacFrameAt(data + offset, size - offset, maxBlock, sample)
+            || sample != point.sample)
+            continue;
+        if (m_points.empty() || (point.sample > m_points.back().sample && offset > m_points.back().offset))
+            m_points.push_back({point.sample, offset});
+    }
+    bool dense = !m_points.empty() && m_points.front().sample == 0;
+    for (size_t i = 1; dense && i < m_points.size(); ++i)
+        dense = m_points[i].sample - m_points[i - 1].sample <= maxSpacing;
+    if (dense && m_totalSamples > 0)
+        dense = m_totalSamples - m_points.back().sample <= maxSpacing;
+    if (dense)
+        return true;
+
+    // Estimate where each second starts from the average bitrate, then take the first
+    // valid frame header from there on
+    if (m_totalSamples == 0)
+        return false;
+    m_points.clear();
+    m_points.push_back({firstSample, firstFrame});
+    const double bytesPerSample = double(size - firstFrame) / double(m_totalSamples);
+    qint64 searchFrom = firstFrame + 1;
+    for (quint64 target = quint64(m_sampleRate); target < m_totalSamples; target += quint64(m_sampleRate)) {
+        qint64 p = qMax(searchFrom, firstFrame + qint64(double(target) * bytesPerSample));
+        const qint64 limit = qMin(size, p + FlacSearchWindow);
+        quint64 sample = 0;
+        for (; p < limit; ++p) {
+            const void* ff = std::memchr(data + p, 0xFF, size_t(limit - p));
+            if (!ff) {
+                p = limit;
+                break;
+            }
+            p = static_cast<const uchar*>(ff) - data;
+            if (flacFrameAt(data + p, size - p, maxBlock, sample) && sample > m_points.back().sample
+                && sample < m_totalSamples)
+                break;
+        }
+        if (p >= limit)
+            continue;
+        m_points.push_back({sample, p});
+        searchFrom = p + 1;
+    }
+    return true;
+}
+
+std::shared_ptr<const SeekIndex> SeekIndex::load(const QString& cachePath, qint64 fileSize, qint64 mtimeMs)
+{
+    QFile file(cachePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return nullptr;
+    const QByteArray bytes = file.readAll();
+
+    CacheHeader header;
+    if (bytes.size() < qsizetype(sizeof(header)))
+        return nullptr;
+    std::memcpy(&header, bytes.constData(), sizeof(header));
+    if (header.magic != IndexMagic || header.version != FormatVersion
+        || header.fileSize != fileSize || header.mtimeMs != mtimeMs || header.sampleRate <= 0
+        || quint64(bytes.size()) - sizeof(header) != header.pointCount * sizeof(Point))
+        return nullptr;
+
+    auto index = std::make_shared<SeekIndex>();
+    index->m_sampleRate = header.sampleRate;
+    index->m_samplesPerFrame = header.samplesPerFrame;
+    index->m_totalSamples = header.totalSamples;
+    index->m_fileSize = header.fileSize;
+    index->m_mtimeMs = header.mtimeMs;
+    index->m_points.resize(size_t(header.pointCount));
+    std::memcpy(index->m_points.data(), bytes.constData() + sizeof(header), header.pointCount * sizeof(Point));
+    return index;
+}
+
+bool SeekIndex::save(const QString& cachePath) const
+{
+    const CacheHeader header {IndexMagic, FormatVersion, m_sampleRate, m_samplesPerFrame,
+                              m_fileSize, m_mtimeMs, m_totalSamples, quint64(m_points.size())};
+    QSaveFile file(cachePath);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(m_points.data()), qint64(m_points.size() * sizeof(Point)));
+    return file.commit();
+}
+
+qint64 SeekIndex::durationMs() const
+{
+    return m_sampleRate > 0 ? qint64(m_totalSamples * 1000 / quint64(m_sampleRate)) : 0;
+}
+
+qint64 SeekIndex::frameStartMs(qint64 positionMs) const
+{
+    if (m_samplesPerFrame <= 0 || m_sampleRate <= 0 || positionMs <= 0)
+        return positionMs;
+    const quint64 sample = quint64(positionMs) * quint64(m_sampleRate) / 1000;
+    const quint64 frameStart = sample - sample % quint64(m_samplesPerFrame);
+    return qint64((frameStart * 1000 + quint64(m_sampleRate) - 1) / quint64(m_sampleRate));
+}
+
+qint64 SeekIndex::offsetFor(qint64 positionMs) const
+{
+    if (m_points.empty())
+        return 0;
+    const quint64 sample = quint64(qMax<qint64>(0, positionMs)) * quint64(m_sampleRate) / 1000;
+    auto it = std::upper_bound(m_points.begin(), m_points.end(), sample,
+                               [](quint64 s, const Point& p) { return s < p.sample; });
+    return it == m_points.begin() ? m_points.front().offset : std::prev(it)->offset;
+}
+
+SeekIndexer::SeekIndexer(const QString& cacheDirectory, QObject* parent)
+    : QObject(parent)
+    , m_cacheDirectory(cacheDirectory)
+{
+    // Indexing reads whole MP3 files; keep it to one at a time and out of playback's way
+    m_pool.setMaxThreadCount(1);
+    m_pool.setThreadPriority(QThread::LowPriority);
+}
+
+SeekIndexer::~SeekIndexer()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+std::shared_ptr<const SeekIndex> SeekIndexer::indexFor(const QString& filePath)
+{
+    const auto it = m_indexes.constFind(filePath);
+    if (it != m_indexes.constEnd())
+        return it.value();
+    if (m_pending.contains(filePath))
+        return nullptr;
+
+    m_pending.insert(filePath);
+    const QString cachePath = m_cacheDirectory + QLatin1Char('/')
+        + QString::fromLatin1(QCryptographicHash::hash(filePath.toUtf8(), QCryptographicHash::Sha1).toHex())
+        + QStringLiteral(".idx");
+    const QString cacheDirectory = m_cacheDirectory;
+
+    m_pool.start([this, filePath, cachePath, cacheDirectory] {
+        const QFileInfo info(filePath);
+        std::shared_ptr<const SeekIndex> index =
+            SeekIndex::load(cachePath, info.size(), info.lastModified().toMSecsSinceEpoch());
+        if (!index) {
+            index = SeekIndex::build(filePath);
+            if (index && (!QDir().mkpath(cacheDirectory) || !index->save(cachePath)))
+                qWarning() << "Failed to write seek index:" << cachePath;
+        }
+        QMetaObject::invokeMethod(this, [this, filePath, index] {
+            insert(filePath, index);
+            emit indexReady(filePath);
+        }, Qt::QueuedConnection);
+    });
+    return nullptr;
+}
+
+void SeekIndexer::insert(const QString& filePath, std::shared_ptr<const SeekIndex> index)
+{
+    m_pending.remove(filePath);
+    if (!m_indexes.contains(filePath))
+        m_order.append(filePath);
+    m_indexes.insert(filePath, std::move(index));
+    while (m_order.size() > MemoryCacheEntries)
+        m_indexes.remove(m_order.takeFirst());
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+
+#include <memory>
+#include <vector>
+
+// Time -> byte offset table for one file, roughly one point per second of audio.
+// MP3: every frame header is walked (VBR files have no other reliable mapping). FLAC: the
+// SEEKTABLE when it is dense enough, otherwise frame headers located by a strided scan and
+// validated by their CRC-8. Immutable once built, so it is shared between threads as
+// shared_ptr<const SeekIndex>.
+class SeekIndex {
+public:
+    struct Point {
+        quint64 sample = 0;
+        qint64 offset = 0; // of the frame starting at or after sample
+    };
+
+    // Null for unsupported formats and files that can't be read or parsed
+    static std::shared_ptr<const SeekIndex> build(const QString& filePath);
+    // Null if the cache file is missing, corrupt or was built for a different file version
+    static std::shared_ptr<const SeekIndex> load(const QString& cachePath, qint64 fileSize, qint64 mtimeMs);
+    bool save(const QString& cachePath) const;
+
+    int sampleRate() const { return m_sampleRate; }
+    quint64 totalSamples() const { return m_totalSamples; }
+    qint64 durationMs() const;
+    const std::vector<Point>& points() const { return m_points; }
+
+    // Start of the frame containing positionMs, rounded up to whole milliseconds so the
+    // backend lands in that frame. Unchanged for variable-blocksize FLAC.
+    qint64 frameStartMs(qint64 positionMs) const;
+    // Offset of the last indexed frame at or before positionMs, O(log n)
+    qint64 offsetFor(qint64 positionMs) const;
+
+private:
+    bool buildMpeg(const uchar* data, qint64 size);
+    bool buildFlac(const uchar* data, qint64 size);
+
+    int m_sampleRate {0};
+    int m_samplesPerFrame {0}; // 0 when frames vary in length
+    quint64 m_totalSamples {0};
+    qint64 m_fileSize {0};
+    qint64 m_mtimeMs {0};
+    std::vector<Point> m_points; // ascending by sample and offset
+};
+
+// Builds seek indexes on a low-priority background thread, one file at a time, and keeps
+// them under the cache directory across runs. GUI thread only.
+class SeekIndexer : public QObject {
+    Q_OBJECT
+
+public:
+    explicit SeekIndexer(const QString& cacheDirectory, QObject* parent = nullptr);
+    ~SeekIndexer() override;
+
+    // The index if it is already in memory; otherwise loads or builds it in the background
+    // and returns null (indexReady follows)
+    std::shared_ptr<const SeekIndex> indexFor(const QString& filePath);
+
+signals:
+    void indexReady(const QString& filePath);
+
+private:
+    void insert(const QString& filePath, std::shared_ptr<const SeekIndex> index);
+
+    QString m_cacheDirectory;
+    QThreadPool m_pool;
+    // Null entries record files that can't be indexed so they aren't retried
+    QHash<QString, std::shared_ptr<const SeekIndex>> m_indexes;
+    QStringList m_order; // least recently inserted first
+    QSet<QString> m_pending;
+};
@@ -0,0 +1,607 @@
+#include "SessionStore.h"
+#include "PlaylistModel.h"
+#include "SmartPlaylist.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Stored in native byte order; a snapshot from a machine of the other endianness fails
+// the magic check and is ignored
+constexpr quint32 IndexMagic = 0x5353504d;    // "MPSS"
+constexpr quint32 PlaylistMagic = 0x4c50504d; // "MPPL"
+constexpr quint32 JournalMagic = 0x524a504d;  // "MPJR"
+constexpr quint32 FormatVersion = 1;
+// session.dat only; 2 added each tab's smart playlist rule
+constexpr quint32 IndexVersion = 2;
+
+constexpr int SaveDebounceMs = 1000;
+constexpr qint64 JournalIntervalMs = 1000;
+// Fold the journal into session.dat once it holds this many records (64 KiB)
+constexpr int JournalCompactRecords = 4096;
+
+struct JournalRecord {
+    quint32 magic;
+    qint32 index;
+    qint64 positionMs;
+};
+static_assert(sizeof(JournalRecord) == 16, "journal records are fixed-size");
+
+void appendU32(QByteArray& out, quint32 v)
+{
+    out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+void appendI64(QByteArray& out, qint64 v)
+{
+    out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+// Length in UTF-16 units, the data, then padding so every record stays 4-byte aligned
+void appendString(QByteArray& out, const QString& s)
+{
+    const quint32 length = quint32(s.size());
+    appendU32(out, length);
+    out.append(reinterpret_cast<const char*>(s.utf16()), qsizetype(length) * 2);
+    if (length & 1)
+        out.append(2, '\0');
+}
+
+class SnapshotReader {
+public:
+    SnapshotReader(const uchar* data, qint64 size, bool inPlace)
+        : m_pos(data), m_end(data + size), m_inPlace(inPlace) {}
+
+    bool ok() const { return m_ok; }
+
+    quint32 u32()
+    {
+        quint32 v = 0;
+        read(&v, sizeof(v));
+        return v;
+    }
+
+    qint64 i64()
+    {
+        qint64 v = 0;
+        read(&v, sizeof(v));
+        return v;
+    }
+
+    QString string()
+    {
+        const quint32 length = u32();
+        const qint64 bytes = (qint64(length) * 2 + 3) & ~qint64(3);
+        if (!m_ok || m_end - m_pos < bytes) {
+            m_ok = false;
+            return QString();
+        }
+        const QChar* chars = reinterpret_cast<const QChar*>(m_pos);
+        m_pos += bytes;
+        if (length == 0)
+            return QString();
+        // In place: no allocation, the string points into the mapping (copy-on-write)
+        return m_inPlace ? QString::fromRawData(chars, length) : QString(chars, length);
+    }
+
+private:
+    void read(void* out, size_t n)
+    {
+        if (!m_ok || size_t(m_end - m_pos) < n) {
+            m_ok = false;
+            return;
+        }
+        std::memcpy(out, m_pos, n);
+        m_pos += n;
+    }
+
+    const uchar* m_pos;
+    const uchar* m_end;
+    bool m_inPlace;
+    bool m_ok {true};
+};
+
+void writeFile(const QString& path, const QByteArray& data)
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit())
+        qWarning() << "Failed to write session file:" << path << file.errorString();
+}
+
+} // namespace
+
+SessionStore::SessionStore(const QString& directory, QObject* parent)
+    : QAbstractListModel(parent)
+    , m_directory(directory)
+{
+    m_writer.setMaxThreadCount(1);
+    m_saveTimer.setSingleShot(true);
+    m_saveTimer.setInterval(SaveDebounceMs);
+    connect(&m_saveTimer, &QTimer::timeout, this, &SessionStore::save);
+    m_sinceJournal.start();
+}
+
+SessionStore::~SessionStore()
+{
+    m_writer.waitForDone();
+    // Restored rows point into m_mappings, so the models go before the mappings do
+    for (Tab& tab : m_tabs)
+        delete tab.model;
+}
+
+int SessionStore::rowCount(const QModelIndex& parent) const
+{
+    if (parent.isValid()) return 0;
+    return m_tabs.size();
+}
+
+QVariant SessionStore::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() < 0 || index.row() >= m_tabs.size())
+        return {};
+    const auto& tab = m_tabs.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+    case NameRole:
+        return tab.name;
+    case TracksRole:
+        return QVariant::fromValue(tab.model);
+    case QueryRole:
+        return tab.query;
+    default:
+        return {};
+    }
+}
+
+QHash<int, QByteArray> SessionStore::roleNames() const
+{
+    QHash<int, QByteArray> r;
+    r[NameRole] = "name";
+    r[TracksRole] = "tracks";
+    r[QueryRole] = "query";
+    return r;
+}
+
+void SessionStore::load()
+{
+    QDir().mkpath(m_directory);
+
+    beginResetModel();
+    if (loadIndex()) {
+        for (Tab& tab : m_tabs) {
+            if (!loadPlaylist(tab))
+                qWarning() << "Discarding unreadable playlist snapshot:" << playlistPath(tab.id);
+        }
+        replayJournal();
+    } else {
+        m_tabs.clear();
+        appendTab(m_nextId++, QStringLiteral("Queue"));
+        appendTab(m_nextId++, QStringLiteral("Playlist 1"));
+        m_currentTab = 0;
+        m_currentIndex = -1;
+        m_position = 0;
+    }
+    endResetModel();
+    emit countChanged();
+
+    // Regular tabs first, so smart playlists start from the whole library
+    for (Tab& tab : m_tabs) {
+        if (tab.query.isEmpty())
+            attach(tab);
+    }
+    for (Tab& tab : m_tabs) {
+        if (!tab.query.isEmpty())
+            attach(tab);
+    }
+
+    m_currentTab = qBound(0, m_currentTab, m_tabs.size() - 1);
+    if (m_currentIndex >= queue()->count())
+        m_currentIndex = -1;
+    m_restoredIndex = m_currentIndex;
+    m_restoredPosition = m_currentIndex >= 0 ? m_position : 0;
+}
+
+void SessionStore::flush()
+{
+    m_saveTimer.stop();
+    m_indexDirty = true;
+    save();
+    m_writer.waitForDone();
+}
+
+PlaylistModel* SessionStore::playlistAt(int index) const
+{
+    if (index < 0 || index >= m_tabs.size()) return nullptr;
+    return m_tabs.at(index).model;
+}
+
+int SessionStore::addPlaylist(const QString& name)
+{
+    const int row = m_tabs.size();
+    beginInsertRows(QModelIndex(), row, row);
+    appendTab(m_nextId++, name.isEmpty() ? unusedName(QStringLiteral("Playlist")) : name);
+    endInsertRows();
+    emit countChanged();
+    attach(m_tabs[row]);
+
+    m_tabs[row].dirty = true;
+    markIndexDirty();
+    return row;
+}
+
+QString SessionStore::unusedName(const QString& prefix) const
+{
+    for (int n = 1;; ++n) {
+        const QString name = QStringLiteral("%1 %2").arg(prefix).arg(n);
+        const bool taken = std::any_of(m_tabs.cbegin(), m_tabs.cend(), [&name](const Tab& tab) { return tab.name == name; });
+        if (!taken)
+            return name;
+    }
+}
+
+void SessionStore::removePlaylist(int index)
+{
+    // The queue is permanent
+    if (index <= 0 || index >= m_tabs.size()) return;
+
+    beginRemoveRows(QModelIndex(), index, index);
+    const Tab tab = m_tabs.takeAt(index);
+    endRemoveRows();
+    emit countChanged();
+    m_library.unwatch(tab.model);
+    tab.model->deleteLater();
+
+    if (m_currentTab >= m_tabs.size()) {
+        m_currentTab = m_tabs.size() - 1;
+        emit currentTabChanged();
+    } else if (index < m_currentTab) {
+        // Same tab, one row up
+        --m_currentTab;
+        emit currentTabChanged();
+    }
+
+    // session.dat stops listing it first, then the snapshot goes
+    m_writer.start([indexFile = indexPath(), indexData = serializeIndex(), snapshot = playlistPath(tab.id)] {
+        writeFile(indexFile, indexData);
+        QFile::remove(snapshot);
+    });
+    m_indexDirty = false;
+}
+
+void SessionStore::renamePlaylist(int index, const QString& name)
+{
+    if (index < 0 || index >= m_tabs.size() || name.isEmpty() || m_tabs[index].name == name) return;
+    m_tabs[index].name = name;
+    const QModelIndex idx = createIndex(index, 0);
+    emit dataChanged(idx, idx, {NameRole});
+    markIndexDirty();
+}
+
+int SessionStore::addSmartPlaylist(const QString& name, const QString& query)
+{
+    if (!queryError(query).isEmpty()) return -1;
+
+    const int row = m_tabs.size();
+    beginInsertRows(QModelIndex(), row, row);
+    appendTab(m_nextId++, name.isEmpty() ? unusedName(QStringLiteral("Smart")) : name, query.trimmed());
+    endInsertRows();
+    emit countChanged();
+    attach(m_tabs[row]);
+
+    m_tabs[row].dirty = true;
+    markIndexDirty();
+    return row;
+}
+
+bool SessionStore::setQuery(int index, const QString& query)
+{
+    if (index <= 0 || index >= m_tabs.size() || !m_tabs[index].smart) return false;
+    Tab& tab = m_tabs[index];
+    if (!tab.smart->setQuery(query)) return false;
+    if (tab.query == tab.smart->query()) return true;
+    tab.query = tab.smart->query();
+    const QModelIndex idx = createIndex(index, 0);
+    emit dataChanged(idx, idx, {QueryRole});
+    markIndexDirty();
+    return true;
+}
+
+QString SessionStore::queryAt(int index) const
+{
+    if (index < 0 || index >= m_tabs.size()) return QString();
+    return m_tabs.at(index).query;
+}
+
+QString SessionStore::queryError(const QString& query) const
+{
+    return SmartQuery::parse(query).errorString();
+}
+
+void SessionStore::applyTagEdits(const QList<QUrl>& files, const QVariantMap& fields)
+{
+    QSet<QString> locations;
+    for (const QUrl& url : files)
+        locations.insert(url.toLocalFile());
+    // Models mark themselves dirty through dataChanged; smart playlists follow the library
+    for (const Tab& tab : std::as_const(m_tabs)) {
+        if (!tab.smart)
+            tab.model->applyTagEdits(locations, fields);
+    }
+}
+
+void SessionStore::setCurrentTab(int index)
+{
+    if (index < 0 || index >= m_tabs.size() || index == m_currentTab) return;
+    m_currentTab = index;
+    emit currentTabChanged();
+    markIndexDirty();
+}
+
+void SessionStore::setCurrentIndex(int index)
+{
+    if (index == m_currentIndex) return;
+    m_currentIndex = index;
+    m_position = 0;
+    emit currentIndexChanged();
+    appendJournal();
+}
+
+void SessionStore::setPosition(qint64 positionMs)
+{
+    m_position = positionMs;
+    if (m_sinceJournal.elapsed() >= JournalIntervalMs)
+        appendJournal();
+}
+
+int SessionStore::appendTab(quint32 id, const QString& name, const QString& query)
+{
+    auto* model = new PlaylistModel(this);
+    m_tabs.append({id, name, model, false, query});
+
+    auto changed = [this, model] { markDirty(model); };
+    connect(model, &QAbstractItemModel::rowsInserted, this, changed);
+    connect(model, &QAbstractItemModel::rowsRemoved, this, changed);
+    connect(model, &QAbstractItemModel::rowsMoved, this, changed);
+    connect(model, &QAbstractItemModel::layoutChanged, this, changed);
+    connect(model, &QAbstractItemModel::modelReset, this, changed);
+    connect(model, &QAbstractItemModel::dataChanged, this, changed);
+    return m_tabs.size() - 1;
+}
+
+// Regular tabs feed the library; smart tabs are filled from it
+void SessionStore::attach(Tab& tab)
+{
+    if (tab.query.isEmpty()) {
+        m_library.watch(tab.model);
+        return;
+    }
+    tab.smart = new SmartPlaylist(&m_library, tab.model);
+    if (!tab.smart->setQuery(tab.query))
+        qWarning() << "Smart playlist rule no longer parses:" << tab.query << queryError(tab.query);
+}
+
+void SessionStore::markDirty(PlaylistModel* model)
+{
+    for (Tab& tab : m_tabs) {
+        if (tab.model == model) {
+            tab.dirty = true;
+            m_saveTimer.start();
+            return;
+        }
+    }
+}
+
+void SessionStore::markIndexDirty()
+{
+    m_indexDirty = true;
+    m_saveTimer.start();
+}
+
+void SessionStore::save()
+{
+    // Serialize here so each write is a consistent snapshot; the I/O happens on the writer
+    for (Tab& tab : m_tabs) {
+        if (!tab.dirty) continue;
+        tab.dirty = false;
+        m_writer.start([path = playlistPath(tab.id), data = serializePlaylist(tab.model)] {
+            writeFile(path, data);
+        });
+    }
+
+    if (m_indexDirty) {
+        m_indexDirty = false;
+        m_journalRecords = 0;
+        // session.dat now carries the latest index/position, so the journal can start over
+        m_writer.start([path = indexPath(), data = serializeIndex(), journal = journalPath()] {
+            writeFile(path, data);
+            QFile::resize(journal, 0);
+        });
+    }
+}
+
+void SessionStore::appendJournal()
+{
+    m_sinceJournal.restart();
+    const JournalRecord record {JournalMagic, qint32(m_currentIndex), m_position};
+    m_writer.start([path = journalPath(), record] {
+        QFile file(path);
+        if (file.open(QIODevice::WriteOnly | QIODevice::Append))
+            file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+    });
+
+    if (++m_journalRecords >= JournalCompactRecords)
+        markIndexDirty();
+}
+
+QString SessionStore::playlistPath(quint32 id) const
+{
+    return m_directory + QStringLiteral("/playlist-%1.dat").arg(id);
+}
+
+QString SessionStore::indexPath() const
+{
+    return m_directory + QStringLiteral("/session.dat");
+}
+
+QString SessionStore::journalPath() const
+{
+    return m_directory + QStringLiteral("/session.journal");
+}
+
+QByteArray SessionStore::serializeIndex() const
+{
+    QByteArray out;
+    appendU32(out, IndexMagic);
+    appendU32(out, IndexVersion);
+    appendU32(out, quint32(m_currentTab));
+    appendU32(out, quint32(m_currentIndex));
+    appendI64(out, m_position);
+    appendU32(out, m_nextId);
+    appendU32(out, quint32(m_tabs.size()));
+    for (const Tab& tab : m_tabs) {
+        appendU32(out, tab.id);
+        appendString(out, tab.name);
+        appendString(out, tab.query);
+    }
+    return out;
+}
+
+QByteArray SessionStore::serializePlaylist(const PlaylistModel* model)
+{
+    const auto& items = model->items();
+    QByteArray out;
+    out.reserve(16 + items.size() * 256);
+    appendU32(out, PlaylistMagic);
+    appendU32(out, FormatVersion);
+    appendU32(out, quint32(items.size()));
+    appendU32(out, 0); // reserved
+    for (const auto& item : items) {
+        appendU32(out, item.remote ? 1u : 0u);
+        appendU32(out, quint32(item.trackNumber));
+        appendI64(out, item.duration);
+        appendString(out, item.location);
+        appendString(out, item.display);
+        appendString(out, item.title);
+        appendString(out, item.artist);
+        appendString(out, item.album);
+        appendString(out, item.genre);
+        appendString(out, item.year);
+    }
+    return out;
+}
+
+bool SessionStore::loadIndex()
+{
+    QFile file(indexPath());
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    const QByteArray data = file.readAll();
+
+    // Small file, read normally; strings are copied since the buffer goes away
+    SnapshotReader in(reinterpret_cast<const uchar*>(data.constData()), data.size(), false);
+    if (in.u32() != IndexMagic) return false;
+    const quint32 version = in.u32();
+    if (version != 1 && version != IndexVersion) return false;
+    const int currentTab = int(in.u32());
+    const int currentIndex = int(in.u32());
+    const qint64 position = in.i64();
+    const quint32 nextId = in.u32();
+    const quint32 count = in.u32();
+    if (!in.ok() || count == 0) return false;
+
+    struct Entry {
+        quint32 id;
+        QString name;
+        QString query;
+    };
+    QVector<Entry> tabs;
+    for (quint32 i = 0; i < count && in.ok(); ++i) {
+        Entry entry;
+        entry.id = in.u32();
+        entry.name = in.string();
+        if (version >= 2)
+            entry.query = in.string();
+        tabs.append(entry);
+    }
+    if (!in.ok()) return false;
+
+    m_tabs.clear();
+    for (const Entry& tab : std::as_const(tabs))
+        appendTab(tab.id, tab.name, tab.query);
+    m_currentTab = currentTab;
+    m_currentIndex = currentIndex;
+    m_position = position;
+    m_nextId = nextId;
+    return true;
+}
+
+bool SessionStore::loadPlaylist(Tab& tab)
+{
+    auto file = std::make_unique<QFile>(playlistPath(tab.id));
+    if (!file->open(QIODevice::ReadOnly)) return false;
+    const qint64 size = file->size();
+    const uchar* data = size > 0 ? file->map(0, size) : nullptr;
+    if (!data) return false;
+
+#ifdef Q_OS_WIN
+    // A mapped file can't be replaced on Windows, so copy the strings and unmap right away
+    const bool inPlace = false;
+#else
+    // QSaveFile renames over the snapshot later; the mapping keeps the old inode alive
+    const bool inPlace = true;
+#endif
+
+    SnapshotReader in(data, size, inPlace);
+    if (in.u32() != PlaylistMagic || in.u32() != FormatVersion) return false;
+    const quint32 rows = in.u32();
+    in.u32(); // reserved
+    if (!in.ok()) return false;
+
+    QVector<PlaylistModel::Item> items;
+    items.reserve(int(qMin<quint64>(rows, quint64(size) / 44)));
+    for (quint32 i = 0; i < rows; ++i) {
+        PlaylistModel::Item item;
+        item.remote = in.u32() & 1;
+        item.trackNumber = int(in.u32());
+        item.duration = in.i64();
+        item.location = in.string();
+        item.display = in.string();
+        item.title = in.string();
+        item.artist = in.string();
+        item.album = in.string();
+        item.genre = in.string();
+        item.year = in.string();
+        if (!in.ok()) return false;
+        items.append(std::move(item));
+    }
+
+    // Loaded before any view exists; the reset is only bookkeeping
+    const QSignalBlocker blocker(tab.model);
+    tab.model->resetItems(std::move(items));
+    if (inPlace)
+        m_mappings.push_back(std::move(file));
+    return true;
+}
+
+void SessionStore::replayJournal()
+{
+    QFile file(journalPath());
+    if (!file.open(QIODevice::ReadOnly)) return;
+    const QByteArray data = file.readAll();
+
+    // Last complete record wins; a torn tail from a crash is ignored
+    const qsizetype records = data.size() / qsizetype(sizeof(JournalRecord));
+    for (qsizetype i = records - 1; i >= 0; --i) {
+        JournalRecord record;
+        std::memcpy(&record, data.constData() + i * sizeof(JournalRecord), sizeof(record));
+        if (record.magic != JournalMagic) continue;
+        m_currentIndex = record.index;
+        m_position = record.positionMs;
+        break;
+    }
+    m_journalRecords = int(records);
+}
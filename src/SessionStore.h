@@ -0,0 +1,144 @@
+#pragma once
+
+#include "LibraryIndex.h"
+
+#include <QAbstractListModel>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QString>
+#include <QThreadPool>
+#include <QTimer>
+#include <QUrl>
+#include <QVariantMap>
+#include <QVector>
+
+#include <memory>
+#include <vector>
+
+class PlaylistModel;
+class SmartPlaylist;
+
+// Owns the playlist tabs (tab 0 is the play queue) and persists them across launches.
+//
+// On disk, in the session directory:
+//   session.dat       tab ids/names/smart playlist rules, current tab, queue index and position
+//   playlist-<id>.dat one snapshot per tab: rows with every displayed field, UTF-16 strings
+//                     laid out so they can be used in place from the mapping
+//   session.journal   append-only (queue index, position) records written while playing
+//
+// Startup maps each snapshot and builds rows whose strings point into the mapping, so
+// restoring does no tag I/O and no string copies. Changed tabs are rewritten on a short
+// debounce with QSaveFile on a writer thread; the journal is folded into session.dat
+// whenever that is rewritten.
+//
+// Regular tabs (the queue included) make up the library; smart playlist tabs are filled from
+// it by their rule and follow its changes.
+class SessionStore : public QAbstractListModel {
+    Q_OBJECT
+    Q_PROPERTY(int count READ rowCount NOTIFY countChanged)
+    Q_PROPERTY(int currentTab READ currentTab WRITE setCurrentTab NOTIFY currentTabChanged)
+    Q_PROPERTY(int currentIndex READ currentIndex WRITE setCurrentIndex NOTIFY currentIndexChanged)
+    Q_PROPERTY(int restoredIndex READ restoredIndex CONSTANT)
+    Q_PROPERTY(qint64 restoredPosition READ restoredPosition CONSTANT)
+
+public:
+    explicit SessionStore(const QString& directory, QObject* parent = nullptr);
+    ~SessionStore() override;
+
+    enum Roles {
+        NameRole = Qt::UserRole + 1,
+        TracksRole,
+        QueryRole // smart playlist rule, empty for regular tabs
+    };
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    // Reads the previous session; falls back to an empty queue and one playlist
+    void load();
+    // Writes everything that is pending and waits for the writer (call on quit)
+    void flush();
+
+    PlaylistModel* queue() const { return m_tabs.isEmpty() ? nullptr : m_tabs.first().model; }
+    Q_INVOKABLE PlaylistModel* playlistAt(int index) const;
+    Q_INVOKABLE int addPlaylist(const QString& name = QString());
+    Q_INVOKABLE void removePlaylist(int index);
+    Q_INVOKABLE void renamePlaylist(int index, const QString& name);
+    // -1 when the rule does not parse (see queryError())
+    Q_INVOKABLE int addSmartPlaylist(const QString& name, const QString& query);
+    Q_INVOKABLE bool setQuery(int index, const QString& query);
+    Q_INVOKABLE QString queryAt(int index) const;
+    // Why a rule does not parse, or empty
+    Q_INVOKABLE QString queryError(const QString& query) const;
+
+    LibraryIndex* library() { return &m_library; }
+
+    int currentTab() const { return m_currentTab; }
+    void setCurrentTab(int index);
+    int currentIndex() const { return m_currentIndex; }
+    void setCurrentIndex(int index);
+    int restoredIndex() const { return m_restoredIndex; }
+    qint64 restoredPosition() const { return m_restoredPosition; }
+
+    // Playback position of the queue's current track; journaled at most once a second
+    void setPosition(qint64 positionMs);
+
+    // Brings every tab in line with a finished TagEditor batch
+    void applyTagEdits(const QList<QUrl>& files, const QVariantMap& fields);
+
+signals:
+    void countChanged();
+    void currentTabChanged();
+    void currentIndexChanged();
+
+private:
+    struct Tab {
+        quint32 id {0};
+        QString name;
+        PlaylistModel* model {nullptr};
+        bool dirty {false};
+        QString query;
+        SmartPlaylist* smart {nullptr}; // child of model
+    };
+
+    int appendTab(quint32 id, const QString& name, const QString& query = QString());
+    // "<prefix> <n>" with the lowest n no tab is named after
+    QString unusedName(const QString& prefix) const;
+    void attach(Tab& tab);
+    void markDirty(PlaylistModel* model);
+    void markIndexDirty();
+    void save();
+    void appendJournal();
+
+    QString playlistPath(quint32 id) const;
+    QString indexPath() const;
+    QString journalPath() const;
+
+    QByteArray serializeIndex() const;
+    static QByteArray serializePlaylist(const PlaylistModel* model);
+    bool loadIndex();
+    bool loadPlaylist(Tab& tab);
+    void replayJournal();
+
+    QString m_directory;
+    QVector<Tab> m_tabs;
+    quint32 m_nextId {1};
+    int m_currentTab {0};
+    int m_currentIndex {-1};
+    qint64 m_position {0};
+    int m_restoredIndex {-1};
+    qint64 m_restoredPosition {0};
+
+    bool m_indexDirty {false};
+    int m_journalRecords {0};
+    QElapsedTimer m_sinceJournal;
+    QTimer m_saveTimer;
+
+    // Snapshots stay mapped for the whole run: restored rows reference them directly
+    std::vector<std::unique_ptr<QFile>> m_mappings;
+    // Holds strings from the mappings, so it goes first
+    LibraryIndex m_library;
+    // Single thread so writes land in the order they were issued
+    QThreadPool m_writer;
+};
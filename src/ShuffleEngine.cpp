@@ -0,0 +1,329 @@
+#include "ShuffleEngine.h"
+#include "PlaylistModel.h"
+
+#include <QSettings>
+
+#include <algorithm>
+
+namespace {
+
+const char EnabledKey[] = "shuffle/enabled";
+const char SpreadKey[] = "shuffle/spread";
+const char NoRepeatKey[] = "shuffle/noRepeatWindow";
+
+// Picks checked for the same artist/album, and random candidates tried before giving up
+constexpr int SpreadTracks = 3;
+constexpr int SpreadAttempts = 8;
+// Entries of play history kept for previous()
+constexpr int HistoryLimit = 10000;
+
+bool validSpread(const QString& spread)
+{
+    return spread == QLatin1String("none") || spread == QLatin1String("artist") || spread == QLatin1String("album");
+}
+
+} // namespace
+
+ShuffleEngine::ShuffleEngine(PlaylistModel* queue, QObject* parent)
+    : QObject(parent)
+    , m_queue(queue)
+    , m_random(QRandomGenerator::global()->generate())
+{
+    const QSettings settings;
+    m_enabled = settings.value(EnabledKey, false).toBool();
+    m_spread = settings.value(SpreadKey, QStringLiteral("artist")).toString();
+    if (!validSpread(m_spread))
+        m_spread = QStringLiteral("artist");
+    m_noRepeatWindow = qMax(0, settings.value(NoRepeatKey, m_noRepeatWindow).toInt());
+
+    connect(queue, &QAbstractItemModel::rowsInserted, this,
+            [this](const QModelIndex&, int first, int last) { onRowsInserted(first, last); });
+    connect(queue, &QAbstractItemModel::rowsRemoved, this,
+            [this](const QModelIndex&, int first, int last) { onRowsRemoved(first, last); });
+    connect(queue, &QAbstractItemModel::rowsMoved, this,
+            [this](const QModelIndex&, int first, int last, const QModelIndex&, int destination) {
+                onRowsMoved(first, last, destination);
+            });
+    // Every row may have moved; the rows of this cycle can't be told apart any more
+    connect(queue, &QAbstractItemModel::layoutChanged, this, &ShuffleEngine::reset);
+    connect(queue, &QAbstractItemModel::modelReset, this, &ShuffleEngine::reset);
+}
+
+void ShuffleEngine::setEnabled(bool enabled)
+{
+    if (enabled == m_enabled) return;
+    m_enabled = enabled;
+    reset();
+    QSettings().setValue(EnabledKey, enabled);
+    emit enabledChanged();
+}
+
+void ShuffleEngine::setSpread(const QString& spread)
+{
+    if (spread == m_spread || !validSpread(spread)) return;
+    m_spread = spread;
+    QSettings().setValue(SpreadKey, spread);
+    emit spreadChanged();
+}
+
+void ShuffleEngine::setNoRepeatWindow(int tracks)
+{
+    tracks = qMax(0, tracks);
+    if (tracks == m_noRepeatWindow) return;
+    m_noRepeatWindow = tracks;
+    QSettings().setValue(NoRepeatKey, tracks);
+    emit noRepeatWindowChanged();
+}
+
+int ShuffleEngine::next(int currentRow)
+{
+    sync(currentRow);
+    ensureNext();
+    if (m_cursor + 1 >= int(m_history.size()))
+        return -1;
+    ++m_cursor;
+    if (m_cursor == int(m_history.size()) - 1)
+        m_peeked = false;
+    while (int(m_history.size()) > HistoryLimit && m_cursor > 0) {
+        m_history.pop_front();
+        --m_cursor;
+    }
+    return m_history[m_cursor];
+}
+
+int ShuffleEngine::peekNext(int currentRow)
+{
+    sync(currentRow);
+    ensureNext();
+    return m_cursor + 1 < int(m_history.size()) ? m_history[m_cursor + 1] : -1;
+}
+
+int ShuffleEngine::previous()
+{
+    if (m_cursor <= 0)
+        return -1;
+    return m_history[--m_cursor];
+}
+
+void ShuffleEngine::reset()
+{
+    m_pool.clear();
+    m_pool.shrink_to_fit();
+    m_poolPos.clear();
+    m_poolPos.shrink_to_fit();
+    m_deferred.clear();
+    m_history.clear();
+    m_cursor = -1;
+    m_peeked = false;
+    m_started = false;
+}
+
+// Brings the history in line with what is actually playing
+void ShuffleEngine::sync(int currentRow)
+{
+    if (!m_started) {
+        const int rows = m_queue->count();
+        m_poolPos.assign(rows, -1);
+        m_pool.reserve(rows);
+        for (int row = 0; row < rows; ++row)
+            addToPool(row);
+        m_started = true;
+    }
+    if (currentRow < 0 || currentRow >= int(m_poolPos.size()))
+        return;
+    if (m_cursor >= 0 && m_history[m_cursor] == currentRow)
+        return;
+
+    // The track after the cursor started on its own (gapless)
+    if (m_cursor + 1 < int(m_history.size()) && m_history[m_cursor + 1] == currentRow) {
+        ++m_cursor;
+        if (m_cursor == int(m_history.size()) - 1)
+            m_peeked = false;
+        return;
+    }
+
+    // A jump: history after the cursor is dropped, a pick that never played goes back
+    if (m_peeked) {
+        addToPool(m_history.back());
+        m_history.pop_back();
+        m_peeked = false;
+    }
+    m_history.erase(m_history.begin() + (m_cursor + 1), m_history.end());
+    removeFromPool(currentRow);
+    m_deferred.erase(std::remove(m_deferred.begin(), m_deferred.end(), currentRow), m_deferred.end());
+    m_history.push_back(currentRow);
+    m_cursor = int(m_history.size()) - 1;
+}
+
+void ShuffleEngine::ensureNext()
+{
+    if (m_cursor + 1 < int(m_history.size()))
+        return;
+    const int row = pick();
+    if (row < 0)
+        return;
+    m_history.push_back(row);
+    m_peeked = true;
+}
+
+int ShuffleEngine::pick()
+{
+    if (m_pool.empty())
+        refill();
+    if (m_pool.empty()) {
+        if (m_deferred.empty())
+            return -1;
+        addToPool(m_deferred.front());
+        m_deferred.pop_front();
+    }
+
+    // Fisher-Yates step; with a spread, retry a few times on a clash rather than scan
+    int chosen = -1;
+    for (int attempt = 0; attempt < SpreadAttempts; ++attempt) {
+        chosen = m_pool[m_random.bounded(int(m_pool.size()))];
+        if (!clashes(chosen))
+            break;
+    }
+    removeFromPool(chosen);
+
+    if (!m_deferred.empty()) {
+        addToPool(m_deferred.front());
+        m_deferred.pop_front();
+    }
+    return chosen;
+}
+
+// New cycle: every row, except the last noRepeatWindow played, which return one per pick
+void ShuffleEngine::refill()
+{
+    const int rows = int(m_poolPos.size());
+    m_pool.clear();
+    m_deferred.clear();
+    std::fill(m_poolPos.begin(), m_poolPos.end(), -1);
+
+    const int window = qMin(m_noRepeatWindow, rows - 1);
+    for (int i = qMax(0, int(m_history.size()) - window); i < int(m_history.size()); ++i) {
+        const int row = m_history[i];
+        if (m_poolPos[row] == -1) {
+            m_poolPos[row] = -2; // held back
+            m_deferred.push_back(row);
+        }
+    }
+    for (int row = 0; row < rows; ++row) {
+        if (m_poolPos[row] == -1)
+            addToPool(row);
+    }
+    for (int row : m_deferred)
+        m_poolPos[row] = -1;
+}
+
+void ShuffleEngine::addToPool(int row)
+{
+    if (m_poolPos[row] >= 0) return;
+    m_poolPos[row] = int(m_pool.size());
+    m_pool.push_back(row);
+}
+
+void ShuffleEngine::removeFromPool(int row)
+{
+    const int pos = m_poolPos[row];
+    if (pos < 0) return;
+    const int last = m_pool.back();
+    m_pool[pos] = last;
+    m_poolPos[last] = pos;
+    m_pool.pop_back();
+    m_poolPos[row] = -1;
+}
+
+bool ShuffleEngine::clashes(int row) const
+{
+    if (m_spread == QLatin1String("none"))
+        return false;
+    const bool byAlbum = m_spread == QLatin1String("album");
+    const QVector<PlaylistModel::Item>& items = m_queue->items();
+    const QString& key = byAlbum ? items.at(row).album : items.at(row).artist;
+    if (key.isEmpty())
+        return false;
+
+    const int end = int(m_history.size());
+    for (int i = qMax(0, end - SpreadTracks); i < end; ++i) {
+        const PlaylistModel::Item& recent = items.at(m_history[i]);
+        if ((byAlbum ? recent.album : recent.artist) == key)
+            return true;
+    }
+    return false;
+}
+
+void ShuffleEngine::onRowsInserted(int first, int last)
+{
+    if (!m_started) return;
+    const int count = last - first + 1;
+
+    // Appends leave every existing row where it was
+    if (first < int(m_poolPos.size())) {
+        const auto shift = [first, count](int& row) {
+            if (row >= first) row += count;
+        };
+        std::for_each(m_pool.begin(), m_pool.end(), shift);
+        std::for_each(m_deferred.begin(), m_deferred.end(), shift);
+        std::for_each(m_history.begin(), m_history.end(), shift);
+    }
+    m_poolPos.insert(m_poolPos.begin() + first, count, -1);
+    for (int row = first; row <= last; ++row)
+        addToPool(row);
+}
+
+void ShuffleEngine::onRowsRemoved(int first, int last)
+{
+    if (!m_started) return;
+    const int count = last - first + 1;
+    for (int row = first; row <= last; ++row)
+        removeFromPool(row);
+    m_poolPos.erase(m_poolPos.begin() + first, m_poolPos.begin() + last + 1);
+
+    const auto removed = [first, last](int row) { return row >= first && row <= last; };
+    const auto shift = [last, count](int& row) {
+        if (row > last) row -= count;
+    };
+    m_deferred.erase(std::remove_if(m_deferred.begin(), m_deferred.end(), removed), m_deferred.end());
+
+    // The cursor stays on the closest earlier entry; a removed current track is re-synced
+    // on the next call
+    std::deque<int> history;
+    int cursor = -1;
+    for (int i = 0; i < int(m_history.size()); ++i) {
+        if (removed(m_history[i])) continue;
+        history.push_back(m_history[i]);
+        if (i <= m_cursor)
+            cursor = int(history.size()) - 1;
+    }
+    m_peeked = m_peeked && !m_history.empty() && !removed(m_history.back());
+    m_history.swap(history);
+    m_cursor = cursor;
+
+    std::for_each(m_pool.begin(), m_pool.end(), shift);
+    std::for_each(m_deferred.begin(), m_deferred.end(), shift);
+    std::for_each(m_history.begin(), m_history.end(), shift);
+}
+
+void ShuffleEngine::onRowsMoved(int first, int last, int destination)
+{
+    if (!m_started) return;
+    const int count = last - first + 1;
+    // Rows [first, last] end up before row destination of the old numbering
+    const auto move = [first, last, destination, count](int& row) {
+        if (row >= first && row <= last)
+            row += destination > last ? destination - last - 1 : destination - first;
+        else if (destination > last && row > last && row < destination)
+            row -= count;
+        else if (destination < first && row >= destination && row < first)
+            row += count;
+    };
+    std::for_each(m_pool.begin(), m_pool.end(), move);
+    std::for_each(m_deferred.begin(), m_deferred.end(), move);
+    std::for_each(m_history.begin(), m_history.end(), move);
+
+    std::fill(m_poolPos.begin(), m_poolPos.end(), -1);
+    for (int pos = 0; pos < int(m_pool.size()); ++pos)
+        m_poolPos[m_pool[pos]] = pos;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <QObject>
+#include <QRandomGenerator>
+#include <QString>
+
+#include <deque>
+#include <vector>
+
+class PlaylistModel;
+
+// Shuffle order for the queue, without reordering it.
+//
+// The order is an incremental Fisher-Yates over the rows not yet played in this cycle: each
+// pick swaps a random pool entry out in O(1), so nothing is shuffled up front and a cycle
+// costs one pass over the rows to refill the pool. Play history is kept, so previous() and
+// stepping forward again after it are O(1) too. Rows added to the queue join the current
+// cycle; removed rows leave it. Appends cost O(1) per row, edits in the middle one
+// linear pass to renumber, and neither reshuffles. Sorting or resetting the queue starts
+// a new cycle.
+//
+// spread keeps the same artist (or album) out of the next few picks where the pool allows it.
+// At a cycle boundary the last noRepeatWindow tracks are held back, so a track never plays
+// again within that many picks of its last play.
+//
+// Rows are queue rows; GUI thread only.
+class ShuffleEngine : public QObject {
+    Q_OBJECT
+    Q_PROPERTY(bool enabled READ enabled WRITE setEnabled NOTIFY enabledChanged)
+    // "none", "artist" or "album"
+    Q_PROPERTY(QString spread READ spread WRITE setSpread NOTIFY spreadChanged)
+    Q_PROPERTY(int noRepeatWindow READ noRepeatWindow WRITE setNoRepeatWindow NOTIFY noRepeatWindowChanged)
+
+public:
+    explicit ShuffleEngine(PlaylistModel* queue, QObject* parent = nullptr);
+
+    // Moves on from currentRow (-1 when nothing plays); -1 when the queue is empty
+    Q_INVOKABLE int next(int currentRow);
+    // What next(currentRow) will return, for arming gapless playback
+    Q_INVOKABLE int peekNext(int currentRow);
+    // The track played before the current one, or -1
+    Q_INVOKABLE int previous();
+    // Forgets history and starts a new cycle
+    Q_INVOKABLE void reset();
+
+    bool enabled() const { return m_enabled; }
+    void setEnabled(bool enabled);
+    QString spread() const { return m_spread; }
+    void setSpread(const QString& spread);
+    int noRepeatWindow() const { return m_noRepeatWindow; }
+    void setNoRepeatWindow(int tracks);
+
+signals:
+    void enabledChanged();
+    void spreadChanged();
+    void noRepeatWindowChanged();
+
+private:
+    void sync(int currentRow);
+    void ensureNext();
+    int pick();
+    void refill();
+    void addToPool(int row);
+    void removeFromPool(int row);
+    bool clashes(int row) const;
+
+    void onRowsInserted(int first, int last);
+    void onRowsRemoved(int first, int last);
+    void onRowsMoved(int first, int last, int destination);
+
+    PlaylistModel* m_queue;
+    bool m_enabled {false};
+    QString m_spread;
+    int m_noRepeatWindow {50};
+    QRandomGenerator m_random;
+
+    // Unplayed rows of this cycle, and each row's position in it (-1 when not in the pool)
+    std::vector<int> m_pool;
+    std::vector<int> m_poolPos;
+    bool m_started {false};
+    // Rows held back from the new cycle, oldest play first; one returns with every pick
+    std::deque<int> m_deferred;
+    // Play order; m_cursor is the current track. An entry after the cursor was either
+    // played before previous() or, when m_peeked, picked by peekNext() and not played yet.
+    std::deque<int> m_history;
+    int m_cursor {-1};
+    bool m_peeked {false};
+};
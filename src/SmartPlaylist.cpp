@@ -0,0 +1,185 @@
+#include "SmartPlaylist.h"
+#include "RowSorter.h"
+
+#include <QHash>
+
+#include <algorithm>
+#include <functional>
+
+namespace {
+
+// More changed tracks than this in one report are cheaper to evaluate in full
+constexpr int IncrementalLimit = 256;
+
+} // namespace
+
+SmartPlaylist::SmartPlaylist(LibraryIndex* library, PlaylistModel* model)
+    : QObject(model)
+    , m_library(library)
+    , m_model(model)
+{
+    // As RowSorter collates, so incremental inserts land where a full sort puts them
+    m_collator.setNumericMode(true);
+    m_collator.setCaseSensitivity(Qt::CaseInsensitive);
+    connect(library, &LibraryIndex::tracksChanged, this, &SmartPlaylist::onTracksChanged);
+}
+
+bool SmartPlaylist::setQuery(const QString& text)
+{
+    SmartQuery query = SmartQuery::parse(text);
+    if (!query.isValid())
+        return false;
+    m_query = std::move(query);
+    refresh();
+    return true;
+}
+
+void SmartPlaylist::refresh(const QVector<int>& changed)
+{
+    std::vector<int> tracks = sorted(m_query.matchAll(*m_library));
+    m_member.assign(m_library->trackCount(), 0);
+    for (int track : tracks)
+        m_member[track] = 1;
+
+    if (tracks != m_tracks) {
+        QVector<PlaylistModel::Item> items;
+        items.reserve(int(tracks.size()));
+        for (int track : tracks)
+            items.append(m_library->item(track));
+        m_tracks = std::move(tracks);
+        m_model->resetItems(std::move(items));
+        return;
+    }
+
+    // Same rows; bring the edited ones up to date
+    std::vector<quint8> edited(m_library->trackCount(), 0);
+    for (int track : changed)
+        edited[track] = 1;
+    for (int row = 0; row < int(m_tracks.size()); ++row) {
+        const int track = m_tracks[row];
+        if (edited[track] && !m_model->items().at(row).sameFields(m_library->item(track)))
+            m_model->setItem(row, m_library->item(track));
+    }
+}
+
+void SmartPlaylist::onTracksChanged(const QVector<int>& tracks)
+{
+    if (!m_query.isValid()) return;
+    if (tracks.size() > IncrementalLimit) {
+        refresh(tracks);
+        return;
+    }
+    m_member.resize(m_library->trackCount(), 0);
+
+    // One pass finds the rows of every changed track that is listed
+    QHash<int, int> rowOf;
+    for (int track : tracks) {
+        if (m_member[track])
+            rowOf.insert(track, -1);
+    }
+    for (int row = 0; row < int(m_tracks.size()) && !rowOf.isEmpty(); ++row) {
+        const auto it = rowOf.find(m_tracks[row]);
+        if (it != rowOf.end())
+            it.value() = row;
+    }
+
+    std::vector<int> removeRows;
+    std::vector<int> insertTracks;
+    for (int track : tracks) {
+        const bool match = m_query.matches(*m_library, track);
+        if (m_member[track]) {
+            const int row = rowOf.value(track);
+            if (!match) {
+                removeRows.push_back(row);
+            } else if (!sameSortKeys(m_model->items().at(row), m_library->item(track))) {
+                removeRows.push_back(row);
+                insertTracks.push_back(track);
+            } else if (!m_model->items().at(row).sameFields(m_library->item(track))) {
+                m_model->setItem(row, m_library->item(track));
+            }
+        } else if (match) {
+            insertTracks.push_back(track);
+        }
+        m_member[track] = match;
+    }
+
+    std::sort(removeRows.begin(), removeRows.end(), std::greater<int>());
+    for (int row : removeRows) {
+        m_tracks.erase(m_tracks.begin() + row);
+        m_model->removeAt(row);
+    }
+    for (int track : insertTracks) {
+        const auto at = std::upper_bound(m_tracks.begin(), m_tracks.end(), track,
+                                         [this](int a, int b) { return less(a, b); });
+        const int row = int(at - m_tracks.begin());
+        m_tracks.insert(at, track);
+        m_model->insertItem(row, m_library->item(track));
+    }
+}
+
+std::vector<int> SmartPlaylist::sorted(std::vector<int> tracks) const
+{
+    const QVector<SmartQuery::SortKey>& keys = m_query.sortKeys();
+    if (keys.isEmpty())
+        return tracks;
+
+    const int rows = int(tracks.size());
+    RowSorter sorter(rows);
+    for (const SmartQuery::SortKey& key : keys) {
+        if (LibraryIndex::isText(key.field)) {
+            const LibraryIndex::TextColumn& column = m_library->text(key.field);
+            QVector<QString> values;
+            values.reserve(rows);
+            for (int track : tracks)
+                values.append(column.values.at(column.ids[track]));
+            sorter.addText(values, key.order);
+        } else {
+            const std::vector<qint64>& column = m_library->numbers(key.field);
+            QVector<qint64> values;
+            values.reserve(rows);
+            for (int track : tracks)
+                values.append(column[track]);
+            sorter.addNumber(values, key.order);
+        }
+    }
+
+    std::vector<int> ordered;
+    ordered.reserve(rows);
+    for (int row : sorter.order())
+        ordered.push_back(tracks[row]);
+    return ordered;
+}
+
+// The order sorted() produces: keys as RowSorter compares them, then track id, since
+// RowSorter is stable and sees the tracks in id order
+bool SmartPlaylist::less(int a, int b) const
+{
+    for (const SmartQuery::SortKey& key : m_query.sortKeys()) {
+        const bool ascending = key.order == Qt::AscendingOrder;
+        if (LibraryIndex::isText(key.field)) {
+            const LibraryIndex::TextColumn& column = m_library->text(key.field);
+            const QString& va = column.values.at(column.ids[a]);
+            const QString& vb = column.values.at(column.ids[b]);
+            if (va.isEmpty() != vb.isEmpty())
+                return vb.isEmpty();
+            const int c = m_collator.compare(va, vb);
+            if (c != 0)
+                return ascending ? c < 0 : c > 0;
+        } else {
+            const std::vector<qint64>& column = m_library->numbers(key.field);
+            if (column[a] != column[b])
+                return ascending ? column[a] < column[b] : column[a] > column[b];
+        }
+    }
+    return a < b;
+}
+
+bool SmartPlaylist::sameSortKeys(const PlaylistModel::Item& a, const PlaylistModel::Item& b) const
+{
+    for (const SmartQuery::SortKey& key : m_query.sortKeys()) {
+        if (LibraryIndex::isText(key.field) ? LibraryIndex::textOf(a, key.field) != LibraryIndex::textOf(b, key.field)
+                                            : LibraryIndex::numberOf(a, key.field) != LibraryIndex::numberOf(b, key.field))
+            return false;
+    }
+    return true;
+}
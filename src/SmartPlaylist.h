@@ -0,0 +1,41 @@
+#pragma once
+
+#include "SmartQuery.h"
+
+#include <QCollator>
+#include <QObject>
+#include <QVector>
+
+#include <vector>
+
+// Keeps a PlaylistModel filled with the library tracks a SmartQuery matches.
+//
+// Setting a query evaluates the whole library. After that only the tracks the library
+// reports as changed are tested, and rows go in and out one at a time at their sorted
+// position, so views keep their place. A batch too large for that is evaluated in full,
+// and the model is reset only when the result differs. Child of the model it fills.
+class SmartPlaylist : public QObject {
+    Q_OBJECT
+
+public:
+    SmartPlaylist(LibraryIndex* library, PlaylistModel* model);
+
+    // False, with the query unchanged, when text does not parse
+    bool setQuery(const QString& text);
+    QString query() const { return m_query.text(); }
+
+private:
+    void refresh(const QVector<int>& changed = {});
+    void onTracksChanged(const QVector<int>& tracks);
+    std::vector<int> sorted(std::vector<int> tracks) const;
+    bool less(int a, int b) const;
+    bool sameSortKeys(const PlaylistModel::Item& a, const PlaylistModel::Item& b) const;
+
+    LibraryIndex* m_library;
+    PlaylistModel* m_model;
+    SmartQuery m_query;
+    QCollator m_collator;
+
+    std::vector<int> m_tracks;    // library track per model row
+    std::vector<quint8> m_member; // per library track
+};
@@ -0,0 +1,508 @@
+#include "SmartQuery.h"
+
+#include <QStringList>
+
+#include <algorithm>
+
+namespace {
+
+// Tracks evaluated per pass; the evaluation stack holds one block per level
+constexpr int BlockSize = 1024;
+// Levels matches() handles on the stack; deeper rules go through evaluate()
+constexpr int RowStackSize = 64;
+
+struct Token {
+    enum Type { Word, Quoted, Operator, Open, Close, Comma, End };
+    Type type;
+    QString text;
+};
+
+bool isOperatorChar(QChar c)
+{
+    return c == QLatin1Char('=') || c == QLatin1Char('<') || c == QLatin1Char('>') || c == QLatin1Char('!')
+           || c == QLatin1Char('~');
+}
+
+QVector<Token> tokenize(const QString& text, QString* error)
+{
+    QVector<Token> tokens;
+    int i = 0;
+    while (i < text.size()) {
+        const QChar c = text.at(i);
+        if (c.isSpace()) {
+            ++i;
+        } else if (c == QLatin1Char('(') || c == QLatin1Char(')') || c == QLatin1Char(',')) {
+            tokens.append(Token{c == QLatin1Char('(') ? Token::Open : c == QLatin1Char(')') ? Token::Close : Token::Comma, QString(c)});
+            ++i;
+        } else if (c == QLatin1Char('"')) {
+            const int close = text.indexOf(QLatin1Char('"'), i + 1);
+            if (close < 0) {
+                *error = QStringLiteral("Missing closing quote");
+                return {};
+            }
+            tokens.append(Token{Token::Quoted, text.mid(i + 1, close - i - 1)});
+            i = close + 1;
+        } else if (isOperatorChar(c)) {
+            const QString two = text.mid(i, 2);
+            if (two == QLatin1String("!=") || two == QLatin1String("!~") || two == QLatin1String("<=")
+                || two == QLatin1String(">=")) {
+                tokens.append(Token{Token::Operator, two});
+                i += 2;
+            } else if (c == QLatin1Char('!')) {
+                *error = QStringLiteral("Unknown operator '!'");
+                return {};
+            } else {
+                tokens.append(Token{Token::Operator, QString(c)});
+                ++i;
+            }
+        } else {
+            const int start = i;
+            while (i < text.size() && !text.at(i).isSpace() && !isOperatorChar(text.at(i))
+                   && text.at(i) != QLatin1Char('(') && text.at(i) != QLatin1Char(')')
+                   && text.at(i) != QLatin1Char(',') && text.at(i) != QLatin1Char('"'))
+                ++i;
+            tokens.append(Token{Token::Word, text.mid(start, i - start)});
+        }
+    }
+    tokens.append(Token{Token::End, QString()});
+    return tokens;
+}
+
+bool fieldFromName(const QString& name, LibraryIndex::Field* field)
+{
+    const QString n = name.toLower();
+    if (n == QLatin1String("title")) *field = LibraryIndex::Title;
+    else if (n == QLatin1String("artist")) *field = LibraryIndex::Artist;
+    else if (n == QLatin1String("album")) *field = LibraryIndex::Album;
+    else if (n == QLatin1String("genre")) *field = LibraryIndex::Genre;
+    else if (n == QLatin1String("path")) *field = LibraryIndex::Path;
+    else if (n == QLatin1String("year")) *field = LibraryIndex::Year;
+    else if (n == QLatin1String("track") || n == QLatin1String("tracknumber")) *field = LibraryIndex::TrackNumber;
+    else if (n == QLatin1String("duration") || n == QLatin1String("length")) *field = LibraryIndex::Duration;
+    else return false;
+    return true;
+}
+
+// "300", "5 min", "1.5h", "4:30", "1:02:00"
+bool parseDuration(const QString& value, qint64* ms)
+{
+    if (value.contains(QLatin1Char(':'))) {
+        qint64 seconds = 0;
+        for (const QString& part : value.split(QLatin1Char(':'))) {
+            bool ok = false;
+            const int n = part.trimmed().toInt(&ok);
+            if (!ok || n < 0) return false;
+            seconds = seconds * 60 + n;
+        }
+        *ms = seconds * 1000;
+        return true;
+    }
+
+    int digits = 0;
+    while (digits < value.size() && (value.at(digits).isDigit() || value.at(digits) == QLatin1Char('.')))
+        ++digits;
+    bool ok = false;
+    const double number = value.left(digits).toDouble(&ok);
+    if (!ok) return false;
+
+    const QString unit = value.mid(digits).trimmed().toLower();
+    double scale;
+    if (unit.isEmpty() || unit == QLatin1String("s") || unit == QLatin1String("sec") || unit == QLatin1String("secs")
+        || unit == QLatin1String("second") || unit == QLatin1String("seconds"))
+        scale = 1000;
+    else if (unit == QLatin1String("m") || unit == QLatin1String("min") || unit == QLatin1String("mins")
+             || unit == QLatin1String("minute") || unit == QLatin1String("minutes"))
+        scale = 60 * 1000;
+    else if (unit == QLatin1String("h") || unit == QLatin1String("hr") || unit == QLatin1String("hour")
+             || unit == QLatin1String("hours"))
+        scale = 60 * 60 * 1000;
+    else
+        return false;
+    *ms = qRound64(number * scale);
+    return true;
+}
+
+template <typename Test>
+void testNumbers(const qint64* values, int count, quint8* out, Test test)
+{
+    // Unknown values fail; no early exit so the loop vectorizes
+    for (int i = 0; i < count; ++i)
+        out[i] = quint8((values[i] != 0) & test(values[i]));
+}
+
+} // namespace
+
+// Recursive descent over the tokens, writing SmartQuery's nodes in postfix order
+class SmartQueryParser {
+public:
+    SmartQueryParser(SmartQuery& query, QVector<Token> tokens)
+        : m_query(query)
+        , m_tokens(std::move(tokens))
+    {
+    }
+
+    void parse()
+    {
+        parseOr();
+        if (peek().type == Token::Comma)
+            take();
+        if (atSortClause())
+            parseSort();
+        if (!failed() && peek().type != Token::End)
+            fail(QStringLiteral("Unexpected '%1'").arg(peek().text));
+    }
+
+private:
+    using Node = SmartQuery::Node;
+    using Op = SmartQuery::Op;
+    using Compare = SmartQuery::Compare;
+
+    const Token& peek(int ahead = 0) const { return m_tokens.at(qMin(m_pos + ahead, int(m_tokens.size()) - 1)); }
+    Token take() { return m_tokens.at(qMin(m_pos++, int(m_tokens.size()) - 1)); }
+    bool failed() const { return !m_query.m_error.isEmpty(); }
+
+    void fail(const QString& message)
+    {
+        if (!failed())
+            m_query.m_error = message;
+    }
+
+    bool isKeyword(const Token& token, const char* keyword) const
+    {
+        return token.type == Token::Word && token.text.compare(QLatin1String(keyword), Qt::CaseInsensitive) == 0;
+    }
+
+    bool atSortClause() const
+    {
+        return (isKeyword(peek(), "sort") || isKeyword(peek(), "sorted") || isKeyword(peek(), "order"))
+               && isKeyword(peek(1), "by");
+    }
+
+    void push(Node node)
+    {
+        switch (node.op) {
+        case Op::Text:
+        case Op::Number:
+            ++m_depth;
+            break;
+        case Op::And:
+        case Op::Or:
+            --m_depth;
+            break;
+        case Op::Not:
+            break;
+        }
+        m_query.m_depth = qMax(m_query.m_depth, m_depth);
+        m_query.m_nodes.push_back(std::move(node));
+    }
+
+    void parseOr()
+    {
+        parseAnd();
+        while (!failed() && isKeyword(peek(), "or")) {
+            take();
+            parseAnd();
+            push({Op::Or});
+        }
+    }
+
+    void parseAnd()
+    {
+        parseNot();
+        while (!failed() && isKeyword(peek(), "and")) {
+            take();
+            parseNot();
+            push({Op::And});
+        }
+    }
+
+    void parseNot()
+    {
+        if (isKeyword(peek(), "not")) {
+            take();
+            parseNot();
+            push({Op::Not});
+            return;
+        }
+        if (peek().type == Token::Open) {
+            take();
+            parseOr();
+            if (!failed() && take().type != Token::Close)
+                fail(QStringLiteral("Missing ')'"));
+            return;
+        }
+        parseComparison();
+    }
+
+    void parseComparison()
+    {
+        const Token name = take();
+        if (failed()) return;
+        Node node {Op::Text};
+        if (name.type != Token::Word || !fieldFromName(name.text, &node.field)) {
+            fail(name.type == Token::End ? QStringLiteral("Expected a condition")
+                                         : QStringLiteral("Unknown field '%1'").arg(name.text));
+            return;
+        }
+
+        const Token op = take();
+        if (op.type != Token::Operator) {
+            fail(QStringLiteral("Expected an operator after '%1'").arg(name.text));
+            return;
+        }
+        if (op.text == QLatin1String("=")) node.compare = Compare::Equal;
+        else if (op.text == QLatin1String("!=")) node.compare = Compare::NotEqual;
+        else if (op.text == QLatin1String("<")) node.compare = Compare::Less;
+        else if (op.text == QLatin1String("<=")) node.compare = Compare::LessEqual;
+        else if (op.text == QLatin1String(">")) node.compare = Compare::Greater;
+        else if (op.text == QLatin1String(">=")) node.compare = Compare::GreaterEqual;
+        else if (op.text == QLatin1String("~")) node.compare = Compare::Contains;
+        else node.compare = Compare::NotContains;
+
+        // A quoted value, or the words up to the next keyword
+        QString value;
+        if (peek().type == Token::Quoted) {
+            value = take().text;
+        } else {
+            QStringList words;
+            while (peek().type == Token::Word && !isKeyword(peek(), "and") && !isKeyword(peek(), "or") && !atSortClause())
+                words.append(take().text);
+            if (words.isEmpty()) {
+                fail(QStringLiteral("Expected a value after '%1 %2'").arg(name.text, op.text));
+                return;
+            }
+            value = words.join(QLatin1Char(' '));
+        }
+
+        const bool textOp = node.compare == Compare::Equal || node.compare == Compare::NotEqual
+                            || node.compare == Compare::Contains || node.compare == Compare::NotContains;
+        if (LibraryIndex::isText(node.field)) {
+            if (!textOp) {
+                fail(QStringLiteral("'%1' compares numbers; %2 is text").arg(op.text, name.text));
+                return;
+            }
+            node.text = value;
+        } else {
+            if (node.compare == Compare::Contains || node.compare == Compare::NotContains) {
+                fail(QStringLiteral("'%1' needs a text field; %2 is a number").arg(op.text, name.text));
+                return;
+            }
+            node.op = Op::Number;
+            bool ok = false;
+            if (node.field == LibraryIndex::Duration) {
+                ok = parseDuration(value, &node.number);
+            } else {
+                node.number = value.toLongLong(&ok);
+            }
+            if (!ok) {
+                fail(QStringLiteral("'%1' is not a valid %2").arg(value, name.text));
+                return;
+            }
+        }
+        push(std::move(node));
+    }
+
+    void parseSort()
+    {
+        take();
+        take();
+        for (;;) {
+            const Token name = take();
+            SmartQuery::SortKey key {LibraryIndex::Title, Qt::AscendingOrder};
+            if (name.type != Token::Word || !fieldFromName(name.text, &key.field)) {
+                fail(name.type == Token::End ? QStringLiteral("Expected a field to sort by")
+                                             : QStringLiteral("Unknown field '%1'").arg(name.text));
+                return;
+            }
+            if (isKeyword(peek(), "desc") || isKeyword(peek(), "descending")) {
+                take();
+                key.order = Qt::DescendingOrder;
+            } else if (isKeyword(peek(), "asc") || isKeyword(peek(), "ascending")) {
+                take();
+            }
+            m_query.m_sortKeys.append(key);
+            if (peek().type != Token::Comma)
+                break;
+            take();
+        }
+    }
+
+    SmartQuery& m_query;
+    QVector<Token> m_tokens;
+    int m_pos {0};
+    int m_depth {0};
+};
+
+SmartQuery SmartQuery::parse(const QString& text)
+{
+    SmartQuery query;
+    query.m_text = text.trimmed();
+    QVector<Token> tokens = tokenize(query.m_text, &query.m_error);
+    if (!query.m_error.isEmpty())
+        return query;
+    SmartQueryParser(query, std::move(tokens)).parse();
+    if (!query.m_error.isEmpty()) {
+        query.m_nodes.clear();
+        query.m_sortKeys.clear();
+    }
+    return query;
+}
+
+void SmartQuery::evaluate(const LibraryIndex& library, int begin, int end, quint8* out)
+{
+    if (!isValid()) {
+        std::fill(out, out + (end - begin), quint8(0));
+        return;
+    }
+    std::vector<quint8> stack(size_t(m_depth) * BlockSize);
+    for (int block = begin; block < end; block += BlockSize)
+        evaluateBlock(library, block, qMin(BlockSize, end - block), stack.data(), out + (block - begin));
+}
+
+void SmartQuery::decide(Node& node, const LibraryIndex::TextColumn& column)
+{
+    if (node.generation != column.generation) {
+        node.decided.clear();
+        node.generation = column.generation;
+    }
+    // Decide values the dictionary gained since the last pass
+    for (size_t id = node.decided.size(); id < size_t(column.values.size()); ++id) {
+        const QString& value = column.values.at(qsizetype(id));
+        bool match = false;
+        switch (node.compare) {
+        case Compare::Equal:
+        case Compare::NotEqual:
+            match = value.compare(node.text, Qt::CaseInsensitive) == 0;
+            break;
+        default:
+            match = value.contains(node.text, Qt::CaseInsensitive);
+            break;
+        }
+        if (node.compare == Compare::NotEqual || node.compare == Compare::NotContains)
+            match = !match;
+        node.decided.push_back(match);
+    }
+}
+
+bool SmartQuery::testNumber(Compare compare, qint64 value, qint64 number)
+{
+    if (value == 0) return false;
+    switch (compare) {
+    case Compare::Equal: return value == number;
+    case Compare::NotEqual: return value != number;
+    case Compare::Less: return value < number;
+    case Compare::LessEqual: return value <= number;
+    case Compare::Greater: return value > number;
+    default: return value >= number;
+    }
+}
+
+void SmartQuery::evaluateBlock(const LibraryIndex& library, int begin, int count, quint8* stack, quint8* out)
+{
+    int top = 0;
+    for (Node& node : m_nodes) {
+        quint8* result = stack + size_t(top) * BlockSize;
+        switch (node.op) {
+        case Op::Text: {
+            const LibraryIndex::TextColumn& column = library.text(node.field);
+            decide(node, column);
+            const int* ids = column.ids.data() + begin;
+            const quint8* decided = node.decided.data();
+            for (int i = 0; i < count; ++i)
+                result[i] = decided[ids[i]];
+            ++top;
+            break;
+        }
+        case Op::Number: {
+            const qint64* values = library.numbers(node.field).data() + begin;
+            const qint64 x = node.number;
+            switch (node.compare) {
+            case Compare::Equal: testNumbers(values, count, result, [x](qint64 v) { return v == x; }); break;
+            case Compare::NotEqual: testNumbers(values, count, result, [x](qint64 v) { return v != x; }); break;
+            case Compare::Less: testNumbers(values, count, result, [x](qint64 v) { return v < x; }); break;
+            case Compare::LessEqual: testNumbers(values, count, result, [x](qint64 v) { return v <= x; }); break;
+            case Compare::Greater: testNumbers(values, count, result, [x](qint64 v) { return v > x; }); break;
+            default: testNumbers(values, count, result, [x](qint64 v) { return v >= x; }); break;
+            }
+            ++top;
+            break;
+        }
+        case Op::Not: {
+            quint8* a = stack + size_t(top - 1) * BlockSize;
+            for (int i = 0; i < count; ++i)
+                a[i] ^= 1;
+            break;
+        }
+        case Op::And:
+        case Op::Or: {
+            quint8* a = stack + size_t(top - 2) * BlockSize;
+            const quint8* b = stack + size_t(top - 1) * BlockSize;
+            if (node.op == Op::And) {
+                for (int i = 0; i < count; ++i)
+                    a[i] &= b[i];
+            } else {
+                for (int i = 0; i < count; ++i)
+                    a[i] |= b[i];
+            }
+            --top;
+            break;
+        }
+        }
+    }
+
+    for (int i = 0; i < count; ++i)
+        out[i] = quint8(stack[i] & quint8(library.isLive(begin + i)));
+}
+
+bool SmartQuery::matches(const LibraryIndex& library, int track)
+{
+    if (!isValid() || !library.isLive(track))
+        return false;
+    if (m_depth > RowStackSize) {
+        quint8 result = 0;
+        evaluate(library, track, track + 1, &result);
+        return result;
+    }
+
+    bool stack[RowStackSize];
+    int top = 0;
+    for (Node& node : m_nodes) {
+        switch (node.op) {
+        case Op::Text: {
+            const LibraryIndex::TextColumn& column = library.text(node.field);
+            decide(node, column);
+            stack[top++] = node.decided[column.ids[track]];
+            break;
+        }
+        case Op::Number:
+            stack[top++] = testNumber(node.compare, library.numbers(node.field)[track], node.number);
+            break;
+        case Op::Not:
+            stack[top - 1] = !stack[top - 1];
+            break;
+        case Op::And:
+            stack[top - 2] = stack[top - 2] && stack[top - 1];
+            --top;
+            break;
+        case Op::Or:
+            stack[top - 2] = stack[top - 2] || stack[top - 1];
+            --top;
+            break;
+        }
+    }
+    return stack[0];
+}
+
+std::vector<int> SmartQuery::matchAll(const LibraryIndex& library)
+{
+    const int tracks = library.trackCount();
+    std::vector<quint8> match(tracks);
+    evaluate(library, 0, tracks, match.data());
+
+    std::vector<int> matched;
+    for (int track = 0; track < tracks; ++track) {
+        if (match[track])
+            matched.push_back(track);
+    }
+    return matched;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "LibraryIndex.h"
+
+#include <QString>
+#include <QVector>
+
+#include <vector>
+
+// A smart playlist rule, parsed once and evaluated over a LibraryIndex a block of tracks at
+// a time.
+//
+//     genre = Jazz AND year < 1970 AND duration > 5 min, sorted by album, track
+//
+// Fields: title, artist, album, genre and path hold text; year, track and duration hold
+// numbers. Text tests ignore case: = and != compare whole values, ~ and !~ look for a
+// substring. Values run to the next AND/OR/sort clause; quote them when they contain those
+// words or operators. Numbers take = != < <= > >=, and durations are seconds unless written
+// as "5 min", "1 h" or "4:30". A track whose number is unknown (0) fails every numeric test.
+// AND binds tighter than OR; NOT and parentheses work as usual. The optional sort clause
+// lists fields, each optionally followed by "desc".
+//
+// Text tests are decided once per distinct column value and cached, so evaluation itself
+// only reads integer columns.
+class SmartQuery {
+public:
+    struct SortKey {
+        LibraryIndex::Field field;
+        Qt::SortOrder order;
+    };
+
+    // An invalid query (errorString() set) for text that does not parse
+    static SmartQuery parse(const QString& text);
+
+    bool isValid() const { return !m_nodes.empty(); }
+    QString errorString() const { return m_error; }
+    QString text() const { return m_text; }
+    const QVector<SortKey>& sortKeys() const { return m_sortKeys; }
+
+    // out[i] is 1 when track begin + i matches; dead tracks never do
+    void evaluate(const LibraryIndex& library, int begin, int end, quint8* out);
+    // One track, without evaluate()'s block-sized stack
+    bool matches(const LibraryIndex& library, int track);
+    // Matching tracks in id order
+    std::vector<int> matchAll(const LibraryIndex& library);
+
+private:
+    friend class SmartQueryParser;
+
+    enum class Op { And, Or, Not, Text, Number };
+    enum class Compare { Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual, Contains, NotContains };
+
+    struct Node {
+        Op op;
+        LibraryIndex::Field field {LibraryIndex::Title};
+        Compare compare {Compare::Equal};
+        QString text;
+        qint64 number {0};
+        // Text tests: the result per dictionary id, extended as the dictionary grows and
+        // started over when its generation moves on
+        std::vector<quint8> decided;
+        quint32 generation {0};
+    };
+
+    // Brings node.decided up to date with the column's dictionary
+    static void decide(Node& node, const LibraryIndex::TextColumn& column);
+    static bool testNumber(Compare compare, qint64 value, qint64 number);
+    void evaluateBlock(const LibraryIndex& library, int begin, int count, quint8* stack, quint8* out);
+
+    QString m_text;
+    QString m_error;
+    std::vector<Node> m_nodes; // postfix
+    int m_depth {0};           // evaluation stack needed by m_nodes
+    QVector<SortKey> m_sortKeys;
+};
@@ -0,0 +1,52 @@
+#include "StartupTrace.h"
+
+#include <QStringList>
+#include <QDebug>
+
+StartupTrace& StartupTrace::instance()
+{
+    static StartupTrace trace;
+    return trace;
+}
+
+StartupTrace::StartupTrace()
+{
+    m_timer.start();
+}
+
+void StartupTrace::mark(const char* phase)
+{
+    if (m_finished) return;
+    const qint64 now = m_timer.nsecsElapsed();
+    m_phases.append({phase, now - m_lastMark});
+    m_lastMark = now;
+}
+
+void StartupTrace::finish()
+{
+    if (m_finished) return;
+    m_finished = true;
+
+    QStringList parts;
+    for (const Phase& p : m_phases)
+        parts << QStringLiteral("%1 %2 ms").arg(QLatin1String(p.name)).arg(double(p.nsecs) / 1e6, 0, 'f', 1);
+    qInfo().noquote() << QStringLiteral("Startup: %1 ms (%2)")
+                             .arg(double(m_lastMark) / 1e6, 0, 'f', 1)
+                             .arg(parts.join(QStringLiteral(", ")));
+}
+
+QVariantMap StartupTrace::toVariantMap() const
+{
+    QVariantList phases;
+    for (const Phase& p : m_phases) {
+        QVariantMap phase;
+        phase["name"] = QString::fromLatin1(p.name);
+        phase["ms"] = double(p.nsecs) / 1e6;
+        phases << phase;
+    }
+
+    QVariantMap m;
+    m["totalMs"] = double(m_lastMark) / 1e6;
+    m["phases"] = phases;
+    return m;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QVariantMap>
+#include <QVector>
+
+// Wall-clock breakdown of application startup.
+// main() marks each phase as it completes; finish() is called once the first frame has been
+// presented and logs a single line with every phase. The result also shows up in
+// Telemetry::snapshot() under "startup". GUI thread only.
+class StartupTrace {
+public:
+    static StartupTrace& instance();
+
+    // Records the time since the previous mark (or since instance() was first called)
+    void mark(const char* phase);
+    void finish();
+    bool finished() const { return m_finished; }
+
+    // { "totalMs": double, "phases": [ { "name": string, "ms": double }, ... ] }
+    QVariantMap toVariantMap() const;
+
+private:
+    StartupTrace();
+
+    struct Phase {
+        const char* name;
+        qint64 nsecs;
+    };
+
+    QElapsedTimer m_timer;
+    qint64 m_lastMark {0};
+    QVector<Phase> m_phases;
+    bool m_finished {false};
+};
@@ -0,0 +1,196 @@
+#include "StreamServer.h"
+#include "Telemetry.h"
+
+#include <QAudioBuffer>
+#include <QDebug>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+#include <algorithm>
+
+namespace {
+
+constexpr int SampleRate = 44100;
+constexpr int Channels = 2;
+// Encoded audio a listener may have queued before it is considered stalled
+constexpr qint64 MaxBacklogMs = 4000;
+// Worst case is roughly uncompressed PCM
+constexpr qint64 MaxBacklogBytes = MaxBacklogMs * SampleRate / 1000 * Channels * 2;
+// Request line and headers; anything longer is not a player asking for a stream
+constexpr qsizetype MaxRequestBytes = 8 * 1024;
+
+const QByteArray StreamHeaders =
+    "HTTP/1.0 200 OK\r\n"
+    "Content-Type: audio/flac\r\n"
+    "Cache-Control: no-cache, no-store\r\n"
+    "Connection: close\r\n"
+    "icy-name: MusicPlayer\r\n"
+    "icy-pub: 0\r\n"
+    "\r\n";
+
+const QByteArray NotFound =
+    "HTTP/1.0 404 Not Found\r\n"
+    "Content-Type: text/plain\r\n"
+    "Connection: close\r\n"
+    "\r\n"
+    "Try /stream.flac\n";
+
+const QByteArray BadRequest =
+    "HTTP/1.0 400 Bad Request\r\n"
+    "Connection: close\r\n"
+    "\r\n";
+
+} // namespace
+
+StreamServer::StreamServer(QObject* parent)
+    : QObject(parent)
+    , m_server(new QTcpServer(this))
+    , m_encoder(SampleRate, Channels)
+    , m_streamHeader(m_encoder.streamHeader())
+{
+    connect(m_server, &QTcpServer::newConnection, this, &StreamServer::onNewConnection);
+}
+
+StreamServer::~StreamServer()
+{
+    for (const Listener& listener : m_listeners)
+        listener.socket->disconnect(this);
+}
+
+QAudioFormat StreamServer::format()
+{
+    QAudioFormat format;
+    format.setSampleRate(SampleRate);
+    format.setChannelCount(Channels);
+    format.setSampleFormat(QAudioFormat::Int16);
+    return format;
+}
+
+bool StreamServer::listen(const QHostAddress& address, quint16 port)
+{
+    if (!m_server->listen(address, port)) {
+        m_error = m_server->errorString();
+        return false;
+    }
+    return true;
+}
+
+QString StreamServer::errorString() const
+{
+    return m_error;
+}
+
+int StreamServer::listenerCount() const
+{
+    return m_streaming;
+}
+
+void StreamServer::pushAudio(const QAudioBuffer& buffer)
+{
+    if (m_streaming == 0 || !buffer.isValid())
+        return;
+    const QAudioFormat bufferFormat = buffer.format();
+    if (bufferFormat.sampleFormat() != QAudioFormat::Int16 || bufferFormat.channelCount() != Channels
+        || bufferFormat.sampleRate() != SampleRate)
+        return;
+
+    QVector<QByteArray> frames;
+    {
+        ScopedLatency timing(Telemetry::instance()->streamEncode());
+        frames = m_encoder.encode(buffer.constData<qint16>(), int(buffer.frameCount()));
+    }
+    if (frames.isEmpty())
+        return;
+
+    QVector<QTcpSocket*> stalled;
+    for (const Listener& listener : std::as_const(m_listeners)) {
+        if (!listener.streaming)
+            continue;
+        if (listener.socket->bytesToWrite() > MaxBacklogBytes) {
+            stalled.append(listener.socket);
+            continue;
+        }
+        for (const QByteArray& frame : std::as_const(frames))
+            listener.socket->write(frame);
+    }
+    for (QTcpSocket* socket : std::as_const(stalled)) {
+        qWarning() << "Stream listener" << socket->peerAddress().toString() << "fell behind; disconnecting";
+        socket->abort();
+    }
+}
+
+void StreamServer::onNewConnection()
+{
+    while (QTcpSocket* socket = m_server->nextPendingConnection()) {
+        m_listeners.append({socket, QByteArray(), false});
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket] { onReadyRead(socket); });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket] { drop(socket); });
+    }
+}
+
+void StreamServer::onReadyRead(QTcpSocket* socket)
+{
+    auto it = std::find_if(m_listeners.begin(), m_listeners.end(),
+                           [socket](const Listener& l) { return l.socket == socket; });
+    if (it == m_listeners.end())
+        return;
+    if (it->streaming) {
+        socket->readAll(); // nothing more is expected from a listener
+        return;
+    }
+
+    it->request += socket->readAll();
+    if (it->request.contains("\r\n\r\n") || it->request.contains("\n\n")) {
+        respond(*it);
+    } else if (it->request.size() > MaxRequestBytes) {
+        socket->write(BadRequest);
+        socket->disconnectFromHost();
+    }
+}
+
+void StreamServer::respond(Listener& listener)
+{
+    QTcpSocket* socket = listener.socket;
+    const QList<QByteArray> requestLine = listener.request.left(listener.request.indexOf('\n')).trimmed().split(' ');
+    listener.request.clear();
+    if (requestLine.size() < 2 || (requestLine.at(0) != "GET" && requestLine.at(0) != "HEAD")) {
+        socket->write(BadRequest);
+        socket->disconnectFromHost();
+        return;
+    }
+
+    const QByteArray path = requestLine.at(1).left(requestLine.at(1).indexOf('?'));
+    if (path != "/" && path != "/stream.flac") {
+        socket->write(NotFound);
+        socket->disconnectFromHost();
+        return;
+    }
+
+    socket->write(StreamHeaders);
+    if (requestLine.at(0) == "HEAD") {
+        socket->disconnectFromHost();
+        return;
+    }
+    // Frames are self-contained, so a listener can join between any two of them
+    socket->write(m_streamHeader);
+    socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    listener.streaming = true;
+    ++m_streaming;
+    emit listenerCountChanged();
+}
+
+void StreamServer::drop(QTcpSocket* socket)
+{
+    for (int i = 0; i < m_listeners.size(); ++i) {
+        if (m_listeners.at(i).socket == socket) {
+            const bool streaming = m_listeners.at(i).streaming;
+            m_listeners.removeAt(i);
+            if (streaming) {
+                --m_streaming;
+                emit listenerCountChanged();
+            }
+            break;
+        }
+    }
+    socket->deleteLater();
+}
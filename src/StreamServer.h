@@ -0,0 +1,64 @@
+#pragma once
+
+#include <QAudioFormat>
+#include <QByteArray>
+#include <QHostAddress>
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+#include "FlacEncoder.h"
+
+class QAudioBuffer;
+class QTcpServer;
+class QTcpSocket;
+
+// Serves the player's output as a live FLAC stream over HTTP, for other rooms and devices:
+//   curl http://host:port/stream.flac | ffplay -    or    ffplay http://host:port/
+// Responses carry icy-name, so Icecast-style clients accept them; no in-band metadata.
+//
+// PCM pushed in is encoded once, and every encoded frame is queued on all listeners as the
+// same implicitly shared QByteArray (frames larger than the socket's 4 KiB write chunk are
+// appended by reference, not copied), so adding a listener costs a socket, not an encoder.
+// A listener that falls more than MaxBacklogMs behind is disconnected rather than allowed to
+// grow its buffer or hold up the others. Nothing is encoded while nobody is listening.
+class StreamServer : public QObject {
+    Q_OBJECT
+
+public:
+    explicit StreamServer(QObject* parent = nullptr);
+    ~StreamServer() override;
+
+    // 16-bit stereo at 44.1 kHz; the player converts every track to it, so one stream can
+    // span track changes without a new header
+    static QAudioFormat format();
+
+    bool listen(const QHostAddress& address, quint16 port);
+    QString errorString() const;
+    int listenerCount() const;
+
+    // Buffers in any other format are ignored
+    void pushAudio(const QAudioBuffer& buffer);
+
+signals:
+    void listenerCountChanged();
+
+private:
+    struct Listener {
+        QTcpSocket* socket {nullptr};
+        QByteArray request; // until the header block is complete
+        bool streaming {false};
+    };
+
+    void onNewConnection();
+    void onReadyRead(QTcpSocket* socket);
+    void respond(Listener& listener);
+    void drop(QTcpSocket* socket);
+
+    QTcpServer* m_server {nullptr};
+    QString m_error;
+    FlacEncoder m_encoder;
+    QByteArray m_streamHeader;
+    QVector<Listener> m_listeners;
+    int m_streaming {0};
+};
@@ -0,0 +1,250 @@
+#include "TagEditor.h"
+#include "FastTagReader.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QHash>
+#include <QSet>
+#include <QThread>
+#include <QtEndian>
+
+#include <taglib/fileref.h>
+#include <taglib/flacfile.h>
+#include <taglib/id3v2header.h>
+#include <taglib/id3v2tag.h>
+#include <taglib/mpegfile.h>
+#include <taglib/tpropertymap.h>
+#include <taglib/xiphcomment.h>
+
+#include <cstring>
+
+namespace {
+
+// TagLib's padding policy when a tag is rewritten: leftover padding above this is given
+// back, which moves the audio just like growing past it
+constexpr qint64 MinFlacPadding = 4096;
+constexpr qint64 MaxFlacPadding = 1024 * 1024;
+
+constexpr int FlacPaddingBlock = 1;
+constexpr int FlacVorbisCommentBlock = 4;
+
+// Playlist role name -> TagLib property key
+const QHash<QString, QString>& propertyKeys()
+{
+    static const QHash<QString, QString> keys {
+        {QStringLiteral("title"), QStringLiteral("TITLE")},
+        {QStringLiteral("artist"), QStringLiteral("ARTIST")},
+        {QStringLiteral("album"), QStringLiteral("ALBUM")},
+        {QStringLiteral("albumArtist"), QStringLiteral("ALBUMARTIST")},
+        {QStringLiteral("genre"), QStringLiteral("GENRE")},
+        {QStringLiteral("year"), QStringLiteral("DATE")},
+        {QStringLiteral("trackNumber"), QStringLiteral("TRACKNUMBER")},
+        {QStringLiteral("discNumber"), QStringLiteral("DISCNUMBER")},
+        {QStringLiteral("composer"), QStringLiteral("COMPOSER")},
+        {QStringLiteral("comment"), QStringLiteral("COMMENT")},
+    };
+    return keys;
+}
+
+TagLib::String toTagLib(const QString& s)
+{
+    return TagLib::String(s.toUtf8().constData(), TagLib::String::UTF8);
+}
+
+// Metadata blocks as found on disk: all of them, and the ones TagLib writes back unchanged
+// (everything but the Vorbis comment and padding, which it regenerates)
+struct FlacLayout {
+    qint64 metadataBytes {-1};
+    qint64 keptBytes {0};
+};
+
+FlacLayout flacLayout(const uchar* data, qint64 size)
+{
+    FlacLayout layout;
+    qint64 pos = FastTagReader::id3v2TagSize(data, size);
+    if (pos + 4 > size || std::memcmp(data + pos, "fLaC", 4) != 0)
+        return layout;
+    pos += 4;
+    const qint64 first = pos;
+
+    bool last = false;
+    while (!last && pos + 4 <= size) {
+        last = data[pos] & 0x80;
+        const int type = data[pos] & 0x7F;
+        const qint64 length = 4 + (qFromBigEndian<quint32>(data + pos) & 0xFFFFFF);
+        if (pos + length > size)
+            return layout;
+        if (type != FlacPaddingBlock && type != FlacVorbisCommentBlock)
+            layout.keptBytes += length;
+        pos += length;
+    }
+    layout.metadataBytes = pos - first;
+    return layout;
+}
+
+struct FileEdit {
+    bool rewritten {false};
+    QString error; // empty when written
+};
+
+FileEdit editFile(const QString& path, const QList<QPair<QString, QString>>& changes, qint64 rewriteLimit)
+{
+    FileEdit result;
+
+    // Layout before the edit, from a mapping that is gone before TagLib opens for writing
+    qint64 size = 0;
+    FlacLayout flac;
+    {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            result.error = file.errorString();
+            return result;
+        }
+        size = file.size();
+        if (const uchar* data = file.map(0, size)) {
+            flac = flacLayout(data, size);
+            file.unmap(const_cast<uchar*>(data));
+        }
+    }
+
+#ifdef Q_OS_WIN
+    TagLib::FileRef ref(reinterpret_cast<const wchar_t*>(path.utf16()), false);
+#else
+    const QByteArray encodedPath = QFile::encodeName(path);
+    TagLib::FileRef ref(encodedPath.constData(), false);
+#endif
+    if (ref.isNull()) {
+        result.error = QStringLiteral("unsupported or unreadable file");
+        return result;
+    }
+    TagLib::File* file = ref.file();
+
+    auto* mpeg = dynamic_cast<TagLib::MPEG::File*>(file);
+    qint64 id3v2Bytes = -1;
+    if (mpeg && mpeg->hasID3v2Tag())
+        id3v2Bytes = qint64(mpeg->ID3v2Tag()->header()->completeTagSize());
+
+    TagLib::PropertyMap properties = file->properties();
+    for (const auto& change : changes) {
+        if (change.second.isEmpty())
+            properties.erase(toTagLib(change.first));
+        else
+            properties.replace(toTagLib(change.first), TagLib::StringList(toTagLib(change.second)));
+    }
+    file->setProperties(properties);
+
+    // Will the new tag fit where the old one and its padding are?
+    bool inPlace = false;
+    if (mpeg) {
+        inPlace = id3v2Bytes > 0 && qint64(mpeg->ID3v2Tag(true)->render().size()) == id3v2Bytes;
+    } else if (auto* flacFile = dynamic_cast<TagLib::FLAC::File*>(file); flacFile && flac.metadataBytes >= 0) {
+        const qint64 rendered = flac.keptBytes + 4 + qint64(flacFile->xiphComment(true)->render(false).size());
+        const qint64 padding = flac.metadataBytes - rendered - 4;
+        inPlace = padding > 0 && padding <= qBound(MinFlacPadding, size / 100, MaxFlacPadding);
+    }
+
+    if (!inPlace && size > rewriteLimit) {
+        result.error = QStringLiteral("the tag no longer fits its padding, and moving %1 MB of audio was not attempted")
+                           .arg(size / (1024 * 1024));
+        return result;
+    }
+    if (!file->save()) {
+        result.error = QStringLiteral("could not be saved");
+        return result;
+    }
+    result.rewritten = !inPlace;
+    return result;
+}
+
+} // namespace
+
+struct TagEditor::Batch {
+    QVariantMap fields;
+    QList<QUrl> edited;
+    int pending {0};
+};
+
+TagEditor::TagEditor(QObject* parent)
+    : QObject(parent)
+{
+    m_pool.setMaxThreadCount(QThread::idealThreadCount());
+}
+
+TagEditor::~TagEditor()
+{
+    m_pool.waitForDone();
+}
+
+bool TagEditor::apply(const QList<QUrl>& files, const QVariantMap& fields)
+{
+    if (m_batch || fields.isEmpty())
+        return false;
+
+    QList<QPair<QString, QString>> changes;
+    for (auto it = fields.constBegin(); it != fields.constEnd(); ++it) {
+        const QString key = propertyKeys().value(it.key());
+        if (key.isEmpty()) {
+            qWarning() << "TagEditor: unknown field" << it.key();
+            return false;
+        }
+        changes.append({key, it.value().toString()});
+    }
+
+    QList<QUrl> unique;
+    QSet<QUrl> seen;
+    for (const QUrl& url : files) {
+        if (url.isLocalFile() && !seen.contains(url)) {
+            seen.insert(url);
+            unique.append(url);
+        }
+    }
+
+    auto batch = std::make_shared<Batch>();
+    batch->fields = fields;
+    batch->pending = int(unique.size());
+    m_batch = batch;
+    m_total = int(unique.size());
+    m_completed = 0;
+    m_rewritten = 0;
+    m_errors.clear();
+    emit busyChanged();
+    emit progressChanged();
+
+    const qint64 rewriteLimit = m_rewriteLimit;
+    for (const QUrl& url : std::as_const(unique)) {
+        m_pool.start([this, batch, url, changes, rewriteLimit] {
+            const FileEdit edit = editFile(url.toLocalFile(), changes, rewriteLimit);
+            QMetaObject::invokeMethod(this, [this, batch, url, edit] {
+                onFileDone(batch, url, edit.rewritten, edit.error);
+            }, Qt::QueuedConnection);
+        });
+    }
+    if (unique.isEmpty()) {
+        m_batch.reset();
+        emit busyChanged();
+    }
+    return true;
+}
+
+void TagEditor::onFileDone(const std::shared_ptr<Batch>& batch, const QUrl& file, bool rewritten, const QString& error)
+{
+    if (batch != m_batch) return;
+
+    ++m_completed;
+    if (error.isEmpty()) {
+        batch->edited.append(file);
+        if (rewritten)
+            ++m_rewritten;
+    } else {
+        qWarning().noquote() << "TagEditor:" << file.toLocalFile() << error;
+        m_errors.append(QStringLiteral("%1: %2").arg(file.fileName(), error));
+    }
+    emit progressChanged();
+
+    if (--batch->pending > 0)
+        return;
+    m_batch.reset();
+    if (!batch->edited.isEmpty())
+        emit tracksEdited(batch->edited, batch->fields);
+    emit busyChanged();
+}
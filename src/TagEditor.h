@@ -0,0 +1,74 @@
+#pragma once
+
+#include <QList>
+#include <QObject>
+#include <QStringList>
+#include <QThreadPool>
+#include <QUrl>
+#include <QVariantMap>
+
+#include <memory>
+
+// Batch tag edits: the same fields set on many files at once (e.g. album artist on a whole
+// box set), one file per worker.
+//
+// Writes go through TagLib, which rewrites a tag in place when the new one fits in the old
+// tag plus its padding (ID3v2 padding, FLAC PADDING block) and otherwise moves the audio to
+// make room, leaving 1 KiB (ID3v2) or 4 KiB (FLAC) of fresh padding. Before saving, the new
+// tag size is worked out for MP3 and FLAC; an edit that would move the audio of a file larger
+// than rewriteLimit() is refused instead, so a one-field change never copies a multi-GB
+// hi-res file. Other formats are assumed to need a rewrite.
+//
+// tracksEdited fires once per batch, after every file has been handled, so playlists, the
+// library and the now-playing record are updated together. GUI thread only.
+class TagEditor : public QObject {
+    Q_OBJECT
+    Q_PROPERTY(bool busy READ busy NOTIFY busyChanged)
+    Q_PROPERTY(int total READ total NOTIFY progressChanged)
+    Q_PROPERTY(int completed READ completed NOTIFY progressChanged)
+    // Of the completed files: how many had their audio moved, and how many were not written
+    Q_PROPERTY(int rewritten READ rewritten NOTIFY progressChanged)
+    Q_PROPERTY(int failed READ failed NOTIFY progressChanged)
+    Q_PROPERTY(QStringList errors READ errors NOTIFY progressChanged)
+
+public:
+    static constexpr qint64 DefaultRewriteLimit = 256 * 1024 * 1024;
+
+    explicit TagEditor(QObject* parent = nullptr);
+    ~TagEditor() override;
+
+    // fields uses the playlist role names: title, artist, album, albumArtist, genre, year,
+    // trackNumber, discNumber, composer, comment. An empty value removes the field.
+    // Returns false while a batch is running or for unknown fields.
+    Q_INVOKABLE bool apply(const QList<QUrl>& files, const QVariantMap& fields);
+
+    qint64 rewriteLimit() const { return m_rewriteLimit; }
+    void setRewriteLimit(qint64 bytes) { m_rewriteLimit = bytes; }
+
+    bool busy() const { return m_batch != nullptr; }
+    int total() const { return m_total; }
+    int completed() const { return m_completed; }
+    int rewritten() const { return m_rewritten; }
+    int failed() const { return m_errors.size(); }
+    QStringList errors() const { return m_errors; }
+
+signals:
+    void busyChanged();
+    void progressChanged();
+    // Files that were written, with the fields applied to each of them
+    void tracksEdited(const QList<QUrl>& files, const QVariantMap& fields);
+
+private:
+    struct Batch;
+
+    // error is empty when the file was written
+    void onFileDone(const std::shared_ptr<Batch>& batch, const QUrl& file, bool rewritten, const QString& error);
+
+    QThreadPool m_pool;
+    std::shared_ptr<Batch> m_batch; // null when idle
+    qint64 m_rewriteLimit {DefaultRewriteLimit};
+    int m_total {0};
+    int m_completed {0};
+    int m_rewritten {0};
+    QStringList m_errors;
+};
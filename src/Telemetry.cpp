@@ -0,0 +1,202 @@
+#include "Telemetry.h"
+#include "StartupTrace.h"
+
+#include <QtAlgorithms>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QDebug>
+
+void LatencyHistogram::record(quint64 micros)
+{
+    m_buckets[bucketIndex(micros)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(micros, std::memory_order_relaxed);
+
+    quint64 prev = m_max.load(std::memory_order_relaxed);
+    while (micros > prev && !m_max.compare_exchange_weak(prev, micros, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::reset()
+{
+    for (auto& bucket : m_buckets)
+        bucket.store(0, std::memory_order_relaxed);
+    m_count.store(0, std::memory_order_relaxed);
+    m_sum.store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+double LatencyHistogram::mean() const
+{
+    const quint64 n = count();
+    return n ? double(m_sum.load(std::memory_order_relaxed)) / double(n) : 0.0;
+}
+
+quint64 LatencyHistogram::percentile(double p) const
+{
+    const quint64 n = count();
+    if (n == 0) return 0;
+
+    // Rank of the requested percentile, at least the first sample
+    const quint64 rank = qMax<quint64>(1, quint64(p / 100.0 * double(n) + 0.5));
+    quint64 seen = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        seen += m_buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+            return qMin(bucketUpperBound(i), max());
+    }
+    return max();
+}
+
+QVariantMap LatencyHistogram::toVariantMap() const
+{
+    QVariantMap m;
+    m["count"] = count();
+    m["mean"] = mean();
+    m["p50"] = percentile(50.0);
+    m["p90"] = percentile(90.0);
+    m["p99"] = percentile(99.0);
+    m["max"] = max();
+    return m;
+}
+
+int LatencyHistogram::bucketIndex(quint64 value)
+{
+    if (value < quint64(SubBucketCount))
+        return int(value);
+
+    // Top SubBucketBits+1 significant bits select the bucket
+    const int msb = 63 - int(qCountLeadingZeroBits(value));
+    const int shift = msb - SubBucketBits;
+    const int sub = int(value >> shift) - SubBucketCount;
+    return SubBucketCount + shift * SubBucketCount + sub;
+}
+
+quint64 LatencyHistogram::bucketUpperBound(int index)
+{
+    if (index < SubBucketCount)
+        return quint64(index);
+
+    const int shift = (index - SubBucketCount) / SubBucketCount;
+    const int sub = (index - SubBucketCount) % SubBucketCount;
+    const quint64 lower = quint64(SubBucketCount + sub) << shift;
+    return lower + ((quint64(1) << shift) - 1);
+}
+
+Telemetry::Telemetry(QObject* parent)
+    : QObject(parent)
+{
+    m_uptime.start();
+}
+
+Telemetry* Telemetry::instance()
+{
+    static Telemetry telemetry;
+    return &telemetry;
+}
+
+void Telemetry::recordMetadataRead(AudioFormat format, quint64 micros, quint64 bytes)
+{
+    metadataRead(format).record(micros);
+    m_filesScanned.fetch_add(1, std::memory_order_relaxed);
+    m_bytesScanned.fetch_add(bytes, std::memory_order_relaxed);
+    m_scanMicros.fetch_add(micros, std::memory_order_relaxed);
+}
+
+void Telemetry::recordPlayerError(const QString& message)
+{
+    m_playerErrors.fetch_add(1, std::memory_order_relaxed);
+    QMutexLocker lock(&m_errorMutex);
+    m_lastError = message;
+}
+
+QVariantMap Telemetry::snapshot() const
+{
+    QVariantMap m;
+    m["uptimeMs"] = m_uptime.elapsed();
+    m["openToFirstAudio"] = m_openToFirstAudio.toVariantMap();
+    m["trackTransitionGap"] = m_trackTransitionGap.toVariantMap();
+    m["coverDecode"] = m_coverDecode.toVariantMap();
+    m["coverEncode"] = m_coverEncode.toVariantMap();
+
+    QVariantMap reads;
+    for (int i = 0; i < static_cast<int>(AudioFormat::Count); ++i) {
+        if (m_metadataRead[i].count() > 0)
+            reads[FormatSniffer::formatName(static_cast<AudioFormat>(i))] = m_metadataRead[i].toVariantMap();
+    }
+    m["metadataRead"] = reads;
+
+    const quint64 files = m_filesScanned.load(std::memory_order_relaxed);
+    const quint64 micros = m_scanMicros.load(std::memory_order_relaxed);
+    QVariantMap scan;
+    scan["files"] = files;
+    scan["bytes"] = m_bytesScanned.load(std::memory_order_relaxed);
+    scan["busyMs"] = micros / 1000;
+    scan["filesPerSecond"] = micros ? double(files) * 1e6 / double(micros) : 0.0;
+    m["scan"] = scan;
+
+    QVariantMap readAhead;
+    readAhead["bufferedBytes"] = m_readAheadBuffered.load(std::memory_order_relaxed);
+    readAhead["capacityBytes"] = m_readAheadCapacity.load(std::memory_order_relaxed);
+    readAhead["stall"] = m_readAheadStall.toVariantMap();
+    readAhead["retries"] = m_readAheadRetries.load(std::memory_order_relaxed);
+    m["readAhead"] = readAhead;
+    m["deviceSwitch"] = m_deviceSwitch.toVariantMap();
+    m["streamEncode"] = m_streamEncode.toVariantMap();
+
+    m["bufferUnderruns"] = m_bufferUnderruns.load(std::memory_order_relaxed);
+    m["playerErrors"] = m_playerErrors.load(std::memory_order_relaxed);
+    {
+        QMutexLocker lock(&m_errorMutex);
+        m["lastError"] = m_lastError;
+    }
+    m["startup"] = StartupTrace::instance().toVariantMap();
+    return m;
+}
+
+QString Telemetry::dumpJson(const QUrl& url) const
+{
+    QString path;
+    if (url.isEmpty()) {
+        const QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+        QDir().mkpath(dir);
+        path = QDir(dir).filePath(QStringLiteral("telemetry-%1.json")
+                                  .arg(QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss")));
+    } else {
+        path = url.isLocalFile() ? url.toLocalFile() : url.toString();
+    }
+
+    QFile f(path);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Telemetry: cannot write" << path << f.errorString();
+        return QString();
+    }
+    f.write(QJsonDocument(QJsonObject::fromVariantMap(snapshot())).toJson(QJsonDocument::Indented));
+    return path;
+}
+
+void Telemetry::reset()
+{
+    m_openToFirstAudio.reset();
+    m_trackTransitionGap.reset();
+    m_coverDecode.reset();
+    m_coverEncode.reset();
+    for (auto& h : m_metadataRead)
+        h.reset();
+    m_readAheadStall.reset();
+    m_deviceSwitch.reset();
+    m_streamEncode.reset();
+    m_bufferUnderruns.store(0, std::memory_order_relaxed);
+    m_readAheadRetries.store(0, std::memory_order_relaxed);
+    m_playerErrors.store(0, std::memory_order_relaxed);
+    m_filesScanned.store(0, std::memory_order_relaxed);
+    m_bytesScanned.store(0, std::memory_order_relaxed);
+    m_scanMicros.store(0, std::memory_order_relaxed);
+    QMutexLocker lock(&m_errorMutex);
+    m_lastError.clear();
+}
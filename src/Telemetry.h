@@ -0,0 +1,114 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QUrl>
+#include <QVariantMap>
+#include <QElapsedTimer>
+#include <QMutex>
+
+#include <array>
+#include <atomic>
+
+#include "FormatSniffer.h"
+
+// Lock-free log-linear latency histogram (HDR-style, 16 sub-buckets per power of two).
+// Values are recorded in microseconds; relative error is bounded by ~6%.
+class LatencyHistogram {
+public:
+    void record(quint64 micros);
+    void reset();
+
+    quint64 count() const { return m_count.load(std::memory_order_relaxed); }
+    quint64 max() const { return m_max.load(std::memory_order_relaxed); }
+    double mean() const;
+    quint64 percentile(double p) const;
+
+    QVariantMap toVariantMap() const;
+
+private:
+    static constexpr int SubBucketBits = 4;
+    static constexpr int SubBucketCount = 1 << SubBucketBits;
+    static constexpr int BucketCount = SubBucketCount * (64 - SubBucketBits + 1);
+
+    static int bucketIndex(quint64 value);
+    static quint64 bucketUpperBound(int index);
+
+    std::array<std::atomic<quint64>, BucketCount> m_buckets {};
+    std::atomic<quint64> m_count {0};
+    std::atomic<quint64> m_sum {0};
+    std::atomic<quint64> m_max {0};
+};
+
+class Telemetry : public QObject {
+    Q_OBJECT
+
+public:
+    static Telemetry* instance();
+
+    LatencyHistogram& openToFirstAudio() { return m_openToFirstAudio; }
+    LatencyHistogram& trackTransitionGap() { return m_trackTransitionGap; }
+    LatencyHistogram& coverDecode() { return m_coverDecode; }
+    LatencyHistogram& coverEncode() { return m_coverEncode; }
+    LatencyHistogram& metadataRead(AudioFormat format) { return m_metadataRead[static_cast<int>(format)]; }
+    // Time the decoder spent waiting on an empty read-ahead window
+    LatencyHistogram& readAheadStall() { return m_readAheadStall; }
+    // Output device change until the current deck is heard on the new sink
+    LatencyHistogram& deviceSwitch() { return m_deviceSwitch; }
+    // Encoding one batch of player output for the HTTP stream (shared by all listeners)
+    LatencyHistogram& streamEncode() { return m_streamEncode; }
+
+    void recordMetadataRead(AudioFormat format, quint64 micros, quint64 bytes);
+    void recordBufferUnderrun() { m_bufferUnderruns.fetch_add(1, std::memory_order_relaxed); }
+    // A read-ahead read that failed or came back short and is being retried
+    void recordReadAheadRetry() { m_readAheadRetries.fetch_add(1, std::memory_order_relaxed); }
+    // Fill level of the read-ahead window that was read from most recently
+    void recordReadAheadLevel(qint64 bufferedBytes, qint64 capacityBytes)
+    {
+        m_readAheadBuffered.store(bufferedBytes, std::memory_order_relaxed);
+        m_readAheadCapacity.store(capacityBytes, std::memory_order_relaxed);
+    }
+    void recordPlayerError(const QString& message);
+
+    // Snapshot of all counters and histograms, suitable for a QML overlay
+    Q_INVOKABLE QVariantMap snapshot() const;
+    // Write snapshot() as JSON; an empty url writes to the app data directory. Returns the path or empty on failure.
+    Q_INVOKABLE QString dumpJson(const QUrl& url = QUrl()) const;
+    Q_INVOKABLE void reset();
+
+private:
+    explicit Telemetry(QObject* parent = nullptr);
+
+    LatencyHistogram m_openToFirstAudio;
+    LatencyHistogram m_trackTransitionGap;
+    LatencyHistogram m_coverDecode;
+    LatencyHistogram m_coverEncode;
+    std::array<LatencyHistogram, static_cast<int>(AudioFormat::Count)> m_metadataRead;
+    LatencyHistogram m_readAheadStall;
+    LatencyHistogram m_deviceSwitch;
+    LatencyHistogram m_streamEncode;
+
+    std::atomic<quint64> m_bufferUnderruns {0};
+    std::atomic<quint64> m_playerErrors {0};
+    std::atomic<quint64> m_filesScanned {0};
+    std::atomic<quint64> m_bytesScanned {0};
+    std::atomic<quint64> m_scanMicros {0};
+    std::atomic<qint64> m_readAheadBuffered {0};
+    std::atomic<qint64> m_readAheadCapacity {0};
+    std::atomic<quint64> m_readAheadRetries {0};
+
+    QElapsedTimer m_uptime;
+    mutable QMutex m_errorMutex;
+    QString m_lastError;
+};
+
+// Records the elapsed time of a scope into a histogram
+class ScopedLatency {
+public:
+    explicit ScopedLatency(LatencyHistogram& histogram) : m_histogram(histogram) { m_timer.start(); }
+    ~ScopedLatency() { m_histogram.record(static_cast<quint64>(m_timer.nsecsElapsed() / 1000)); }
+
+private:
+    LatencyHistogram& m_histogram;
+    QElapsedTimer m_timer;
+};
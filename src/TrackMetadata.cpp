@@ -1,4 +1,5 @@
 #include "TrackMetadata.h"
+#include "Telemetry.h"
 
 #include <QBuffer>
 #include <QImageWriter>
@@ -112,6 +113,7 @@ QString TrackMetadata::coverArtUrl() const
     }
     
     // Generate base64 data URL
+    ScopedLatency encodeLatency(Telemetry::instance()->coverEncode());
     QByteArray byteArray;
     QBuffer buffer(&byteArray);
     buffer.open(QIODevice::WriteOnly);
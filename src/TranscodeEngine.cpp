@@ -0,0 +1,809 @@
+#include "TranscodeEngine.h"
+#include "MappedFileStream.h"
+#include "MetadataReader.h"
+#include "PlaylistModel.h"
+#include "TrackMetadata.h"
+
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QProcess>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QThread>
+
+#include <taglib/attachedpictureframe.h>
+#include <taglib/fileref.h>
+#include <taglib/flacpicture.h>
+#include <taglib/id3v2tag.h>
+#include <taglib/mp4file.h>
+#include <taglib/mpegfile.h>
+#include <taglib/opusfile.h>
+#include <taglib/tpropertymap.h>
+#include <taglib/xiphcomment.h>
+
+#include <atomic>
+#include <filesystem>
+#include <system_error>
+#include <vector>
+
+namespace {
+
+constexpr quint32 ManifestMagic = 0x5953504d; // "MPSY"
+constexpr quint32 RunMagic = 0x5254504d;      // "MPTR"
+constexpr quint32 FormatVersion = 1;
+const char ManifestName[] = ".musicplayer-sync";
+// Manifest entries of targets finished since the manifest was last saved
+const char JournalName[] = ".musicplayer-sync.journal";
+const char RunFileName[] = "run.dat";
+// Portable players choke on large embedded art
+constexpr int CoverMaxSide = 500;
+constexpr int CoverJpegQuality = 90;
+// Finished targets are recorded in the manifest this often at most while a run is active
+constexpr int ManifestSaveMs = 2000;
+// How quickly a cancel reaches the running encoders
+constexpr int CancelPollMs = 100;
+// FAT and friends: keep path components short
+constexpr int MaxComponentLength = 100;
+
+struct Codec {
+    const char* name;
+    const char* encoder;   // ffmpeg -c:a
+    const char* muxer;     // ffmpeg -f
+    const char* extension;
+    AudioFormat format;    // for tagging
+};
+
+constexpr Codec Codecs[] = {
+    {"opus", "libopus", "opus", "opus", AudioFormat::OggOpus},
+    {"mp3", "libmp3lame", "mp3", "mp3", AudioFormat::Mpeg},
+    {"aac", "aac", "ipod", "m4a", AudioFormat::Mp4},
+};
+
+const Codec* codecByName(const QString& name)
+{
+    for (const Codec& codec : Codecs) {
+        if (name.compare(QLatin1String(codec.name), Qt::CaseInsensitive) == 0)
+            return &codec;
+    }
+    return nullptr;
+}
+
+QString pathComponent(QString name, const QString& fallback)
+{
+    static const QString reserved = QStringLiteral("/\\:*?\"<>|");
+    name = name.trimmed();
+    for (QChar& c : name) {
+        if (c.unicode() < 0x20 || reserved.contains(c))
+            c = QLatin1Char('_');
+    }
+    name.truncate(MaxComponentLength);
+    while (name.endsWith(QLatin1Char('.')) || name.endsWith(QLatin1Char(' ')))
+        name.chop(1);
+    return name.isEmpty() ? fallback : name;
+}
+
+QByteArray sha1Of(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(&file);
+    return hash.result();
+}
+
+std::filesystem::path fsPath(const QString& path)
+{
+    return std::filesystem::path(path.toStdU16String());
+}
+
+std::unique_ptr<TagLib::File> openForTagging(const Codec& codec, const QString& path)
+{
+    // TagLib wants wide paths on Windows and local 8-bit ones elsewhere
+#ifdef Q_OS_WIN
+    const TagLib::FileName name(reinterpret_cast<const wchar_t*>(path.utf16()));
+#else
+    const QByteArray encoded = QFile::encodeName(path);
+    const TagLib::FileName name(encoded.constData());
+#endif
+    switch (codec.format) {
+    case AudioFormat::OggOpus:
+        return std::make_unique<TagLib::Ogg::Opus::File>(name, false);
+    case AudioFormat::Mpeg:
+        return std::make_unique<TagLib::MPEG::File>(name, false);
+    case AudioFormat::Mp4:
+        return std::make_unique<TagLib::MP4::File>(name, false);
+    default:
+        return nullptr;
+    }
+}
+
+void attachCover(TagLib::File* file, const QImage& cover)
+{
+    QByteArray jpeg;
+    QBuffer buffer(&jpeg);
+    buffer.open(QIODevice::WriteOnly);
+    if (!cover.save(&buffer, "JPEG", CoverJpegQuality))
+        return;
+    const TagLib::ByteVector data(jpeg.constData(), static_cast<unsigned int>(jpeg.size()));
+
+    if (auto* mpeg = dynamic_cast<TagLib::MPEG::File*>(file)) {
+        auto* frame = new TagLib::ID3v2::AttachedPictureFrame;
+        frame->setMimeType("image/jpeg");
+        frame->setType(TagLib::ID3v2::AttachedPictureFrame::FrontCover);
+        frame->setPicture(data);
+        mpeg->ID3v2Tag(true)->addFrame(frame);
+    } else if (auto* opus = dynamic_cast<TagLib::Ogg::Opus::File*>(file)) {
+        auto* picture = new TagLib::FLAC::Picture;
+        picture->setType(TagLib::FLAC::Picture::FrontCover);
+        picture->setMimeType("image/jpeg");
+        picture->setWidth(cover.width());
+        picture->setHeight(cover.height());
+        picture->setColorDepth(24);
+        picture->setData(data);
+        opus->tag()->addPicture(picture);
+    } else if (auto* mp4 = dynamic_cast<TagLib::MP4::File*>(file)) {
+        TagLib::MP4::CoverArtList covers;
+        covers.append(TagLib::MP4::CoverArt(TagLib::MP4::CoverArt::JPEG, data));
+        mp4->tag()->setItem("covr", covers);
+    }
+}
+
+// ffmpeg drops tags across containers inconsistently, so they are copied here instead
+bool copyTags(const Codec& codec, const QString& source, const QString& target, QString& error)
+{
+    TagLib::PropertyMap properties;
+    {
+        MappedFileStream stream(source);
+        if (stream.isOpen()) {
+            TagLib::FileRef in(&stream, false);
+            if (!in.isNull())
+                properties = in.file()->properties();
+        }
+    }
+
+    const std::unique_ptr<TagLib::File> out = openForTagging(codec, target);
+    if (!out || !out->isValid()) {
+        error = QStringLiteral("Encoded file could not be opened for tagging");
+        return false;
+    }
+    out->setProperties(properties);
+
+    QImage cover = MetadataReader::readCoverArt(QUrl::fromLocalFile(source));
+    if (!cover.isNull()) {
+        if (cover.width() > CoverMaxSide || cover.height() > CoverMaxSide)
+            cover = cover.scaled(CoverMaxSide, CoverMaxSide, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        attachCover(out.get(), cover.convertToFormat(QImage::Format_RGB32));
+    }
+
+    if (!out->save()) {
+        error = QStringLiteral("Tags could not be written");
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+struct TranscodeEngine::Run {
+    std::atomic<bool> cancelled {false};
+    int planning {0};                         // GUI thread
+    int pending {0};                          // GUI thread
+    std::vector<Plan> plans;                  // GUI thread, by row
+    QHash<QString, ManifestEntry> manifest;   // as loaded at the start; read by workers
+    QString folder;
+    QString ffmpeg;
+    const Codec* codec {nullptr};
+    int bitrateKbps {0};
+    QString profile;
+};
+
+struct TranscodeEngine::JobSpec {
+    int row {0};
+    QString source;
+    QString target; // relative
+    qint64 durationMs {0};
+};
+
+TranscodeEngine::TranscodeEngine(const QString& stateDirectory, QObject* parent)
+    : QAbstractListModel(parent)
+    , m_stateDirectory(stateDirectory)
+{
+    // Each job is one single-threaded encoder
+    m_pool.setMaxThreadCount(QThread::idealThreadCount());
+
+    m_manifestTimer.setSingleShot(true);
+    m_manifestTimer.setInterval(ManifestSaveMs);
+    connect(&m_manifestTimer, &QTimer::timeout, this, [this] { saveManifest(); });
+}
+
+TranscodeEngine::~TranscodeEngine()
+{
+    if (m_run)
+        m_run->cancelled = true;
+    m_pool.waitForDone();
+    saveManifest();
+}
+
+int TranscodeEngine::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : int(m_jobs.size());
+}
+
+QVariant TranscodeEngine::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_jobs.size()) return QVariant();
+    const Job& job = m_jobs.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+    case SourceRole:
+        return job.source;
+    case TargetRole:
+        return job.target;
+    case StatusRole:
+        switch (job.status) {
+        case Status::Queued: return QStringLiteral("queued");
+        case Status::Running: return QStringLiteral("running");
+        case Status::Done: return QStringLiteral("done");
+        case Status::Skipped: return QStringLiteral("skipped");
+        case Status::Failed: return QStringLiteral("failed");
+        case Status::Cancelled: return QStringLiteral("cancelled");
+        }
+        return QVariant();
+    case ProgressRole:
+        return job.progress;
+    case ErrorRole:
+        return job.error;
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> TranscodeEngine::roleNames() const
+{
+    return {
+        {SourceRole, "source"},
+        {TargetRole, "target"},
+        {StatusRole, "status"},
+        {ProgressRole, "progress"},
+        {ErrorRole, "error"},
+    };
+}
+
+bool TranscodeEngine::start(PlaylistModel* playlist, const QUrl& targetFolder, const QString& format, int bitrateKbps)
+{
+    if (!playlist || !targetFolder.isLocalFile()) {
+        setError(QStringLiteral("Choose a playlist and a local target folder"));
+        return false;
+    }
+
+    // Each source once; remote streams can't be synced
+    QStringList sources;
+    QSet<QString> seen;
+    for (const PlaylistModel::Item& item : playlist->items()) {
+        if (item.remote || seen.contains(item.location))
+            continue;
+        seen.insert(item.location);
+        sources.append(item.location);
+    }
+    return startJobs(sources, targetFolder.toLocalFile(), format, bitrateKbps);
+}
+
+bool TranscodeEngine::startFromM3U8(const QUrl& playlistFile, const QUrl& targetFolder, const QString& format, int bitrateKbps)
+{
+    PlaylistModel playlist;
+    if (!playlist.importM3U8(playlistFile)) {
+        setError(QStringLiteral("Could not read %1").arg(playlistFile.toDisplayString()));
+        return false;
+    }
+    return start(&playlist, targetFolder, format, bitrateKbps);
+}
+
+bool TranscodeEngine::resume()
+{
+    QFile file(runFilePath());
+    if (m_run || !file.open(QIODevice::ReadOnly)) {
+        setError(QStringLiteral("There is no interrupted sync to resume"));
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0, version = 0;
+    QString folder, format;
+    qint32 bitrateKbps = 0;
+    QStringList sources;
+    in >> magic >> version;
+    if (magic == RunMagic && version == FormatVersion)
+        in >> folder >> format >> bitrateKbps >> sources;
+    if (magic != RunMagic || version != FormatVersion || in.status() != QDataStream::Ok) {
+        file.remove();
+        emit resumableChanged();
+        setError(QStringLiteral("The interrupted sync could not be read"));
+        return false;
+    }
+    return startJobs(sources, folder, format, bitrateKbps);
+}
+
+bool TranscodeEngine::startJobs(const QStringList& sources, const QString& folder, const QString& format, int bitrateKbps)
+{
+    if (m_run) {
+        setError(QStringLiteral("A sync is already running"));
+        return false;
+    }
+    const Codec* codec = codecByName(format);
+    if (!codec) {
+        setError(QStringLiteral("Unsupported format \"%1\"").arg(format));
+        return false;
+    }
+    const QString ffmpeg = QStandardPaths::findExecutable(QStringLiteral("ffmpeg"));
+    if (ffmpeg.isEmpty()) {
+        setError(QStringLiteral("ffmpeg was not found on PATH"));
+        return false;
+    }
+    if (!QDir().mkpath(folder)) {
+        setError(QStringLiteral("Could not create %1").arg(QDir::toNativeSeparators(folder)));
+        return false;
+    }
+
+    auto run = std::make_shared<Run>();
+    run->folder = folder;
+    run->ffmpeg = ffmpeg;
+    run->codec = codec;
+    run->bitrateKbps = qBound(32, bitrateKbps, 320);
+    run->profile = QStringLiteral("%1-%2").arg(QLatin1String(codec->name)).arg(run->bitrateKbps);
+    run->planning = int(sources.size());
+    run->pending = int(sources.size());
+    run->plans.resize(size_t(sources.size()));
+
+    saveManifest(); // the previous folder's, if its timer is still pending
+    m_manifestTimer.stop();
+    loadManifest(folder);
+    run->manifest = m_manifest;
+
+    beginResetModel();
+    m_jobs.clear();
+    m_jobs.reserve(sources.size());
+    for (const QString& source : sources) {
+        Job job;
+        job.source = source;
+        m_jobs.append(job);
+    }
+    m_folder = folder;
+    m_finished = m_skipped = m_failed = 0;
+    m_audioMs = 0;
+    m_wallMs = 0;
+    endResetModel();
+
+    m_run = run;
+    saveRunFile(QLatin1String(codec->name), run->bitrateKbps);
+    m_wallClock.start();
+    setError(QString());
+    emit runningChanged();
+    emit resumableChanged();
+    emit progressChanged();
+
+    for (int row = 0; row < m_jobs.size(); ++row) {
+        const QString source = m_jobs.at(row).source;
+        m_pool.start([this, run, row, source] {
+            const Plan plan = planJob(source, *run);
+            QMetaObject::invokeMethod(this, [this, run, row, plan] {
+                onJobPlanned(run, row, plan);
+            }, Qt::QueuedConnection);
+        });
+    }
+    if (sources.isEmpty())
+        finishRun();
+    return true;
+}
+
+TranscodeEngine::Plan TranscodeEngine::planJob(const QString& source, const Run& run)
+{
+    Plan plan;
+    plan.name = pathComponent(QFileInfo(source).completeBaseName(), QStringLiteral("Track"));
+    // The target path comes from the tags, which playlist rows don't always have yet
+    std::unique_ptr<TrackMetadata> metadata;
+    if (!run.cancelled && QFileInfo(source).isFile()) {
+        metadata.reset(MetadataReader::readMetadataStandalone(
+            QUrl::fromLocalFile(source), nullptr, MetadataReader::ReadMode::Fast));
+    }
+    const QString artist = metadata ? metadata->artist() : QString();
+    const QString album = metadata ? metadata->album() : QString();
+    plan.folder = pathComponent(artist, QStringLiteral("Unknown Artist")) + QLatin1Char('/')
+                + pathComponent(album, QStringLiteral("Unknown Album"));
+    if (metadata) {
+        plan.trackNumber = metadata->trackNumber();
+        plan.durationMs = metadata->duration();
+    }
+    return plan;
+}
+
+void TranscodeEngine::onJobPlanned(const std::shared_ptr<Run>& run, int row, const Plan& plan)
+{
+    if (run != m_run) return;
+    run->plans[size_t(row)] = plan;
+    if (--run->planning == 0)
+        scheduleJobs(run);
+}
+
+void TranscodeEngine::scheduleJobs(const std::shared_ptr<Run>& run)
+{
+    // Portable players mostly use FAT, which ignores case
+    const auto key = [](const QString& relative) { return relative.toCaseFolded(); };
+    const QString extension = QLatin1Char('.') + QLatin1String(run->codec->extension);
+
+    QHash<QString, int> uses;
+    for (const Plan& plan : run->plans)
+        ++uses[key(plan.folder + QLatin1Char('/') + plan.name)];
+
+    // In playlist order, so the same playlist gets the same targets on every sync
+    QSet<QString> taken;
+    for (int row = 0; row < m_jobs.size(); ++row) {
+        const Plan& plan = run->plans[size_t(row)];
+        QString name = plan.name;
+        if (uses.value(key(plan.folder + QLatin1Char('/') + name)) > 1 && plan.trackNumber > 0)
+            name = QStringLiteral("%1 %2").arg(plan.trackNumber, 2, 10, QLatin1Char('0')).arg(name);
+        QString relative = plan.folder + QLatin1Char('/') + name + extension;
+        for (int copy = 2; taken.contains(key(relative)); ++copy)
+            relative = plan.folder + QLatin1Char('/') + name + QStringLiteral(" (%1)").arg(copy) + extension;
+        taken.insert(key(relative));
+
+        Job& job = m_jobs[row];
+        job.target = relative;
+        job.durationMs = plan.durationMs;
+    }
+    if (!m_jobs.isEmpty())
+        emit dataChanged(index(0), index(int(m_jobs.size()) - 1), {TargetRole});
+
+    for (int row = 0; row < m_jobs.size(); ++row) {
+        JobSpec spec;
+        spec.row = row;
+        spec.source = m_jobs.at(row).source;
+        spec.target = m_jobs.at(row).target;
+        spec.durationMs = m_jobs.at(row).durationMs;
+        m_pool.start([this, run, row, spec] {
+            const auto started = [this, run, row] {
+                QMetaObject::invokeMethod(this, [this, run, row] {
+                    onJobStarted(run, row);
+                }, Qt::QueuedConnection);
+            };
+            const auto progress = [this, run, row](double value) {
+                QMetaObject::invokeMethod(this, [this, run, row, value] {
+                    onJobProgress(run, row, value);
+                }, Qt::QueuedConnection);
+            };
+            const JobResult result = runJob(spec, *run, started, progress);
+            QMetaObject::invokeMethod(this, [this, run, row, result] {
+                onJobFinished(run, row, result);
+            }, Qt::QueuedConnection);
+        });
+    }
+}
+
+TranscodeEngine::JobResult TranscodeEngine::runJob(const JobSpec& spec, const Run& run,
+                                                   const std::function<void()>& started,
+                                                   const std::function<void(double)>& progress)
+{
+    JobResult result;
+    if (run.cancelled) {
+        result.status = Status::Cancelled;
+        return result;
+    }
+
+    const QFileInfo source(spec.source);
+    if (!source.isFile()) {
+        result.error = QStringLiteral("Source file not found");
+        return result;
+    }
+
+    const QString& relative = spec.target;
+    const qint64 durationMs = spec.durationMs;
+    started();
+
+    ManifestEntry entry;
+    entry.source = spec.source;
+    entry.size = source.size();
+    entry.mtimeMs = source.lastModified().toMSecsSinceEpoch();
+    entry.profile = run.profile;
+    result.entry = entry;
+
+    // Up to date: unchanged source, or unchanged content behind a new mtime, encoded the same
+    // way. A target without a record is of unknown profile and encoded again.
+    const QString target = run.folder + QLatin1Char('/') + relative;
+    const QFileInfo targetInfo(target);
+    if (targetInfo.isFile()) {
+        const auto previous = run.manifest.constFind(relative);
+        if (previous != run.manifest.constEnd()) {
+            if (previous->source == entry.source && previous->profile == entry.profile && previous->size == entry.size) {
+                if (previous->mtimeMs == entry.mtimeMs) {
+                    result.status = Status::Skipped;
+                    result.entry = *previous;
+                    return result;
+                }
+                result.entry.sha1 = sha1Of(spec.source);
+                if (!result.entry.sha1.isEmpty() && result.entry.sha1 == previous->sha1) {
+                    result.status = Status::Skipped;
+                    return result;
+                }
+            }
+        }
+    }
+
+    if (!QDir().mkpath(targetInfo.absolutePath())) {
+        result.error = QStringLiteral("Could not create the album folder");
+        return result;
+    }
+    // Per job, so a leftover from another run never gets in the way
+    const QString part = target + QStringLiteral(".%1.part").arg(spec.row);
+
+    QProcess ffmpeg;
+    ffmpeg.start(run.ffmpeg, {
+        QStringLiteral("-nostdin"), QStringLiteral("-hide_banner"), QStringLiteral("-nostats"),
+        QStringLiteral("-loglevel"), QStringLiteral("error"),
+        QStringLiteral("-i"), spec.source,
+        QStringLiteral("-map"), QStringLiteral("0:a:0"),
+        QStringLiteral("-map_metadata"), QStringLiteral("-1"),
+        QStringLiteral("-threads"), QStringLiteral("1"),
+        QStringLiteral("-c:a"), QLatin1String(run.codec->encoder),
+        QStringLiteral("-b:a"), QStringLiteral("%1k").arg(run.bitrateKbps),
+        QStringLiteral("-f"), QLatin1String(run.codec->muxer),
+        QStringLiteral("-progress"), QStringLiteral("pipe:1"),
+        QStringLiteral("-y"), part,
+    });
+    if (!ffmpeg.waitForStarted()) {
+        result.error = QStringLiteral("ffmpeg could not be started");
+        return result;
+    }
+
+    QByteArray report;
+    double reported = 0;
+    const auto readProgress = [&] {
+        report += ffmpeg.readAllStandardOutput();
+        qsizetype end;
+        while ((end = report.indexOf('\n')) >= 0) {
+            const QByteArray line = report.left(end).trimmed();
+            report.remove(0, end + 1);
+            // out_time_us (and the misnamed out_time_ms) are microseconds
+            if (durationMs > 0 && (line.startsWith("out_time_us=") || line.startsWith("out_time_ms="))) {
+                const double value = qBound(0.0, line.mid(line.indexOf('=') + 1).toLongLong() / 1000.0 / double(durationMs), 1.0);
+                if (value - reported >= 0.01) {
+                    reported = value;
+                    progress(value);
+                }
+            }
+        }
+    };
+    while (ffmpeg.state() != QProcess::NotRunning && !ffmpeg.waitForFinished(CancelPollMs)) {
+        if (run.cancelled) {
+            ffmpeg.kill();
+            ffmpeg.waitForFinished();
+            QFile::remove(part);
+            result.status = Status::Cancelled;
+            return result;
+        }
+        readProgress();
+    }
+    readProgress();
+
+    if (ffmpeg.exitStatus() != QProcess::NormalExit || ffmpeg.exitCode() != 0) {
+        const QList<QByteArray> errors = ffmpeg.readAllStandardError().trimmed().split('\n');
+        result.error = errors.isEmpty() || errors.last().isEmpty()
+                     ? QStringLiteral("ffmpeg failed with exit code %1").arg(ffmpeg.exitCode())
+                     : QString::fromLocal8Bit(errors.last());
+        QFile::remove(part);
+        return result;
+    }
+
+    if (!copyTags(*run.codec, spec.source, part, result.error)) {
+        QFile::remove(part);
+        return result;
+    }
+    if (result.entry.sha1.isEmpty())
+        result.entry.sha1 = sha1Of(spec.source);
+
+    // Replaces an outdated target in one step
+    std::error_code error;
+    std::filesystem::rename(fsPath(part), fsPath(target), error);
+    if (error) {
+        result.error = QString::fromStdString(error.message());
+        QFile::remove(part);
+        return result;
+    }
+
+    result.status = Status::Done;
+    return result;
+}
+
+void TranscodeEngine::onJobStarted(const std::shared_ptr<Run>& run, int row)
+{
+    if (run != m_run) return;
+    m_jobs[row].status = Status::Running;
+    const QModelIndex changed = index(row);
+    emit dataChanged(changed, changed, {StatusRole});
+}
+
+void TranscodeEngine::onJobProgress(const std::shared_ptr<Run>& run, int row, double progress)
+{
+    if (run != m_run) return;
+    Job& job = m_jobs[row];
+    m_audioMs += (progress - job.progress) * double(job.durationMs);
+    job.progress = progress;
+    const QModelIndex changed = index(row);
+    emit dataChanged(changed, changed, {ProgressRole});
+    emit progressChanged();
+}
+
+void TranscodeEngine::onJobFinished(const std::shared_ptr<Run>& run, int row, const JobResult& result)
+{
+    if (run != m_run) return;
+    Job& job = m_jobs[row];
+    job.status = result.status;
+    job.error = result.error;
+    switch (result.status) {
+    case Status::Done:
+        m_audioMs += (1.0 - job.progress) * double(job.durationMs);
+        job.progress = 1.0;
+        m_manifest.insert(job.target, result.entry);
+        appendJournal(job.target, result.entry);
+        break;
+    case Status::Skipped:
+        job.progress = 1.0;
+        ++m_skipped;
+        m_manifest.insert(job.target, result.entry);
+        break;
+    case Status::Failed:
+        ++m_failed;
+        break;
+    default:
+        break;
+    }
+    ++m_finished;
+    if ((result.status == Status::Done || result.status == Status::Skipped) && !m_manifestTimer.isActive())
+        m_manifestTimer.start();
+
+    const QModelIndex changed = index(row);
+    emit dataChanged(changed, changed, {StatusRole, ProgressRole, ErrorRole});
+    emit progressChanged();
+
+    if (--run->pending == 0)
+        finishRun();
+}
+
+void TranscodeEngine::finishRun()
+{
+    const bool completed = !m_run->cancelled;
+    m_wallMs = m_wallClock.elapsed();
+    m_run.reset();
+    m_manifestTimer.stop();
+    saveManifest();
+    // Failed jobs are retried by the next sync to this folder, not by resume()
+    if (completed)
+        QFile::remove(runFilePath());
+    emit runningChanged();
+    emit resumableChanged();
+    emit progressChanged();
+}
+
+void TranscodeEngine::cancel()
+{
+    if (m_run)
+        m_run->cancelled = true;
+}
+
+bool TranscodeEngine::resumable() const
+{
+    return !m_run && QFileInfo::exists(runFilePath());
+}
+
+double TranscodeEngine::throughput() const
+{
+    const qint64 wallMs = m_run ? m_wallClock.elapsed() : m_wallMs;
+    return wallMs > 0 ? m_audioMs / double(wallMs) : 0.0;
+}
+
+void TranscodeEngine::setError(const QString& error)
+{
+    if (error == m_error) return;
+    m_error = error;
+    emit errorChanged();
+}
+
+QString TranscodeEngine::runFilePath() const
+{
+    return m_stateDirectory + QLatin1Char('/') + QLatin1String(RunFileName);
+}
+
+bool TranscodeEngine::loadManifest(const QString& folder)
+{
+    m_manifest.clear();
+    bool loaded = false;
+    QFile file(folder + QLatin1Char('/') + QLatin1String(ManifestName));
+    if (file.open(QIODevice::ReadOnly)) {
+        QDataStream in(&file);
+        in.setVersion(QDataStream::Qt_6_0);
+        quint32 magic = 0, version = 0, count = 0;
+        in >> magic >> version >> count;
+        if (magic == ManifestMagic && version == FormatVersion) {
+            for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+                QString target;
+                ManifestEntry entry;
+                in >> target >> entry.source >> entry.size >> entry.mtimeMs >> entry.profile >> entry.sha1;
+                m_manifest.insert(target, entry);
+            }
+            loaded = in.status() == QDataStream::Ok;
+            if (!loaded)
+                m_manifest.clear();
+        }
+    }
+
+    // Targets renamed into place after the last save; a torn last entry is dropped
+    QFile journal(folder + QLatin1Char('/') + QLatin1String(JournalName));
+    if (journal.open(QIODevice::ReadOnly)) {
+        QDataStream in(&journal);
+        in.setVersion(QDataStream::Qt_6_0);
+        while (!in.atEnd()) {
+            QString target;
+            ManifestEntry entry;
+            in >> target >> entry.source >> entry.size >> entry.mtimeMs >> entry.profile >> entry.sha1;
+            if (in.status() != QDataStream::Ok)
+                break;
+            m_manifest.insert(target, entry);
+        }
+    }
+    return loaded;
+}
+
+bool TranscodeEngine::saveManifest() const
+{
+    if (m_folder.isEmpty())
+        return false;
+    QSaveFile file(m_folder + QLatin1Char('/') + QLatin1String(ManifestName));
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << ManifestMagic << FormatVersion << quint32(m_manifest.size());
+    for (auto it = m_manifest.constBegin(); it != m_manifest.constEnd(); ++it) {
+        const ManifestEntry& entry = it.value();
+        out << it.key() << entry.source << entry.size << entry.mtimeMs << entry.profile << entry.sha1;
+    }
+    if (!file.commit())
+        return false;
+    QFile::remove(m_folder + QLatin1Char('/') + QLatin1String(JournalName));
+    return true;
+}
+
+void TranscodeEngine::appendJournal(const QString& target, const ManifestEntry& entry) const
+{
+    QFile file(m_folder + QLatin1Char('/') + QLatin1String(JournalName));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append))
+        return;
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << target << entry.source << entry.size << entry.mtimeMs << entry.profile << entry.sha1;
+}
+
+bool TranscodeEngine::saveRunFile(const QString& format, int bitrateKbps) const
+{
+    QStringList sources;
+    sources.reserve(m_jobs.size());
+    for (const Job& job : m_jobs)
+        sources.append(job.source);
+
+    QDir().mkpath(m_stateDirectory);
+    QSaveFile file(runFilePath());
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << RunMagic << FormatVersion << m_folder << format << qint32(bitrateKbps) << sources;
+    return file.commit();
+}
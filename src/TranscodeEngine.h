@@ -0,0 +1,163 @@
+#pragma once
+
+#include <QAbstractListModel>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QTimer>
+#include <QUrl>
+#include <QVector>
+
+#include <functional>
+#include <memory>
+
+class PlaylistModel;
+
+// Converts playlists for portable players. Every local track becomes Opus, MP3 or AAC under a
+// target folder as <artist>/<album>/<file name>.<ext>, with its tags and a front cover scaled
+// to CoverMaxSide copied over by TagLib. Sources that would share a target (01.flac next to
+// 01.mp3, two discs' "01 Intro") get their track number in front, then " (2)" and so on.
+//
+// Jobs run on a pool with one worker per core, each driving a single-threaded ffmpeg (which
+// must be on PATH). Every source's tags are read first, so the targets can be made unique
+// before any encoder starts. Output is written next to the target as .<row>.part and renamed
+// into place, so a target is either complete or absent.
+//
+// A manifest in the target folder (.musicplayer-sync) records size, mtime, SHA-1 and encoding
+// profile of the source of every target; targets finished since it was last saved are
+// appended to a journal beside it. A target is skipped when its source has the same size and
+// mtime, or the same content after a touch, and the profile matches. The run itself (folder,
+// profile, tracks) is kept in the state directory until it completes, so an interrupted sync
+// is resumed with resume().
+//
+// One row per job, for progress views; the properties summarise the run. GUI thread only.
+class TranscodeEngine : public QAbstractListModel {
+    Q_OBJECT
+    Q_PROPERTY(bool running READ running NOTIFY runningChanged)
+    Q_PROPERTY(bool resumable READ resumable NOTIFY resumableChanged)
+    Q_PROPERTY(int jobCount READ rowCount NOTIFY progressChanged)
+    // Done, skipped, failed or cancelled
+    Q_PROPERTY(int finishedCount READ finishedCount NOTIFY progressChanged)
+    Q_PROPERTY(int skippedCount READ skippedCount NOTIFY progressChanged)
+    Q_PROPERTY(int failedCount READ failedCount NOTIFY progressChanged)
+    // Seconds of audio converted per second of wall time, all workers together
+    Q_PROPERTY(double throughput READ throughput NOTIFY progressChanged)
+    Q_PROPERTY(QString error READ error NOTIFY errorChanged)
+
+public:
+    explicit TranscodeEngine(const QString& stateDirectory, QObject* parent = nullptr);
+    ~TranscodeEngine() override;
+
+    enum Roles {
+        SourceRole = Qt::UserRole + 1,
+        TargetRole,   // relative to the target folder
+        StatusRole,   // "queued", "running", "done", "skipped", "failed" or "cancelled"
+        ProgressRole, // 0..1
+        ErrorRole
+    };
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    // format is "opus", "mp3" or "aac". Fails (see error) while a run is active, when ffmpeg
+    // is missing or the folder can't be created.
+    Q_INVOKABLE bool start(PlaylistModel* playlist, const QUrl& targetFolder,
+                           const QString& format = QStringLiteral("opus"), int bitrateKbps = 160);
+    Q_INVOKABLE bool startFromM3U8(const QUrl& playlistFile, const QUrl& targetFolder,
+                                   const QString& format = QStringLiteral("opus"), int bitrateKbps = 160);
+    // Restarts the last run that did not complete; finished targets are skipped
+    Q_INVOKABLE bool resume();
+    // Stops after killing the running encoders; the run stays resumable
+    Q_INVOKABLE void cancel();
+
+    bool running() const { return m_run != nullptr; }
+    bool resumable() const;
+    int finishedCount() const { return m_finished; }
+    int skippedCount() const { return m_skipped; }
+    int failedCount() const { return m_failed; }
+    double throughput() const;
+    QString error() const { return m_error; }
+
+signals:
+    void runningChanged();
+    void resumableChanged();
+    void progressChanged();
+    void errorChanged();
+
+private:
+    enum class Status { Queued, Running, Done, Skipped, Failed, Cancelled };
+
+    struct ManifestEntry {
+        QString source;
+        qint64 size {-1};
+        qint64 mtimeMs {-1};
+        QString profile;
+        QByteArray sha1;
+    };
+
+    struct Job {
+        QString source;
+        QString target;        // relative; known once every job has read its source's tags
+        qint64 durationMs {0};
+        Status status {Status::Queued};
+        double progress {0};
+        QString error;
+    };
+
+    struct JobResult {
+        Status status {Status::Failed};
+        QString error;
+        ManifestEntry entry; // for Done and Skipped
+    };
+
+    // Where a job's output goes, from the source's tags
+    struct Plan {
+        QString folder; // <artist>/<album>, relative
+        QString name;   // without extension
+        int trackNumber {0};
+        qint64 durationMs {0};
+    };
+
+    struct Run;
+    struct JobSpec;
+
+    bool startJobs(const QStringList& sources, const QString& folder, const QString& format, int bitrateKbps);
+    // Worker thread
+    static Plan planJob(const QString& source, const Run& run);
+    void onJobPlanned(const std::shared_ptr<Run>& run, int row, const Plan& plan);
+    // Once every job is planned: makes the targets unique and starts the encoders
+    void scheduleJobs(const std::shared_ptr<Run>& run);
+    // Worker thread
+    static JobResult runJob(const JobSpec& spec, const Run& run,
+                            const std::function<void()>& started,
+                            const std::function<void(double progress)>& progress);
+    void onJobStarted(const std::shared_ptr<Run>& run, int row);
+    void onJobProgress(const std::shared_ptr<Run>& run, int row, double progress);
+    void onJobFinished(const std::shared_ptr<Run>& run, int row, const JobResult& result);
+    void finishRun();
+    void setError(const QString& error);
+
+    bool loadManifest(const QString& folder);
+    bool saveManifest() const;
+    void appendJournal(const QString& target, const ManifestEntry& entry) const;
+    bool saveRunFile(const QString& format, int bitrateKbps) const;
+    QString runFilePath() const;
+
+    QString m_stateDirectory;
+    QThreadPool m_pool;
+    std::shared_ptr<Run> m_run; // null when idle
+    QVector<Job> m_jobs;
+    QString m_folder;
+    QHash<QString, ManifestEntry> m_manifest; // by relative target
+    QTimer m_manifestTimer;
+    QElapsedTimer m_wallClock;
+    qint64 m_wallMs {0};     // of the last run, once it has ended
+    double m_audioMs {0};    // converted so far, from job progress
+    int m_finished {0};
+    int m_skipped {0};
+    int m_failed {0};
+    QString m_error;
+};
@@ -1,31 +1,136 @@
+#include <QCommandLineParser>
 #include <QGuiApplication>
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
 #include <QtQml>
 #include <QQuickWindow>
-#include <QSGRendererInterface>
+#include <QStandardPaths>
 
+#include <memory>
+#include <type_traits>
+
+#include "ControlClient.h"
+#include "ControlServer.h"
+#include "CoverImageProvider.h"
+#include "DuplicateFinder.h"
+#include "FolderBrowserModel.h"
+#include "FrameStats.h"
+#include "GraphicsBackend.h"
+#include "PlayHistory.h"
 #include "PlayerController.h"
 #include "PlaylistModel.h"
+#include "SessionStore.h"
+#include "ShuffleEngine.h"
+#include "StartupTrace.h"
+#include "StreamServer.h"
+#include "TagEditor.h"
 #include "TrackMetadata.h"
+#include "TranscodeEngine.h"
+#include "Telemetry.h"
 
 int main(int argc, char *argv[])
 {
+    StartupTrace& trace = StartupTrace::instance();
     QGuiApplication app(argc, argv);
-    // Force software rendering backend to avoid driver/OpenGL issues
-    QQuickWindow::setGraphicsApi(QSGRendererInterface::Software);
-    qputenv("QSG_RHI_BACKEND", QByteArray("software"));
-    qputenv("QT_QUICK_BACKEND", QByteArray("software"));
-    
+    trace.mark("app");
+
     // Register TrackMetadata for QML
     qmlRegisterType<TrackMetadata>("MusicPlayer", 1, 0, "TrackMetadata");
 
-    PlayerController controller;
-    PlaylistModel playlist;
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    const QCommandLineOption attachOption(QStringLiteral("attach"),
+                                          QStringLiteral("Control a running musicplayerd instead of playing in this process."));
+    const QCommandLineOption socketOption(QStringLiteral("socket"),
+                                          QStringLiteral("Daemon socket to attach to."),
+                                          QStringLiteral("path"), ControlServer::defaultSocketName());
+    const QCommandLineOption streamPortOption(QStringLiteral("stream-port"),
+                                              QStringLiteral("Also serve the output as a FLAC stream over HTTP on <port>."),
+                                              QStringLiteral("port"));
+    const QCommandLineOption graphicsApiOption(QStringLiteral("graphics-api"),
+                                               QStringLiteral("Scene graph backend: %1 (default: the \"graphics/api\" setting, else auto).")
+                                                   .arg(GraphicsBackend::names().join(QStringLiteral(", "))),
+                                               QStringLiteral("api"));
+    parser.addOptions({attachOption, socketOption, streamPortOption, graphicsApiOption});
+    parser.process(app);
+
+    GraphicsBackend::select(parser.value(graphicsApiOption));
+    trace.mark("graphics");
 
+    // Either the engine runs in this process, or a daemon is driven through the same API
+    std::unique_ptr<PlayerController> controller;
+    std::unique_ptr<ControlClient> client;
+    QObject* player = nullptr;
+    if (parser.isSet(attachOption)) {
+        client = std::make_unique<ControlClient>();
+        client->connectToServer(parser.value(socketOption));
+        player = client.get();
+    } else {
+        controller = std::make_unique<PlayerController>();
+        player = controller.get();
+    }
+    std::unique_ptr<StreamServer> stream;
+    if (controller && parser.isSet(streamPortOption)) {
+        stream = std::make_unique<StreamServer>();
+        if (stream->listen(QHostAddress::Any, quint16(parser.value(streamPortOption).toUInt()))) {
+            controller->enableAudioTap(StreamServer::format());
+            QObject::connect(controller.get(), &PlayerController::audioBufferReady, stream.get(), &StreamServer::pushAudio);
+        } else {
+            qWarning() << "HTTP stream not started:" << stream->errorString();
+        }
+    }
+    FolderBrowserModel folderBrowser;
+    trace.mark("player");
+
+    // Restore playlist tabs before QML loads so views bind to populated models
+    SessionStore session(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/session");
+    session.load();
+    const auto journalPosition = [&session](auto* source) {
+        using Source = std::remove_pointer_t<decltype(source)>;
+        QObject::connect(source, &Source::positionChanged, &session, [source, &session] {
+            session.setPosition(source->position());
+        });
+    };
+    if (controller)
+        journalPosition(controller.get());
+    else
+        journalPosition(client.get());
+    QObject::connect(&app, &QCoreApplication::aboutToQuit, &session, &SessionStore::flush);
+    ShuffleEngine shuffle(session.queue());
+    // Plays are recorded where the engine runs: by musicplayerd while attached to it, so the
+    // GUI then has no history of its own (and QML hides the controls over it)
+    std::unique_ptr<PlayHistory> history;
+    if (controller) {
+        history = std::make_unique<PlayHistory>(session.library(), QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/history");
+        history->load();
+        QObject::connect(controller.get(), &PlayerController::trackEnded, history.get(), &PlayHistory::recordPlay);
+        // The track still playing at quit counts too, so it is reported before the flush
+        QObject::connect(&app, &QCoreApplication::aboutToQuit, controller.get(), &PlayerController::reportTrackEnd);
+        QObject::connect(&app, &QCoreApplication::aboutToQuit, history.get(), &PlayHistory::flush);
+    }
+    DuplicateFinder duplicates(session.library(), QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/library");
+    TranscodeEngine transcoder(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/transcode");
+    TagEditor tagEditor;
+    QObject::connect(&tagEditor, &TagEditor::tracksEdited, &session, &SessionStore::applyTagEdits);
+    if (controller)
+        QObject::connect(&tagEditor, &TagEditor::tracksEdited, controller.get(), &PlayerController::refreshMetadata);
+    trace.mark("session");
+
+    // Outlives the engine: the window reports frames until it is gone
+    FrameStats frameStats;
     QQmlApplicationEngine engine;
-    engine.rootContext()->setContextProperty("player", &controller);
-    engine.rootContext()->setContextProperty("playlist", &playlist);
+    engine.rootContext()->setContextProperty("player", player);
+    engine.rootContext()->setContextProperty("playlist", session.queue());
+    engine.rootContext()->setContextProperty("session", &session);
+    engine.rootContext()->setContextProperty("shuffle", &shuffle);
+    engine.rootContext()->setContextProperty("history", history.get());
+    engine.rootContext()->setContextProperty("telemetry", Telemetry::instance());
+    engine.rootContext()->setContextProperty("folderBrowser", &folderBrowser);
+    engine.rootContext()->setContextProperty("transcoder", &transcoder);
+    engine.rootContext()->setContextProperty("duplicates", &duplicates);
+    engine.rootContext()->setContextProperty("tagEditor", &tagEditor);
+    engine.rootContext()->setContextProperty("frameStats", &frameStats);
+    engine.addImageProvider("covers", new CoverImageProvider);
 
     const QUrl url(QStringLiteral("qrc:/qt/qml/MusicPlayer/qml/Main.qml"));
     QObject::connect(&engine, &QQmlApplicationEngine::objectCreated,
@@ -34,6 +139,26 @@ int main(int argc, char *argv[])
             QCoreApplication::exit(-1);
     }, Qt::QueuedConnection);
     engine.load(url);
+    trace.mark("qml");
+
+    // Device enumeration can take a noticeable while on some audio stacks; do it once the
+    // window is on screen
+    if (auto* window = qobject_cast<QQuickWindow*>(engine.rootObjects().value(0))) {
+        GraphicsBackend::windowCreated();
+        frameStats.attach(window);
+        auto firstFrame = std::make_shared<QMetaObject::Connection>();
+        *firstFrame = QObject::connect(window, &QQuickWindow::frameSwapped, &app, [firstFrame, &controller, &trace] {
+            QObject::disconnect(*firstFrame);
+            trace.mark("first frame");
+            GraphicsBackend::firstFrameShown();
+            if (controller)
+                controller->initializeAudioDevices();
+            trace.mark("audio devices");
+            trace.finish();
+        }, Qt::QueuedConnection);
+    } else if (controller) {
+        controller->initializeAudioDevices();
+    }
 
     return app.exec();
 }
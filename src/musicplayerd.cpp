@@ -0,0 +1,109 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QStandardPaths>
+
+#include "ControlServer.h"
+#include "PlayHistory.h"
+#include "PlayerController.h"
+#include "SessionStore.h"
+#include "StreamServer.h"
+
+#ifdef Q_OS_UNIX
+#include <QSocketNotifier>
+
+#include <csignal>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+int signalPipe[2] = {-1, -1};
+
+void onTerminate(int)
+{
+    const char byte = 1;
+    [[maybe_unused]] const ssize_t written = ::write(signalPipe[1], &byte, 1);
+}
+
+// SIGTERM/SIGINT end the event loop normally, so the session is flushed on the way out
+void quitOnTerminate(QCoreApplication& app)
+{
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, signalPipe) != 0)
+        return;
+    auto* notifier = new QSocketNotifier(signalPipe[0], QSocketNotifier::Read, &app);
+    QObject::connect(notifier, &QSocketNotifier::activated, &app, &QCoreApplication::quit);
+
+    struct sigaction action {};
+    action.sa_handler = onTerminate;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    ::sigaction(SIGTERM, &action, nullptr);
+    ::sigaction(SIGINT, &action, nullptr);
+}
+
+} // namespace
+#endif
+
+// Headless playback engine: no display server, no QML. Controlled over ControlServer's
+// socket by scripts or by the GUI started with --attach.
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("musicplayerd"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Headless music player controlled over a local socket"));
+    parser.addHelpOption();
+    const QCommandLineOption socketOption(QStringLiteral("socket"),
+                                          QStringLiteral("Listen on <path> instead of the default socket."),
+                                          QStringLiteral("path"), ControlServer::defaultSocketName());
+    const QCommandLineOption streamPortOption(QStringLiteral("stream-port"),
+                                              QStringLiteral("Also serve the output as a FLAC stream over HTTP on <port>."),
+                                              QStringLiteral("port"));
+    parser.addOptions({socketOption, streamPortOption});
+    parser.process(app);
+
+    SessionStore session(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/session");
+    session.load();
+    QObject::connect(&app, &QCoreApplication::aboutToQuit, &session, &SessionStore::flush);
+
+    ControlServer server(&session);
+    if (!server.listen(parser.value(socketOption))) {
+        qCritical().noquote() << "musicplayerd:" << server.errorString();
+        return 1;
+    }
+    qInfo().noquote() << "musicplayerd: listening on" << parser.value(socketOption);
+
+    PlayHistory history(session.library(), QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/history");
+    history.load();
+    PlayerController* engine = nullptr;
+    QObject::connect(&server, &ControlServer::engineCreated, &history, [&history, &engine](PlayerController* player) {
+        engine = player;
+        QObject::connect(player, &PlayerController::trackEnded, &history, &PlayHistory::recordPlay);
+    });
+    // The track still playing at quit counts too, so it is reported before the flush
+    QObject::connect(&app, &QCoreApplication::aboutToQuit, &history, [&history, &engine] {
+        if (engine)
+            engine->reportTrackEnd();
+        history.flush();
+    });
+
+    StreamServer stream;
+    if (parser.isSet(streamPortOption)) {
+        if (!stream.listen(QHostAddress::Any, quint16(parser.value(streamPortOption).toUInt()))) {
+            qCritical().noquote() << "musicplayerd: stream:" << stream.errorString();
+            return 1;
+        }
+        QObject::connect(&server, &ControlServer::engineCreated, &stream, [&stream](PlayerController* player) {
+            player->enableAudioTap(StreamServer::format());
+            QObject::connect(player, &PlayerController::audioBufferReady, &stream, &StreamServer::pushAudio);
+        });
+        qInfo().noquote() << "musicplayerd: streaming on port" << parser.value(streamPortOption);
+    }
+
+#ifdef Q_OS_UNIX
+    quitOnTerminate(app);
+#endif
+    return app.exec();
+}